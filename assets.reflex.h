@@ -0,0 +1,149 @@
+
+////////////////////////////////////////////////////////////////////////
+// Includes
+#include <stddef.h> // for offsetof macro
+
+
+////////////////////////////////////////////////////////////////////////
+// enum GeometryType
+
+// ReflexEnumerator info
+static const ReflexEnumerator reflexEnumerators_GeometryType[] = {
+  { .name = "GeometryTypeCube", .value = 0, },
+  { .name = "GeometryTypePlane", .value = 1, },
+  { .name = "GeometryTypeScreen", .value = 2, },
+};
+
+// ReflexEnum info
+static const ReflexEnum reflexEnum_GeometryType =
+{
+  .name = "GeometryType",
+  .enumerators = reflexEnumerators_GeometryType,
+  .enumeratorCount = ARRAY_COUNT(reflexEnumerators_GeometryType),
+};
+
+// ReflexEnum registration
+static const ReflexID ReflexID_GeometryType = ReflexRegisterEnum(&reflexEnum_GeometryType);
+
+
+////////////////////////////////////////////////////////////////////////
+// struct float3
+
+// ReflexMember info
+static const ReflexMember reflexMembers_float3[] = {
+  { .name = "x", .isConst = false, .pointerCount = 0, .isArray = false, .arrayDim = 0, .reflexId = ReflexID_Float, .offset = offsetof(float3, x) },
+  { .name = "y", .isConst = false, .pointerCount = 0, .isArray = false, .arrayDim = 0, .reflexId = ReflexID_Float, .offset = offsetof(float3, y) },
+  { .name = "z", .isConst = false, .pointerCount = 0, .isArray = false, .arrayDim = 0, .reflexId = ReflexID_Float, .offset = offsetof(float3, z) },
+};
+
+// ReflexStruct info
+static const ReflexStruct reflexStruct_float3 =
+{
+  .name = "float3",
+  .members = reflexMembers_float3,
+  .memberCount = ARRAY_COUNT(reflexMembers_float3),
+  .size = sizeof(float3),
+};
+
+// ReflexStruct registration
+static const ReflexID ReflexID_float3 = ReflexRegisterStruct(&reflexStruct_float3);
+
+
+////////////////////////////////////////////////////////////////////////
+// struct TextureDesc
+
+// ReflexMember info
+static const ReflexMember reflexMembers_TextureDesc[] = {
+  { .name = "name", .isConst = true, .pointerCount = 1, .isArray = false, .arrayDim = 0, .reflexId = ReflexID_Char, .offset = offsetof(TextureDesc, name) },
+  { .name = "filename", .isConst = true, .pointerCount = 1, .isArray = false, .arrayDim = 0, .reflexId = ReflexID_Char, .offset = offsetof(TextureDesc, filename) },
+  { .name = "mipmap", .isConst = false, .pointerCount = 0, .isArray = false, .arrayDim = 0, .reflexId = ReflexID_Int, .offset = offsetof(TextureDesc, mipmap) },
+};
+
+// ReflexStruct info
+static const ReflexStruct reflexStruct_TextureDesc =
+{
+  .name = "TextureDesc",
+  .members = reflexMembers_TextureDesc,
+  .memberCount = ARRAY_COUNT(reflexMembers_TextureDesc),
+  .size = sizeof(TextureDesc),
+};
+
+// ReflexStruct registration
+static const ReflexID ReflexID_TextureDesc = ReflexRegisterStruct(&reflexStruct_TextureDesc);
+
+
+////////////////////////////////////////////////////////////////////////
+// struct MaterialDesc
+
+// ReflexMember info
+static const ReflexMember reflexMembers_MaterialDesc[] = {
+  { .name = "name", .isConst = true, .pointerCount = 1, .isArray = false, .arrayDim = 0, .reflexId = ReflexID_Char, .offset = offsetof(MaterialDesc, name) },
+  { .name = "textureName", .isConst = true, .pointerCount = 1, .isArray = false, .arrayDim = 0, .reflexId = ReflexID_Char, .offset = offsetof(MaterialDesc, textureName) },
+  { .name = "pipelineName", .isConst = true, .pointerCount = 1, .isArray = false, .arrayDim = 0, .reflexId = ReflexID_Char, .offset = offsetof(MaterialDesc, pipelineName) },
+  { .name = "uvScale", .isConst = false, .pointerCount = 0, .isArray = false, .arrayDim = 0, .reflexId = ReflexID_Float, .offset = offsetof(MaterialDesc, uvScale) },
+};
+
+// ReflexStruct info
+static const ReflexStruct reflexStruct_MaterialDesc =
+{
+  .name = "MaterialDesc",
+  .members = reflexMembers_MaterialDesc,
+  .memberCount = ARRAY_COUNT(reflexMembers_MaterialDesc),
+  .size = sizeof(MaterialDesc),
+};
+
+// ReflexStruct registration
+static const ReflexID ReflexID_MaterialDesc = ReflexRegisterStruct(&reflexStruct_MaterialDesc);
+
+
+////////////////////////////////////////////////////////////////////////
+// struct EntityDesc
+
+// ReflexMember info
+static const ReflexMember reflexMembers_EntityDesc[] = {
+  { .name = "name", .isConst = true, .pointerCount = 1, .isArray = false, .arrayDim = 0, .reflexId = ReflexID_Char, .offset = offsetof(EntityDesc, name) },
+  { .name = "materialName", .isConst = true, .pointerCount = 1, .isArray = false, .arrayDim = 0, .reflexId = ReflexID_Char, .offset = offsetof(EntityDesc, materialName) },
+  { .name = "pos", .isConst = false, .pointerCount = 0, .isArray = false, .arrayDim = 0, .reflexId = ReflexID_float3, .offset = offsetof(EntityDesc, pos) },
+  { .name = "scale", .isConst = false, .pointerCount = 0, .isArray = false, .arrayDim = 0, .reflexId = ReflexID_Float, .offset = offsetof(EntityDesc, scale) },
+  { .name = "geometryType", .isConst = false, .pointerCount = 0, .isArray = false, .arrayDim = 0, .reflexId = ReflexID_GeometryType, .offset = offsetof(EntityDesc, geometryType) },
+};
+
+// ReflexStruct info
+static const ReflexStruct reflexStruct_EntityDesc =
+{
+  .name = "EntityDesc",
+  .members = reflexMembers_EntityDesc,
+  .memberCount = ARRAY_COUNT(reflexMembers_EntityDesc),
+  .size = sizeof(EntityDesc),
+};
+
+// ReflexStruct registration
+static const ReflexID ReflexID_EntityDesc = ReflexRegisterStruct(&reflexStruct_EntityDesc);
+
+
+////////////////////////////////////////////////////////////////////////
+// struct Assets
+
+// ReflexMember info
+static const ReflexMember reflexMembers_Assets[] = {
+  { .name = "textures", .isConst = true, .pointerCount = 1, .isArray = false, .arrayDim = 0, .reflexId = ReflexID_TextureDesc, .offset = offsetof(Assets, textures) },
+  { .name = "texturesCount", .isConst = false, .pointerCount = 0, .isArray = false, .arrayDim = 0, .reflexId = ReflexID_UnsignedInt, .offset = offsetof(Assets, texturesCount) },
+  { .name = "materials", .isConst = true, .pointerCount = 1, .isArray = false, .arrayDim = 0, .reflexId = ReflexID_MaterialDesc, .offset = offsetof(Assets, materials) },
+  { .name = "materialsCount", .isConst = false, .pointerCount = 0, .isArray = false, .arrayDim = 0, .reflexId = ReflexID_UnsignedInt, .offset = offsetof(Assets, materialsCount) },
+  { .name = "entities", .isConst = true, .pointerCount = 1, .isArray = false, .arrayDim = 0, .reflexId = ReflexID_EntityDesc, .offset = offsetof(Assets, entities) },
+  { .name = "entitiesCount", .isConst = false, .pointerCount = 0, .isArray = false, .arrayDim = 0, .reflexId = ReflexID_UnsignedInt, .offset = offsetof(Assets, entitiesCount) },
+  { .name = "arrayTest", .isConst = false, .pointerCount = 0, .isArray = true, .arrayDim = 2, .reflexId = ReflexID_Int, .offset = offsetof(Assets, arrayTest) },
+};
+
+// ReflexStruct info
+static const ReflexStruct reflexStruct_Assets =
+{
+  .name = "Assets",
+  .members = reflexMembers_Assets,
+  .memberCount = ARRAY_COUNT(reflexMembers_Assets),
+  .size = sizeof(Assets),
+};
+
+// ReflexStruct registration
+static const ReflexID ReflexID_Assets = ReflexRegisterStruct(&reflexStruct_Assets);
+
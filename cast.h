@@ -58,6 +58,9 @@
 #define cast_f32 f32
 #define CastString String
 #define CastArena Arena
+#define CastTempArena TempArena
+#define CastBeginTempArena BeginTempArena
+#define CastEndTempArena EndTempArena
 #define CastMemSet MemSet
 #define CastPushStruct PushStruct
 #define CastPushZeroStruct PushZeroStruct
@@ -1179,11 +1182,11 @@ static bool Cast_IsTypedef( const CastExternalDeclaration *externalDeclaration,
 }
 
 #define CAST_BACKUP() \
-	CastArena backupArena = *parser.arena; \
+	CastTempArena tempArena = CastBeginTempArena(*parser.arena); \
 	cast_u32 nextTokenBackup = parser.nextToken;
 
 #define CAST_RESTORE() \
-	*parser.arena = backupArena; \
+	CastEndTempArena(tempArena); \
 	parser.nextToken = nextTokenBackup;
 
 #define CAST_NODE( TypeName ) \
@@ -35,6 +35,7 @@ struct ClonGlobalsList
 struct Clon
 {
 	ClonGlobalsList *globalsList;
+	HashMap globalsMap; // From global name to ClonGlobal pointer
 };
 
 void ClonAddGlobal(Clon *clon, Arena *arena, const char *typeName, const char *name, void *data, u32 elemCount)
@@ -53,50 +54,24 @@ void ClonAddGlobal(Clon *clon, Arena *arena, const char *typeName, const char *n
 	global->name = name;
 	global->data = data;
 	global->elemCount = elemCount;
-}
-
-const ClonGlobal *ClonGetGlobal(const Clon *clon, const char *type_name, const char *global_name)
-{
-	const ClonGlobalsList *list = clon->globalsList;
 
-	while (list)
+	if (!clon->globalsMap.entries)
 	{
-		for (u32 i = 0; i < list->globalsCount; ++i)
-		{
-			const ClonGlobal *global = &list->globals[i];
-
-			if (StrEq(global->typeName, type_name) && StrEq(global->name, global_name))
-			{
-				return global;
-			}
-		}
-
-		list = list->next;
+		clon->globalsMap = MakeHashMap(*arena);
 	}
-
-	return NULL;
+	HashMapInsert(clon->globalsMap, MakeString(name), (u64)global);
 }
 
 const ClonGlobal *ClonGetGlobal(const Clon *clon, const char *global_name)
 {
-	const ClonGlobalsList *list = clon->globalsList;
-
-	while (list)
-	{
-		for (u32 i = 0; i < list->globalsCount; ++i)
-		{
-			const ClonGlobal *global = &list->globals[i];
-
-			if (StrEq(global->name, global_name))
-			{
-				return global;
-			}
-		}
-
-		list = list->next;
-	}
+	const u64 *global = HashMapFind(clon->globalsMap, MakeString(global_name));
+	return global ? (const ClonGlobal *)*global : NULL;
+}
 
-	return NULL;
+const ClonGlobal *ClonGetGlobal(const Clon *clon, const char *type_name, const char *global_name)
+{
+	const ClonGlobal *global = ClonGetGlobal(clon, global_name);
+	return global && StrEq(global->typeName, type_name) ? global : NULL;
 }
 
 void ClonFillTrivial(const Clon *clon, Arena *arena, void *dataPtr, ReflexID reflexId, const CastInitializer *initializer)
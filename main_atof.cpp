@@ -1,65 +1,239 @@
 #include "tools.h"
-#include <stdlib.h> // atof
+#include <stdlib.h> // strtof, strtol
 
 #define TEST_FUNCTIONALITY 1
 #define TEST_PERFORMANCE 1
 
-f32 myatof(const char *str)
+#define DATASET_COUNT 1000000
+#define BENCH_ROUNDS 5
+
+struct Dataset
 {
-	f32 value = StrToFloat(str);
-	return value;
+	const char *name;
+	char *text; // numbers separated by new lines
+	u32 textSize;
+	String *numbers;
+	u32 count;
+};
+
+static u64 gRandomState = 0x2545f4914f6cdd1dull;
+
+u32 Random()
+{
+	gRandomState ^= gRandomState << 13;
+	gRandomState ^= gRandomState >> 7;
+	gRandomState ^= gRandomState << 17;
+	return (u32)gRandomState;
 }
 
-int main()
+u32 FloatBits(f32 value)
+{
+	union { f32 value; u32 bits; } pun = { value };
+	return pun.bits;
+}
+
+// Random bit patterns, so every magnitude is there, printed with enough digits to round-trip
+u32 PrintRandomFloat(char *buffer, u32 size)
+{
+	f32 value;
+	do {
+		union { u32 bits; f32 value; } pun = { Random() };
+		value = pun.value;
+	} while ( !isfinite(value) );
+	return snprintf(buffer, size, "%.9g", value);
+}
+
+// Like coordinates and colors in asset files
+u32 PrintShortDecimal(char *buffer, u32 size)
+{
+	const f32 value = (Random() % 2000000) / 1000.0f - 1000.0f;
+	return snprintf(buffer, size, "%.*f", 1 + Random() % 3, value);
+}
+
+// Like indices and counts in asset files, with all lengths up to 10 digits
+u32 PrintInteger(char *buffer, u32 size)
+{
+	const i32 value = (i32)(Random() >> (Random() % 32));
+	return snprintf(buffer, size, "%d", Random() % 2 ? value : -value);
+}
+
+Dataset MakeDataset(Arena &arena, const char *name, u32 (*print)(char *, u32), u32 count)
+{
+	Dataset dataset = {};
+	dataset.name = name;
+	dataset.numbers = PushArray(arena, String, count);
+	dataset.count = count;
+	dataset.text = (char*)PushSize(arena, 0);
+	for (u32 i = 0; i < count; ++i)
+	{
+		char buffer[64];
+		const u32 size = print(buffer, sizeof(buffer));
+		char *number = PushArray(arena, char, size + 1);
+		MemCopy(number, buffer, size);
+		number[size] = '\n';
+		dataset.numbers[i] = MakeString(number, size);
+	}
+	dataset.textSize = (u32)((char*)PushSize(arena, 0) - dataset.text);
+	*PushSize(arena, 1) = 0;
+	return dataset;
+}
+
+bool CheckNumber(const char *str, u32 size)
+{
+	char buffer[512];
+	ASSERT(size < sizeof(buffer));
+	for (u32 i = 0; i < size; ++i) buffer[i] = str[i];
+	buffer[size] = 0;
+
+	const f32 expected = strtof(buffer, NULL);
+	const f32 terminated = StrToFloat(buffer);
+	const f32 sized = StrToFloat(str, size);
+	if ( FloatBits(expected) != FloatBits(terminated) || FloatBits(expected) != FloatBits(sized) )
+	{
+		LOG(Error, "- %s: strtof %.9g, StrToFloat %.9g (sized %.9g)\n", buffer, expected, terminated, sized);
+		return false;
+	}
+	return true;
+}
+
+bool TestFunctionality(const Dataset *datasets, u32 datasetsCount, const Dataset &integers)
 {
 	const char *numbers [] = {
 		"0", "0.0f", "10.54", "10.54f", ".43", ".43f", "5.f",
-		"-0", "-0.0f", "-10.54", "-10.54f", "-.43", "-.43f", "-5.f"
+		"-0", "-0.0f", "-10.54", "-10.54f", "-.43", "-.43f", "-5.f",
+		"1e10", "1E-10", "2.5e+3f", "7e", "7e+", "0e999", "1e-999", "1e39", "-1e39",
+		"3.4028235e38", "3.4028236e38", "1.17549435e-38", "1.4e-45", "7e-46", "8e-46",
+		"0.1", "0.3", "16777216", "16777217", "16777219", "4294967296", "123456789012345678901234567890",
+		"1.000000059604644775390625", "1.000000059604644775390625000000000000001",
+		"1.00000017881393432617187499999999999999", "0.000000000000000000000000000000000000000000001401298464324817",
+		"3.14159265358979323846264338327950288419716939937510", "00000000000000000000000001.5",
+		"0.00000000000000000000000000000000000000000000000000000000000000000001e60",
 	};
 
-#if TEST_FUNCTIONALITY
-	LOG(Info, "Functional test:\n");
-
+	u32 failures = 0;
 	for ( u32 i = 0; i < ARRAY_COUNT(numbers); ++i )
 	{
-		const char *numberStr = numbers[i];
-		LOG(Info, "- atof: %f\n", atof(numberStr));
-		LOG(Info, "- myatof: %f\n", myatof(numberStr));
+		failures += CheckNumber(numbers[i], StrLen(numbers[i])) ? 0 : 1;
 	}
-#endif
 
-#if TEST_PERFORMANCE
-	LOG(Info, "Performance test:\n");
+	for ( u32 i = 0; i < datasetsCount; ++i )
+	{
+		const Dataset &dataset = datasets[i];
+		for ( u32 j = 0; j < dataset.count && failures < 20; ++j )
+		{
+			failures += CheckNumber(dataset.numbers[j].str, dataset.numbers[j].size) ? 0 : 1;
+		}
+	}
 
+	for ( u32 i = 0; i < integers.count && failures < 20; ++i )
+	{
+		const String number = integers.numbers[i];
+		const i32 expected = (i32)strtol(number.str, NULL, 10);
+		if ( StrToInt(number) != expected )
+		{
+			LOG(Error, "- %.*s: strtol %d, StrToInt %d\n", number.size, number.str, expected, StrToInt(number));
+			failures++;
+		}
+	}
+
+	LOG(Info, "- %s\n", failures == 0 ? "OK (same bits as strtof, same integers as strtol)" : "FAILED");
+	return failures == 0;
+}
+
+void TestPerformance(const Dataset &dataset)
+{
 	f32 sum = 0.0f;
+	f32 libcSeconds = 1e9f;
+	f32 toolsSeconds = 1e9f;
 
-	Clock c0 = GetClock();
-	for ( u32 j = 0; j < 999999; ++j )
+	for ( u32 round = 0; round < BENCH_ROUNDS; ++round )
 	{
-		for ( u32 i = 0; i < ARRAY_COUNT(numbers); ++i )
+		Clock c0 = GetClock();
+		const char *str = dataset.text;
+		for ( u32 i = 0; i < dataset.count; ++i )
 		{
-			const char *numberStr = numbers[i];
-			sum += atof(numberStr);
+			char *end;
+			sum += strtof(str, &end);
+			str = end + 1;
 		}
+
+		Clock c1 = GetClock();
+		for ( u32 i = 0; i < dataset.count; ++i )
+		{
+			sum += StrToFloat(dataset.numbers[i]);
+		}
+
+		Clock c2 = GetClock();
+		libcSeconds = Min(libcSeconds, GetSecondsElapsed(c0, c1));
+		toolsSeconds = Min(toolsSeconds, GetSecondsElapsed(c1, c2));
 	}
 
-	Clock c1 = GetClock();
-	for ( u32 j = 0; j < 999999; ++j )
+	const f32 megabytes = dataset.textSize / (1024.0f * 1024.0f);
+	LOG(Info, "- %s (%u numbers, %.1f MB):\n", dataset.name, dataset.count, megabytes);
+	LOG(Info, "  - strtof:     %8.2f MB/s %8.2f ns/number\n", megabytes / libcSeconds, 1e9f * libcSeconds / dataset.count);
+	LOG(Info, "  - StrToFloat: %8.2f MB/s %8.2f ns/number\n", megabytes / toolsSeconds, 1e9f * toolsSeconds / dataset.count, sum);
+	// NOTE: The last unused argument 'sum' is to avoid optimizing the loops
+}
+
+void TestIntegerPerformance(const Dataset &dataset)
+{
+	i32 sum = 0;
+	f32 libcSeconds = 1e9f;
+	f32 toolsSeconds = 1e9f;
+
+	for ( u32 round = 0; round < BENCH_ROUNDS; ++round )
 	{
-		for ( u32 i = 0; i < ARRAY_COUNT(numbers); ++i )
+		Clock c0 = GetClock();
+		const char *str = dataset.text;
+		for ( u32 i = 0; i < dataset.count; ++i )
+		{
+			char *end;
+			sum += (i32)strtol(str, &end, 10);
+			str = end + 1;
+		}
+
+		Clock c1 = GetClock();
+		for ( u32 i = 0; i < dataset.count; ++i )
 		{
-			const char *numberStr = numbers[i];
-			sum += myatof(numberStr);
+			sum += StrToInt(dataset.numbers[i]);
 		}
+
+		Clock c2 = GetClock();
+		libcSeconds = Min(libcSeconds, GetSecondsElapsed(c0, c1));
+		toolsSeconds = Min(toolsSeconds, GetSecondsElapsed(c1, c2));
 	}
 
-	Clock c2 = GetClock();
+	const f32 megabytes = dataset.textSize / (1024.0f * 1024.0f);
+	LOG(Info, "- %s (%u numbers, %.1f MB):\n", dataset.name, dataset.count, megabytes);
+	LOG(Info, "  - strtol:     %8.2f MB/s %8.2f ns/number\n", megabytes / libcSeconds, 1e9f * libcSeconds / dataset.count);
+	LOG(Info, "  - StrToInt:   %8.2f MB/s %8.2f ns/number\n", megabytes / toolsSeconds, 1e9f * toolsSeconds / dataset.count, sum);
+}
 
-	LOG(Info, "- atof: %f seconds\n", GetSecondsElapsed(c0, c1), sum);
-	LOG(Info, "- myatof: %f seconds\n", GetSecondsElapsed(c1, c2), sum);
-	// NOTE: The last unused argument 'sum' is to avoid optimizing the loops
+int main()
+{
+	Arena arena = MakeGrowableArena(GB(1));
+
+	const Dataset datasets[] = {
+		MakeDataset(arena, "random floats", PrintRandomFloat, DATASET_COUNT),
+		MakeDataset(arena, "short decimals", PrintShortDecimal, DATASET_COUNT),
+	};
+	const Dataset integers = MakeDataset(arena, "integers", PrintInteger, DATASET_COUNT);
+
+	bool ok = true;
+
+#if TEST_FUNCTIONALITY
+	LOG(Info, "Functional test:\n");
+	ok = TestFunctionality(datasets, ARRAY_COUNT(datasets), integers);
 #endif
 
-	return 0;
-}
+#if TEST_PERFORMANCE
+	LOG(Info, "Performance test:\n");
+	for ( u32 i = 0; i < ARRAY_COUNT(datasets); ++i )
+	{
+		TestPerformance(datasets[i]);
+	}
+	TestIntegerPerformance(integers);
+#endif
 
+	return ok ? 0 : -1;
+}
@@ -0,0 +1,1362 @@
+// Differential fuzzer and performance-regression harness for jsl.
+//
+// Random valid programs are generated from a string of bytes and run through the different
+// execution paths of the interpreter: the reference one (serial scan, whole program in a single
+// slice) and the alternative ones (parallel scan in chunks, execution in small slices). All of
+// them must print exactly the same output and take exactly the same number of steps.
+//
+// Fast paths selected at compile time (SCAN_USE_SIMD, ARRAY_USE_SIMD) are compared across builds
+// instead: a baseline recorded with one build stores a hash of the output and the execution time
+// of each program, and comparing another build against it flags programs whose output changed or
+// that got slower. Note that sum() and dot() reassociate additions in their vectorized versions,
+// so arrays of 8+ non-integer numbers can legitimately differ in the last bits across builds.
+//
+// Standalone driver (make main_fuzz):
+//   main_fuzz [--seeds <count>] [--first <seed>] [--record <baseline>] [--compare <baseline>]
+//   main_fuzz --print <seed>
+//
+// libFuzzer target (mismatches abort so the input gets saved):
+//   clang++ -g -O1 -fsanitize=fuzzer,address -DJSL_LIBFUZZER=1 -o jsl_fuzz main_fuzz.cpp -pthread
+
+#define JSL_NO_MAIN
+#include "main_interpreter.cpp"
+
+#include <stdarg.h> // va_list
+#include <unistd.h> // dup, dup2
+
+#ifndef JSL_LIBFUZZER
+#define JSL_LIBFUZZER 0
+#endif
+
+#define FUZZ_ARENA_SIZE MB(64)
+#define FUZZ_RUNTIME_ARENA_SIZE MB(16) // carved from the one above for each run
+#define FUZZ_MAX_SCRIPT_SIZE KB(16)   // generation stops past this size
+#define FUZZ_SCRIPT_CAPACITY KB(32)   // a statement can overflow the size above a bit
+#define FUZZ_MAX_OUTPUT_SIZE MB(1)
+#define FUZZ_MAX_STEPS 2000000        // programs running longer are not compared
+#define FUZZ_MAX_NAMES 512
+#define FUZZ_MAX_EXPR_DEPTH 4
+#define FUZZ_MAX_BLOCK_DEPTH 3
+#define FUZZ_INPUT_SIZE KB(4)         // bytes generated per seed in the standalone driver
+#define FUZZ_TIMING_RUNS 5            // the fastest run is the one reported
+#define FUZZ_RETIMING_RUNS 25         // of programs that looked slower than in the baseline
+#define FUZZ_SLOWER_RATIO 1.25f       // tolerance of the timing gate...
+#define FUZZ_SLOWER_MICROSECONDS 50   // ...and its absolute slack, timings of small scripts are noisy
+
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Program generator
+
+// Programs are generated from the input bytes, every byte picks one of the options of a grammar
+// rule. The option 0 is always the one closing the rule, so generation ends once the input is
+// exhausted. Expressions are typed, so generated programs never mix numbers and booleans in
+// arithmetic, and loops are bounded by counters the rest of the program never assigns.
+
+struct FuzzInput
+{
+	const u8 *data;
+	u32 size;
+	u32 cursor;
+};
+
+enum FuzzNameType
+{
+	FUZZ_NUMBER,
+	FUZZ_BOOL,
+	FUZZ_COUNTER,   // read-only number driving a loop
+	FUZZ_ARRAY,
+	FUZZ_MAP,
+	FUZZ_CLASS,
+	FUZZ_INSTANCE,
+	FUZZ_FUNCTION,
+	FUZZ_GENERATOR, // function yielding numbers, to be run as a coroutine
+	FUZZ_COROUTINE,
+};
+
+struct FuzzName
+{
+	u8 type;
+	u8 count;       // arity of functions and minimum length of arrays
+	bool strings;   // maps with string keys, whose iteration order is not deterministic
+	char str[7];
+};
+
+struct FuzzGenerator
+{
+	FuzzInput input;
+
+	char *text;
+	u32 size;
+	u32 capacity;
+
+	FuzzName names[FUZZ_MAX_NAMES];
+	u32 namesCount;
+	u32 nextId;
+
+	u32 blockDepth;
+	u32 loopDepth;
+	bool inFunction;
+	bool inGenerator;
+};
+
+u32 Choose(FuzzGenerator &gen, u32 count)
+{
+	FuzzInput &input = gen.input;
+	const u32 choice = input.cursor < input.size ? input.data[input.cursor++] % count : 0;
+	return choice;
+}
+
+void Emit(FuzzGenerator &gen, const char *format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	const int size = vsnprintf(gen.text + gen.size, gen.capacity - gen.size, format, args);
+	va_end(args);
+	ASSERT( size >= 0 && gen.size + size < gen.capacity );
+	gen.size += size;
+}
+
+void EmitIndent(FuzzGenerator &gen)
+{
+	for (u32 i = 0; i < gen.blockDepth; ++i) Emit(gen, "\t");
+}
+
+FuzzName MakeName(FuzzGenerator &gen, FuzzNameType type, const char *prefix, u32 count = 0)
+{
+	FuzzName name = {};
+	name.type = type;
+	name.count = count;
+	snprintf(name.str, sizeof(name.str), "%s%u", prefix, gen.nextId++);
+	return name;
+}
+
+// Names become visible once declared, after generating the initializers that can't use them
+void DeclareName(FuzzGenerator &gen, const FuzzName &name)
+{
+	ASSERT( gen.namesCount < FUZZ_MAX_NAMES );
+	gen.names[gen.namesCount++] = name;
+}
+
+// Picks one of the visible names of the given type, or returns null if there are none
+const FuzzName *PickName(FuzzGenerator &gen, FuzzNameType type)
+{
+	u32 count = 0;
+	for (u32 i = 0; i < gen.namesCount; ++i)
+	{
+		count += gen.names[i].type == type ? 1 : 0;
+	}
+	if ( count == 0 )
+	{
+		return 0;
+	}
+
+	u32 pick = Choose(gen, count);
+	for (u32 i = 0; i < gen.namesCount; ++i)
+	{
+		if ( gen.names[i].type == type && pick-- == 0 )
+		{
+			return &gen.names[i];
+		}
+	}
+	INVALID_CODE_PATH();
+	return 0;
+}
+
+void EmitNumberLiteral(FuzzGenerator &gen)
+{
+	static const char *literals[] = { "0", "1", "2", "3", "7", "10", "0.5", "2.25", "100", "1024" };
+	Emit(gen, "%s", literals[Choose(gen, ARRAY_COUNT(literals))]);
+}
+
+void EmitMapKey(FuzzGenerator &gen, const FuzzName &map)
+{
+	if ( map.strings )
+	{
+		Emit(gen, "\"k%u\"", Choose(gen, 4));
+	}
+	else
+	{
+		Emit(gen, "%u", Choose(gen, 6));
+	}
+}
+
+void GenNumber(FuzzGenerator &gen, u32 depth, bool atom);
+void GenBool(FuzzGenerator &gen, u32 depth, bool atom);
+
+void GenArguments(FuzzGenerator &gen, u32 count, u32 depth)
+{
+	for (u32 i = 0; i < count; ++i)
+	{
+		if ( i > 0 ) Emit(gen, ", ");
+		GenNumber(gen, depth + 1, false);
+	}
+}
+
+// Generates an expression evaluating to a number. Atoms are wrapped in parentheses if needed,
+// to be used as operands of unary operators.
+void GenNumber(FuzzGenerator &gen, u32 depth, bool atom)
+{
+	const u32 choice = depth < FUZZ_MAX_EXPR_DEPTH ? Choose(gen, 13) : Choose(gen, 3);
+	const FuzzName *name = 0;
+
+	if ( choice == 1 || choice == 2 )
+	{
+		name = PickName(gen, choice == 1 ? FUZZ_NUMBER : FUZZ_COUNTER);
+		if ( name )
+		{
+			Emit(gen, "%s", name->str);
+			return;
+		}
+	}
+	else if ( choice >= 3 && choice <= 6 )
+	{
+		static const char *operators[] = { "+", "-", "*", "/" };
+		if ( atom ) Emit(gen, "(");
+		GenNumber(gen, depth + 1, false);
+		Emit(gen, " %s ", operators[choice - 3]);
+		GenNumber(gen, depth + 1, true);
+		if ( atom ) Emit(gen, ")");
+		return;
+	}
+	else if ( choice == 7 )
+	{
+		Emit(gen, "-");
+		GenNumber(gen, depth + 1, true);
+		return;
+	}
+	else if ( choice == 8 && !gen.inGenerator && ( name = PickName(gen, FUZZ_FUNCTION) ) )
+	{
+		Emit(gen, "%s(", name->str);
+		GenArguments(gen, name->count, depth);
+		Emit(gen, ")");
+		return;
+	}
+	else if ( choice == 9 && ( name = PickName(gen, FUZZ_ARRAY) ) )
+	{
+		switch ( Choose(gen, 5) )
+		{
+			case 0: Emit(gen, "%s[%u]", name->str, Choose(gen, name->count)); break;
+			case 1: Emit(gen, "%s[len(%s) - 1]", name->str, name->str); break;
+			case 2: Emit(gen, "len(%s)", name->str); break;
+			case 3: Emit(gen, "sum(%s)", name->str); break;
+			case 4: Emit(gen, "dot(%s, %s)", name->str, name->str); break;
+		}
+		return;
+	}
+	else if ( choice == 10 && ( name = PickName(gen, FUZZ_INSTANCE) ) )
+	{
+		Emit(gen, "%s.%s", name->str, Choose(gen, 2) ? "y" : "x");
+		return;
+	}
+	else if ( choice == 11 && ( name = PickName(gen, FUZZ_MAP) ) )
+	{
+		Emit(gen, "len(%s)", name->str);
+		return;
+	}
+	else if ( choice == 12 && ( name = PickName(gen, FUZZ_NUMBER) ) )
+	{
+		Emit(gen, "(%s = ", name->str);
+		GenNumber(gen, depth + 1, false);
+		Emit(gen, ")");
+		return;
+	}
+
+	EmitNumberLiteral(gen);
+}
+
+// Generates an expression evaluating to a boolean
+void GenBool(FuzzGenerator &gen, u32 depth, bool atom)
+{
+	const u32 choice = depth < FUZZ_MAX_EXPR_DEPTH ? Choose(gen, 10) : Choose(gen, 2);
+	const FuzzName *name = 0;
+
+	if ( choice == 1 && ( name = PickName(gen, FUZZ_BOOL) ) )
+	{
+		Emit(gen, "%s", name->str);
+		return;
+	}
+	else if ( choice == 2 || choice == 3 )
+	{
+		static const char *operators[] = { "<", "<=", ">", ">=", "==", "!=" };
+		if ( atom ) Emit(gen, "(");
+		GenNumber(gen, depth + 1, false);
+		Emit(gen, " %s ", operators[Choose(gen, ARRAY_COUNT(operators))]);
+		GenNumber(gen, depth + 1, false);
+		if ( atom ) Emit(gen, ")");
+		return;
+	}
+	else if ( choice >= 4 && choice <= 6 )
+	{
+		static const char *operators[] = { "&&", "||", "==" };
+		if ( atom ) Emit(gen, "(");
+		GenBool(gen, depth + 1, true);
+		Emit(gen, " %s ", operators[choice - 4]);
+		GenBool(gen, depth + 1, true);
+		if ( atom ) Emit(gen, ")");
+		return;
+	}
+	else if ( choice == 7 )
+	{
+		Emit(gen, "!");
+		GenBool(gen, depth + 1, true);
+		return;
+	}
+	else if ( choice == 8 && ( name = PickName(gen, FUZZ_MAP) ) )
+	{
+		Emit(gen, "has(%s, ", name->str);
+		EmitMapKey(gen, *name);
+		Emit(gen, ")");
+		return;
+	}
+	else if ( choice == 9 && !gen.inGenerator && ( name = PickName(gen, FUZZ_COROUTINE) ) )
+	{
+		Emit(gen, "done(%s)", name->str);
+		return;
+	}
+
+	Emit(gen, Choose(gen, 2) ? "true" : "false");
+}
+
+void GenStatement(FuzzGenerator &gen);
+
+void GenBlock(FuzzGenerator &gen)
+{
+	const u32 namesCount = gen.namesCount;
+	Emit(gen, "{\n");
+	gen.blockDepth++;
+	const u32 statementsCount = gen.blockDepth <= FUZZ_MAX_BLOCK_DEPTH ? Choose(gen, 5) : 0;
+	for (u32 i = 0; i < statementsCount && gen.size < FUZZ_MAX_SCRIPT_SIZE; ++i)
+	{
+		GenStatement(gen);
+	}
+	gen.blockDepth--;
+	EmitIndent(gen);
+	Emit(gen, "}");
+	gen.namesCount = namesCount;
+}
+
+void GenLoop(FuzzGenerator &gen)
+{
+	const u32 namesCount = gen.namesCount;
+	const FuzzName counter = MakeName(gen, FUZZ_COUNTER, "i");
+	DeclareName(gen, counter);
+	Emit(gen, "var %s = 0;\n", counter.str);
+	EmitIndent(gen);
+	Emit(gen, "while (%s < %u) {\n", counter.str, 1 + Choose(gen, 6));
+	gen.blockDepth++;
+	gen.loopDepth++;
+	const u32 statementsCount = gen.blockDepth <= FUZZ_MAX_BLOCK_DEPTH ? Choose(gen, 4) : 0;
+	for (u32 i = 0; i < statementsCount && gen.size < FUZZ_MAX_SCRIPT_SIZE; ++i)
+	{
+		GenStatement(gen);
+	}
+	if ( gen.inGenerator )
+	{
+		EmitIndent(gen);
+		Emit(gen, "yield(");
+		GenNumber(gen, 1, false);
+		Emit(gen, ");\n");
+	}
+	EmitIndent(gen);
+	Emit(gen, "%s = %s + 1;\n", counter.str, counter.str);
+	gen.loopDepth--;
+	gen.blockDepth--;
+	EmitIndent(gen);
+	Emit(gen, "}\n");
+	gen.namesCount = namesCount;
+}
+
+void GenInstance(FuzzGenerator &gen, const FuzzName &klass)
+{
+	const FuzzName instance = MakeName(gen, FUZZ_INSTANCE, "o");
+	Emit(gen, "var %s = %s();\n", instance.str, klass.str);
+
+	// Both orders, so that instances of the same class end up with different shapes
+	const char *first = Choose(gen, 2) ? "y" : "x";
+	const char *second = first[0] == 'x' ? "y" : "x";
+	EmitIndent(gen);
+	Emit(gen, "%s.%s = ", instance.str, first);
+	GenNumber(gen, 1, false);
+	Emit(gen, ";\n");
+	EmitIndent(gen);
+	Emit(gen, "%s.%s = ", instance.str, second);
+	GenNumber(gen, 1, false);
+	Emit(gen, ";\n");
+	DeclareName(gen, instance);
+}
+
+void GenStatement(FuzzGenerator &gen)
+{
+	EmitIndent(gen);
+
+	const FuzzName *name = 0;
+	const u32 choice = Choose(gen, 20);
+	switch ( choice )
+	{
+		case 1:
+		{
+			Emit(gen, "print(");
+			GenBool(gen, 0, false);
+			Emit(gen, ");\n");
+			return;
+		}
+		case 2:
+		{
+			const FuzzName var = MakeName(gen, FUZZ_NUMBER, "n");
+			Emit(gen, "var %s = ", var.str);
+			GenNumber(gen, 0, false);
+			Emit(gen, ";\n");
+			DeclareName(gen, var);
+			return;
+		}
+		case 3:
+		{
+			const FuzzName var = MakeName(gen, FUZZ_BOOL, "b");
+			Emit(gen, "var %s = ", var.str);
+			GenBool(gen, 0, false);
+			Emit(gen, ";\n");
+			DeclareName(gen, var);
+			return;
+		}
+		case 4:
+		{
+			if ( !( name = PickName(gen, FUZZ_NUMBER) ) ) break;
+			Emit(gen, "%s = ", name->str);
+			GenNumber(gen, 0, false);
+			Emit(gen, ";\n");
+			return;
+		}
+		case 5:
+		{
+			Emit(gen, "if (");
+			GenBool(gen, 0, false);
+			Emit(gen, ") ");
+			GenBlock(gen);
+			if ( Choose(gen, 2) )
+			{
+				Emit(gen, " else ");
+				GenBlock(gen);
+			}
+			Emit(gen, "\n");
+			return;
+		}
+		case 6:
+		{
+			if ( gen.loopDepth >= 2 ) break;
+			GenLoop(gen);
+			return;
+		}
+		case 7:
+		{
+			const u32 length = 1 + Choose(gen, 6);
+			const FuzzName array = MakeName(gen, FUZZ_ARRAY, "a", length);
+			if ( Choose(gen, 2) )
+			{
+				Emit(gen, "var %s = [", array.str);
+				GenArguments(gen, length, 0);
+				Emit(gen, "];\n");
+			}
+			else
+			{
+				// Long enough for the vectorized natives
+				Emit(gen, "var %s = array(%u);\n", array.str, length + 12);
+			}
+			DeclareName(gen, array);
+			return;
+		}
+		case 8:
+		{
+			if ( !( name = PickName(gen, FUZZ_ARRAY) ) ) break;
+			const u32 operation = Choose(gen, 5);
+			switch ( operation )
+			{
+				case 0: Emit(gen, "%s[%u] = ", name->str, Choose(gen, name->count)); break;
+				case 1: Emit(gen, "push(%s, ", name->str); break;
+				case 2: Emit(gen, "scale(%s, ", name->str); break;
+				case 3: Emit(gen, "sort(%s);\n", name->str); return;
+				case 4: Emit(gen, "print(%s);\n", name->str); return;
+			}
+			GenNumber(gen, 0, false);
+			Emit(gen, operation == 0 ? ";\n" : ");\n");
+			return;
+		}
+		case 9:
+		{
+			FuzzName map = MakeName(gen, FUZZ_MAP, "m");
+			map.strings = Choose(gen, 2);
+			Emit(gen, "var %s = map();\n", map.str);
+			DeclareName(gen, map);
+			return;
+		}
+		case 10:
+		{
+			if ( !( name = PickName(gen, FUZZ_MAP) ) ) break;
+			switch ( Choose(gen, 5) )
+			{
+				case 0:
+					Emit(gen, "%s[", name->str);
+					EmitMapKey(gen, *name);
+					Emit(gen, "] = ");
+					GenNumber(gen, 0, false);
+					Emit(gen, ";\n");
+					break;
+				case 1:
+					Emit(gen, "print(%s[", name->str);
+					EmitMapKey(gen, *name);
+					Emit(gen, "]);\n");
+					break;
+				case 2:
+					Emit(gen, "print(remove(%s, ", name->str);
+					EmitMapKey(gen, *name);
+					Emit(gen, "));\n");
+					break;
+				case 3:
+					// Strings are hashed by address, so only numbers keep the same order across runs
+					if ( name->strings ) Emit(gen, "print(len(keys(%s)));\n", name->str);
+					else Emit(gen, "print(keys(%s));\n", name->str);
+					break;
+				case 4:
+					if ( name->strings ) Emit(gen, "print(len(%s));\n", name->str);
+					else Emit(gen, "print(%s);\n", name->str);
+					break;
+			}
+			return;
+		}
+		case 11:
+		{
+			if ( gen.inGenerator || !( name = PickName(gen, FUZZ_CLASS) ) ) break;
+			GenInstance(gen, *name);
+			return;
+		}
+		case 12:
+		{
+			if ( !( name = PickName(gen, FUZZ_INSTANCE) ) ) break;
+			Emit(gen, "%s.%s = ", name->str, Choose(gen, 2) ? "y" : "x");
+			GenNumber(gen, 0, false);
+			Emit(gen, ";\n");
+			return;
+		}
+		case 13:
+		{
+			if ( gen.inGenerator || !( name = PickName(gen, FUZZ_FUNCTION) ) ) break;
+			Emit(gen, "%s(", name->str);
+			GenArguments(gen, name->count, 0);
+			Emit(gen, ");\n");
+			return;
+		}
+		case 14:
+		{
+			if ( gen.inGenerator || !( name = PickName(gen, FUZZ_COROUTINE) ) ) break;
+			Emit(gen, "if (!done(%s)) print(resume(%s, ", name->str, name->str);
+			GenNumber(gen, 0, false);
+			Emit(gen, "));\n");
+			return;
+		}
+		case 15:
+		{
+			GenBlock(gen);
+			Emit(gen, "\n");
+			return;
+		}
+		case 16:
+		{
+			if ( !gen.inFunction || gen.inGenerator ) break;
+			Emit(gen, "return ");
+			GenNumber(gen, 0, false);
+			Emit(gen, ";\n");
+			return;
+		}
+		case 17:
+		{
+			// Strings and comments, the scanner has to find chunk boundaries outside of them
+			static const char *strings[] = { "", "a", "hello world", "// not a comment", "/* nor this */" };
+			Emit(gen, "print(\"%s\");\n", strings[Choose(gen, ARRAY_COUNT(strings))]);
+			return;
+		}
+		case 18:
+		{
+			Emit(gen, Choose(gen, 2) ? "// comment\n" : "/* comment\n   spanning lines */\n");
+			return;
+		}
+		case 19:
+		{
+			static const FuzzNameType types[] = { FUZZ_ARRAY, FUZZ_INSTANCE, FUZZ_FUNCTION, FUZZ_CLASS, FUZZ_COROUTINE };
+			if ( !( name = PickName(gen, types[Choose(gen, ARRAY_COUNT(types))]) ) ) break;
+			Emit(gen, "print(%s);\n", name->str);
+			return;
+		}
+	}
+
+	Emit(gen, "print(");
+	GenNumber(gen, 0, false);
+	Emit(gen, ");\n");
+}
+
+void GenFunction(FuzzGenerator &gen, bool generator)
+{
+	const u32 paramsCount = generator ? 1 : Choose(gen, 4);
+	const u32 namesCount = gen.namesCount;
+
+	// Declared after the body, so that functions never call themselves
+	const FuzzName function = MakeName(gen, generator ? FUZZ_GENERATOR : FUZZ_FUNCTION, generator ? "g" : "f", paramsCount);
+	Emit(gen, "fun %s(", function.str);
+	for (u32 i = 0; i < paramsCount; ++i)
+	{
+		const FuzzName param = MakeName(gen, FUZZ_NUMBER, "p");
+		DeclareName(gen, param);
+		Emit(gen, "%s%s", i > 0 ? ", " : "", param.str);
+	}
+	Emit(gen, ") {\n");
+
+	gen.blockDepth++;
+	gen.inFunction = true;
+	gen.inGenerator = generator;
+	const u32 statementsCount = Choose(gen, 5);
+	for (u32 i = 0; i < statementsCount && gen.size < FUZZ_MAX_SCRIPT_SIZE; ++i)
+	{
+		GenStatement(gen);
+	}
+	if ( generator )
+	{
+		EmitIndent(gen);
+		GenLoop(gen);
+	}
+	EmitIndent(gen);
+	Emit(gen, "return ");
+	GenNumber(gen, 0, false);
+	Emit(gen, ";\n");
+	gen.inGenerator = false;
+	gen.inFunction = false;
+	gen.blockDepth--;
+	Emit(gen, "}\n");
+
+	gen.namesCount = namesCount;
+	DeclareName(gen, function);
+}
+
+void GenDeclaration(FuzzGenerator &gen)
+{
+	const FuzzName *name = 0;
+	switch ( Choose(gen, 8) )
+	{
+		case 1:
+		{
+			const FuzzName klass = MakeName(gen, FUZZ_CLASS, "C");
+			Emit(gen, "class %s {}\n", klass.str);
+			DeclareName(gen, klass);
+			return;
+		}
+		case 2:
+		{
+			GenFunction(gen, false);
+			return;
+		}
+		case 3:
+		{
+			GenFunction(gen, true);
+			return;
+		}
+		case 4:
+		{
+			if ( !( name = PickName(gen, FUZZ_GENERATOR) ) ) break;
+			const FuzzName coroutine = MakeName(gen, FUZZ_COROUTINE, "c");
+			Emit(gen, "var %s = coroutine(%s);\n", coroutine.str, name->str);
+			DeclareName(gen, coroutine);
+			return;
+		}
+	}
+
+	GenStatement(gen);
+}
+
+// Returns the size of the generated program, written into text as a null-terminated string
+u32 GenProgram(const u8 *data, u32 size, char *text, u32 capacity)
+{
+	FuzzGenerator *gen = (FuzzGenerator*)AllocateVirtualMemory(sizeof(FuzzGenerator));
+	gen->input.data = data;
+	gen->input.size = size;
+	gen->text = text;
+	gen->capacity = capacity;
+
+	Emit(*gen, ""); // null-terminated even if empty
+	// Leave room for the names declared inside of the last declaration
+	while ( gen->size < FUZZ_MAX_SCRIPT_SIZE && gen->namesCount + 64 < FUZZ_MAX_NAMES && Choose(*gen, 32) != 0 )
+	{
+		GenDeclaration(*gen);
+	}
+
+	const u32 textSize = gen->size;
+	FreeVirtualMemory(gen, sizeof(FuzzGenerator));
+	return textSize;
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Differential runs
+
+struct FuzzConfig
+{
+	const char *name;
+	u32 chunksCount; // 1 scans serially
+	u32 sliceSteps;  // 0 runs the program in a single slice
+};
+
+struct FuzzRun
+{
+	bool valid;    // scanned and parsed without errors
+	bool finished; // within FUZZ_MAX_STEPS
+	u64 steps;
+	f32 seconds;
+	u32 outputSize;
+	char *output;
+};
+
+// The output of the interpreter is captured by pointing stdout to a temporary file
+struct FuzzCapture
+{
+	FILE *file;
+	int stdoutFd;
+};
+
+FuzzCapture BeginCapture(FILE *file)
+{
+	fflush(stdout);
+	FuzzCapture capture = {};
+	capture.file = file;
+	capture.stdoutFd = dup(fileno(stdout));
+	ftruncate(fileno(file), 0);
+	lseek(fileno(file), 0, SEEK_SET);
+	dup2(fileno(file), fileno(stdout));
+	return capture;
+}
+
+u32 EndCapture(FuzzCapture &capture, char *output, u32 capacity)
+{
+	fflush(stdout);
+	dup2(capture.stdoutFd, fileno(stdout));
+	close(capture.stdoutFd);
+
+	const int fd = fileno(capture.file);
+	const u32 size = (u32)lseek(fd, 0, SEEK_END);
+	const ssize_t readSize = pread(fd, output, Min(size, capacity), 0);
+	ASSERT( readSize >= 0 );
+	return size;
+}
+
+FuzzRun RunConfig(Arena &arena, FILE *captureFile, const char *script, u32 scriptSize, const FuzzConfig &config)
+{
+	FuzzRun run = {};
+	run.output = PushArray(arena, char, FUZZ_MAX_OUTPUT_SIZE);
+
+	// The output stays in the arena for the caller to compare
+	TempArena temp = BeginTempArena(arena);
+	Arena runtimeArena = MakeArena(PushSize(arena, FUZZ_RUNTIME_ARENA_SIZE), FUZZ_RUNTIME_ARENA_SIZE);
+
+	FuzzCapture capture = BeginCapture(captureFile);
+	const Clock start = GetClock();
+
+	ScanState scanState = {};
+	TokenList tokenList = Scan(arena, scanState, script, scriptSize, config.chunksCount);
+
+	ParseState parseState = {};
+	Program program = {};
+	if ( !scanState.hasErrors )
+	{
+		program = Parse(arena, parseState, tokenList);
+	}
+
+	if ( !scanState.hasErrors && !parseState.hasErrors )
+	{
+		run.valid = true;
+
+		Environment env = {};
+		Execution exec;
+		BeginExecution(runtimeArena, exec, program, env);
+
+		ExecutionBudget budget = {};
+		budget.maxSteps = config.sliceSteps ? config.sliceSteps : FUZZ_MAX_STEPS;
+		while ( !run.finished && exec.steps < FUZZ_MAX_STEPS )
+		{
+			run.finished = ExecuteSlice(exec, budget);
+		}
+
+		run.steps = exec.steps;
+		EndExecution(exec);
+	}
+
+	run.seconds = GetSecondsElapsed(start, GetClock());
+	run.outputSize = EndCapture(capture, run.output, FUZZ_MAX_OUTPUT_SIZE);
+
+	EndTempArena(temp);
+	return run;
+}
+
+bool SameRuns(const FuzzRun &a, const FuzzRun &b)
+{
+	const u32 size = Min(a.outputSize, (u32)FUZZ_MAX_OUTPUT_SIZE);
+	const bool same =
+		a.valid == b.valid &&
+		a.finished == b.finished &&
+		a.steps == b.steps &&
+		a.outputSize == b.outputSize &&
+		MemCompare(a.output, b.output, size) == 0;
+	return same;
+}
+
+u32 LineSize(const char *output, u32 offset, u32 size)
+{
+	u32 end = offset;
+	while ( end < size && output[end] != '\n' ) end++;
+	return end - offset;
+}
+
+void PrintRunMismatch(const char *script, const FuzzConfig &config, const FuzzRun &reference, const FuzzRun &run)
+{
+	const u32 referenceSize = Min(reference.outputSize, (u32)FUZZ_MAX_OUTPUT_SIZE);
+	const u32 runSize = Min(run.outputSize, (u32)FUZZ_MAX_OUTPUT_SIZE);
+
+	// First line that differs
+	u32 offset = 0, lineOffset = 0, line = 1;
+	while ( offset < referenceSize && offset < runSize && reference.output[offset] == run.output[offset] )
+	{
+		if ( reference.output[offset++] == '\n' )
+		{
+			lineOffset = offset;
+			line++;
+		}
+	}
+
+	LOG(Error, "Program:\n%s\n", script);
+	LOG(Error, "Config %s differs from the reference:\n", config.name);
+	LOG(Error, "- steps: %llu vs %llu\n", reference.steps, run.steps);
+	LOG(Error, "- output size: %u vs %u\n", reference.outputSize, run.outputSize);
+	LOG(Error, "- output line %u: \"%.*s\" vs \"%.*s\"\n", line,
+			LineSize(reference.output, lineOffset, referenceSize), reference.output + lineOffset,
+			LineSize(run.output, lineOffset, runSize), run.output + lineOffset);
+}
+
+struct FuzzResult
+{
+	bool ok;       // all configs matched the reference
+	bool valid;    // the generator produced a program without errors
+	bool finished; // within FUZZ_MAX_STEPS, otherwise the configs were not compared
+	u32 hash;      // of the output
+	u64 steps;
+	f32 seconds;   // of the fastest reference run
+};
+
+// Runs the program generated from the input with every config and compares them all to the
+// reference one. The configs are picked from the first bytes of the input.
+FuzzResult FuzzOne(Arena &arena, FILE *captureFile, const u8 *data, u32 size, u32 timingRuns)
+{
+	FuzzResult result = {};
+	TempArena temp = BeginTempArena(arena);
+
+	const u32 chunksCount = 2 + ( size > 0 ? data[0] % 7 : 0 );
+	const u32 sliceSteps = 1 + ( size > 1 ? data[1] % 64 : 0 );
+	const u32 skipped = Min(size, 2u);
+
+	char *script = PushArray(arena, char, FUZZ_SCRIPT_CAPACITY);
+	const u32 scriptSize = GenProgram(data + skipped, size - skipped, script, FUZZ_SCRIPT_CAPACITY);
+
+	const FuzzConfig reference = { "reference", 1, 0 };
+	const FuzzConfig configs[] = {
+		{ "parallel scan", chunksCount, 0 },
+		{ "sliced execution", 1, sliceSteps },
+		{ "parallel scan + sliced execution", chunksCount, 1 },
+	};
+
+	const FuzzRun referenceRun = RunConfig(arena, captureFile, script, scriptSize, reference);
+	result.ok = true;
+	result.valid = referenceRun.valid;
+	result.finished = referenceRun.finished;
+	result.hash = HashFNV(referenceRun.output, Min(referenceRun.outputSize, (u32)FUZZ_MAX_OUTPUT_SIZE));
+	result.steps = referenceRun.steps;
+	result.seconds = referenceRun.seconds;
+
+	if ( !referenceRun.valid )
+	{
+		LOG(Error, "Program:\n%s\n", script);
+		LOG(Error, "The generated program is not valid:\n%.*s\n", referenceRun.outputSize, referenceRun.output);
+		result.ok = false;
+	}
+	else if ( referenceRun.finished )
+	{
+		for (u32 i = 0; i < ARRAY_COUNT(configs); ++i)
+		{
+			TempArena runTemp = BeginTempArena(arena);
+			const FuzzRun run = RunConfig(arena, captureFile, script, scriptSize, configs[i]);
+			if ( !SameRuns(referenceRun, run) )
+			{
+				PrintRunMismatch(script, configs[i], referenceRun, run);
+				result.ok = false;
+			}
+			EndTempArena(runTemp);
+		}
+
+		for (u32 i = 1; i < timingRuns; ++i)
+		{
+			TempArena runTemp = BeginTempArena(arena);
+			const FuzzRun run = RunConfig(arena, captureFile, script, scriptSize, reference);
+			result.seconds = Min(result.seconds, run.seconds);
+			EndTempArena(runTemp);
+		}
+	}
+
+	EndTempArena(temp);
+	return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Images
+
+// An image of a prelude must load back the same globals, scripts running on top of it must
+// print the same as when running after the prelude, and corrupted images must be rejected
+// instead of read out of bounds.
+
+static const char *gImagePrelude =
+	"var name = \"jsl\";\n"
+	"var version = 2;\n"
+	"var enabled = true;\n"
+	"var nothing = nil;\n"
+	"fun square(x) { return x * x; }\n"
+	"class Shape {\n"
+	"  init(size) { this.size = size; }\n"
+	"  area() { return square(this.size); }\n"
+	"}\n"
+	"class Square < Shape {\n"
+	"  area() { return super.area() + version; }\n"
+	"}\n"
+	"var Alias = Square;\n"
+	"fun count(n) { var i = 0; while (i < n) { yield(i); i = i + 1; } }\n";
+
+static const char *gImageScript =
+	"fun cube(x) { return x * square(x); }\n"
+	"print(cube(version));\n"
+	"print(Square(3).area());\n"
+	"print(Alias(1).area());\n"
+	"print(Alias == Square);\n"
+	"var shape = Shape(5);\n"
+	"shape.size = 6;\n"
+	"print(shape.area());\n"
+	"var counter = coroutine(count);\n"
+	"print(resume(counter, 2));\n"
+	"print(resume(counter));\n"
+	"print(name);\n";
+
+typedef void (*ImageCorruption)(DataChunk &image);
+
+void TruncateImage(DataChunk &image)
+{
+	image.size = sizeof(ImageHeader) - 1;
+}
+
+void CorruptImageMagic(DataChunk &image)
+{
+	((ImageHeader*)image.bytes)->magic++;
+}
+
+// Cut in the last var, with a strings size that wraps around to the cut size in 32 bits. The
+// last var and all strings would be read past the end.
+void CutImageVars(DataChunk &image)
+{
+	ImageHeader &header = *(ImageHeader*)image.bytes;
+	image.size = header.strings.offset - 1;
+	header.strings.size = (u32)image.size - header.strings.offset;
+}
+
+void CorruptImageStringOffset(DataChunk &image)
+{
+	ImageVar &var = *(ImageVar*)(image.bytes + sizeof(ImageHeader));
+	var.name.offset = U32_MAX - 1;
+}
+
+void CorruptImageStringSize(DataChunk &image)
+{
+	ImageVar &var = *(ImageVar*)(image.bytes + sizeof(ImageHeader));
+	var.name.size = U32_MAX;
+}
+
+void CorruptImageExprToken(DataChunk &image)
+{
+	const ImageHeader &header = *(ImageHeader*)image.bytes;
+	Expr &expr = *(Expr*)(image.bytes + header.exprs.offset + sizeof(Expr));
+	expr.token = header.tokens.count;
+}
+
+void CorruptImageStmtBody(DataChunk &image)
+{
+	const ImageHeader &header = *(ImageHeader*)image.bytes;
+	Stmt &stmt = *(Stmt*)(image.bytes + header.stmts.offset + sizeof(Stmt));
+	stmt.body = U32_MAX;
+}
+
+// The first class becomes its own superclass
+void CorruptImageSuperclass(DataChunk &image)
+{
+	const ImageHeader &header = *(ImageHeader*)image.bytes;
+	ImageClass &klass = *(ImageClass*)(image.bytes + header.classes.offset);
+	klass.superclass = 0;
+}
+
+void CorruptImageFunction(DataChunk &image)
+{
+	const ImageHeader &header = *(ImageHeader*)image.bytes;
+	ImageVar *vars = (ImageVar*)(image.bytes + header.vars.offset);
+	for (u32 i = 0; i < header.vars.count; ++i)
+	{
+		if ( vars[i].type == VALUE_TYPE_FUNCTION ) vars[i].function = header.stmts.count;
+	}
+}
+
+// Classes are created again when loading, from the same declaration
+bool SameImageValue(const Value &a, const Value &b)
+{
+	if ( a.type == VALUE_TYPE_CLASS ) return b.type == VALUE_TYPE_CLASS && a.klass->decl == b.klass->decl;
+	return ValuesEqual(a, b);
+}
+
+bool TestImages(Arena &arena, FILE *captureFile)
+{
+	TempArena temp = BeginTempArena(arena);
+	Arena runtimeArena = MakeArena(PushSize(arena, FUZZ_RUNTIME_ARENA_SIZE), FUZZ_RUNTIME_ARENA_SIZE);
+	char *referenceOutput = PushArray(arena, char, FUZZ_MAX_OUTPUT_SIZE);
+	char *output = PushArray(arena, char, FUZZ_MAX_OUTPUT_SIZE);
+	const ExecutionBudget unlimited = {};
+
+	// The script right after the prelude, as a single program
+	const u32 preludeSize = StrLen(gImagePrelude);
+	const u32 scriptSize = StrLen(gImageScript);
+	char *referenceScript = PushArray(arena, char, preludeSize + scriptSize);
+	MemCopy(referenceScript, gImagePrelude, preludeSize);
+	MemCopy(referenceScript + preludeSize, gImageScript, scriptSize);
+
+	FuzzCapture referenceCapture = BeginCapture(captureFile);
+	Environment referenceEnv = {};
+	const bool referenceRan = Run(arena, runtimeArena, referenceScript, preludeSize + scriptSize, referenceEnv, unlimited);
+	const u32 referenceOutputSize = Min(EndCapture(referenceCapture, referenceOutput, FUZZ_MAX_OUTPUT_SIZE), (u32)FUZZ_MAX_OUTPUT_SIZE);
+
+	FuzzCapture capture = BeginCapture(captureFile);
+	Environment env = {};
+	DataChunk image = {};
+	bool saved = Run(arena, runtimeArena, gImagePrelude, preludeSize, env, unlimited) && PushImage(arena, env, image);
+
+	Environment loadedEnv = {};
+	bool loaded = saved && LoadImage(arena, runtimeArena, image, loadedEnv);
+	for (VarList *list = env.variables; loaded && list; list = list->next)
+	{
+		for (u32 i = 0; i < list->varsCount; ++i)
+		{
+			Value value;
+			loaded = loaded && Get(loadedEnv, list->vars[i].name, value) && SameImageValue(list->vars[i].value, value);
+		}
+	}
+
+	const bool ran = loaded && Run(arena, runtimeArena, gImageScript, scriptSize, loadedEnv, unlimited);
+	const u32 outputSize = Min(EndCapture(capture, output, FUZZ_MAX_OUTPUT_SIZE), (u32)FUZZ_MAX_OUTPUT_SIZE);
+	const bool sameOutput = referenceRan && ran && outputSize == referenceOutputSize &&
+		MemCompare(output, referenceOutput, outputSize) == 0;
+
+	const ImageCorruption corruptions[] = {
+		TruncateImage,
+		CorruptImageMagic,
+		CutImageVars,
+		CorruptImageStringOffset,
+		CorruptImageStringSize,
+		CorruptImageExprToken,
+		CorruptImageStmtBody,
+		CorruptImageSuperclass,
+		CorruptImageFunction,
+	};
+
+	// Rejected images report errors, which are expected here
+	FuzzCapture corruptionsCapture = BeginCapture(captureFile);
+
+	u32 acceptedCount = 0;
+	for (u32 i = 0; saved && i < ARRAY_COUNT(corruptions); ++i)
+	{
+		DataChunk corrupted = { PushArray(arena, byte, image.size), image.size };
+		MemCopy(corrupted.bytes, image.bytes, image.size);
+		corruptions[i](corrupted);
+
+		Environment corruptedEnv = {};
+		acceptedCount += LoadImage(arena, runtimeArena, corrupted, corruptedEnv) ? 1 : 0;
+	}
+
+	EndCapture(corruptionsCapture, output, FUZZ_MAX_OUTPUT_SIZE);
+
+	if ( !loaded )
+	{
+		LOG(Error, "The image of the prelude did not load back its globals\n");
+	}
+	else if ( !sameOutput )
+	{
+		LOG(Error, "The script on top of the image printed:\n%.*s\nInstead of:\n%.*s\n",
+				outputSize, output, referenceOutputSize, referenceOutput);
+	}
+	if ( acceptedCount > 0 )
+	{
+		LOG(Error, "%u corrupted images were accepted\n", acceptedCount);
+	}
+
+	EndTempArena(temp);
+	return loaded && sameOutput && acceptedCount == 0;
+}
+
+Arena MakeFuzzArena()
+{
+	byte *base = (byte*)AllocateVirtualMemory(FUZZ_ARENA_SIZE);
+
+	// Pages are touched upfront, so that timings don't depend on what previous programs used
+	MemSet(base, FUZZ_ARENA_SIZE, 0);
+
+	Arena arena = MakeArena(base, FUZZ_ARENA_SIZE);
+	return arena;
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Main
+
+#if JSL_LIBFUZZER
+
+extern "C" int LLVMFuzzerTestOneInput(const u8 *data, size_t size)
+{
+	static Arena arena = MakeFuzzArena();
+	static FILE *captureFile = tmpfile();
+
+	const u32 inputSize = size < U32_MAX ? (u32)size : U32_MAX;
+	const FuzzResult result = FuzzOne(arena, captureFile, data, inputSize, 1);
+	if ( !result.ok )
+	{
+		abort();
+	}
+	return 0;
+}
+
+#else
+
+// Seeds are expanded into inputs with a xorshift generator
+void MakeSeedInput(u32 seed, u8 *data, u32 size)
+{
+	u64 state = 0x9E3779B97F4A7C15ull * ( seed + 1 );
+	for (u32 i = 0; i < size; ++i)
+	{
+		state ^= state << 13;
+		state ^= state >> 7;
+		state ^= state << 17;
+		data[i] = (u8)( state >> 32 );
+	}
+}
+
+// Baselines contain a line per seed: "seed hash steps microseconds"
+struct FuzzBaseline
+{
+	u32 seed;
+	u32 hash;
+	u64 steps;
+	u32 microseconds;
+};
+
+u32 ParseBaseline(Arena &arena, const char *filename, FuzzBaseline *&entries)
+{
+	u64 fileSize;
+	if ( !GetFileSize(filename, fileSize) )
+	{
+		LOG(Error, "Could not read baseline %s\n", filename);
+		return 0;
+	}
+
+	char *text = PushArray(arena, char, fileSize + 1);
+	ReadEntireFile(filename, text, fileSize);
+	text[fileSize] = 0;
+
+	u32 linesCount = 0;
+	for (u64 i = 0; i < fileSize; ++i) linesCount += text[i] == '\n' ? 1 : 0;
+	entries = PushArray(arena, FuzzBaseline, linesCount);
+
+	u32 entriesCount = 0;
+	const char *cursor = text;
+	while ( *cursor && entriesCount < linesCount )
+	{
+		u64 fields[4];
+		for (u32 i = 0; i < ARRAY_COUNT(fields); ++i)
+		{
+			while ( *cursor == ' ' ) cursor++;
+			fields[i] = 0;
+			while ( IsDigit(*cursor) ) fields[i] = fields[i] * 10 + ( *cursor++ - '0' );
+		}
+		while ( *cursor && *cursor++ != '\n' );
+
+		FuzzBaseline &entry = entries[entriesCount++];
+		entry.seed = (u32)fields[0];
+		entry.hash = (u32)fields[1];
+		entry.steps = fields[2];
+		entry.microseconds = (u32)fields[3];
+	}
+
+	return entriesCount;
+}
+
+const FuzzBaseline *FindBaseline(const FuzzBaseline *entries, u32 entriesCount, u32 seed)
+{
+	for (u32 i = 0; i < entriesCount; ++i)
+	{
+		if ( entries[i].seed == seed ) return &entries[i];
+	}
+	return 0;
+}
+
+void PrintFuzzUsage()
+{
+	printf("Usage: main_fuzz [--seeds <count>] [--first <seed>] [--record <baseline>] [--compare <baseline>]\n");
+	printf("       main_fuzz --print <seed>\n");
+}
+
+int main(int argc, char **argv)
+{
+	u32 firstSeed = 0;
+	u32 seedsCount = 1000;
+	const char *recordFilename = 0;
+	const char *compareFilename = 0;
+	bool print = false;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		if ( i + 1 < argc && StrEq(argv[i], "--seeds") ) seedsCount = StrToUnsignedInt(argv[++i]);
+		else if ( i + 1 < argc && StrEq(argv[i], "--first") ) firstSeed = StrToUnsignedInt(argv[++i]);
+		else if ( i + 1 < argc && StrEq(argv[i], "--record") ) recordFilename = argv[++i];
+		else if ( i + 1 < argc && StrEq(argv[i], "--compare") ) compareFilename = argv[++i];
+		else if ( i + 1 < argc && StrEq(argv[i], "--print") ) { print = true; firstSeed = StrToUnsignedInt(argv[++i]); }
+		else
+		{
+			PrintFuzzUsage();
+			return -1;
+		}
+	}
+
+	Arena arena = MakeFuzzArena();
+	u8 *data = PushArray(arena, u8, FUZZ_INPUT_SIZE);
+
+	if ( print )
+	{
+		char *script = PushArray(arena, char, FUZZ_SCRIPT_CAPACITY);
+		MakeSeedInput(firstSeed, data, FUZZ_INPUT_SIZE);
+		GenProgram(data + 2, FUZZ_INPUT_SIZE - 2, script, FUZZ_SCRIPT_CAPACITY);
+		printf("%s", script);
+		return 0;
+	}
+
+	FuzzBaseline *baseline = 0;
+	u32 baselineCount = 0;
+	if ( compareFilename )
+	{
+		baselineCount = ParseBaseline(arena, compareFilename, baseline);
+		if ( baselineCount == 0 )
+		{
+			return -1;
+		}
+	}
+
+	const u32 recordCapacity = seedsCount * 64;
+	char *record = recordFilename ? PushArray(arena, char, recordCapacity) : 0;
+	u32 recordSize = 0;
+
+	FILE *captureFile = tmpfile();
+	if ( !captureFile )
+	{
+		LOG(Error, "Could not create a temporary file to capture the output\n");
+		return -1;
+	}
+
+	const u32 timingRuns = recordFilename || compareFilename ? FUZZ_TIMING_RUNS : 1;
+	u32 failedCount = TestImages(arena, captureFile) ? 0 : 1;
+	u32 unfinishedCount = 0;
+	u32 changedCount = 0;
+	u32 slowerCount = 0;
+	const FuzzBaseline **slower = PushArray(arena, const FuzzBaseline*, seedsCount);
+	f32 seconds = 0.0f;
+	f32 baselineSeconds = 0.0f;
+
+	for (u32 seed = firstSeed; seed < firstSeed + seedsCount; ++seed)
+	{
+		MakeSeedInput(seed, data, FUZZ_INPUT_SIZE);
+		const FuzzResult result = FuzzOne(arena, captureFile, data, FUZZ_INPUT_SIZE, timingRuns);
+		const u32 microseconds = (u32)( result.seconds * 1000000.0f );
+
+		if ( !result.ok )
+		{
+			LOG(Error, "Seed %u failed\n\n", seed);
+			failedCount++;
+		}
+		if ( !result.finished )
+		{
+			unfinishedCount++;
+			continue;
+		}
+
+		if ( record )
+		{
+			recordSize += snprintf(record + recordSize, recordCapacity - recordSize, "%u %u %llu %u\n",
+					seed, result.hash, result.steps, microseconds);
+		}
+
+		const FuzzBaseline *entry = compareFilename ? FindBaseline(baseline, baselineCount, seed) : 0;
+		if ( entry )
+		{
+			if ( entry->hash != result.hash || entry->steps != result.steps )
+			{
+				LOG(Error, "Seed %u output changed from the baseline (%llu steps, %llu in the baseline)\n",
+						seed, result.steps, entry->steps);
+				changedCount++;
+			}
+			if ( microseconds > entry->microseconds * FUZZ_SLOWER_RATIO + FUZZ_SLOWER_MICROSECONDS )
+			{
+				slower[slowerCount++] = entry;
+			}
+			seconds += result.seconds;
+			baselineSeconds += entry->microseconds * 0.000001f;
+		}
+	}
+
+	// Timings are noisy and noise comes in bursts, so the programs that looked slower are timed
+	// again once all of them ran, and only flagged if they are still slower
+	u32 stillSlowerCount = 0;
+	for (u32 i = 0; i < slowerCount; ++i)
+	{
+		const FuzzBaseline &entry = *slower[i];
+		MakeSeedInput(entry.seed, data, FUZZ_INPUT_SIZE);
+		const FuzzResult result = FuzzOne(arena, captureFile, data, FUZZ_INPUT_SIZE, FUZZ_RETIMING_RUNS);
+		const u32 microseconds = (u32)( result.seconds * 1000000.0f );
+		if ( microseconds > entry.microseconds * FUZZ_SLOWER_RATIO + FUZZ_SLOWER_MICROSECONDS )
+		{
+			LOG(Warning, "Seed %u is slower than the baseline: %u us, %u us in the baseline\n",
+					entry.seed, microseconds, entry.microseconds);
+			stillSlowerCount++;
+		}
+	}
+	slowerCount = stillSlowerCount;
+
+	LOG(Info, "%u programs, %u failed, %u not finished within %u steps\n",
+			seedsCount, failedCount, unfinishedCount, FUZZ_MAX_STEPS);
+
+	if ( compareFilename )
+	{
+		LOG(Info, "Compared to %s: %u changed, %u slower\n", compareFilename, changedCount, slowerCount);
+		LOG(Info, "- time: %.3f ms, %.3f ms in the baseline\n", seconds * 1000.0f, baselineSeconds * 1000.0f);
+	}
+
+	if ( record && !WriteEntireFile(recordFilename, record, recordSize) )
+	{
+		LOG(Error, "Could not write baseline %s\n", recordFilename);
+		failedCount++;
+	}
+
+	const bool ok = failedCount == 0 && changedCount == 0 && slowerCount == 0;
+	return ok ? 0 : -1;
+}
+
+#endif // JSL_LIBFUZZER
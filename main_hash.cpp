@@ -0,0 +1,287 @@
+#include "tools.h"
+
+#define TEST_FUNCTIONALITY 1
+#define TEST_QUALITY 1
+#define TEST_PERFORMANCE 1
+
+#define QUALITY_KEY_COUNT 1000000
+#define QUALITY_BUCKET_COUNT 65536
+#define AVALANCHE_ROUNDS 20000
+#define MAX_BENCH_SIZE MB(1)
+#define BENCH_BYTES_PER_SIZE MB(256)
+
+static u64 gRandomState = 0x853c49e6748fea9bull;
+
+u32 Random()
+{
+	gRandomState ^= gRandomState << 13;
+	gRandomState ^= gRandomState >> 7;
+	gRandomState ^= gRandomState << 17;
+	return (u32)gRandomState;
+}
+
+////////////////////////////////////////////////////////////////////////
+// Functional test
+
+// The streaming API has to give the one-shot hash however the input is split
+bool TestFunctionality(byte *buffer, u32 bufferSize)
+{
+	u32 failures = 0;
+
+	for ( u32 i = 0; i < bufferSize; ++i ) buffer[i] = (byte)Random();
+
+	for ( u32 i = 0; i < 100000 && failures < 10; ++i )
+	{
+		const u32 size = i < 400 ? i : Random() % (i % 8 == 0 ? KB(4) : 300);
+		const u32 offset = Random() % 64;
+		const u64 seed = i % 2 ? Random() : 0;
+		const byte *data = buffer + offset;
+		const u64 expected = Hash64(data, size, seed);
+
+		HashState state = HashBegin(seed);
+		u32 hashed = 0;
+		while ( hashed < size )
+		{
+			const u32 count = Random() % 4 == 0 ? Random() % 200 : Random() % 20;
+			const u32 clamped = Min(count, size - hashed);
+			HashUpdate(state, data + hashed, clamped);
+			hashed += clamped;
+		}
+		const u64 streamed = HashEnd(state);
+
+		if ( streamed != expected )
+		{
+			LOG(Error, "- HashUpdate failed (size:%u seed:%llu) %016llx != %016llx\n", size, seed, streamed, expected);
+			failures++;
+		}
+	}
+
+	// Seeds have to change the hash, also for empty inputs
+	if ( Hash64("", 0, 0) == Hash64("", 0, 1) || Hash64("name", 4, 0) == Hash64("name", 4, 1) )
+	{
+		LOG(Error, "- Seed is not changing the hash\n");
+		failures++;
+	}
+
+	if ( HashString64("identifier") != Hash64("identifier", 10) )
+	{
+		LOG(Error, "- HashString64 differs from Hash64\n");
+		failures++;
+	}
+
+	LOG(Info, "- %s\n", failures == 0 ? "OK (streaming and one-shot hashes match)" : "FAILED");
+	return failures == 0;
+}
+
+////////////////////////////////////////////////////////////////////////
+// Quality test
+
+typedef u32 (*PrintKeyFunction)(char *buffer, u32 size, u32 index);
+
+// Like identifiers in scripts and shaders
+u32 PrintIdentifier(char *buffer, u32 size, u32 index)
+{
+	static const char *prefixes[] = { "i", "var", "position", "uTexture", "gGlobal", "player_" };
+	return snprintf(buffer, size, "%s%u", prefixes[index % ARRAY_COUNT(prefixes)], (u32)(index / ARRAY_COUNT(prefixes)));
+}
+
+// Like asset names
+u32 PrintAssetName(char *buffer, u32 size, u32 index)
+{
+	return snprintf(buffer, size, "assets/textures/level_%02u/material_%05u_albedo.png", index % 64, index / 64);
+}
+
+// Binary keys differing only in a few low bits
+u32 PrintSequentialNumber(char *buffer, u32 size, u32 index)
+{
+	MemCopy(buffer, &index, sizeof(index));
+	return sizeof(index);
+}
+
+struct HashFunction
+{
+	const char *name;
+	u64 (*hash)(const void *data, u32 size);
+};
+
+u64 HashFNVFunction(const void *data, u32 size) { return HashFNV(data, size); }
+u64 Hash64Function(const void *data, u32 size) { return Hash64(data, size); }
+
+const HashFunction gHashFunctions[] = {
+	{ "HashFNV", HashFNVFunction },
+	{ "Hash64", Hash64Function },
+};
+
+int CompareU32(const void *a, const void *b)
+{
+	const u32 valueA = *(const u32*)a;
+	const u32 valueB = *(const u32*)b;
+	return valueA < valueB ? -1 : valueA > valueB ? 1 : 0;
+}
+
+// Collisions of the low 32 bits, which is what tables keep, and chi-square over buckets
+void TestKeys(Arena arena, const char *name, PrintKeyFunction print)
+{
+	const u32 count = QUALITY_KEY_COUNT;
+	u32 *hashes = PushArray(arena, u32, count);
+	u32 *buckets = PushArray(arena, u32, QUALITY_BUCKET_COUNT);
+
+	// Expected collisions among n random 32-bit values: n^2 / 2^33
+	const f32 expectedCollisions = (f32)count * count / 8589934592.0f;
+	LOG(Info, "- %s (%u keys, %.0f collisions expected):\n", name, count, expectedCollisions);
+
+	for ( u32 f = 0; f < ARRAY_COUNT(gHashFunctions); ++f )
+	{
+		const HashFunction &function = gHashFunctions[f];
+		MemSet(buckets, QUALITY_BUCKET_COUNT * sizeof(u32), 0);
+
+		for ( u32 i = 0; i < count; ++i )
+		{
+			char key[128];
+			const u32 size = print(key, sizeof(key), i);
+			hashes[i] = (u32)function.hash(key, size);
+			buckets[hashes[i] % QUALITY_BUCKET_COUNT]++;
+		}
+
+		qsort(hashes, count, sizeof(u32), CompareU32);
+		u32 collisions = 0;
+		for ( u32 i = 1; i < count; ++i )
+		{
+			collisions += hashes[i] == hashes[i - 1] ? 1 : 0;
+		}
+
+		// Close to 1.0 is a uniform distribution, much higher means some buckets are overloaded
+		const f32 expectedPerBucket = (f32)count / QUALITY_BUCKET_COUNT;
+		f32 chiSquare = 0.0f;
+		for ( u32 i = 0; i < QUALITY_BUCKET_COUNT; ++i )
+		{
+			const f32 delta = buckets[i] - expectedPerBucket;
+			chiSquare += delta * delta / expectedPerBucket;
+		}
+		chiSquare /= QUALITY_BUCKET_COUNT - 1;
+
+		LOG(Info, "  - %-8s %8u collisions %8.2f chi-square/dof\n", function.name, collisions, chiSquare);
+	}
+}
+
+// Flipping any input bit should flip each output bit half the time
+void TestAvalanche(const HashFunction &function, u32 size)
+{
+	u32 flips[64] = {};
+	u32 trials = 0;
+
+	for ( u32 round = 0; round < AVALANCHE_ROUNDS; ++round )
+	{
+		byte key[64];
+		for ( u32 i = 0; i < size; ++i ) key[i] = (byte)Random();
+		const u64 hash = function.hash(key, size);
+		const u32 bit = Random() % (size * 8);
+		key[bit / 8] ^= 1 << (bit % 8);
+		const u64 diff = hash ^ function.hash(key, size);
+		for ( u32 i = 0; i < 64; ++i ) flips[i] += (diff >> i) & 1;
+		trials++;
+	}
+
+	// FNV only has 32 output bits
+	const u32 outputBits = function.hash == HashFNVFunction ? 32 : 64;
+	f32 worstBias = 0.0f;
+	u64 totalFlips = 0;
+	for ( u32 i = 0; i < outputBits; ++i )
+	{
+		const f32 bias = fabsf((f32)flips[i] / trials - 0.5f) * 2.0f;
+		worstBias = Max(worstBias, bias);
+		totalFlips += flips[i];
+	}
+
+	LOG(Info, "  - %-8s %2u bytes: %5.2f of %u bits flip, worst bit bias %5.1f%%\n",
+			function.name, size, (f32)totalFlips / trials, outputBits, worstBias * 100.0f);
+}
+
+void TestQuality(Arena arena)
+{
+	TestKeys(arena, "identifiers", PrintIdentifier);
+	TestKeys(arena, "asset names", PrintAssetName);
+	TestKeys(arena, "sequential numbers", PrintSequentialNumber);
+
+	LOG(Info, "- avalanche (0%% bias is ideal):\n");
+	const u32 sizes[] = { 4, 8, 16, 24, 64 };
+	for ( u32 f = 0; f < ARRAY_COUNT(gHashFunctions); ++f )
+	{
+		for ( u32 i = 0; i < ARRAY_COUNT(sizes); ++i )
+		{
+			TestAvalanche(gHashFunctions[f], sizes[i]);
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////////
+// Performance test
+
+void PrintThroughput(u32 size, u32 repetitions, Clock c0, Clock c1)
+{
+	const f32 seconds = GetSecondsElapsed(c0, c1);
+	const f32 gigabytes = (f32)size * repetitions / (1024.0f * 1024.0f * 1024.0f);
+	const f32 nanoseconds = 1e9f * seconds / repetitions;
+	LOG(Info, " %10.2f %10.2f", seconds > 0.0f ? gigabytes / seconds : 0.0f, nanoseconds);
+}
+
+void TestPerformance(byte *buffer)
+{
+	volatile u64 sink = 0;
+
+	LOG(Info, "%10s %10s %10s %10s %10s %10s %10s\n", "size", "FNV GB/s", "FNV ns", "Hash64 GB/s", "Hash64 ns", "Stream GB/s", "Stream ns");
+
+	for ( u32 size = 4; size <= MAX_BENCH_SIZE; size *= 4 )
+	{
+		const u32 repetitions = Min(BENCH_BYTES_PER_SIZE / size, 50000000u);
+
+		if (size < KB(1)) LOG(Info, "%9uB", size);
+		else if (size < MB(1)) LOG(Info, "%8ukB", (u32)(size / KB(1)));
+		else LOG(Info, "%8uMB", (u32)(size / MB(1)));
+
+		// The first byte changes so every hash depends on the previous one
+		Clock c0 = GetClock();
+		for ( u32 i = 0; i < repetitions; ++i ) { buffer[0] = (byte)sink; sink = sink + HashFNV(buffer, size); }
+		Clock c1 = GetClock();
+		for ( u32 i = 0; i < repetitions; ++i ) { buffer[0] = (byte)sink; sink = sink + Hash64(buffer, size); }
+		Clock c2 = GetClock();
+		for ( u32 i = 0; i < repetitions; ++i )
+		{
+			buffer[0] = (byte)sink;
+			HashState state = HashBegin();
+			HashUpdate(state, buffer, size);
+			sink = sink + HashEnd(state);
+		}
+		Clock c3 = GetClock();
+
+		PrintThroughput(size, repetitions, c0, c1);
+		PrintThroughput(size, repetitions, c1, c2);
+		PrintThroughput(size, repetitions, c2, c3);
+		LOG(Info, "\n");
+	}
+}
+
+int main()
+{
+	Arena arena = MakeGrowableArena(GB(1));
+	byte *buffer = PushArray(arena, byte, MAX_BENCH_SIZE + 64);
+
+	bool ok = true;
+
+#if TEST_FUNCTIONALITY
+	LOG(Info, "Functional test:\n");
+	ok = TestFunctionality(buffer, MAX_BENCH_SIZE + 64);
+#endif
+
+#if TEST_QUALITY
+	LOG(Info, "Quality test:\n");
+	TestQuality(arena);
+#endif
+
+#if TEST_PERFORMANCE
+	LOG(Info, "Performance test:\n");
+	TestPerformance(buffer);
+#endif
+
+	return ok ? 0 : -1;
+}
@@ -1,5 +1,10 @@
 #include "tools.h"
 
+#if PLATFORM_LINUX
+#include <signal.h>   // sigaction
+#include <sys/time.h> // setitimer
+#endif
+
 
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -7,7 +12,6 @@
 
 
 #define MAX_LINE_SIZE KB(1)
-#define MAX_TOKEN_COUNT KB(10)
 
 
 // Enum values
@@ -35,6 +39,26 @@ enum ValueType
 	VALUE_TYPE_FLOAT,
 	VALUE_TYPE_STRING,
 	VALUE_TYPE_NIL,
+	VALUE_TYPE_CLASS,
+	VALUE_TYPE_INSTANCE,
+	VALUE_TYPE_FUNCTION,
+	VALUE_TYPE_METHOD,
+	VALUE_TYPE_NATIVE,
+	VALUE_TYPE_COROUTINE,
+	VALUE_TYPE_ARRAY,
+	VALUE_TYPE_MAP,
+};
+
+struct Class;
+struct Instance;
+struct Coroutine;
+struct Array;
+struct Map;
+
+struct BoundMethod
+{
+	Instance *instance;
+	u32 function; // StmtId of the method declaration
 };
 
 struct Value
@@ -46,6 +70,14 @@ struct Value
 		i32 i;
 		f32 f;
 		String s;
+		Class *klass;
+		Instance *instance;
+		u32 function; // StmtId of the function declaration
+		BoundMethod method;
+		u32 native;   // NativeId
+		Coroutine *coroutine;
+		Array *array;
+		Map *map;
 	};
 };
 
@@ -63,6 +95,8 @@ struct TokenList
 {
 	Token *tokens;
 	i32 count;
+	i32 capacity;
+	Arena *arena; // if set, tokens are pushed into it one by one, so it commits memory as they come
 };
 
 struct ScanState
@@ -134,6 +168,178 @@ char PeekNext(const ScanState &scanState)
 	return scanState.script[ scanState.current + 1 ];
 }
 
+// SIMD fast paths to skip runs of whitespaces, comments, string and identifier characters.
+// Blocks are only loaded when they are fully inside the script, the tail goes scalar.
+
+#ifndef SCAN_USE_SIMD
+#define SCAN_USE_SIMD 1
+#endif
+
+#if !SCAN_USE_SIMD
+#elif defined(__AVX2__)
+#	define SCAN_SIMD_AVX2 1
+#	include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#	define SCAN_SIMD_SSE2 1
+#	include <emmintrin.h>
+#endif
+
+#if SCAN_SIMD_AVX2
+
+#define SCAN_BLOCK_SIZE 32
+#define SCAN_BLOCK_MASK 0xffffffff
+
+typedef __m256i ScanBlock;
+
+ScanBlock LoadScanBlock(const char *chars)
+{
+	return _mm256_loadu_si256((const __m256i*)chars);
+}
+
+u32 MatchChar(ScanBlock block, char c)
+{
+	return (u32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, _mm256_set1_epi8(c)));
+}
+
+// Works for ASCII ranges, as bytes above 127 are negative in signed comparisons
+u32 MatchRange(ScanBlock block, char first, char last)
+{
+	const __m256i aboveFirst = _mm256_cmpgt_epi8(block, _mm256_set1_epi8(first - 1));
+	const __m256i belowLast = _mm256_cmpgt_epi8(_mm256_set1_epi8(last + 1), block);
+	return (u32)_mm256_movemask_epi8(_mm256_and_si256(aboveFirst, belowLast));
+}
+
+#elif SCAN_SIMD_SSE2
+
+#define SCAN_BLOCK_SIZE 16
+#define SCAN_BLOCK_MASK 0xffff
+
+typedef __m128i ScanBlock;
+
+ScanBlock LoadScanBlock(const char *chars)
+{
+	return _mm_loadu_si128((const __m128i*)chars);
+}
+
+u32 MatchChar(ScanBlock block, char c)
+{
+	return (u32)_mm_movemask_epi8(_mm_cmpeq_epi8(block, _mm_set1_epi8(c)));
+}
+
+// Works for ASCII ranges, as bytes above 127 are negative in signed comparisons
+u32 MatchRange(ScanBlock block, char first, char last)
+{
+	const __m128i aboveFirst = _mm_cmpgt_epi8(block, _mm_set1_epi8(first - 1));
+	const __m128i belowLast = _mm_cmpgt_epi8(_mm_set1_epi8(last + 1), block);
+	return (u32)_mm_movemask_epi8(_mm_and_si128(aboveFirst, belowLast));
+}
+
+#endif
+
+#if SCAN_SIMD_AVX2 || SCAN_SIMD_SSE2
+#define SCAN_SIMD 1
+
+bool HasScanBlock(const ScanState &scanState)
+{
+	return scanState.current + SCAN_BLOCK_SIZE <= scanState.scriptSize;
+}
+
+// Advances up to the first character not in the mask, counting the lines skipped
+bool AdvanceScanBlock(ScanState &scanState, u32 skipMask, u32 newLineMask)
+{
+	const u32 stopMask = ~skipMask & SCAN_BLOCK_MASK;
+	const u32 count = stopMask ? CTZ(stopMask) : SCAN_BLOCK_SIZE;
+	const u32 countMask = count < 32 ? (1u << count) - 1 : 0xffffffff;
+	scanState.line += PopCount(newLineMask & countMask);
+	scanState.current += count;
+	return stopMask != 0;
+}
+#endif
+
+// Skips spaces, tabs, carriage returns and new lines
+void SkipWhitespaces(ScanState &scanState)
+{
+#if SCAN_SIMD
+	while ( HasScanBlock(scanState) )
+	{
+		const ScanBlock block = LoadScanBlock(scanState.script + scanState.current);
+		const u32 newLineMask = MatchChar(block, '\n');
+		const u32 skipMask = MatchChar(block, ' ') | MatchChar(block, '\t') | MatchChar(block, '\r') | newLineMask;
+		if ( AdvanceScanBlock(scanState, skipMask, newLineMask) ) return;
+	}
+#endif
+	for (;;)
+	{
+		const char c = Peek(scanState);
+		if ( c == '\n' ) scanState.line++;
+		else if ( c != ' ' && c != '\t' && c != '\r' ) break;
+		scanState.current++;
+	}
+}
+
+// Skips characters up to the end of line (not included)
+void SkipLineComment(ScanState &scanState)
+{
+#if SCAN_SIMD
+	while ( HasScanBlock(scanState) )
+	{
+		const ScanBlock block = LoadScanBlock(scanState.script + scanState.current);
+		const u32 newLineMask = MatchChar(block, '\n');
+		if ( AdvanceScanBlock(scanState, ~newLineMask, 0) ) return;
+	}
+#endif
+	while ( !IsEOL( Peek(scanState) ) && !IsAtEnd(scanState) ) Advance(scanState);
+}
+
+// Skips characters up to the next occurrence of the given one (not included), counting lines
+void SkipUntil(ScanState &scanState, char terminator)
+{
+#if SCAN_SIMD
+	while ( HasScanBlock(scanState) )
+	{
+		const ScanBlock block = LoadScanBlock(scanState.script + scanState.current);
+		const u32 newLineMask = MatchChar(block, '\n');
+		const u32 stopMask = MatchChar(block, terminator);
+		if ( AdvanceScanBlock(scanState, ~stopMask, newLineMask) ) return;
+	}
+#endif
+	while ( Peek(scanState) != terminator && !IsAtEnd(scanState) )
+	{
+		if ( IsEOL( Peek(scanState) ) ) scanState.line++;
+		Advance(scanState);
+	}
+}
+
+// Skips characters up to and including the closing "*/", returns false if not found
+bool SkipBlockComment(ScanState &scanState)
+{
+	for (;;)
+	{
+		SkipUntil(scanState, '*');
+		if ( IsAtEnd(scanState) ) return false;
+		Advance(scanState);
+		if ( Consume(scanState, '/') ) return true;
+	}
+}
+
+// Skips letters, digits and underscores
+void SkipAlphaNumeric(ScanState &scanState)
+{
+#if SCAN_SIMD
+	while ( HasScanBlock(scanState) )
+	{
+		const ScanBlock block = LoadScanBlock(scanState.script + scanState.current);
+		const u32 skipMask =
+			MatchRange(block, 'a', 'z') |
+			MatchRange(block, 'A', 'Z') |
+			MatchRange(block, '0', '9') |
+			MatchChar(block, '_');
+		if ( AdvanceScanBlock(scanState, skipMask, 0) ) return;
+	}
+#endif
+	while ( IsAlphaNumeric( Peek(scanState) ) ) Advance(scanState);
+}
+
 String ScannedString(const ScanState &scanState)
 {
 	const char *lexemeStart = scanState.script + scanState.start;
@@ -150,7 +356,8 @@ void AddToken(const ScanState &scanState, TokenList &tokenList, TokenId tokenId,
 	newToken.literal = literal;
 	newToken.line = scanState.line;
 
-	ASSERT( tokenList.count < MAX_TOKEN_COUNT );
+	ASSERT( tokenList.count < tokenList.capacity );
+	if ( tokenList.arena ) PushStruct(*tokenList.arena, Token);
 	tokenList.tokens[tokenList.count++] = newToken;
 }
 
@@ -199,6 +406,8 @@ void ScanToken(ScanState &scanState, TokenList &tokenList)
 		case ')': AddToken(scanState, tokenList, TOKEN_RIGHT_PAREN); break;
 		case '{': AddToken(scanState, tokenList, TOKEN_LEFT_BRACE); break;
 		case '}': AddToken(scanState, tokenList, TOKEN_RIGHT_BRACE); break;
+		case '[': AddToken(scanState, tokenList, TOKEN_LEFT_BRACKET); break;
+		case ']': AddToken(scanState, tokenList, TOKEN_RIGHT_BRACKET); break;
 		case ',': AddToken(scanState, tokenList, TOKEN_COMMA); break;
 		case '.': AddToken(scanState, tokenList, TOKEN_DOT); break;
 		case '-': AddToken(scanState, tokenList, TOKEN_MINUS); break;
@@ -209,18 +418,19 @@ void ScanToken(ScanState &scanState, TokenList &tokenList)
 		case '=': AddToken(scanState, tokenList, Consume(scanState, '=') ? TOKEN_EQUAL_EQUAL : TOKEN_EQUAL); break;
 		case '<': AddToken(scanState, tokenList, Consume(scanState, '=') ? TOKEN_LESS_EQUAL : TOKEN_LESS); break;
 		case '>': AddToken(scanState, tokenList, Consume(scanState, '=') ? TOKEN_GREATER_EQUAL : TOKEN_GREATER); break;
+		case '&': AddToken(scanState, tokenList, Consume(scanState, '&') ? TOKEN_ANDAND : TOKEN_AND); break;
+		case '|': AddToken(scanState, tokenList, Consume(scanState, '|') ? TOKEN_OROR : TOKEN_OR); break;
 		case '/':
 			if ( Consume(scanState, '/') )
 			{
 				// Discard all chars until the end of line is reached
-				while ( !IsEOL( Peek(scanState) ) && !IsAtEnd(scanState) ) Advance(scanState);
+				SkipLineComment(scanState);
 			}
 			else if ( Consume(scanState, '*') )
 			{
-				while( Peek(scanState) != '*' && PeekNext(scanState) != '/' &&  !IsAtEnd(scanState) )
+				if ( !SkipBlockComment(scanState) )
 				{
-					if ( IsEOL( Peek(scanState) ) ) scanState.line++;
-					Advance(scanState);
+					ReportError( scanState, "Unterminated block comment." );
 				}
 			}
 			else
@@ -233,19 +443,17 @@ void ScanToken(ScanState &scanState, TokenList &tokenList)
 		case ' ':
 		case '\r':
 		case '\t':
+			SkipWhitespaces(scanState);
 			break;
 
 		// End of line counter
 		case '\n':
 			scanState.line++;
+			SkipWhitespaces(scanState);
 			break;
 
 		case '\"':
-			while ( Peek(scanState) != '\"' && !IsAtEnd(scanState) )
-			{
-				if ( IsEOL( Peek(scanState) ) ) scanState.line++;
-				Advance(scanState);
-			}
+			SkipUntil(scanState, '\"');
 
 			if ( IsAtEnd(scanState) )
 			{
@@ -273,7 +481,7 @@ void ScanToken(ScanState &scanState, TokenList &tokenList)
 			}
 			else if ( IsAlpha(c) )
 			{
-				while ( IsAlphaNumeric( Peek(scanState) ) ) Advance(scanState);
+				SkipAlphaNumeric(scanState);
 
 				String word = ScannedString(scanState);
 
@@ -302,23 +510,202 @@ void ScanToken(ScanState &scanState, TokenList &tokenList)
 	}
 }
 
-TokenList Scan(Arena &arena, ScanState &scanState, const char *script, u32 scriptSize)
+void ScanTokens(ScanState &scanState, TokenList &tokenList)
+{
+	while ( !IsAtEnd(scanState) )
+	{
+		ScanToken(scanState, tokenList);
+	}
+}
+
+// Parallel scanning of large scripts
+//
+// A quick pre-pass splits the script in chunks at new lines found outside of strings and
+// comments, remembering the line number at each split. Then chunks are scanned on separate
+// threads into temporary token lists that are finally stitched together.
+
+#define PARALLEL_SCAN_MIN_SCRIPT_SIZE MB(1)
+#define PARALLEL_SCAN_MIN_CHUNK_SIZE KB(256)
+#define PARALLEL_SCAN_MAX_CHUNKS 64
+
+struct ScanChunk
+{
+	ScanState scanState;
+	TokenList tokenList;
+	Arena tokensArena;
+};
+
+u32 SplitScript(const char *script, u32 scriptSize, ScanChunk *chunks, u32 maxChunksCount)
+{
+	ScanState scanState = {};
+	scanState.script = script;
+	scanState.scriptSize = scriptSize;
+	scanState.line = 1;
+
+	const u32 targetChunkSize = scriptSize / maxChunksCount;
+
+	u32 chunksCount = 0;
+	u32 chunkStart = 0;
+	i32 chunkLine = 1;
+
+	while ( !IsAtEnd(scanState) )
+	{
+		const char c = Advance(scanState);
+		if ( c == '\n' )
+		{
+			scanState.line++;
+			if ( scanState.current - chunkStart >= targetChunkSize && chunksCount + 1 < maxChunksCount )
+			{
+				ScanChunk &chunk = chunks[chunksCount++];
+				chunk.scanState.script = script + chunkStart;
+				chunk.scanState.scriptSize = scanState.current - chunkStart;
+				chunk.scanState.line = chunkLine;
+				chunkStart = scanState.current;
+				chunkLine = scanState.line;
+			}
+		}
+		else if ( c == '\"' )
+		{
+			SkipUntil(scanState, '\"');
+			if ( !IsAtEnd(scanState) ) Advance(scanState);
+		}
+		else if ( c == '/' && Consume(scanState, '/') )
+		{
+			SkipLineComment(scanState);
+		}
+		else if ( c == '/' && Consume(scanState, '*') )
+		{
+			SkipBlockComment(scanState);
+		}
+	}
+
+	ScanChunk &lastChunk = chunks[chunksCount++];
+	lastChunk.scanState.script = script + chunkStart;
+	lastChunk.scanState.scriptSize = scriptSize - chunkStart;
+	lastChunk.scanState.line = chunkLine;
+
+	return chunksCount;
+}
+
+void ScanChunkTokens(ScanChunk &chunk)
+{
+	// Every token spans at least one character, which bounds the token count. That much is
+	// only reserved, the arena commits memory as tokens are pushed.
+	const u32 capacity = chunk.scanState.scriptSize + 1;
+	chunk.tokensArena = MakeGrowableArena((u64)capacity * sizeof(Token));
+	chunk.tokenList.tokens = (Token*)chunk.tokensArena.base;
+	chunk.tokenList.capacity = capacity;
+	chunk.tokenList.arena = &chunk.tokensArena;
+
+	ScanTokens(chunk.scanState, chunk.tokenList);
+}
+
+THREAD_FUNCTION(ScanChunkMain)
+{
+	ScanChunkTokens(*(ScanChunk*)arguments);
+	THREAD_FUNCTION_RETURN();
+}
+
+PARALLEL_FOR_FUNCTION(ScanChunksJob)
 {
+	ScanChunk *chunks = (ScanChunk*)arguments;
+	for (u32 i = begin; i < end; ++i)
+	{
+		ScanChunkTokens(chunks[i]);
+	}
+}
+
+TokenList ScanParallel(Arena &arena, ScanState &scanState, const char *script, u32 scriptSize, u32 maxChunksCount)
+{
+	ScanChunk chunks[PARALLEL_SCAN_MAX_CHUNKS] = {};
+	const u32 chunksCount = SplitScript(script, scriptSize, chunks, maxChunksCount);
+
+	// Within jobs (e.g. batch runs), chunks go to the job system instead of oversubscribing cores
+	if ( JobSystem *jobs = GetJobSystem() )
+	{
+		RunParallelFor(*jobs, chunksCount, 1, ScanChunksJob, chunks);
+	}
+	else
+	{
+		Thread threads[PARALLEL_SCAN_MAX_CHUNKS];
+		for (u32 i = 1; i < chunksCount; ++i)
+		{
+			threads[i] = CreateThread(ScanChunkMain, &chunks[i]);
+		}
+		ScanChunkTokens(chunks[0]);
+		for (u32 i = 1; i < chunksCount; ++i)
+		{
+			JoinThread(threads[i]);
+		}
+	}
+
+	// Stitch chunks together
+	i32 tokensCount = 0;
+	for (u32 i = 0; i < chunksCount; ++i)
+	{
+		tokensCount += chunks[i].tokenList.count;
+		scanState.hasErrors = scanState.hasErrors || chunks[i].scanState.hasErrors;
+	}
+
 	TokenList tokenList = {};
-	tokenList.tokens = PushArray(arena, Token, MAX_TOKEN_COUNT);
+	tokenList.capacity = tokensCount + 1; // + EOF
+	tokenList.tokens = PushArray(arena, Token, tokenList.capacity);
+
+	for (u32 i = 0; i < chunksCount; ++i)
+	{
+		ScanChunk &chunk = chunks[i];
+		MemCopy(tokenList.tokens + tokenList.count, chunk.tokenList.tokens, chunk.tokenList.count * sizeof(Token));
+		tokenList.count += chunk.tokenList.count;
+		FreeGrowableArena(chunk.tokensArena);
+	}
+
+	scanState.current = scriptSize;
+	scanState.line = chunks[chunksCount - 1].scanState.line;
+
+	return tokenList;
+}
 
+// Scans the script in chunksCount chunks in parallel, or serially if it is 1
+TokenList Scan(Arena &arena, ScanState &scanState, const char *script, u32 scriptSize, u32 chunksCount)
+{
 	scanState.line = 1;
 	scanState.hasErrors = false;
 	scanState.script = script;
 	scanState.scriptSize = scriptSize;
 
-	while ( !IsAtEnd(scanState) )
+	TokenList tokenList = {};
+
+	if ( chunksCount > 1 )
 	{
-		ScanToken(scanState, tokenList);
+		tokenList = ScanParallel(arena, scanState, script, scriptSize, chunksCount);
+	}
+	else
+	{
+		// Every token spans at least one character, which bounds the token count (+ EOF)
+		tokenList.capacity = scriptSize + 1;
+		tokenList.tokens = PushArray(arena, Token, tokenList.capacity);
+		ScanTokens(scanState, tokenList);
 	}
 
+	scanState.start = scanState.current;
 	AddToken(scanState, tokenList, TOKEN_EOF);
 
+	if ( chunksCount <= 1 )
+	{
+		// Tokens are the last allocation, so the arena can take back what was not used
+		arena.used -= (tokenList.capacity - tokenList.count) * sizeof(Token);
+		tokenList.capacity = tokenList.count;
+	}
+
+	return tokenList;
+}
+
+TokenList Scan(Arena &arena, ScanState &scanState, const char *script, u32 scriptSize)
+{
+	const u32 maxChunksCount = Min(GetProcessorCount(), (u32)PARALLEL_SCAN_MAX_CHUNKS);
+	const u32 chunksCount = Min(maxChunksCount, scriptSize / PARALLEL_SCAN_MIN_CHUNK_SIZE);
+	const bool parallel = scriptSize >= PARALLEL_SCAN_MIN_SCRIPT_SIZE && chunksCount > 1;
+	const TokenList tokenList = Scan(arena, scanState, script, scriptSize, parallel ? chunksCount : 1);
 	return tokenList;
 }
 
@@ -329,23 +716,105 @@ TokenList Scan(Arena &arena, ScanState &scanState, const char *script, u32 scrip
 
 // Grammar:
 // program        -> declaration* EOF
-// declaration    -> varDecl | statement
-// statement      -> exprStatement | printStatement
+// declaration    -> classDecl | funDecl | varDecl | statement
+// classDecl      -> "class" IDENTIFIER ( "<" IDENTIFIER )? "{" function* "}"
+// funDecl        -> "fun" function
+// function       -> IDENTIFIER "(" parameters? ")" block
+// parameters     -> IDENTIFIER ( "," IDENTIFIER )*
+// statement      -> exprStatement | printStatement | returnStatement | block | ifStatement | whileStatement
+// returnStatement -> "return" expression? ";"
+// block          -> "{" declaration* "}"
+// ifStatement    -> "if" "(" expression ")" statement ( "else" statement )?
+// whileStatement -> "while" "(" expression ")" statement
 // exprStatement  -> expression ";"
 // printStatement -> "print" "(" expression ")" ";"
-// expression     -> assignment
-// assignment     -> IDENTIFIER "=" assignment | equality
-// equality       -> comparison ( ( "!=" | "==") comparison )
-// comparison     -> term ( ( ">" | ">=" | "<" | "<=" ) term )*
-// term           -> factor ( ( "-" | "+" ) factor )*
-// factor         -> unary ( ( "/" | "*" ) unary )*
-// unary          -> ( "!" | "-" ) unary | primary
-// primary        -> NUMBER | STRING | "true" | "false" | "nil" | "(" expression ")"
+// expression     -> ( "!" | "-" )* primary ( infix )*
+// infix          -> ( BINARY_OPERATOR | "&&" | "||" ) expression | "=" expression | "(" arguments? ")" | "." IDENTIFIER | "[" expression "]"
+// arguments      -> expression ( "," expression )*
+// primary        -> NUMBER | STRING | IDENTIFIER | "true" | "false" | "nil" | "this" | "super" "." IDENTIFIER
+//                 | "(" expression ")" | "[" arguments? "]"
+//
+// Expressions are parsed with precedence climbing (Pratt parsing): infix operators are
+// looked up in BindingPowers and only bind to the left operand while their precedence is
+// at least the one of the enclosing operator. Precedences from lowest to highest:
+// assignment (right associative), "||", "&&", "==" "!=", ">" ">=" "<" "<=", "+" "-",
+// "*" "/", unary "!" "-", and call / property access.
+
+#define MAX_CALL_ARGUMENTS 64
+#define MAX_ARRAY_ELEMENTS 256 // in array literals
+#define INLINE_CACHE_SIZE 4
+
+enum Precedence
+{
+	PREC_NONE,
+	PREC_ASSIGNMENT,
+	PREC_OR,
+	PREC_AND,
+	PREC_EQUALITY,
+	PREC_COMPARISON,
+	PREC_TERM,
+	PREC_FACTOR,
+	PREC_UNARY,
+	PREC_CALL,
+};
+
+// Precedence of each token when found after an operand, PREC_NONE if it is not an infix operator
+static const u8 BindingPowers[] =
+{
+	PREC_CALL,       // TOKEN_LEFT_PAREN
+	PREC_NONE,       // TOKEN_RIGHT_PAREN
+	PREC_NONE,       // TOKEN_LEFT_BRACE
+	PREC_NONE,       // TOKEN_RIGHT_BRACE
+	PREC_CALL,       // TOKEN_LEFT_BRACKET
+	PREC_NONE,       // TOKEN_RIGHT_BRACKET
+	PREC_NONE,       // TOKEN_COMMA
+	PREC_CALL,       // TOKEN_DOT
+	PREC_TERM,       // TOKEN_MINUS
+	PREC_TERM,       // TOKEN_PLUS
+	PREC_NONE,       // TOKEN_SEMICOLON
+	PREC_FACTOR,     // TOKEN_SLASH
+	PREC_FACTOR,     // TOKEN_STAR
+	PREC_NONE,       // TOKEN_NOT
+	PREC_EQUALITY,   // TOKEN_NOT_EQUAL
+	PREC_ASSIGNMENT, // TOKEN_EQUAL
+	PREC_EQUALITY,   // TOKEN_EQUAL_EQUAL
+	PREC_COMPARISON, // TOKEN_GREATER
+	PREC_COMPARISON, // TOKEN_GREATER_EQUAL
+	PREC_COMPARISON, // TOKEN_LESS
+	PREC_COMPARISON, // TOKEN_LESS_EQUAL
+	PREC_NONE,       // TOKEN_AND
+	PREC_AND,        // TOKEN_ANDAND
+	PREC_NONE,       // TOKEN_OR
+	PREC_OR,         // TOKEN_OROR
+	PREC_NONE,       // TOKEN_IDENTIFIER
+	PREC_NONE,       // TOKEN_STRING
+	PREC_NONE,       // TOKEN_NUMBER
+	PREC_NONE,       // TOKEN_IF
+	PREC_NONE,       // TOKEN_ELSE
+	PREC_NONE,       // TOKEN_FOR
+	PREC_NONE,       // TOKEN_WHILE
+	PREC_NONE,       // TOKEN_CLASS
+	PREC_NONE,       // TOKEN_SUPER
+	PREC_NONE,       // TOKEN_THIS
+	PREC_NONE,       // TOKEN_FUN
+	PREC_NONE,       // TOKEN_RETURN
+	PREC_NONE,       // TOKEN_TRUE
+	PREC_NONE,       // TOKEN_FALSE
+	PREC_NONE,       // TOKEN_NIL
+	PREC_NONE,       // TOKEN_VAR
+	PREC_NONE,       // TOKEN_PRINT
+	PREC_NONE,       // TOKEN_EOF
+};
+
+CT_ASSERT(ARRAY_COUNT(BindingPowers) == ARRAY_COUNT(TokenNames));
 
 struct ParseState
 {
 	TokenList* tokenList;
 	u32 current;
+	u32 scopeDepth;
+	u32 functionDepth;
+	u32 currentClass; // StmtId of the class whose method is being parsed, 0 outside methods
 	bool hasErrors;
 };
 
@@ -355,86 +824,209 @@ enum ExprType
 	EXPR_LITERAL,
 	EXPR_UNARY,
 	EXPR_BINARY,
+	EXPR_LOGICAL,
 	EXPR_ASSIGNMENT,
+	EXPR_CALL,
+	EXPR_GET,
+	EXPR_SET,
+	EXPR_ARRAY,
+	EXPR_INDEX,
+	EXPR_INDEX_SET,
+	EXPR_SUPER,
 };
 
 struct Expr;
+struct Shape;
+
+// Property access sites remember the shapes they have seen along with the slot where the
+// property lives for each of them (and the shape transition it caused, in case of sets).
+// Sites seeing more than INLINE_CACHE_SIZE shapes keep replacing entries round-robin.
+struct InlineCacheEntry
+{
+	Shape *shape;
+	Shape *newShape;
+	u32 slot;
+};
 
-struct ExprIdentifier
+struct InlineCache
 {
-	Token *identifierToken;
+	InlineCacheEntry entries[INLINE_CACHE_SIZE];
+	u32 entriesCount;
 };
 
-struct ExprLiteral
+struct PropertySite
 {
-	Token *literalToken;
+	const char *name; // interned
+	InlineCache cache;
 };
 
+// Expressions live in a contiguous array and reference each other (and tokens) by 32-bit
+// indices instead of pointers. Operators are stored inline. Index 0 means no expression.
+typedef u32 ExprId;
+
 struct ExprUnary
 {
-	Token *operatorToken;
-	Expr *expr;
+	ExprId expr;
 };
 
 struct ExprBinary
 {
-	Expr *left;
-	Token *operatorToken;
-	Expr *right;
+	ExprId left;
+	ExprId right;
 };
 
 struct ExprAssignment
 {
-	Token *nameToken;
-	Expr *right;
+	ExprId right;
+};
+
+struct ExprCall
+{
+	ExprId callee;
+	u32 firstArgument; // index into Program::arguments
+};
+
+struct ExprGet
+{
+	ExprId object;
+	u32 site; // index into Program::sites
+};
+
+struct ExprSet
+{
+	ExprId object;
+	u32 site; // index into Program::sites
+	ExprId value;
+};
+
+struct ExprArray
+{
+	u32 firstElement; // index into Program::arguments
+};
+
+struct ExprIndex
+{
+	ExprId object;
+	ExprId index;
+	ExprId value; // only for EXPR_INDEX_SET
+};
+
+struct ExprSuper
+{
+	u32 klass; // StmtId of the class declaring the method
 };
 
 struct Expr
 {
-	ExprType type;
+	u8 type; // ExprType
+	u8 op;   // TokenId of unary, binary and logical operators
+	u16 argumentsCount; // also elements of array literals
+	u32 token; // identifier, literal, operator, property name, call parenthesis or bracket
 	union
 	{
-		ExprIdentifier identifier;
-		ExprLiteral literal;
 		ExprUnary unary;
-		ExprBinary binary;
+		ExprBinary binary; // Also for logical expressions
 		ExprAssignment assignment;
+		ExprCall call;
+		ExprGet get;
+		ExprSet set;
+		ExprArray array;
+		ExprIndex index;
+		ExprSuper super;
 	};
 };
 
-struct ExprList
-{
-	Expr exprs[8];
-	u32 exprsCount;
-	ExprList *next;
-};
+CT_ASSERT(sizeof(Expr) == 20);
+CT_ASSERT(TOKEN_EOF <= U8_MAX);
 
 enum StmtType
 {
 	STMT_PRINT,
 	STMT_EXPR,
 	STMT_VAR_DECL,
+	STMT_CLASS_DECL,
+	STMT_FUN_DECL, // also methods, linked through next from the body of their class
+	STMT_RETURN,
+	STMT_BLOCK,
+	STMT_IF,
+	STMT_WHILE,
 };
 
+// Statements are stored like expressions, index 0 means no statement. Statements in the
+// same block are linked through next.
+typedef u32 StmtId;
+
 struct Stmt
 {
 	StmtType type;
-	Expr *expr;
-	Token *identifier;
+	ExprId expr;       // expression, initializer, condition or superclass
+	u32 identifier;    // token index
+	i32 line;
+	StmtId next;       // next statement in the same block
+	StmtId body;       // first statement of a block, then branch or loop body
+	StmtId elseBranch;
+	u32 firstParam;    // token index, parameters are separated by commas so the i-th one is at firstParam + 2*i
+	u32 paramsCount;
+	bool local;        // declared inside a block
+	bool initializer;  // init method, which always returns the instance
 };
 
-struct StmtList
+struct Program
 {
-	Stmt stmts[8];
+	Arena *arena;
+	const TokenList *tokenList;
+
+	Expr *exprs;
+	u32 exprsCount;
+	u32 exprsCapacity;
+
+	ExprId *arguments;
+	u32 argumentsCount;
+	u32 argumentsCapacity;
+
+	PropertySite *sites;
+	u32 sitesCount;
+	u32 sitesCapacity;
+
+	Stmt *stmts;
 	u32 stmtsCount;
-	StmtList *next;
+	u32 stmtsCapacity;
+	StmtId firstStmt;
+
+	StringInterning interning;
 };
 
-struct Program
+// Hidden classes
+//
+// Instances created in the same way share a chain of shapes. Each shape adds one property
+// to its parent and knows the slot where the value of that property is stored within the
+// instance, so instances only store a shape pointer plus an array of slot values.
+// Shapes are allocated along with the program, as its inline caches point to them.
+
+struct Shape
 {
-	Arena *arena;
-	ExprList *expressions;
-	StmtList *statements;
+	const char *name; // interned name of the property added by this shape
+	u32 slot;
+	u32 slotsCount;
+	Shape *parent;
+	Shape *transitions; // first child shape
+	Shape *sibling;     // next child shape of the parent
+};
+
+struct Class
+{
+	String name;
+	Shape *rootShape;
+	Class *superclass;
+	u32 decl; // StmtId of the class declaration, whose body lists the methods
+};
+
+struct Instance
+{
+	Class *klass;
+	Shape *shape;
+	Value *slots;
+	u32 slotsCapacity;
 };
 
 struct Var
@@ -453,6 +1045,7 @@ struct VarList
 struct Environment
 {
 	VarList *variables;
+	Program *program; // declares the functions and classes of the variables, next scripts run on top of it
 };
 
 void ReportError(ParseState &parseState, const char *message)
@@ -470,6 +1063,13 @@ bool IsAtEnd(const ParseState &parseState)
 	return currentToken.type == TOKEN_EOF;
 }
 
+bool Check(const ParseState &parseState, TokenId tokenId)
+{
+	const TokenList &tokenList = *parseState.tokenList;
+	const Token &currentToken = tokenList.tokens[ parseState.current ];
+	return currentToken.type == tokenId;
+}
+
 bool Consume(ParseState &parseState, TokenId tokenId)
 {
 	TokenList &tokenList = *parseState.tokenList;
@@ -498,131 +1098,133 @@ void ConsumeForced(ParseState &parseState, TokenId tokenId, const char *context)
 	}
 }
 
-Token* Consumed(ParseState &parseState)
+u32 Consumed(ParseState &parseState)
 {
 	ASSERT( parseState.current > 0 );
-	TokenList &tokenList = *parseState.tokenList;
-	Token &consumedToken = tokenList.tokens[ parseState.current - 1 ];
-	return &consumedToken;
+	return parseState.current - 1;
 }
 
-Expr* AddExpression(Program &program)
+const Token &GetToken(const Program &program, u32 token)
 {
-	// Ensure the first expression list block
-	if ( !program.expressions )
-	{
-		program.expressions = PushStruct(*program.arena, ExprList);
-		program.expressions->exprsCount = 0;
-		program.expressions->next = 0;
-	}
+	return program.tokenList->tokens[token];
+}
 
-	// Advance to the last expression list block
-	ExprList *list = program.expressions;
-	while ( list->next ) list = list->next;
+Expr &GetExpr(Program &program, ExprId expr)
+{
+	ASSERT( expr > 0 && expr < program.exprsCount );
+	return program.exprs[expr];
+}
 
-	// Ensure we have a list block with space
-	if ( list->exprsCount == ARRAY_COUNT(list->exprs) )
-	{
-		list->next = PushStruct(*program.arena, ExprList);
-		list->next->exprsCount = 0;
-		list->next->next = 0;
-		list = list->next;
-	}
+ExprId AddExpression(Program &program, ExprType type, u32 token)
+{
+	ASSERT( program.exprsCount < program.exprsCapacity );
+	const ExprId exprId = program.exprsCount++;
+	Expr &expr = program.exprs[exprId];
+	ZeroStruct(&expr);
+	expr.type = type;
+	expr.token = token;
+	return exprId;
+}
 
-	Expr* expr = &list->exprs[list->exprsCount++];
-	return expr;
+ExprId AddExpression(Program &program, u32 token)
+{
+	const ExprType type = GetToken(program, token).type == TOKEN_IDENTIFIER ? EXPR_IDENTIFIER : EXPR_LITERAL;
+	return AddExpression(program, type, token);
 }
 
-Expr* AddExpression(Program &program, Token* token)
+ExprId AddExpression(Program &program, u32 operatorToken, ExprId pExpr)
 {
-	Expr* expr = AddExpression(program);
-	if ( token->type == TOKEN_IDENTIFIER )
-	{
-		expr->type = EXPR_IDENTIFIER;
-		expr->identifier.identifierToken = token;
-	}
-	else
-	{
-		expr->type = EXPR_LITERAL;
-		expr->literal.literalToken = token;
-	}
-	return expr;
+	const ExprId exprId = AddExpression(program, EXPR_UNARY, operatorToken);
+	Expr &expr = program.exprs[exprId];
+	expr.op = GetToken(program, operatorToken).type;
+	expr.unary.expr = pExpr;
+	return exprId;
 }
 
-Expr* AddExpression(Program &program, Token* operatorToken, Expr* pExpr)
+ExprId AddExpression(Program &program, ExprId left, u32 operatorToken, ExprId right)
 {
-	Expr* expr = AddExpression(program);
-	expr->type = EXPR_UNARY;
-	expr->unary.operatorToken = operatorToken;
-	expr->unary.expr = pExpr;
-	return expr;
+	const ExprId exprId = AddExpression(program, EXPR_BINARY, operatorToken);
+	Expr &expr = program.exprs[exprId];
+	expr.op = GetToken(program, operatorToken).type;
+	expr.binary.left = left;
+	expr.binary.right = right;
+	return exprId;
 }
 
-Expr* AddExpression(Program &program, Expr* left, Token* operatorToken, Expr* right)
+StmtId AddStatement(Program &program, StmtType type, ExprId expr)
 {
-	Expr* expr = AddExpression(program);
-	expr->type = EXPR_BINARY;
-	expr->binary.left = left;
-	expr->binary.operatorToken = operatorToken;
-	expr->binary.right = right;
-	return expr;
+	ASSERT( program.stmtsCount < program.stmtsCapacity );
+	const StmtId stmtId = program.stmtsCount++;
+	Stmt &stmt = program.stmts[stmtId];
+	ZeroStruct(&stmt);
+	stmt.type = type;
+	stmt.expr = expr;
+	return stmtId;
+}
+
+StmtId AddDeclaration(Program &program, StmtType type, u32 tokenIdentifier, ExprId expr, bool local)
+{
+	const StmtId stmtId = AddStatement(program, type, expr);
+	Stmt &stmt = program.stmts[stmtId];
+	stmt.identifier = tokenIdentifier;
+	stmt.local = local;
+	return stmtId;
 }
 
-Stmt* AddStatement(Program &program)
+void AppendStatement(Program &program, StmtId &first, StmtId &last, StmtId stmt)
 {
-	// Ensure first list block
-	if ( !program.statements )
+	if ( last )
 	{
-		program.statements = PushStruct(*program.arena, StmtList);
-		program.statements->stmtsCount = 0;
-		program.statements->next = 0;
+		program.stmts[last].next = stmt;
 	}
-
-	// Advance to the last list block
-	StmtList *list = program.statements;
-	while ( list->next ) list = list->next;
-
-	// Ensure a current list block with space
-	if ( list->stmtsCount == ARRAY_COUNT( list->stmts ) )
+	else
 	{
-		list->next = PushStruct(*program.arena, StmtList);
-		list->next->stmtsCount = 0;
-		list->next->next = 0;
-		list = list->next;
+		first = stmt;
 	}
-
-	Stmt *stmt = &list->stmts[ list->stmtsCount++ ];
-	return stmt;
+	last = stmt;
 }
 
-Stmt* AddPrintStatement(Program &program, Expr *expr)
+ExprId ParseExpression(ParseState &parseState, Program &program, u8 minPrecedence = PREC_ASSIGNMENT);
+
+const char *InternString(Program &program, String string)
 {
-	Stmt *statement = AddStatement(program);
-	statement->type = STMT_PRINT;
-	statement->expr = expr;
-	return statement;
+	return MakeStringIntern(&program.interning, string.str, string.size);
 }
 
-Stmt* AddExpressionStatement(Program &program, Expr *expr)
+// Parses comma separated expressions until the closing token and adds them contiguously
+// to Program::arguments. Returns their count.
+u32 ParseExpressionList(ParseState &parseState, Program &program, TokenId closing, u32 maxCount, u32 &first)
 {
-	Stmt *statement = AddStatement(program);
-	statement->type = STMT_EXPR;
-	statement->expr = expr;
-	return statement;
-}
+	// Nested lists may add their own expressions while parsing ours, so expressions
+	// are collected here first and then added contiguously.
+	ExprId exprs[MAX_ARRAY_ELEMENTS];
+	ASSERT( maxCount <= ARRAY_COUNT(exprs) );
 
-Stmt* AddVarDeclaration(Program &program, Token *tokenIdentifier, Expr *expr)
-{
-	Stmt *statement = AddStatement(program);
-	statement->type = STMT_VAR_DECL;
-	statement->expr = expr;
-	statement->identifier = tokenIdentifier;
-	return statement;
-}
+	u32 count = 0;
+	if ( !Consume(parseState, closing) )
+	{
+		do
+		{
+			if ( count == maxCount )
+			{
+				ReportError(parseState, "Too many expressions in list");
+				return 0;
+			}
+			exprs[count++] = ParseExpression(parseState, program);
+		}
+		while ( Consume(parseState, TOKEN_COMMA) );
 
-Expr* ParseExpression(ParseState &parseState, Program &program);
+		ConsumeForced(parseState, closing, __FUNCTION__);
+	}
+
+	ASSERT( program.argumentsCount + count <= program.argumentsCapacity );
+	first = program.argumentsCount;
+	MemCopy(program.arguments + first, exprs, count * sizeof(ExprId));
+	program.argumentsCount += count;
+	return count;
+}
 
-Expr* ParsePrimary(ParseState &parseState, Program &program)
+ExprId ParsePrimary(ParseState &parseState, Program &program)
 {
 	if ( Consume(parseState, TOKEN_FALSE) ) return AddExpression(program, Consumed(parseState));
 	if ( Consume(parseState, TOKEN_TRUE) ) return AddExpression(program, Consumed(parseState));
@@ -630,162 +1232,321 @@ Expr* ParsePrimary(ParseState &parseState, Program &program)
 	if ( Consume(parseState, TOKEN_NUMBER) ) return AddExpression(program, Consumed(parseState));
 	if ( Consume(parseState, TOKEN_STRING) ) return AddExpression(program, Consumed(parseState));
 	if ( Consume(parseState, TOKEN_IDENTIFIER) ) return AddExpression(program, Consumed(parseState));
+	if ( Consume(parseState, TOKEN_THIS) )
+	{
+		// Methods get the instance as a local named "this"
+		if ( !parseState.currentClass )
+		{
+			ReportError(parseState, "Can't use 'this' outside of a method");
+			return 0;
+		}
+		return AddExpression(program, EXPR_IDENTIFIER, Consumed(parseState));
+	}
+	if ( Consume(parseState, TOKEN_SUPER) )
+	{
+		if ( !parseState.currentClass || !program.stmts[parseState.currentClass].expr )
+		{
+			ReportError(parseState, "Can't use 'super' outside of a method of a subclass");
+			return 0;
+		}
+		ConsumeForced(parseState, TOKEN_DOT, __FUNCTION__);
+		ConsumeForced(parseState, TOKEN_IDENTIFIER, __FUNCTION__);
+		const ExprId expr = AddExpression(program, EXPR_SUPER, Consumed(parseState));
+		program.exprs[expr].super.klass = parseState.currentClass;
+		return expr;
+	}
 	if ( Consume(parseState, TOKEN_LEFT_PAREN) )
 	{
-		Expr* expr = ParseExpression(parseState, program);
+		ExprId expr = ParseExpression(parseState, program);
 		ConsumeForced(parseState, TOKEN_RIGHT_PAREN, __FUNCTION__);
 		return expr;
 	}
+	if ( Consume(parseState, TOKEN_LEFT_BRACKET) )
+	{
+		const u32 bracket = Consumed(parseState);
+		u32 firstElement = 0;
+		const u32 elementsCount = ParseExpressionList(parseState, program, TOKEN_RIGHT_BRACKET, MAX_ARRAY_ELEMENTS, firstElement);
+
+		const ExprId expr = AddExpression(program, EXPR_ARRAY, bracket);
+		program.exprs[expr].argumentsCount = elementsCount;
+		program.exprs[expr].array.firstElement = firstElement;
+		return expr;
+	}
 
 	ReportError(parseState, "Could not parse primary expression");
 	return 0;
 }
 
-Expr* ParseUnary(ParseState &parseState, Program &program)
-{
-	if ( Consume(parseState, TOKEN_NOT) ||
-		 Consume(parseState, TOKEN_MINUS) )
-	{
-		Token* op = Consumed(parseState);
-		Expr* expr = ParseUnary(parseState, program);
-		return AddExpression(program, op, expr);
-	}
-	else
-	{
-		return ParsePrimary(parseState, program);
-	}
-}
-
-Expr* ParseFactor(ParseState &parseState, Program &program)
+ExprId ParseCallArguments(ParseState &parseState, Program &program, ExprId callee)
 {
-	Expr *expr = ParseUnary(parseState, program);
+	const u32 paren = Consumed(parseState);
 
-	while ( Consume(parseState, TOKEN_STAR) ||
-			Consume(parseState, TOKEN_SLASH) )
-	{
-		Token* op = Consumed(parseState);
-		Expr* right = ParseUnary(parseState, program);
-		expr = AddExpression(program, expr, op, right);
-	}
+	u32 firstArgument = 0;
+	const u32 argumentsCount = ParseExpressionList(parseState, program, TOKEN_RIGHT_PAREN, MAX_CALL_ARGUMENTS, firstArgument);
 
+	const ExprId expr = AddExpression(program, EXPR_CALL, paren);
+	Expr &call = program.exprs[expr];
+	call.argumentsCount = argumentsCount;
+	call.call.callee = callee;
+	call.call.firstArgument = firstArgument;
 	return expr;
 }
 
-Expr* ParseTerm(ParseState &parseState, Program &program)
+ExprId ParseIndex(ParseState &parseState, Program &program, ExprId object)
 {
-	Expr* expr = ParseFactor(parseState, program);
-
-	while ( Consume(parseState, TOKEN_MINUS) ||
-			Consume(parseState, TOKEN_PLUS) )
-	{
-		Token* op = Consumed(parseState);
-		Expr* right = ParseFactor(parseState, program);
-		expr = AddExpression(program, expr, op, right);
-	}
+	const u32 bracket = Consumed(parseState);
+	ExprId index = ParseExpression(parseState, program);
+	ConsumeForced(parseState, TOKEN_RIGHT_BRACKET, __FUNCTION__);
 
+	const ExprId expr = AddExpression(program, EXPR_INDEX, bracket);
+	program.exprs[expr].index.object = object;
+	program.exprs[expr].index.index = index;
 	return expr;
 }
 
-Expr* ParseComparison(ParseState &parseState, Program &program)
+ExprId ParsePropertyAccess(ParseState &parseState, Program &program, ExprId object)
 {
-	Expr* expr = ParseTerm(parseState, program);
+	ConsumeForced(parseState, TOKEN_IDENTIFIER, __FUNCTION__);
+	const u32 nameToken = Consumed(parseState);
 
-	while ( Consume(parseState, TOKEN_GREATER) ||
-			Consume(parseState, TOKEN_GREATER_EQUAL) ||
-			Consume(parseState, TOKEN_LESS) ||
-			Consume(parseState, TOKEN_LESS_EQUAL) )
-	{
-		Token* op = Consumed(parseState);
-		Expr* right = ParseTerm(parseState, program);
-		expr = AddExpression(program, expr, op, right);
-	}
+	ASSERT( program.sitesCount < program.sitesCapacity );
+	const u32 site = program.sitesCount++;
+	ZeroStruct(&program.sites[site]);
+	program.sites[site].name = InternString(program, GetToken(program, nameToken).lexeme);
 
+	const ExprId expr = AddExpression(program, EXPR_GET, nameToken);
+	Expr &get = program.exprs[expr];
+	get.get.object = object;
+	get.get.site = site;
 	return expr;
 }
 
-Expr* ParseEquality(ParseState &parseState, Program &program)
+ExprId ParseAssignment(Program &program, ExprId target, ExprId right)
 {
-	Expr* expr = ParseComparison(parseState, program);
+	Expr &left = program.exprs[target];
 
-	if ( Consume(parseState, TOKEN_EQUAL_EQUAL) ||
-		 Consume(parseState, TOKEN_NOT_EQUAL) )
+	if (left.type == EXPR_IDENTIFIER && GetToken(program, left.token).type == TOKEN_IDENTIFIER)
 	{
-		Token* op = Consumed(parseState);
-		Expr* right = ParseComparison(parseState, program);
-		expr = AddExpression(program, expr, op, right);
+		ExprId exprAssign = AddExpression(program, EXPR_ASSIGNMENT, left.token);
+		program.exprs[exprAssign].assignment.right = right;
+		return exprAssign;
+	}
+	else if (left.type == EXPR_GET)
+	{
+		// Reuse the get node, which is no longer referenced by anyone else
+		ExprGet get = left.get;
+		left.type = EXPR_SET;
+		left.set.object = get.object;
+		left.set.site = get.site;
+		left.set.value = right;
+		return target;
+	}
+	else if (left.type == EXPR_INDEX)
+	{
+		left.type = EXPR_INDEX_SET;
+		left.index.value = right;
+		return target;
+	}
+	else
+	{
+		printf("Invalid assignment target.\n");
+		return target;
 	}
-
-	return expr;
 }
 
-Expr* ParseAssignment(ParseState &parseState, Program &program)
+ExprId ParseExpression(ParseState &parseState, Program &program, u8 minPrecedence)
 {
-	Expr *expr = ParseEquality(parseState, program);
+	ExprId expr = 0;
 
-	if ( Consume(parseState, TOKEN_EQUAL) )
+	if ( Consume(parseState, TOKEN_NOT) ||
+		 Consume(parseState, TOKEN_MINUS) )
+	{
+		const u32 op = Consumed(parseState);
+		ExprId operand = ParseExpression(parseState, program, PREC_UNARY);
+		expr = AddExpression(program, op, operand);
+	}
+	else
+	{
+		expr = ParsePrimary(parseState, program);
+	}
+
+	while ( expr && !parseState.hasErrors )
 	{
-		Expr *left = expr;
-		//Token *equals = Consumed(parseState);
-		Expr *right = ParseAssignment(parseState, program);
+		const TokenId tokenId = parseState.tokenList->tokens[ parseState.current ].type;
+		const u8 precedence = BindingPowers[ tokenId ];
+		if ( precedence < minPrecedence )
+		{
+			break;
+		}
+
+		parseState.current++;
 
-		if (left->type == EXPR_IDENTIFIER)
+		if ( tokenId == TOKEN_LEFT_PAREN )
+		{
+			expr = ParseCallArguments(parseState, program, expr);
+		}
+		else if ( tokenId == TOKEN_DOT )
+		{
+			expr = ParsePropertyAccess(parseState, program, expr);
+		}
+		else if ( tokenId == TOKEN_LEFT_BRACKET )
+		{
+			expr = ParseIndex(parseState, program, expr);
+		}
+		else if ( tokenId == TOKEN_EQUAL )
 		{
-			Expr *exprAssign = AddExpression(program);
-			exprAssign->type = EXPR_ASSIGNMENT;
-			exprAssign->assignment.nameToken = left->identifier.identifierToken;
-			exprAssign->assignment.right = right;
-			return exprAssign;
+			// Right associative
+			ExprId right = ParseExpression(parseState, program, PREC_ASSIGNMENT);
+			expr = ParseAssignment(program, expr, right);
 		}
 		else
 		{
-			printf("Invalid assignment target.\n");
+			// Left associative
+			const u32 op = Consumed(parseState);
+			ExprId right = ParseExpression(parseState, program, precedence + 1);
+			expr = AddExpression(program, expr, op, right);
+
+			if ( tokenId == TOKEN_ANDAND || tokenId == TOKEN_OROR )
+			{
+				program.exprs[expr].type = EXPR_LOGICAL;
+			}
 		}
 	}
 
 	return expr;
 }
 
-Expr* ParseExpression(ParseState &parseState, Program &program)
+StmtId ParseExpressionStatement(ParseState &parseState, Program &program)
 {
-	return ParseAssignment(parseState, program);
+	ExprId expr = ParseExpression(parseState, program);
+	ConsumeForced(parseState, TOKEN_SEMICOLON, __FUNCTION__);
+	return AddStatement(program, STMT_EXPR, expr);
 }
 
-Stmt* ParseExpressionStatement(ParseState &parseState, Program &program)
+StmtId ParsePrintStatement(ParseState &parseState, Program &program)
 {
-	Expr *expr = ParseExpression(parseState, program);
+	ConsumeForced(parseState, TOKEN_LEFT_PAREN, __FUNCTION__);
+	ExprId expr = ParseExpression(parseState, program);
+	ConsumeForced(parseState, TOKEN_RIGHT_PAREN, __FUNCTION__);
 	ConsumeForced(parseState, TOKEN_SEMICOLON, __FUNCTION__);
-	Stmt *stmt = AddExpressionStatement(program, expr);
+	return AddStatement(program, STMT_PRINT, expr);
+}
+
+StmtId ParseDeclaration(ParseState &parseState, Program &program);
+
+StmtId ParseBlock(ParseState &parseState, Program &program)
+{
+	StmtId first = 0;
+	StmtId last = 0;
+
+	parseState.scopeDepth++;
+
+	while ( !Check(parseState, TOKEN_RIGHT_BRACE) && !IsAtEnd(parseState) && !parseState.hasErrors )
+	{
+		StmtId stmt = ParseDeclaration(parseState, program);
+		AppendStatement(program, first, last, stmt);
+	}
+
+	parseState.scopeDepth--;
+
+	ConsumeForced(parseState, TOKEN_RIGHT_BRACE, __FUNCTION__);
+
+	StmtId block = AddStatement(program, STMT_BLOCK, 0);
+	program.stmts[block].body = first;
+	return block;
+}
+
+StmtId ParseStatement(ParseState &parseState, Program &program);
+
+StmtId ParseIfStatement(ParseState &parseState, Program &program)
+{
+	ConsumeForced(parseState, TOKEN_LEFT_PAREN, __FUNCTION__);
+	ExprId condition = ParseExpression(parseState, program);
+	ConsumeForced(parseState, TOKEN_RIGHT_PAREN, __FUNCTION__);
+
+	StmtId thenBranch = ParseStatement(parseState, program);
+	StmtId elseBranch = 0;
+	if ( Consume(parseState, TOKEN_ELSE) )
+	{
+		elseBranch = ParseStatement(parseState, program);
+	}
+
+	StmtId stmt = AddStatement(program, STMT_IF, condition);
+	program.stmts[stmt].body = thenBranch;
+	program.stmts[stmt].elseBranch = elseBranch;
 	return stmt;
 }
 
-Stmt* ParsePrintStatement(ParseState &parseState, Program &program)
+StmtId ParseWhileStatement(ParseState &parseState, Program &program)
 {
 	ConsumeForced(parseState, TOKEN_LEFT_PAREN, __FUNCTION__);
-	Expr *expr = ParseExpression(parseState, program);
+	ExprId condition = ParseExpression(parseState, program);
 	ConsumeForced(parseState, TOKEN_RIGHT_PAREN, __FUNCTION__);
-	ConsumeForced(parseState, TOKEN_SEMICOLON, __FUNCTION__);
-	Stmt *stmt = AddPrintStatement(program, expr);
+
+	StmtId body = ParseStatement(parseState, program);
+
+	StmtId stmt = AddStatement(program, STMT_WHILE, condition);
+	program.stmts[stmt].body = body;
 	return stmt;
 }
 
-Stmt* ParseStatement(ParseState &parseState, Program &program)
+StmtId ParseReturnStatement(ParseState &parseState, Program &program)
+{
+	if ( parseState.functionDepth == 0 )
+	{
+		ReportError(parseState, "Can't return from top-level code.");
+		return AddStatement(program, STMT_RETURN, 0);
+	}
+
+	ExprId expr = 0;
+	if ( !Check(parseState, TOKEN_SEMICOLON) )
+	{
+		expr = ParseExpression(parseState, program);
+	}
+	ConsumeForced(parseState, TOKEN_SEMICOLON, __FUNCTION__);
+	return AddStatement(program, STMT_RETURN, expr);
+}
+
+StmtId ParseStatement(ParseState &parseState, Program &program)
 {
+	const i32 line = parseState.tokenList->tokens[ parseState.current ].line;
+
+	StmtId stmt = 0;
 	if ( Consume(parseState, TOKEN_PRINT) )
 	{
-		return ParsePrintStatement(parseState, program);
+		stmt = ParsePrintStatement(parseState, program);
+	}
+	else if ( Consume(parseState, TOKEN_LEFT_BRACE) )
+	{
+		stmt = ParseBlock(parseState, program);
+	}
+	else if ( Consume(parseState, TOKEN_IF) )
+	{
+		stmt = ParseIfStatement(parseState, program);
+	}
+	else if ( Consume(parseState, TOKEN_WHILE) )
+	{
+		stmt = ParseWhileStatement(parseState, program);
+	}
+	else if ( Consume(parseState, TOKEN_RETURN) )
+	{
+		stmt = ParseReturnStatement(parseState, program);
 	}
 	else
 	{
-		return ParseExpressionStatement(parseState, program);
+		stmt = ParseExpressionStatement(parseState, program);
 	}
+
+	program.stmts[stmt].line = line;
+	return stmt;
 }
 
-Stmt* ParseVarDeclaration(ParseState &parseState, Program &program)
+StmtId ParseVarDeclaration(ParseState &parseState, Program &program)
 {
 	ConsumeForced(parseState, TOKEN_IDENTIFIER, __FUNCTION__);
-	Token *tokenIdentifier = Consumed( parseState );
+	const u32 tokenIdentifier = Consumed( parseState );
 
-	Expr *initExpr = 0;
+	ExprId initExpr = 0;
 	if ( Consume(parseState, TOKEN_EQUAL) )
 	{
 		initExpr = ParseExpression(parseState, program);
@@ -793,74 +1554,222 @@ Stmt* ParseVarDeclaration(ParseState &parseState, Program &program)
 
 	ConsumeForced(parseState, TOKEN_SEMICOLON, __FUNCTION__);
 
-	Stmt *stmt = AddVarDeclaration(program, tokenIdentifier, initExpr);
+	const bool local = parseState.scopeDepth > 0;
+	return AddDeclaration(program, STMT_VAR_DECL, tokenIdentifier, initExpr, local);
+}
+
+StmtId ParseFunDeclaration(ParseState &parseState, Program &program, StmtId klass);
+
+StmtId ParseClassDeclaration(ParseState &parseState, Program &program)
+{
+	ConsumeForced(parseState, TOKEN_IDENTIFIER, __FUNCTION__);
+	const u32 tokenIdentifier = Consumed( parseState );
+
+	ExprId superclass = 0;
+	if ( Consume(parseState, TOKEN_LESS) )
+	{
+		ConsumeForced(parseState, TOKEN_IDENTIFIER, __FUNCTION__);
+		const u32 tokenSuperclass = Consumed( parseState );
+		if ( StrEq( GetToken(program, tokenSuperclass).lexeme, GetToken(program, tokenIdentifier).lexeme ) )
+		{
+			ReportError(parseState, "A class can't inherit from itself");
+		}
+		superclass = AddExpression(program, tokenSuperclass);
+	}
+
+	// Added before the methods, as their super expressions refer to it
+	const bool local = parseState.scopeDepth > 0;
+	const StmtId stmt = AddDeclaration(program, STMT_CLASS_DECL, tokenIdentifier, superclass, local);
+
+	ConsumeForced(parseState, TOKEN_LEFT_BRACE, __FUNCTION__);
+	StmtId lastMethod = 0;
+	while ( !Check(parseState, TOKEN_RIGHT_BRACE) && !Check(parseState, TOKEN_EOF) && !parseState.hasErrors )
+	{
+		const i32 line = parseState.tokenList->tokens[ parseState.current ].line;
+		const StmtId method = ParseFunDeclaration(parseState, program, stmt);
+		program.stmts[method].line = line;
+		AppendStatement(program, program.stmts[stmt].body, lastMethod, method);
+	}
+	ConsumeForced(parseState, TOKEN_RIGHT_BRACE, __FUNCTION__);
+
+	return stmt;
+}
+
+// Also parses methods, given the class declaring them
+StmtId ParseFunDeclaration(ParseState &parseState, Program &program, StmtId klass)
+{
+	ConsumeForced(parseState, TOKEN_IDENTIFIER, __FUNCTION__);
+	const u32 tokenIdentifier = Consumed( parseState );
+
+	ConsumeForced(parseState, TOKEN_LEFT_PAREN, __FUNCTION__);
+	const u32 firstParam = parseState.current;
+	u32 paramsCount = 0;
+	if ( !Check(parseState, TOKEN_RIGHT_PAREN) )
+	{
+		do
+		{
+			if ( paramsCount == MAX_CALL_ARGUMENTS )
+			{
+				ReportError(parseState, "Too many parameters in function");
+				break;
+			}
+			ConsumeForced(parseState, TOKEN_IDENTIFIER, __FUNCTION__);
+			paramsCount++;
+		}
+		while ( Consume(parseState, TOKEN_COMMA) );
+	}
+	ConsumeForced(parseState, TOKEN_RIGHT_PAREN, __FUNCTION__);
+
+	// The name is declared before parsing the body, as in the enclosing scope
+	const bool local = parseState.scopeDepth > 0;
+
+	ConsumeForced(parseState, TOKEN_LEFT_BRACE, __FUNCTION__);
+	const u32 enclosingClass = parseState.currentClass;
+	parseState.currentClass = klass;
+	parseState.functionDepth++;
+	StmtId block = ParseBlock(parseState, program);
+	parseState.functionDepth--;
+	parseState.currentClass = enclosingClass;
+
+	StmtId stmt = AddDeclaration(program, STMT_FUN_DECL, tokenIdentifier, 0, local);
+	program.stmts[stmt].body = program.stmts[block].body;
+	program.stmts[stmt].firstParam = firstParam;
+	program.stmts[stmt].paramsCount = paramsCount;
+	program.stmts[stmt].initializer = klass && StrEq( GetToken(program, tokenIdentifier).lexeme, "init" );
 	return stmt;
 }
 
-void ParseDeclaration(ParseState &parseState, Program &program)
+StmtId ParseDeclaration(ParseState &parseState, Program &program)
 {
-	if ( Consume(parseState, TOKEN_VAR) )
+	const i32 line = parseState.tokenList->tokens[ parseState.current ].line;
+
+	StmtId stmt = 0;
+	if ( Consume(parseState, TOKEN_CLASS) )
+	{
+		stmt = ParseClassDeclaration(parseState, program);
+	}
+	else if ( Consume(parseState, TOKEN_FUN) )
+	{
+		stmt = ParseFunDeclaration(parseState, program, 0);
+	}
+	else if ( Consume(parseState, TOKEN_VAR) )
 	{
-		ParseVarDeclaration(parseState, program);
+		stmt = ParseVarDeclaration(parseState, program);
 	}
 	else
 	{
-		ParseStatement(parseState, program);
+		stmt = ParseStatement(parseState, program);
 	}
 
+	program.stmts[stmt].line = line;
+
 	// This is a good point to catch parsing errors and synchronize
 	if ( parseState.hasErrors )
 	{
 		// TODO(jesus): Advance to the next declaration/statement here
 	}
+
+	return stmt;
 }
 
 #if 0
-void PrintExpr(Expr* expr, u32 level = 0)
+void PrintExpr(Program &program, ExprId exprId, u32 level = 0)
 {
 	for (u32 i = 0; i < level; ++i) printf("  ");
 	u32 space = 16 - level*2;
 
-	if (expr->type == EXPR_LITERAL)
-	{
-		String lexeme = expr->literal.literalToken->lexeme;
-		printf("%.&s%*s(%s)\n", lexeme.size, lexeme.str, space, "", TokenNames[expr->literal.literalToken->type] );
-	}
-	else if (expr->type == EXPR_UNARY)
+	const Expr &expr = GetExpr(program, exprId);
+	const Token &token = GetToken(program, expr.token);
+	printf("%.*s%*s(%s)\n", token.lexeme.size, token.lexeme.str, space, "", TokenNames[token.type] );
+
+	if (expr.type == EXPR_UNARY)
 	{
-		String lexeme = expr->unary.operatorToken->lexeme;
-		printf("%.*s%*s(%s)\n", lexeme.size, lexeme.str, space, "", TokenNames[expr->unary.operatorToken->type] );
-		PrintExpr(expr->unary.expr, level+1);
+		PrintExpr(program, expr.unary.expr, level+1);
 	}
-	else if (expr->type == EXPR_BINARY)
+	else if (expr.type == EXPR_BINARY || expr.type == EXPR_LOGICAL)
 	{
-		String lexeme = expr->binary.operatorToken->lexeme;
-		printf("%.*s%*s(%s)\n", lexeme.size, lexeme.str, space, "", TokenNames[expr->binary.operatorToken->type] );
-		PrintExpr(expr->binary.left, level+1);
-		PrintExpr(expr->binary.right, level+1);
+		PrintExpr(program, expr.binary.left, level+1);
+		PrintExpr(program, expr.binary.right, level+1);
 	}
 }
 #endif
 
-Program Parse(Arena &arena, ParseState &parseState, TokenList &tokens)
+// Scripts running on top of a program (e.g. the prelude of an image) extend it: its tokens,
+// expressions and statements keep their indices, so the functions and classes it declared
+// stay valid, and the ones of the script come after them.
+TokenList AppendTokens(Arena &arena, const TokenList &baseTokens, const TokenList &tokens)
+{
+	TokenList tokenList = {};
+	tokenList.capacity = baseTokens.count + tokens.count;
+	tokenList.tokens = PushArray(arena, Token, tokenList.capacity);
+	MemCopy(tokenList.tokens, baseTokens.tokens, baseTokens.count * sizeof(Token));
+	MemCopy(tokenList.tokens + baseTokens.count, tokens.tokens, tokens.count * sizeof(Token));
+	tokenList.count = tokenList.capacity;
+	return tokenList;
+}
+
+// With a base program, tokens must start with its ones (see AppendTokens)
+Program Parse(Arena &arena, ParseState &parseState, TokenList &tokens, const Program *base = NULL)
 {
 	Program program = {};
 	program.arena = &arena;
+	program.tokenList = &tokens;
+	program.exprsCount = 1; // Skip ExprId 0, which means no expression
+	program.stmtsCount = 1; // Skip StmtId 0, which means no statement
+
+	u32 firstToken = 0;
+	if ( base )
+	{
+		// Shares the interned strings, which the shapes of existing instances point to
+		program.interning = base->interning;
+		program.exprsCount = base->exprsCount;
+		program.argumentsCount = base->argumentsCount;
+		program.sitesCount = base->sitesCount;
+		program.stmtsCount = base->stmtsCount;
+		firstToken = base->tokenList->count;
+	}
+	else
+	{
+		program.interning = StringInterningCreate(&arena);
+	}
+
+	// Every expression, argument and statement starts at a different token, which bounds
+	// their counts. Property sites are bounded by the number of dots.
+	u32 dotsCount = 0;
+	for (i32 i = firstToken; i < tokens.count; ++i)
+	{
+		dotsCount += tokens.tokens[i].type == TOKEN_DOT ? 1 : 0;
+	}
+
+	const u32 tokensCount = tokens.count - firstToken;
+	program.exprsCapacity = program.exprsCount + tokensCount;
+	program.exprs = PushArray(arena, Expr, program.exprsCapacity);
+	program.argumentsCapacity = program.argumentsCount + tokensCount;
+	program.arguments = PushArray(arena, ExprId, program.argumentsCapacity);
+	program.sitesCapacity = program.sitesCount + dotsCount;
+	program.sites = PushArray(arena, PropertySite, program.sitesCapacity);
+	program.stmtsCapacity = program.stmtsCount + tokensCount;
+	program.stmts = PushArray(arena, Stmt, program.stmtsCapacity);
+
+	if ( base )
+	{
+		MemCopy(program.exprs, base->exprs, base->exprsCount * sizeof(Expr));
+		MemCopy(program.arguments, base->arguments, base->argumentsCount * sizeof(ExprId));
+		MemCopy(program.sites, base->sites, base->sitesCount * sizeof(PropertySite));
+		MemCopy(program.stmts, base->stmts, base->stmtsCount * sizeof(Stmt));
+	}
 
 	parseState.tokenList = &tokens;
-	parseState.current = 0;
+	parseState.current = firstToken;
+	parseState.scopeDepth = 0;
+	parseState.functionDepth = 0;
 	parseState.hasErrors = false;
 
+	StmtId lastStmt = 0;
 	while (!IsAtEnd(parseState) && !parseState.hasErrors)
 	{
-		ParseDeclaration(parseState, program);
-		// TODO: Maybe the declaration must be pushed here onto the arena
-
-		//program.exprCount = 0; // Reset AST expression list
-		//Expr *expr = ParseExpression(parseState, program);
-#if 0
-		PrintExpr(expr);
-#endif
+		StmtId stmt = ParseDeclaration(parseState, program);
+		AppendStatement(program, program.firstStmt, lastStmt, stmt);
 	}
 
 	return program;
@@ -869,80 +1778,336 @@ Program Parse(Arena &arena, ParseState &parseState, TokenList &tokens)
 
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
-// Evaluator
+// Profiler
 
-bool Add(Arena &arena, Environment &e, String name, Value value)
+// Sampling profiler driven by a SIGPROF interval timer. The interpreter keeps a small stack
+// of frames (one per running script and one per function call) updated with the line of the
+// statement being executed, and the signal handler copies that stack into a preallocated
+// sample buffer. Samples are written in the collapsed stack format used by flamegraph tools.
+
+#define PROFILER_MAX_FRAMES 32
+#define PROFILER_MAX_SAMPLES KB(64)
+#define PROFILER_SAMPLING_INTERVAL_US 1000
+
+struct ProfilerFrame
 {
-	VarList *varlist = e.variables;
+	const char *name;
+	i32 line;
+};
 
-	if ( varlist )
-	{
-		while ( varlist->next )
-		{
-			for ( u32 i = 0; i < varlist->varsCount; ++i )
-			{
-				if ( StrEq( name, varlist->vars[i].name ) )
-				{
-					printf("A variable with the same name'%s' already exists in this environment.\n", name.str);
-					return false;
-				}
-			}
+struct ProfilerSample
+{
+	ProfilerFrame frames[PROFILER_MAX_FRAMES];
+	u32 framesCount;
+};
 
-			varlist = varlist->next;
-		}
-	}
-	else
+struct Profiler
+{
+	volatile ProfilerFrame frames[PROFILER_MAX_FRAMES];
+	volatile u32 framesCount;
+
+	ProfilerSample *samples;
+	volatile u32 samplesCount;
+	volatile u32 droppedSamplesCount;
+	bool enabled;
+
+	// Samples and report generation use their own memory so the script arena is not disturbed
+	Arena arena;
+};
+
+static Profiler gProfiler;
+
+// The frames are only kept while profiling, which runs a single script. Batch workers run
+// scripts concurrently, and would race on the frames otherwise.
+
+void ProfilerEnter(const char *name)
+{
+	if ( !gProfiler.enabled )
 	{
-		varlist = PushStruct( arena, VarList );
-		varlist->varsCount = 0;
-		varlist->next = 0;
-		e.variables = varlist;
+		return;
 	}
 
-	if ( varlist->varsCount == ARRAY_COUNT(varlist->vars) )
+	if ( gProfiler.framesCount < PROFILER_MAX_FRAMES )
 	{
-		varlist->next = PushStruct( arena, VarList );
-		varlist = varlist->next;
-		varlist->varsCount = 0;
-		varlist->next = 0;
+		gProfiler.frames[ gProfiler.framesCount ].name = name;
+		gProfiler.frames[ gProfiler.framesCount ].line = 0;
 	}
+	gProfiler.framesCount++;
+}
 
-	varlist->vars[ varlist->varsCount ].name = name;
-	varlist->vars[ varlist->varsCount ].value = value;
-	varlist->varsCount++;
+void ProfilerLeave()
+{
+	if ( !gProfiler.enabled )
+	{
+		return;
+	}
 
-	return true;
+	ASSERT( gProfiler.framesCount > 0 );
+	gProfiler.framesCount--;
 }
 
-bool Get(Environment &e, String name, Value &value)
+u32 ProfilerFramesCount()
 {
-	VarList *varlist = e.variables;
+	return gProfiler.framesCount;
+}
 
-	while ( varlist )
+// Drops the frames left by a script that stopped on an error
+void ProfilerUnwind(u32 framesCount)
+{
+	if ( !gProfiler.enabled )
 	{
-		for ( u32 i = 0; i < varlist->varsCount; ++i )
-		{
-			if ( StrEq( name, varlist->vars[i].name ) )
-			{
-				value = varlist->vars[i].value;
-				return true;
-			}
-		}
-
-		varlist = varlist->next;
+		return;
 	}
 
-	return false;
+	ASSERT( gProfiler.framesCount >= framesCount );
+	gProfiler.framesCount = framesCount;
 }
 
-bool Set(Environment &e, String name, Value value)
+void ProfilerLine(i32 line)
 {
-	VarList *varlist = e.variables;
+	if ( !gProfiler.enabled )
+	{
+		return;
+	}
 
-	while ( varlist )
+	const u32 framesCount = gProfiler.framesCount;
+	if ( framesCount > 0 && framesCount <= PROFILER_MAX_FRAMES )
 	{
-		for ( u32 i = 0; i < varlist->varsCount; ++i )
-		{
+		gProfiler.frames[ framesCount - 1 ].line = line;
+	}
+}
+
+#if PLATFORM_LINUX
+
+void ProfilerSignalHandler(int)
+{
+	const u32 framesCount = Min(gProfiler.framesCount, (u32)PROFILER_MAX_FRAMES);
+	if ( framesCount == 0 )
+	{
+		return;
+	}
+
+	if ( gProfiler.samplesCount == PROFILER_MAX_SAMPLES )
+	{
+		gProfiler.droppedSamplesCount++;
+		return;
+	}
+
+	ProfilerSample &sample = gProfiler.samples[ gProfiler.samplesCount ];
+	for (u32 i = 0; i < framesCount; ++i)
+	{
+		sample.frames[i].name = gProfiler.frames[i].name;
+		sample.frames[i].line = gProfiler.frames[i].line;
+	}
+	sample.framesCount = framesCount;
+	gProfiler.samplesCount++;
+}
+
+bool ProfilerStart()
+{
+	// Room for the samples and for the report
+	const u64 arenaSize = PROFILER_MAX_SAMPLES * sizeof(ProfilerSample) + MB(32);
+	gProfiler.arena = MakeArena((byte*)AllocateVirtualMemory(arenaSize), arenaSize);
+	gProfiler.samples = PushZeroArray(gProfiler.arena, ProfilerSample, PROFILER_MAX_SAMPLES);
+	gProfiler.samplesCount = 0;
+	gProfiler.droppedSamplesCount = 0;
+
+	struct sigaction action = {};
+	action.sa_handler = ProfilerSignalHandler;
+	action.sa_flags = SA_RESTART;
+	sigemptyset(&action.sa_mask);
+	if ( sigaction(SIGPROF, &action, NULL) != 0 )
+	{
+		LinuxReportError("sigaction");
+		return false;
+	}
+
+	struct itimerval timer = {};
+	timer.it_interval.tv_usec = PROFILER_SAMPLING_INTERVAL_US;
+	timer.it_value.tv_usec = PROFILER_SAMPLING_INTERVAL_US;
+	if ( setitimer(ITIMER_PROF, &timer, NULL) != 0 )
+	{
+		LinuxReportError("setitimer");
+		return false;
+	}
+
+	gProfiler.enabled = true;
+	return true;
+}
+
+void ProfilerStop()
+{
+	struct itimerval timer = {};
+	setitimer(ITIMER_PROF, &timer, NULL);
+	signal(SIGPROF, SIG_IGN);
+	gProfiler.enabled = false;
+}
+
+#else
+
+bool ProfilerStart()
+{
+	LOG(Error, "The sampling profiler is not supported on this platform.\n");
+	return false;
+}
+
+void ProfilerStop()
+{
+}
+
+#endif
+
+bool SameProfilerStack(const ProfilerSample &a, const ProfilerSample &b)
+{
+	if ( a.framesCount != b.framesCount ) return false;
+	for (u32 i = 0; i < a.framesCount; ++i)
+	{
+		if ( a.frames[i].name != b.frames[i].name || a.frames[i].line != b.frames[i].line ) return false;
+	}
+	return true;
+}
+
+bool WriteProfile(const char *filename)
+{
+	ASSERT( !gProfiler.enabled );
+
+	Arena &arena = gProfiler.arena;
+	TempArena temp = BeginTempArena(arena);
+
+	// Merge identical stacks
+	const u32 samplesCount = gProfiler.samplesCount;
+	ProfilerSample **stacks = PushArray(arena, ProfilerSample*, samplesCount);
+	u32 *stackCounts = PushZeroArray(arena, u32, samplesCount);
+	u32 stacksCount = 0;
+	for (u32 i = 0; i < samplesCount; ++i)
+	{
+		ProfilerSample &sample = gProfiler.samples[i];
+		u32 stackIndex = 0;
+		while ( stackIndex < stacksCount && !SameProfilerStack(*stacks[stackIndex], sample) ) stackIndex++;
+		if ( stackIndex == stacksCount )
+		{
+			stacks[stacksCount++] = &sample;
+		}
+		stackCounts[stackIndex]++;
+	}
+
+	// One line per unique stack: "frame;frame;...;frame count"
+	char *text = (char*)(arena.base + arena.used);
+	u32 textSize = 0;
+	for (u32 i = 0; i < stacksCount; ++i)
+	{
+		const ProfilerSample &stack = *stacks[i];
+		for (u32 j = 0; j < stack.framesCount; ++j)
+		{
+			const u32 capacity = arena.size - arena.used - textSize;
+			textSize += snprintf(text + textSize, capacity, "%s%s:%d", j > 0 ? ";" : "", stack.frames[j].name, stack.frames[j].line);
+		}
+		const u32 capacity = arena.size - arena.used - textSize;
+		textSize += snprintf(text + textSize, capacity, " %u\n", stackCounts[i]);
+		ASSERT( arena.used + textSize < arena.size );
+	}
+
+	const bool ok = WriteEntireFile(filename, text, textSize);
+	if ( ok )
+	{
+		LOG(Info, "Profile: %u samples (%u dropped), %u unique stacks written to %s\n",
+				samplesCount, gProfiler.droppedSamplesCount, stacksCount, filename);
+	}
+
+	EndTempArena(temp);
+	return ok;
+}
+
+void FreeProfiler()
+{
+	ASSERT( !gProfiler.enabled );
+
+	if ( gProfiler.arena.base )
+	{
+		FreeVirtualMemory(gProfiler.arena.base, gProfiler.arena.size);
+		gProfiler.arena = {};
+		gProfiler.samples = NULL;
+		gProfiler.samplesCount = 0;
+	}
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Evaluator
+
+bool Add(Arena &arena, Environment &e, String name, Value value)
+{
+	VarList *varlist = e.variables;
+
+	if ( varlist )
+	{
+		while ( varlist->next )
+		{
+			for ( u32 i = 0; i < varlist->varsCount; ++i )
+			{
+				if ( StrEq( name, varlist->vars[i].name ) )
+				{
+					printf("A variable with the same name'%s' already exists in this environment.\n", name.str);
+					return false;
+				}
+			}
+
+			varlist = varlist->next;
+		}
+	}
+	else
+	{
+		varlist = PushStruct( arena, VarList );
+		varlist->varsCount = 0;
+		varlist->next = 0;
+		e.variables = varlist;
+	}
+
+	if ( varlist->varsCount == ARRAY_COUNT(varlist->vars) )
+	{
+		varlist->next = PushStruct( arena, VarList );
+		varlist = varlist->next;
+		varlist->varsCount = 0;
+		varlist->next = 0;
+	}
+
+	varlist->vars[ varlist->varsCount ].name = name;
+	varlist->vars[ varlist->varsCount ].value = value;
+	varlist->varsCount++;
+
+	return true;
+}
+
+bool Get(Environment &e, String name, Value &value)
+{
+	VarList *varlist = e.variables;
+
+	while ( varlist )
+	{
+		for ( u32 i = 0; i < varlist->varsCount; ++i )
+		{
+			if ( StrEq( name, varlist->vars[i].name ) )
+			{
+				value = varlist->vars[i].value;
+				return true;
+			}
+		}
+
+		varlist = varlist->next;
+	}
+
+	return false;
+}
+
+bool Set(Environment &e, String name, Value value)
+{
+	VarList *varlist = e.variables;
+
+	while ( varlist )
+	{
+		for ( u32 i = 0; i < varlist->varsCount; ++i )
+		{
 			if ( StrEq( name, varlist->vars[i].name ) )
 			{
 				varlist->vars[i].value = value;
@@ -950,206 +2115,2824 @@ bool Set(Environment &e, String name, Value value)
 			}
 		}
 
-		varlist = varlist->next;
+		varlist = varlist->next;
+	}
+
+	return false;
+}
+
+Shape *AddProperty(Arena &arena, Shape *shape, const char *name)
+{
+	for (Shape *child = shape->transitions; child; child = child->sibling)
+	{
+		if ( child->name == name )
+		{
+			return child;
+		}
+	}
+
+	Shape *child = PushZeroStruct(arena, Shape);
+	child->name = name;
+	child->slot = shape->slotsCount;
+	child->slotsCount = shape->slotsCount + 1;
+	child->parent = shape;
+	child->sibling = shape->transitions;
+	shape->transitions = child;
+	return child;
+}
+
+bool FindProperty(const Shape *shape, const char *name, u32 &slot)
+{
+	for (; shape->parent; shape = shape->parent)
+	{
+		if ( shape->name == name )
+		{
+			slot = shape->slot;
+			return true;
+		}
+	}
+	return false;
+}
+
+Class *CreateClass(Arena &arena, Arena &shapeArena, String name, StmtId decl, Class *superclass)
+{
+	Class *klass = PushZeroStruct(arena, Class);
+	klass->name = name;
+	klass->rootShape = PushZeroStruct(shapeArena, Shape);
+	klass->superclass = superclass;
+	klass->decl = decl;
+	return klass;
+}
+
+// Methods are looked up by name in the class and then in its superclasses
+bool FindMethod(const Program &program, const Class *klass, String name, StmtId &method)
+{
+	for ( ; klass; klass = klass->superclass )
+	{
+		for (StmtId stmt = program.stmts[klass->decl].body; stmt; stmt = program.stmts[stmt].next)
+		{
+			if ( StrEq( GetToken(program, program.stmts[stmt].identifier).lexeme, name ) )
+			{
+				method = stmt;
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+Instance *CreateInstance(Arena &arena, Class *klass)
+{
+	Instance *instance = PushZeroStruct(arena, Instance);
+	instance->klass = klass;
+	instance->shape = klass->rootShape;
+	return instance;
+}
+
+void SetInstanceShape(Arena &arena, Instance *instance, Shape *shape)
+{
+	if ( shape->slotsCount > instance->slotsCapacity )
+	{
+		const u32 slotsCapacity = Max(4u, instance->slotsCapacity * 2);
+		Value *slots = PushArray(arena, Value, slotsCapacity);
+		MemCopy(slots, instance->slots, instance->slotsCapacity * sizeof(Value));
+		instance->slots = slots;
+		instance->slotsCapacity = slotsCapacity;
+	}
+	instance->shape = shape;
+}
+
+void AddToInlineCache(InlineCache &cache, Shape *shape, Shape *newShape, u32 slot)
+{
+	InlineCacheEntry &entry = cache.entries[ cache.entriesCount++ % INLINE_CACHE_SIZE ];
+	entry.shape = shape;
+	entry.newShape = newShape;
+	entry.slot = slot;
+}
+
+bool GetProperty(Instance *instance, const char *name, InlineCache &cache, Value &value)
+{
+	const u32 entriesCount = Min(cache.entriesCount, (u32)INLINE_CACHE_SIZE);
+	for (u32 i = 0; i < entriesCount; ++i)
+	{
+		if ( cache.entries[i].shape == instance->shape )
+		{
+			value = instance->slots[ cache.entries[i].slot ];
+			return true;
+		}
+	}
+
+	u32 slot;
+	if ( FindProperty(instance->shape, name, slot) )
+	{
+		AddToInlineCache(cache, instance->shape, instance->shape, slot);
+		value = instance->slots[slot];
+		return true;
+	}
+
+	return false;
+}
+
+void SetProperty(Arena &arena, Arena &shapeArena, Instance *instance, const char *name, InlineCache &cache, Value value)
+{
+	const u32 entriesCount = Min(cache.entriesCount, (u32)INLINE_CACHE_SIZE);
+	for (u32 i = 0; i < entriesCount; ++i)
+	{
+		const InlineCacheEntry &entry = cache.entries[i];
+		if ( entry.shape == instance->shape )
+		{
+			if ( entry.newShape != entry.shape )
+			{
+				SetInstanceShape(arena, instance, entry.newShape);
+			}
+			instance->slots[ entry.slot ] = value;
+			return;
+		}
+	}
+
+	Shape *shape = instance->shape;
+	u32 slot;
+	if ( FindProperty(shape, name, slot) )
+	{
+		AddToInlineCache(cache, shape, shape, slot);
+	}
+	else
+	{
+		Shape *newShape = AddProperty(shapeArena, shape, name);
+		SetInstanceShape(arena, instance, newShape);
+		slot = newShape->slot;
+		AddToInlineCache(cache, shape, newShape, slot);
+	}
+
+	instance->slots[slot] = value;
+}
+
+bool ValuesEqual(const Value &left, const Value &right)
+{
+	if ( left.type != right.type ) return false;
+	switch ( left.type )
+	{
+		case VALUE_TYPE_BOOL: return left.b == right.b;
+		case VALUE_TYPE_FLOAT: return left.f == right.f;
+		case VALUE_TYPE_STRING: return StrEq(left.s, right.s);
+		case VALUE_TYPE_NIL: return true;
+		case VALUE_TYPE_CLASS: return left.klass == right.klass;
+		case VALUE_TYPE_INSTANCE: return left.instance == right.instance;
+		case VALUE_TYPE_FUNCTION: return left.function == right.function;
+		case VALUE_TYPE_METHOD: return left.method.instance == right.method.instance && left.method.function == right.method.function;
+		case VALUE_TYPE_NATIVE: return left.native == right.native;
+		case VALUE_TYPE_COROUTINE: return left.coroutine == right.coroutine;
+		case VALUE_TYPE_ARRAY: return left.array == right.array;
+		case VALUE_TYPE_MAP: return left.map == right.map;
+		default: return false;
+	}
+}
+
+// Arrays
+//
+// Arrays store unboxed floats contiguously while all their elements are numbers, so the
+// numeric natives (sum, dot, scale, sort) run vectorized loops over them. Storing anything
+// else boxes all the elements into values, for good.
+
+#ifndef ARRAY_USE_SIMD
+#define ARRAY_USE_SIMD 1
+#endif
+
+#if !ARRAY_USE_SIMD
+#elif defined(__AVX__)
+#	define ARRAY_SIMD_AVX 1
+#	include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#	define ARRAY_SIMD_SSE 1
+#	include <emmintrin.h>
+#endif
+
+struct Array
+{
+	u32 count;
+	u32 capacity;
+	bool boxed;
+	union
+	{
+		f32 *floats;
+		Value *values;
+	};
+};
+
+f32 SumFloats(const f32 *floats, u32 count)
+{
+	u32 i = 0;
+	f32 sum = 0.0f;
+#if ARRAY_SIMD_AVX
+	__m256 sum0 = _mm256_setzero_ps();
+	__m256 sum1 = _mm256_setzero_ps();
+	for (; i + 16 <= count; i += 16)
+	{
+		sum0 = _mm256_add_ps(sum0, _mm256_loadu_ps(floats + i));
+		sum1 = _mm256_add_ps(sum1, _mm256_loadu_ps(floats + i + 8));
+	}
+	f32 lanes[8];
+	_mm256_storeu_ps(lanes, _mm256_add_ps(sum0, sum1));
+	for (u32 lane = 0; lane < 8; ++lane) sum += lanes[lane];
+#elif ARRAY_SIMD_SSE
+	__m128 sum0 = _mm_setzero_ps();
+	__m128 sum1 = _mm_setzero_ps();
+	for (; i + 8 <= count; i += 8)
+	{
+		sum0 = _mm_add_ps(sum0, _mm_loadu_ps(floats + i));
+		sum1 = _mm_add_ps(sum1, _mm_loadu_ps(floats + i + 4));
+	}
+	f32 lanes[4];
+	_mm_storeu_ps(lanes, _mm_add_ps(sum0, sum1));
+	for (u32 lane = 0; lane < 4; ++lane) sum += lanes[lane];
+#endif
+	for (; i < count; ++i) sum += floats[i];
+	return sum;
+}
+
+f32 DotFloats(const f32 *a, const f32 *b, u32 count)
+{
+	u32 i = 0;
+	f32 dot = 0.0f;
+#if ARRAY_SIMD_AVX
+	__m256 dot0 = _mm256_setzero_ps();
+	__m256 dot1 = _mm256_setzero_ps();
+	for (; i + 16 <= count; i += 16)
+	{
+		dot0 = _mm256_add_ps(dot0, _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+		dot1 = _mm256_add_ps(dot1, _mm256_mul_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8)));
+	}
+	f32 lanes[8];
+	_mm256_storeu_ps(lanes, _mm256_add_ps(dot0, dot1));
+	for (u32 lane = 0; lane < 8; ++lane) dot += lanes[lane];
+#elif ARRAY_SIMD_SSE
+	__m128 dot0 = _mm_setzero_ps();
+	__m128 dot1 = _mm_setzero_ps();
+	for (; i + 8 <= count; i += 8)
+	{
+		dot0 = _mm_add_ps(dot0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+		dot1 = _mm_add_ps(dot1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+	}
+	f32 lanes[4];
+	_mm_storeu_ps(lanes, _mm_add_ps(dot0, dot1));
+	for (u32 lane = 0; lane < 4; ++lane) dot += lanes[lane];
+#endif
+	for (; i < count; ++i) dot += a[i] * b[i];
+	return dot;
+}
+
+void ScaleFloats(f32 *floats, u32 count, f32 factor)
+{
+	u32 i = 0;
+#if ARRAY_SIMD_AVX
+	const __m256 factor8 = _mm256_set1_ps(factor);
+	for (; i + 8 <= count; i += 8)
+	{
+		_mm256_storeu_ps(floats + i, _mm256_mul_ps(_mm256_loadu_ps(floats + i), factor8));
+	}
+#elif ARRAY_SIMD_SSE
+	const __m128 factor4 = _mm_set1_ps(factor);
+	for (; i + 4 <= count; i += 4)
+	{
+		_mm_storeu_ps(floats + i, _mm_mul_ps(_mm_loadu_ps(floats + i), factor4));
+	}
+#endif
+	for (; i < count; ++i) floats[i] *= factor;
+}
+
+// Maps float bits to unsigned keys with the same order: negative numbers get all their
+// bits flipped, positive ones just the sign bit.
+u32 FloatSortKey(f32 f)
+{
+	u32 bits;
+	MemCopy(&bits, &f, sizeof(bits));
+	const u32 mask = (u32)(-(i32)(bits >> 31)) | 0x80000000;
+	return bits ^ mask;
+}
+
+f32 FloatFromSortKey(u32 key)
+{
+	const u32 mask = ((key >> 31) - 1) | 0x80000000;
+	const u32 bits = key ^ mask;
+	f32 f;
+	MemCopy(&f, &bits, sizeof(f));
+	return f;
+}
+
+// Radix sort over the keys, 8 bits per pass. There are no data dependent branches, and the
+// four histograms are built in a single pass.
+void SortFloats(f32 *floats, u32 count)
+{
+	TempArena scratch = BeginScratch();
+	Arena &arena = *scratch.arena;
+	u32 *keys = PushArray(arena, u32, count);
+	u32 *sorted = PushArray(arena, u32, count);
+	u32 *histograms = PushZeroArray(arena, u32, 4 * 256);
+
+	for (u32 i = 0; i < count; ++i)
+	{
+		const u32 key = FloatSortKey(floats[i]);
+		keys[i] = key;
+		histograms[0 * 256 + ((key >> 0) & 0xff)]++;
+		histograms[1 * 256 + ((key >> 8) & 0xff)]++;
+		histograms[2 * 256 + ((key >> 16) & 0xff)]++;
+		histograms[3 * 256 + ((key >> 24) & 0xff)]++;
+	}
+
+	for (u32 pass = 0; pass < 4; ++pass)
+	{
+		u32 *offsets = histograms + pass * 256;
+		u32 offset = 0;
+		for (u32 digit = 0; digit < 256; ++digit)
+		{
+			const u32 digitCount = offsets[digit];
+			offsets[digit] = offset;
+			offset += digitCount;
+		}
+
+		const u32 shift = pass * 8;
+		for (u32 i = 0; i < count; ++i)
+		{
+			const u32 key = keys[i];
+			sorted[ offsets[(key >> shift) & 0xff]++ ] = key;
+		}
+
+		u32 *swap = keys;
+		keys = sorted;
+		sorted = swap;
+	}
+
+	for (u32 i = 0; i < count; ++i)
+	{
+		floats[i] = FloatFromSortKey(keys[i]);
+	}
+
+	EndTempArena(scratch);
+}
+
+Array *CreateArray(Arena &arena, u32 count)
+{
+	Array *array = PushZeroStruct(arena, Array);
+	array->count = count;
+	array->capacity = count;
+	array->floats = PushZeroArray(arena, f32, count);
+	return array;
+}
+
+void BoxArray(Arena &arena, Array *array)
+{
+	Value *values = PushArray(arena, Value, array->capacity);
+	for (u32 i = 0; i < array->count; ++i)
+	{
+		values[i].type = VALUE_TYPE_FLOAT;
+		values[i].f = array->floats[i];
+	}
+	array->values = values;
+	array->boxed = true;
+}
+
+Value GetElement(const Array *array, u32 index)
+{
+	if ( array->boxed )
+	{
+		return array->values[index];
+	}
+
+	Value value;
+	value.type = VALUE_TYPE_FLOAT;
+	value.f = array->floats[index];
+	return value;
+}
+
+void SetElement(Arena &arena, Array *array, u32 index, Value value)
+{
+	if ( !array->boxed && value.type != VALUE_TYPE_FLOAT )
+	{
+		BoxArray(arena, array);
+	}
+
+	if ( array->boxed )
+	{
+		array->values[index] = value;
+	}
+	else
+	{
+		array->floats[index] = value.f;
+	}
+}
+
+void PushElement(Arena &arena, Array *array, Value value)
+{
+	if ( array->count == array->capacity )
+	{
+		const u32 capacity = Max(8u, array->capacity * 2);
+		const u32 elementSize = array->boxed ? sizeof(Value) : sizeof(f32);
+		void *elements = PushSize(arena, capacity * elementSize);
+		MemCopy(elements, array->floats, array->count * elementSize);
+		array->floats = (f32*)elements;
+		array->capacity = capacity;
+	}
+
+	SetElement(arena, array, array->count++, value);
+}
+
+// Maps
+//
+// Entries are packed in an array and found through the hash maps of tools.h, which give their
+// index. Keys are numbers or strings. Strings are interned first, so both kinds of keys are
+// numbers for the hash maps: the bits of the float or the interned pointer.
+
+struct MapEntry
+{
+	Value key;
+	Value value;
+};
+
+struct Map
+{
+	HashMap numbers; // number keys to entry indices
+	HashMap strings; // string keys to entry indices
+	MapEntry *entries;
+	u32 count;
+	u32 capacity;
+};
+
+// Returns false for values that cannot be keys
+bool MakeMapKey(Program &program, const Value &value, Value &key)
+{
+	key = value;
+	if ( value.type == VALUE_TYPE_FLOAT )
+	{
+		key.f = value.f == 0.0f ? 0.0f : value.f; // -0 and 0 are the same key
+		return true;
+	}
+	else if ( value.type == VALUE_TYPE_STRING )
+	{
+		key.s.str = InternString(program, value.s);
+		return true;
+	}
+	return false;
+}
+
+HashMap &MapIndex(Map *map, const Value &key)
+{
+	return key.type == VALUE_TYPE_FLOAT ? map->numbers : map->strings;
+}
+
+u64 MapKeyBits(const Value &key)
+{
+	if ( key.type == VALUE_TYPE_FLOAT )
+	{
+		u32 bits;
+		MemCopy(&bits, &key.f, sizeof(bits));
+		return bits;
+	}
+	return (u64)key.s.str;
+}
+
+Map *CreateMap(Arena &arena)
+{
+	// The hash maps get their entries on the first insert
+	Map *map = PushZeroStruct(arena, Map);
+	map->numbers.arena = &arena;
+	map->strings.arena = &arena;
+	return map;
+}
+
+// Returns the index of the entry, or U32_MAX if missing
+u32 MapFind(Map *map, const Value &key)
+{
+	const u64 *index = HashMapFind(MapIndex(map, key), MapKeyBits(key));
+	return index ? (u32)*index : U32_MAX;
+}
+
+void MapInsert(Arena &arena, Map *map, const Value &key, const Value &value)
+{
+	const u32 index = MapFind(map, key);
+	if ( index != U32_MAX )
+	{
+		map->entries[index].value = value;
+		return;
+	}
+
+	if ( map->count == map->capacity )
+	{
+		const u32 capacity = Max(8u, map->capacity * 2);
+		MapEntry *entries = PushArray(arena, MapEntry, capacity);
+		MemCopy(entries, map->entries, map->count * sizeof(MapEntry));
+		map->entries = entries;
+		map->capacity = capacity;
+	}
+
+	HashMapInsert(MapIndex(map, key), MapKeyBits(key), map->count);
+	map->entries[map->count].key = key;
+	map->entries[map->count].value = value;
+	map->count++;
+}
+
+bool MapRemove(Map *map, const Value &key)
+{
+	const u32 index = MapFind(map, key);
+	if ( index == U32_MAX )
+	{
+		return false;
+	}
+
+	HashMapRemove(MapIndex(map, key), MapKeyBits(key));
+
+	// The last entry fills the hole
+	const u32 last = --map->count;
+	if ( index != last )
+	{
+		const MapEntry &moved = map->entries[last];
+		map->entries[index] = moved;
+		HashMapInsert(MapIndex(map, moved.key), MapKeyBits(moved.key), index);
+	}
+	return true;
+}
+
+// Only false and nil are falsey
+bool IsTruthy(const Value &value)
+{
+	if ( value.type == VALUE_TYPE_BOOL ) return value.b;
+	return value.type != VALUE_TYPE_NIL;
+}
+
+void PrintValue(const Program &program, const Value &val)
+{
+	switch ( val.type )
+	{
+		case VALUE_TYPE_FLOAT:
+			printf("%f", val.f);
+			break;
+		case VALUE_TYPE_BOOL:
+			printf("%s", val.b ? "true" : "false" );
+			break;
+		case VALUE_TYPE_STRING:
+			char cstring[512];
+			StrCopy(cstring, val.s);
+			printf("%s", cstring);
+			break;
+		case VALUE_TYPE_NIL:
+			printf("nil");
+			break;
+		case VALUE_TYPE_CLASS:
+			printf("%.*s", val.klass->name.size, val.klass->name.str);
+			break;
+		case VALUE_TYPE_INSTANCE:
+			printf("%.*s instance", val.instance->klass->name.size, val.instance->klass->name.str);
+			break;
+		case VALUE_TYPE_FUNCTION:
+		{
+			const String name = GetToken(program, program.stmts[val.function].identifier).lexeme;
+			printf("<fn %.*s>", name.size, name.str);
+			break;
+		}
+		case VALUE_TYPE_METHOD:
+		{
+			const String name = GetToken(program, program.stmts[val.method.function].identifier).lexeme;
+			printf("<fn %.*s>", name.size, name.str);
+			break;
+		}
+		case VALUE_TYPE_NATIVE:
+			printf("<native fn>");
+			break;
+		case VALUE_TYPE_COROUTINE:
+			printf("<coroutine>");
+			break;
+		case VALUE_TYPE_ARRAY:
+			printf("[");
+			for (u32 i = 0; i < val.array->count; ++i)
+			{
+				printf(i > 0 ? ", " : "");
+				PrintValue(program, GetElement(val.array, i));
+			}
+			printf("]");
+			break;
+		case VALUE_TYPE_MAP:
+		{
+			printf("{");
+			for (u32 i = 0; i < val.map->count; ++i)
+			{
+				const MapEntry &entry = val.map->entries[i];
+				printf(i > 0 ? ", " : "");
+				PrintValue(program, entry.key);
+				printf(": ");
+				PrintValue(program, entry.value);
+			}
+			printf("}");
+			break;
+		}
+		default:
+			INVALID_CODE_PATH();
+	}
+}
+
+// Execution
+//
+// Instead of recursing through the AST, the interpreter keeps its own stack of frames. Each
+// frame is a node being executed along with the stage it reached, and intermediate results
+// are kept in a separate value stack. The native stack is never used to hold script state,
+// so execution can stop after any step and continue later, which is what allows running
+// scripts in time slices from the host main loop.
+//
+// Coroutines get their own (smaller) stacks, taken from a pool and returned to it once they
+// finish, so resuming or yielding only swaps the stack the interpreter steps on.
+//
+// Everything created while running goes to the runtime arena, apart from the program. Blocks,
+// the statements inside them, and loop iterations open regions in it, and closing a region
+// frees what was allocated since it was opened. Storing an object somewhere that outlives the
+// regions opened after that place (a global, an outer local, an older object, the caller of a
+// function...) keeps those regions instead, so only unreachable temporaries are freed and
+// loops run in constant memory unless they keep what they create.
+
+#define EXECUTION_MAX_FRAMES 1024
+#define EXECUTION_MAX_VALUES 1024
+#define EXECUTION_MAX_LOCALS 256
+#define EXECUTION_CLOCK_STEPS 256 // steps between clock reads when running with a time budget
+
+#define COROUTINE_MAX_FRAMES 128
+#define COROUTINE_MAX_VALUES 128
+#define COROUTINE_MAX_LOCALS 64
+#define COROUTINE_MAX_STACKS 65536 // alive at once, their pool is reserved on the first coroutine and committed as it grows
+
+#ifndef EXECUTION_POISON_REGIONS
+#define EXECUTION_POISON_REGIONS 0 // fill freed regions so that dangling references show up
+#endif
+
+enum FrameType
+{
+	FRAME_EXPR,
+	FRAME_STMT,
+	FRAME_LIST, // statements of a block, one after another
+	FRAME_CALL, // function body being executed
+};
+
+enum RegionFlags
+{
+	REGION_BLOCK = 1 << 0, // the whole list
+	REGION_STEP = 1 << 1,  // the current statement of a list, or the current loop iteration
+};
+
+struct ExecFrame
+{
+	u8 type;    // FrameType
+	u8 stage;
+	u8 regions; // RegionFlags opened by the frame
+	u8 keep;    // RegionFlags not to be freed when closed
+	u32 node;   // ExprId, StmtId, or the next StmtId for lists
+	u32 mark;   // locals count when a list was entered, locals base of the caller for calls, argument cursor for call expressions
+	u32 blockMark; // runtime arena used when the regions were opened
+	u32 stepMark;  // runtime arena used when the current step began
+};
+
+struct ExecStack
+{
+	ExecFrame *frames;
+	u32 framesCount;
+	u32 framesCapacity;
+
+	Value *values;
+	u32 valuesCount;
+	u32 valuesCapacity;
+
+	Var *locals;
+	u32 localsCount;
+	u32 localsCapacity;
+	u32 localsBase; // first local visible from the current function
+
+	ExecStack *nextFree;
+};
+
+enum CoroutineState
+{
+	COROUTINE_SUSPENDED, // created or yielded
+	COROUTINE_RUNNING,   // running, or resumed another coroutine
+	COROUTINE_DEAD,
+};
+
+struct Coroutine
+{
+	CoroutineState state;
+	StmtId function;
+	bool started;
+	ExecStack *stack;       // 0 once dead
+	ExecStack *callerStack; // stack of whoever resumed it
+	Coroutine *caller;      // 0 when resumed from the main script
+	u32 switchMark;         // runtime arena used when it was last resumed or suspended
+};
+
+struct Execution
+{
+	Program *program;
+	Environment *env; // globals
+	Arena *arena;     // runtime
+
+	ExecStack *stack; // the one being executed
+	ExecStack mainStack;
+	Coroutine *coroutine; // the one running, 0 for the main script
+
+	Arena stackPool;
+	ExecStack *freeStacks;
+
+	u32 profilerFramesCount; // the ones below the script
+
+	u64 steps;
+	bool hasErrors;
+};
+
+// Zero means no limit
+struct ExecutionBudget
+{
+	u64 maxSteps;
+	u32 maxMicroseconds;
+};
+
+enum NativeId
+{
+	NATIVE_COROUTINE,
+	NATIVE_RESUME,
+	NATIVE_YIELD,
+	NATIVE_DONE,
+	NATIVE_ARRAY,
+	NATIVE_LEN,
+	NATIVE_PUSH,
+	NATIVE_SUM,
+	NATIVE_DOT,
+	NATIVE_SCALE,
+	NATIVE_SORT,
+	NATIVE_MAP,
+	NATIVE_HAS,
+	NATIVE_REMOVE,
+	NATIVE_KEYS,
+};
+
+struct Native
+{
+	const char *name;
+	u32 minArity;
+	u32 maxArity;
+};
+
+// Indexed by NativeId
+static const Native Natives[] =
+{
+	{ "coroutine", 1, 1 },                  // coroutine(function) creates a suspended coroutine
+	{ "resume", 1, MAX_CALL_ARGUMENTS },    // resume(co, args...) runs it until it yields or returns
+	{ "yield", 0, 1 },                      // yield(value?) suspends the running coroutine
+	{ "done", 1, 1 },                       // done(co) tells whether it returned already
+	{ "array", 1, 1 },                      // array(n) creates an array of n zeros
+	{ "len", 1, 1 },                        // len(a) of arrays and maps
+	{ "push", 2, 2 },                       // push(a, value) appends to the array
+	{ "sum", 1, 1 },                        // sum(a) of an array of numbers
+	{ "dot", 2, 2 },                        // dot(a, b) of two arrays of numbers with the same length
+	{ "scale", 2, 2 },                      // scale(a, factor) multiplies all the numbers in place
+	{ "sort", 1, 1 },                       // sort(a) sorts the numbers in place
+	{ "map", 0, 0 },                        // map() creates an empty map
+	{ "has", 2, 2 },                        // has(m, key)
+	{ "remove", 2, 2 },                     // remove(m, key) returns whether the key was there
+	{ "keys", 1, 1 },                       // keys(m) returns an array with the keys
+};
+
+void ReportError(Execution &exec, const char *message)
+{
+	printf("ERROR: %s\n", message);
+	exec.hasErrors = true;
+}
+
+// Runtime errors stop the execution, which then counts as failed
+#define RUNTIME_ERROR(exec, fmt, ...) ( printf(fmt, ##__VA_ARGS__), (exec).hasErrors = true )
+
+ExecFrame &TopFrame(Execution &exec)
+{
+	ExecStack &stack = *exec.stack;
+	ASSERT( stack.framesCount > 0 );
+	return stack.frames[ stack.framesCount - 1 ];
+}
+
+void PushFrame(Execution &exec, FrameType type, u32 node)
+{
+	ExecStack &stack = *exec.stack;
+	if ( stack.framesCount == stack.framesCapacity )
+	{
+		ReportError(exec, "Stack overflow.");
+		return;
+	}
+
+	ExecFrame &frame = stack.frames[ stack.framesCount++ ];
+	frame.type = type;
+	frame.stage = 0;
+	frame.regions = 0;
+	frame.keep = 0;
+	frame.node = node;
+	frame.mark = 0;
+}
+
+void PopFrame(Execution &exec)
+{
+	ASSERT( exec.stack->framesCount > 0 );
+	exec.stack->framesCount--;
+}
+
+void OpenRegions(Execution &exec, ExecFrame &frame, u8 regions)
+{
+	frame.regions = regions;
+	frame.blockMark = exec.arena->used;
+	frame.stepMark = exec.arena->used;
+}
+
+void FreeRegion(Execution &exec, u32 mark)
+{
+	Arena &arena = *exec.arena;
+	ASSERT( arena.used >= mark );
+#if EXECUTION_POISON_REGIONS
+	MemSet(arena.base + mark, arena.used - mark, 0xCD);
+#endif
+	arena.used = mark;
+}
+
+// The current step finished, what it allocated goes away unless it was kept
+void EndStep(Execution &exec, ExecFrame &frame)
+{
+	if ( !(frame.keep & REGION_STEP) )
+	{
+		FreeRegion(exec, frame.stepMark);
+	}
+	frame.stepMark = exec.arena->used;
+	frame.keep &= ~REGION_STEP;
+}
+
+void CloseRegions(Execution &exec, ExecFrame &frame)
+{
+	if ( (frame.regions & REGION_STEP) && !(frame.keep & REGION_STEP) )
+	{
+		FreeRegion(exec, frame.stepMark);
+	}
+	if ( (frame.regions & REGION_BLOCK) && !(frame.keep & REGION_BLOCK) )
+	{
+		FreeRegion(exec, frame.blockMark);
+	}
+}
+
+// Regions are numbered from the bottom of the stack, the block of a frame before its step,
+// so that places in the stack can be given by the first region that may hold them.
+u32 BlockRegion(u32 frameIndex) { return 2 * frameIndex; }
+u32 StepRegion(u32 frameIndex) { return 2 * frameIndex + 1; }
+
+// Keeps the regions holding an object that is stored somewhere else, as long as they were
+// opened after that place. Heap objects and globals are places given by their location in
+// the arena (0 for globals), places in the current stack by the first region that may hold
+// them (0 when unknown).
+void KeepObjectAlive(Execution &exec, const void *object, const void *place, u32 firstRegion)
+{
+	const Arena &arena = *exec.arena;
+	const byte *base = arena.base;
+	if ( (const byte*)object < base || (const byte*)object >= base + arena.size )
+	{
+		return; // not created while running
+	}
+
+	const u32 address = (u32)((const byte*)object - base);
+	const u32 location = (const byte*)place >= base && (const byte*)place < base + arena.size ?
+		(u32)((const byte*)place - base) : 0;
+
+	ExecStack &stack = *exec.stack;
+	for (u32 i = stack.framesCount; i > 0 && StepRegion(i - 1) >= firstRegion; --i)
+	{
+		ExecFrame &frame = stack.frames[i - 1];
+		if ( !frame.regions )
+		{
+			continue;
+		}
+
+		if ( frame.stepMark <= address && frame.stepMark > location && StepRegion(i - 1) >= firstRegion )
+		{
+			frame.keep |= REGION_STEP;
+		}
+		if ( (frame.regions & REGION_BLOCK) && frame.blockMark <= address && frame.blockMark > location && BlockRegion(i - 1) >= firstRegion )
+		{
+			frame.keep |= REGION_BLOCK;
+		}
+
+		// Regions below were opened earlier
+		const u32 lowestMark = frame.regions & REGION_BLOCK ? frame.blockMark : frame.stepMark;
+		if ( lowestMark <= location )
+		{
+			break;
+		}
+	}
+}
+
+// Object referenced by a value, if any
+const void *GetObject(const Value &value)
+{
+	switch ( value.type )
+	{
+		case VALUE_TYPE_CLASS: return value.klass;
+		case VALUE_TYPE_INSTANCE: return value.instance;
+		case VALUE_TYPE_METHOD: return value.method.instance;
+		case VALUE_TYPE_COROUTINE: return value.coroutine;
+		case VALUE_TYPE_ARRAY: return value.array;
+		case VALUE_TYPE_MAP: return value.map;
+		default: return 0;
+	}
+}
+
+void KeepAlive(Execution &exec, const Value &value, const void *place, u32 firstRegion)
+{
+	if ( const void *object = GetObject(value) )
+	{
+		KeepObjectAlive(exec, object, place, firstRegion);
+	}
+}
+
+// Keeps what was allocated since 'used' for an object stored at 'place', e.g. its new slots
+void KeepAllocations(Execution &exec, u32 used, const void *place)
+{
+	if ( exec.arena->used > used )
+	{
+		KeepObjectAlive(exec, exec.arena->base + used, place, 0);
+	}
+}
+
+// First region that may hold the values pushed by the frames below 'framesCount'
+u32 ValueRegion(Execution &exec, u32 framesCount)
+{
+	ExecStack &stack = *exec.stack;
+	for (u32 i = framesCount; i > 0; --i)
+	{
+		if ( stack.frames[i - 1].regions )
+		{
+			return StepRegion(i - 1) + 1;
+		}
+	}
+	return 0;
+}
+
+// First region that may hold the local variable at 'index', that is, the step of the list
+// declaring it, or for parameters, whatever runs the call
+u32 LocalRegion(Execution &exec, u32 index)
+{
+	ExecStack &stack = *exec.stack;
+	bool parameter = false;
+	for (u32 i = stack.framesCount; i > 0; --i)
+	{
+		const ExecFrame &frame = stack.frames[i - 1];
+		if ( frame.type == FRAME_CALL )
+		{
+			parameter = true;
+		}
+		else if ( parameter ? frame.regions != 0 : frame.type == FRAME_LIST && frame.mark <= index )
+		{
+			return parameter ? StepRegion(i - 1) + 1 : StepRegion(i - 1);
+		}
+	}
+	return 0;
+}
+
+// Moves all the open regions of a stack to the top of the arena. Used when a stack continues
+// running after others allocated above its regions, which it must not free, or freed what
+// was above them, so that its regions do not start past the top.
+void MoveRegions(Execution &exec, ExecStack &stack)
+{
+	for (u32 i = 0; i < stack.framesCount; ++i)
+	{
+		ExecFrame &frame = stack.frames[i];
+		frame.blockMark = exec.arena->used;
+		frame.stepMark = exec.arena->used;
+	}
+}
+
+void PushValue(Execution &exec, Value value)
+{
+	ExecStack &stack = *exec.stack;
+	if ( stack.valuesCount == stack.valuesCapacity )
+	{
+		ReportError(exec, "Value stack overflow.");
+		return;
+	}
+
+	stack.values[ stack.valuesCount++ ] = value;
+}
+
+Value PopValue(Execution &exec)
+{
+	ASSERT( exec.stack->valuesCount > 0 );
+	return exec.stack->values[ --exec.stack->valuesCount ];
+}
+
+Value &TopValue(Execution &exec)
+{
+	ASSERT( exec.stack->valuesCount > 0 );
+	return exec.stack->values[ exec.stack->valuesCount - 1 ];
+}
+
+Value NilValue()
+{
+	Value value = {};
+	value.type = VALUE_TYPE_NIL;
+	return value;
+}
+
+void DeclareLocal(Execution &exec, String name, Value value)
+{
+	ExecStack &stack = *exec.stack;
+	if ( stack.localsCount == stack.localsCapacity )
+	{
+		ReportError(exec, "Too many local variables.");
+		return;
+	}
+
+	Var &var = stack.locals[ stack.localsCount++ ];
+	var.name = name;
+	var.value = value;
+}
+
+void Declare(Execution &exec, String name, Value value, bool local)
+{
+	if ( local )
+	{
+		DeclareLocal(exec, name, value);
+		if ( const void *object = GetObject(value) )
+		{
+			KeepObjectAlive(exec, object, 0, LocalRegion(exec, exec.stack->localsCount - 1));
+		}
+	}
+	else
+	{
+		const u32 used = exec.arena->used;
+		if ( !Add( *exec.arena, *exec.env, name, value ) )
+		{
+			RUNTIME_ERROR(exec, "Could not declare %.*s.\n", name.size, name.str);
+		}
+		KeepAlive(exec, value, 0, 0);
+		KeepAllocations(exec, used, 0);
+	}
+}
+
+Var *FindLocal(Execution &exec, String name)
+{
+	// Innermost declarations first, so they shadow outer ones. Functions do not see the
+	// locals of their callers.
+	ExecStack &stack = *exec.stack;
+	for (u32 i = stack.localsCount; i > stack.localsBase; --i)
+	{
+		if ( StrEq( name, stack.locals[i - 1].name ) )
+		{
+			return &stack.locals[i - 1];
+		}
+	}
+	return 0;
+}
+
+bool Lookup(Execution &exec, String name, Value &value)
+{
+	if ( Var *var = FindLocal(exec, name) )
+	{
+		value = var->value;
+		return true;
+	}
+
+	if ( Get( *exec.env, name, value ) )
+	{
+		return true;
+	}
+
+	for (u32 i = 0; i < ARRAY_COUNT(Natives); ++i)
+	{
+		if ( StrEq( name, Natives[i].name ) )
+		{
+			value.type = VALUE_TYPE_NATIVE;
+			value.native = i;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool Assign(Execution &exec, String name, Value value)
+{
+	if ( Var *var = FindLocal(exec, name) )
+	{
+		var->value = value;
+		if ( const void *object = GetObject(value) )
+		{
+			KeepObjectAlive(exec, object, 0, LocalRegion(exec, (u32)(var - exec.stack->locals)));
+		}
+		return true;
+	}
+	KeepAlive(exec, value, 0, 0);
+	return Set( *exec.env, name, value );
+}
+
+ExecStack *AcquireStack(Execution &exec)
+{
+	ExecStack *stack = exec.freeStacks;
+	if ( stack )
+	{
+		exec.freeStacks = stack->nextFree;
+	}
+	else
+	{
+		const u32 stackSize = sizeof(ExecStack) +
+			COROUTINE_MAX_FRAMES * sizeof(ExecFrame) +
+			COROUTINE_MAX_VALUES * sizeof(Value) +
+			COROUTINE_MAX_LOCALS * sizeof(Var);
+
+		if ( !exec.stackPool.base )
+		{
+			exec.stackPool = MakeGrowableArena((u64)COROUTINE_MAX_STACKS * stackSize);
+			if ( !exec.stackPool.base )
+			{
+				return 0;
+			}
+		}
+
+		if ( exec.stackPool.used + stackSize > exec.stackPool.size )
+		{
+			return 0;
+		}
+
+		stack = PushStruct(exec.stackPool, ExecStack);
+		stack->frames = PushArray(exec.stackPool, ExecFrame, COROUTINE_MAX_FRAMES);
+		stack->framesCapacity = COROUTINE_MAX_FRAMES;
+		stack->values = PushArray(exec.stackPool, Value, COROUTINE_MAX_VALUES);
+		stack->valuesCapacity = COROUTINE_MAX_VALUES;
+		stack->locals = PushArray(exec.stackPool, Var, COROUTINE_MAX_LOCALS);
+		stack->localsCapacity = COROUTINE_MAX_LOCALS;
+	}
+
+	stack->framesCount = 0;
+	stack->valuesCount = 0;
+	stack->localsCount = 0;
+	stack->localsBase = 0;
+	stack->nextFree = 0;
+	return stack;
+}
+
+void ReleaseStack(Execution &exec, ExecStack *stack)
+{
+	stack->nextFree = exec.freeStacks;
+	exec.freeStacks = stack;
+}
+
+// Function calls get a profiler frame named after the function. Suspended coroutines take
+// the frames of their calls along, and push them again when resumed.
+void ProfilerEnterCall(Execution &exec, StmtId function)
+{
+	if ( gProfiler.enabled )
+	{
+		Program &program = *exec.program;
+		ProfilerEnter(InternString(program, GetToken(program, program.stmts[function].identifier).lexeme));
+	}
+}
+
+void ProfilerEnterCalls(Execution &exec, const ExecStack &stack)
+{
+	for (u32 i = 0; i < stack.framesCount; ++i)
+	{
+		if ( stack.frames[i].type == FRAME_CALL ) ProfilerEnterCall(exec, stack.frames[i].node);
+	}
+}
+
+void ProfilerLeaveCalls(const ExecStack &stack)
+{
+	for (u32 i = 0; i < stack.framesCount; ++i)
+	{
+		if ( stack.frames[i].type == FRAME_CALL ) ProfilerLeave();
+	}
+}
+
+// Expects the function (or bound method) and its arguments on top of the value stack
+void CallFunction(Execution &exec, StmtId function, u32 argumentsCount)
+{
+	Program &program = *exec.program;
+	const Stmt &decl = program.stmts[function];
+	ExecStack &stack = *exec.stack;
+
+	const u32 callerLocalsBase = stack.localsBase;
+	stack.localsBase = stack.localsCount;
+
+	// Methods see their instance as the first local
+	const Value callee = stack.values[ stack.valuesCount - argumentsCount - 1 ];
+	if ( callee.type == VALUE_TYPE_METHOD )
+	{
+		Value instance;
+		instance.type = VALUE_TYPE_INSTANCE;
+		instance.instance = callee.method.instance;
+		DeclareLocal(exec, MakeString("this"), instance);
+	}
+
+	const Value *arguments = stack.values + stack.valuesCount - argumentsCount;
+	for (u32 i = 0; i < argumentsCount; ++i)
+	{
+		DeclareLocal(exec, GetToken(program, decl.firstParam + 2 * i).lexeme, arguments[i]);
+	}
+	stack.valuesCount -= argumentsCount + 1;
+
+	PushFrame(exec, FRAME_CALL, function);
+	TopFrame(exec).mark = callerLocalsBase;
+	ProfilerEnterCall(exec, function);
+	PushFrame(exec, FRAME_LIST, decl.body);
+	TopFrame(exec).mark = stack.localsCount;
+	OpenRegions(exec, TopFrame(exec), REGION_BLOCK | REGION_STEP);
+}
+
+// Gives control back to whoever resumed the running coroutine along with a value
+void LeaveCoroutine(Execution &exec, Value value, bool dead)
+{
+	// The value must outlive the regions of the coroutine
+	KeepAlive(exec, value, 0, 0);
+
+	Coroutine *coroutine = exec.coroutine;
+	ProfilerLeaveCalls(*coroutine->stack);
+	exec.stack = coroutine->callerStack;
+	exec.coroutine = coroutine->caller;
+
+	if ( exec.arena->used != coroutine->switchMark )
+	{
+		MoveRegions(exec, *exec.stack);
+	}
+	coroutine->switchMark = exec.arena->used;
+
+	if ( dead )
+	{
+		ReleaseStack(exec, coroutine->stack);
+		coroutine->stack = 0;
+		coroutine->state = COROUTINE_DEAD;
+	}
+	else
+	{
+		coroutine->state = COROUTINE_SUSPENDED;
+	}
+
+	PushValue(exec, value);
+}
+
+// Unwinds the frames of the current function, which must be on top of the call frame
+void ReturnFromFunction(Execution &exec, Value value)
+{
+	ExecStack &stack = *exec.stack;
+
+	u32 callFrame = stack.framesCount - 1;
+	while ( stack.frames[callFrame].type != FRAME_CALL )
+	{
+		callFrame--;
+	}
+
+	if ( exec.program->stmts[ stack.frames[callFrame].node ].initializer )
+	{
+		value = stack.locals[ stack.localsBase ].value; // this
+	}
+
+	// The value goes to whatever runs the call
+	if ( const void *object = GetObject(value) )
+	{
+		KeepObjectAlive(exec, object, 0, ValueRegion(exec, callFrame));
+	}
+
+	while ( TopFrame(exec).type != FRAME_CALL )
+	{
+		CloseRegions(exec, TopFrame(exec));
+		PopFrame(exec);
+	}
+
+	stack.localsCount = stack.localsBase;
+	stack.localsBase = TopFrame(exec).mark;
+	PopFrame(exec);
+	ProfilerLeave();
+
+	if ( stack.framesCount == 0 && exec.coroutine )
+	{
+		// Returning from the body of a coroutine
+		LeaveCoroutine(exec, value, true);
+	}
+	else
+	{
+		PushValue(exec, value);
+	}
+}
+
+// Expects the native and its arguments on top of the value stack
+void CallNative(Execution &exec, NativeId native, u32 argumentsCount, i32 line)
+{
+	Arena &arena = *exec.arena;
+	ExecStack &stack = *exec.stack;
+	const Value *arguments = stack.values + stack.valuesCount - argumentsCount;
+	const Value argument = argumentsCount > 0 ? arguments[0] : NilValue();
+	stack.valuesCount -= argumentsCount + 1;
+
+	Value result = NilValue();
+
+	switch ( native )
+	{
+		case NATIVE_COROUTINE:
+		{
+			if ( argument.type != VALUE_TYPE_FUNCTION )
+			{
+				RUNTIME_ERROR(exec, "%d: Coroutines can only be created from functions.\n", line);
+				break;
+			}
+
+			Coroutine *coroutine = PushZeroStruct(arena, Coroutine);
+			coroutine->state = COROUTINE_SUSPENDED;
+			coroutine->function = argument.function;
+			result.type = VALUE_TYPE_COROUTINE;
+			result.coroutine = coroutine;
+			break;
+		}
+		case NATIVE_RESUME:
+		{
+			if ( argument.type != VALUE_TYPE_COROUTINE )
+			{
+				RUNTIME_ERROR(exec, "%d: Can only resume coroutines.\n", line);
+				break;
+			}
+
+			Coroutine *coroutine = argument.coroutine;
+			if ( coroutine->state != COROUTINE_SUSPENDED )
+			{
+				RUNTIME_ERROR(exec, "%d: Cannot resume a %s coroutine.\n", line, coroutine->state == COROUTINE_DEAD ? "finished" : "running");
+				break;
+			}
+
+			const u32 resumeArgumentsCount = argumentsCount - 1;
+			if ( !coroutine->started )
+			{
+				const u32 paramsCount = exec.program->stmts[coroutine->function].paramsCount;
+				if ( resumeArgumentsCount != paramsCount )
+				{
+					RUNTIME_ERROR(exec, "%d: Expected %u arguments but got %u.\n", line, paramsCount, resumeArgumentsCount);
+					break;
+				}
+			}
+			else if ( resumeArgumentsCount > 1 )
+			{
+				RUNTIME_ERROR(exec, "%d: Resuming a coroutine passes at most one value to yield.\n", line);
+				break;
+			}
+
+			if ( !coroutine->started && !(coroutine->stack = AcquireStack(exec)) )
+			{
+				ReportError(exec, "Out of coroutine stacks.");
+				return;
+			}
+
+			for (u32 i = 0; i < resumeArgumentsCount; ++i)
+			{
+				KeepAlive(exec, arguments[1 + i], 0, 0);
+			}
+
+			// The coroutine resuming this one stays running, so it cannot be resumed while it waits
+			coroutine->callerStack = exec.stack;
+			coroutine->caller = exec.coroutine;
+			coroutine->state = COROUTINE_RUNNING;
+			exec.coroutine = coroutine;
+			exec.stack = coroutine->stack;
+
+			if ( arena.used != coroutine->switchMark )
+			{
+				MoveRegions(exec, *exec.stack);
+			}
+			coroutine->switchMark = arena.used;
+
+			if ( !coroutine->started )
+			{
+				coroutine->started = true;
+				Value function = {};
+				function.type = VALUE_TYPE_FUNCTION;
+				function.function = coroutine->function;
+				PushValue(exec, function);
+				for (u32 i = 0; i < resumeArgumentsCount; ++i)
+				{
+					PushValue(exec, arguments[1 + i]);
+				}
+				CallFunction(exec, coroutine->function, resumeArgumentsCount);
+			}
+			else
+			{
+				ProfilerEnterCalls(exec, *exec.stack);
+
+				// Becomes the result of the yield call that suspended it
+				PushValue(exec, resumeArgumentsCount > 0 ? arguments[1] : NilValue());
+			}
+			return;
+		}
+		case NATIVE_YIELD:
+		{
+			if ( !exec.coroutine )
+			{
+				RUNTIME_ERROR(exec, "%d: Cannot yield from outside a coroutine.\n", line);
+				break;
+			}
+
+			LeaveCoroutine(exec, argument, false);
+			return;
+		}
+		case NATIVE_ARRAY:
+		{
+			if ( argument.type != VALUE_TYPE_FLOAT || argument.f < 0.0f || argument.f >= (f32)U32_MAX )
+			{
+				RUNTIME_ERROR(exec, "%d: Expected an array size.\n", line);
+				break;
+			}
+
+			result.type = VALUE_TYPE_ARRAY;
+			result.array = CreateArray( arena, (u32)argument.f );
+			break;
+		}
+		case NATIVE_MAP:
+		{
+			result.type = VALUE_TYPE_MAP;
+			result.map = CreateMap( arena );
+			break;
+		}
+		case NATIVE_HAS:
+		case NATIVE_REMOVE:
+		case NATIVE_KEYS:
+		{
+			if ( argument.type != VALUE_TYPE_MAP )
+			{
+				RUNTIME_ERROR(exec, "%d: Expected a map.\n", line);
+				break;
+			}
+
+			Map *map = argument.map;
+
+			if ( native == NATIVE_KEYS )
+			{
+				result.type = VALUE_TYPE_ARRAY;
+				result.array = CreateArray( arena, 0 );
+				for (u32 i = 0; i < map->count; ++i)
+				{
+					PushElement( arena, result.array, map->entries[i].key );
+				}
+				break;
+			}
+
+			Value key;
+			if ( !MakeMapKey( *exec.program, arguments[1], key ) )
+			{
+				RUNTIME_ERROR(exec, "%d: Map keys must be strings or numbers.\n", line);
+				break;
+			}
+
+			result.type = VALUE_TYPE_BOOL;
+			result.b = native == NATIVE_HAS ? MapFind( map, key ) != U32_MAX : MapRemove( map, key );
+			break;
+		}
+		case NATIVE_LEN:
+		case NATIVE_PUSH:
+		case NATIVE_SUM:
+		case NATIVE_DOT:
+		case NATIVE_SCALE:
+		case NATIVE_SORT:
+		{
+			if ( native == NATIVE_LEN && argument.type == VALUE_TYPE_MAP )
+			{
+				result.type = VALUE_TYPE_FLOAT;
+				result.f = (f32)argument.map->count;
+				break;
+			}
+
+			if ( argument.type != VALUE_TYPE_ARRAY )
+			{
+				RUNTIME_ERROR(exec, "%d: Expected an array.\n", line);
+				break;
+			}
+
+			Array *array = argument.array;
+
+			if ( native == NATIVE_LEN )
+			{
+				result.type = VALUE_TYPE_FLOAT;
+				result.f = (f32)array->count;
+				break;
+			}
+			if ( native == NATIVE_PUSH )
+			{
+				const u32 used = arena.used;
+				PushElement( arena, array, arguments[1] );
+				KeepAlive( exec, arguments[1], array, 0 );
+				KeepAllocations( exec, used, array );
+				break;
+			}
+
+			// The rest only work on numbers
+			if ( array->boxed )
+			{
+				RUNTIME_ERROR(exec, "%d: Expected an array of numbers.\n", line);
+				break;
+			}
+
+			if ( native == NATIVE_SUM )
+			{
+				result.type = VALUE_TYPE_FLOAT;
+				result.f = SumFloats( array->floats, array->count );
+			}
+			else if ( native == NATIVE_DOT )
+			{
+				const Value other = arguments[1];
+				if ( other.type != VALUE_TYPE_ARRAY || other.array->boxed || other.array->count != array->count )
+				{
+					RUNTIME_ERROR(exec, "%d: Expected two arrays of numbers with the same length.\n", line);
+					break;
+				}
+				result.type = VALUE_TYPE_FLOAT;
+				result.f = DotFloats( array->floats, other.array->floats, array->count );
+			}
+			else if ( native == NATIVE_SCALE )
+			{
+				if ( arguments[1].type != VALUE_TYPE_FLOAT )
+				{
+					RUNTIME_ERROR(exec, "%d: Expected a number to scale with.\n", line);
+					break;
+				}
+				ScaleFloats( array->floats, array->count, arguments[1].f );
+				result = argument;
+			}
+			else
+			{
+				SortFloats( array->floats, array->count );
+				result = argument;
+			}
+			break;
+		}
+		case NATIVE_DONE:
+		{
+			if ( argument.type != VALUE_TYPE_COROUTINE )
+			{
+				RUNTIME_ERROR(exec, "%d: Expected a coroutine.\n", line);
+				break;
+			}
+
+			result.type = VALUE_TYPE_BOOL;
+			result.b = argument.coroutine->state == COROUTINE_DEAD;
+			break;
+		}
+		default:
+			INVALID_CODE_PATH();
+	}
+
+	PushValue(exec, result);
+}
+
+void StepExpr(Execution &exec)
+{
+	Arena &arena = *exec.arena;
+	Program &program = *exec.program;
+	ExecFrame &frame = TopFrame(exec);
+	const Expr &expr = GetExpr(program, frame.node);
+	const Token &token = GetToken(program, expr.token);
+
+	switch (expr.type)
+	{
+		case EXPR_IDENTIFIER:
+		{
+			Value value = {};
+			if ( !Lookup(exec, token.lexeme, value) )
+			{
+				RUNTIME_ERROR(exec, "Could not find identifier %.*s\n", token.lexeme.size, token.lexeme.str);
+			}
+			PopFrame(exec);
+			PushValue(exec, value);
+			break;
+		}
+		case EXPR_LITERAL:
+		{
+			PopFrame(exec);
+			PushValue(exec, token.literal);
+			break;
+		}
+		case EXPR_UNARY:
+		{
+			if ( frame.stage++ == 0 )
+			{
+				PushFrame(exec, FRAME_EXPR, expr.unary.expr);
+				break;
+			}
+
+			Value value = PopValue(exec);
+			switch ( expr.op )
+			{
+				case TOKEN_MINUS:
+					ASSERT( value.type == VALUE_TYPE_FLOAT );
+					value.f = -value.f;
+					break;
+				case TOKEN_NOT:
+					ASSERT( value.type == VALUE_TYPE_BOOL );
+					value.b = !value.b;
+					break;
+				default:
+					INVALID_CODE_PATH();
+			}
+			PopFrame(exec);
+			PushValue(exec, value);
+			break;
+		}
+		case EXPR_BINARY:
+		{
+			if ( frame.stage == 0 )
+			{
+				frame.stage = 1;
+				PushFrame(exec, FRAME_EXPR, expr.binary.left);
+				break;
+			}
+			if ( frame.stage == 1 )
+			{
+				frame.stage = 2;
+				PushFrame(exec, FRAME_EXPR, expr.binary.right);
+				break;
+			}
+
+			Value right = PopValue(exec);
+			Value left = PopValue(exec);
+			Value value = {};
+			switch ( expr.op )
+			{
+				case TOKEN_MINUS:
+					ASSERT( left.type == VALUE_TYPE_FLOAT && right.type == VALUE_TYPE_FLOAT );
+					value.type = VALUE_TYPE_FLOAT;
+					value.f = left.f - right.f;
+					break;
+				case TOKEN_PLUS:
+					ASSERT( left.type == VALUE_TYPE_FLOAT && right.type == VALUE_TYPE_FLOAT );
+					value.type = VALUE_TYPE_FLOAT;
+					value.f = left.f + right.f;
+					break;
+				case TOKEN_STAR:
+					ASSERT( left.type == VALUE_TYPE_FLOAT && right.type == VALUE_TYPE_FLOAT );
+					value.type = VALUE_TYPE_FLOAT;
+					value.f = left.f * right.f;
+					break;
+				case TOKEN_SLASH:
+					ASSERT( left.type == VALUE_TYPE_FLOAT && right.type == VALUE_TYPE_FLOAT );
+					value.type = VALUE_TYPE_FLOAT;
+					value.f = left.f / right.f;
+					break;
+				case TOKEN_LESS:
+					ASSERT( left.type == VALUE_TYPE_FLOAT && right.type == VALUE_TYPE_FLOAT );
+					value.type = VALUE_TYPE_BOOL;
+					value.b = left.f < right.f;
+					break;
+				case TOKEN_LESS_EQUAL:
+					ASSERT( left.type == VALUE_TYPE_FLOAT && right.type == VALUE_TYPE_FLOAT );
+					value.type = VALUE_TYPE_BOOL;
+					value.b = left.f <= right.f;
+					break;
+				case TOKEN_GREATER:
+					ASSERT( left.type == VALUE_TYPE_FLOAT && right.type == VALUE_TYPE_FLOAT );
+					value.type = VALUE_TYPE_BOOL;
+					value.b = left.f > right.f;
+					break;
+				case TOKEN_GREATER_EQUAL:
+					ASSERT( left.type == VALUE_TYPE_FLOAT && right.type == VALUE_TYPE_FLOAT );
+					value.type = VALUE_TYPE_BOOL;
+					value.b = left.f >= right.f;
+					break;
+				case TOKEN_NOT_EQUAL:
+					value.type = VALUE_TYPE_BOOL;
+					value.b = !ValuesEqual(left, right);
+					break;
+				case TOKEN_EQUAL_EQUAL:
+					value.type = VALUE_TYPE_BOOL;
+					value.b = ValuesEqual(left, right);
+					break;
+				default:
+					INVALID_CODE_PATH();
+			}
+			PopFrame(exec);
+			PushValue(exec, value);
+			break;
+		}
+		case EXPR_LOGICAL:
+		{
+			if ( frame.stage == 0 )
+			{
+				frame.stage = 1;
+				PushFrame(exec, FRAME_EXPR, expr.binary.left);
+				break;
+			}
+			if ( frame.stage == 1 )
+			{
+				// Short-circuit: the right operand is only evaluated when the left one does
+				// not determine the result already, which is then the value of the last operand
+				const bool truthy = IsTruthy( TopValue(exec) );
+				if ( expr.op == TOKEN_OROR ? !truthy : truthy )
+				{
+					PopValue(exec);
+					frame.stage = 2;
+					PushFrame(exec, FRAME_EXPR, expr.binary.right);
+					break;
+				}
+			}
+			PopFrame(exec);
+			break;
+		}
+		case EXPR_ASSIGNMENT:
+		{
+			if ( frame.stage++ == 0 )
+			{
+				PushFrame(exec, FRAME_EXPR, expr.assignment.right);
+				break;
+			}
+
+			if ( !Assign( exec, token.lexeme, TopValue(exec) ) )
+			{
+				RUNTIME_ERROR(exec, "Could not find identifier %.*s\n", token.lexeme.size, token.lexeme.str);
+			}
+			PopFrame(exec);
+			break;
+		}
+		case EXPR_CALL:
+		{
+			// Stage 0 evaluates the callee, stage 1 the arguments one by one (mark is the
+			// cursor) and then calls. Stage 2 just leaves the result of the call.
+			if ( frame.stage == 0 )
+			{
+				frame.stage = 1;
+				PushFrame(exec, FRAME_EXPR, expr.call.callee);
+				break;
+			}
+			if ( frame.stage == 1 && frame.mark < expr.argumentsCount )
+			{
+				PushFrame(exec, FRAME_EXPR, program.arguments[ expr.call.firstArgument + frame.mark++ ]);
+				break;
+			}
+			if ( frame.stage == 2 )
+			{
+				PopFrame(exec);
+				break;
+			}
+
+			frame.stage = 2;
+
+			const u32 argumentsCount = expr.argumentsCount;
+			const Value callee = exec.stack->values[ exec.stack->valuesCount - argumentsCount - 1 ];
+			const i32 line = token.line;
+
+			if ( callee.type == VALUE_TYPE_FUNCTION || callee.type == VALUE_TYPE_METHOD )
+			{
+				const StmtId function = callee.type == VALUE_TYPE_FUNCTION ? callee.function : callee.method.function;
+				const u32 paramsCount = program.stmts[function].paramsCount;
+				if ( argumentsCount == paramsCount )
+				{
+					CallFunction(exec, function, argumentsCount);
+					break;
+				}
+				RUNTIME_ERROR(exec, "%d: Expected %u arguments but got %u.\n", line, paramsCount, argumentsCount);
+			}
+			else if ( callee.type == VALUE_TYPE_NATIVE )
+			{
+				const Native &native = Natives[callee.native];
+				if ( argumentsCount >= native.minArity && argumentsCount <= native.maxArity )
+				{
+					// The native may switch to another stack, so this frame is not touched after
+					CallNative(exec, (NativeId)callee.native, argumentsCount, line);
+					break;
+				}
+				RUNTIME_ERROR(exec, "%d: Wrong number of arguments for %s.\n", line, native.name);
+			}
+			else if ( callee.type == VALUE_TYPE_CLASS )
+			{
+				// The init method, if any, takes the constructor arguments and returns the instance
+				StmtId init = 0;
+				FindMethod(program, callee.klass, MakeString("init"), init);
+				const u32 paramsCount = init ? program.stmts[init].paramsCount : 0;
+				if ( argumentsCount == paramsCount )
+				{
+					Value &value = exec.stack->values[ exec.stack->valuesCount - argumentsCount - 1 ];
+					Instance *instance = CreateInstance( arena, callee.klass );
+					if ( init )
+					{
+						value.type = VALUE_TYPE_METHOD;
+						value.method.instance = instance;
+						value.method.function = init;
+						CallFunction(exec, init, argumentsCount);
+					}
+					else
+					{
+						value.type = VALUE_TYPE_INSTANCE;
+						value.instance = instance;
+					}
+					break;
+				}
+				RUNTIME_ERROR(exec, "%d: Expected %u arguments but got %u.\n", line, paramsCount, argumentsCount);
+			}
+			else
+			{
+				RUNTIME_ERROR(exec, "%d: Can only call functions and classes.\n", line);
+			}
+
+			exec.stack->valuesCount -= argumentsCount + 1;
+			PushValue(exec, NilValue());
+			break;
+		}
+		case EXPR_GET:
+		{
+			if ( frame.stage++ == 0 )
+			{
+				PushFrame(exec, FRAME_EXPR, expr.get.object);
+				break;
+			}
+
+			const Value object = PopValue(exec);
+			PropertySite &site = program.sites[ expr.get.site ];
+			Value value = NilValue();
+
+			if ( object.type != VALUE_TYPE_INSTANCE )
+			{
+				RUNTIME_ERROR(exec, "%d: Only instances have properties.\n", token.line);
+			}
+			else if ( !GetProperty( object.instance, site.name, site.cache, value ) )
+			{
+				// Fields shadow methods
+				StmtId method;
+				if ( FindMethod( program, object.instance->klass, token.lexeme, method ) )
+				{
+					value.type = VALUE_TYPE_METHOD;
+					value.method.instance = object.instance;
+					value.method.function = method;
+				}
+				else
+				{
+					RUNTIME_ERROR(exec, "%d: Undefined property '%.*s'.\n", token.line, token.lexeme.size, token.lexeme.str);
+					value = NilValue();
+				}
+			}
+			PopFrame(exec);
+			PushValue(exec, value);
+			break;
+		}
+		case EXPR_SUPER:
+		{
+			// Methods of the superclass of the class declaring the running method, which may
+			// be an ancestor of the class of the instance
+			Value value = NilValue();
+			const Var *self = FindLocal(exec, MakeString("this"));
+			const Class *klass = self && self->value.type == VALUE_TYPE_INSTANCE ? self->value.instance->klass : 0;
+			while ( klass && klass->decl != expr.super.klass )
+			{
+				klass = klass->superclass;
+			}
+
+			StmtId method;
+			if ( klass && FindMethod( program, klass->superclass, token.lexeme, method ) )
+			{
+				value.type = VALUE_TYPE_METHOD;
+				value.method.instance = self->value.instance;
+				value.method.function = method;
+			}
+			else
+			{
+				RUNTIME_ERROR(exec, "%d: Undefined superclass method '%.*s'.\n", token.line, token.lexeme.size, token.lexeme.str);
+			}
+			PopFrame(exec);
+			PushValue(exec, value);
+			break;
+		}
+		case EXPR_SET:
+		{
+			if ( frame.stage == 0 )
+			{
+				frame.stage = 1;
+				PushFrame(exec, FRAME_EXPR, expr.set.object);
+				break;
+			}
+			if ( frame.stage == 1 )
+			{
+				if ( TopValue(exec).type == VALUE_TYPE_INSTANCE )
+				{
+					frame.stage = 2;
+					PushFrame(exec, FRAME_EXPR, expr.set.value);
+				}
+				else
+				{
+					RUNTIME_ERROR(exec, "%d: Only instances have fields.\n", token.line);
+					PopValue(exec);
+					PopFrame(exec);
+					PushValue(exec, NilValue());
+				}
+				break;
+			}
+
+			const Value value = PopValue(exec);
+			const Value object = PopValue(exec);
+			PropertySite &site = program.sites[ expr.set.site ];
+			const u32 used = arena.used;
+			SetProperty( arena, *program.arena, object.instance, site.name, site.cache, value );
+			KeepAlive( exec, value, object.instance, 0 );
+			KeepAllocations( exec, used, object.instance );
+			PopFrame(exec);
+			PushValue(exec, value);
+			break;
+		}
+		case EXPR_ARRAY:
+		{
+			// Elements are evaluated one by one, mark is the cursor
+			if ( frame.mark < expr.argumentsCount )
+			{
+				PushFrame(exec, FRAME_EXPR, program.arguments[ expr.array.firstElement + frame.mark++ ]);
+				break;
+			}
+
+			const u32 elementsCount = expr.argumentsCount;
+			const Value *elements = exec.stack->values + exec.stack->valuesCount - elementsCount;
+
+			Value value;
+			value.type = VALUE_TYPE_ARRAY;
+			value.array = CreateArray( arena, elementsCount );
+			for (u32 i = 0; i < elementsCount; ++i)
+			{
+				SetElement( arena, value.array, i, elements[i] );
+			}
+
+			exec.stack->valuesCount -= elementsCount;
+			PopFrame(exec);
+			PushValue(exec, value);
+			break;
+		}
+		case EXPR_INDEX:
+		case EXPR_INDEX_SET:
+		{
+			if ( frame.stage == 0 )
+			{
+				frame.stage = 1;
+				PushFrame(exec, FRAME_EXPR, expr.index.object);
+				break;
+			}
+			if ( frame.stage == 1 )
+			{
+				frame.stage = 2;
+				PushFrame(exec, FRAME_EXPR, expr.index.index);
+				break;
+			}
+			if ( frame.stage == 2 && expr.type == EXPR_INDEX_SET )
+			{
+				frame.stage = 3;
+				PushFrame(exec, FRAME_EXPR, expr.index.value);
+				break;
+			}
+
+			const Value value = expr.type == EXPR_INDEX_SET ? PopValue(exec) : NilValue();
+			const Value index = PopValue(exec);
+			const Value object = PopValue(exec);
+			Value result = NilValue();
+
+			if ( object.type == VALUE_TYPE_MAP )
+			{
+				// Missing keys read as nil
+				Value key;
+				if ( !MakeMapKey( program, index, key ) )
+				{
+					RUNTIME_ERROR(exec, "%d: Map keys must be strings or numbers.\n", token.line);
+				}
+				else if ( expr.type == EXPR_INDEX_SET )
+				{
+					const u32 used = arena.used;
+					MapInsert( arena, object.map, key, value );
+					KeepAlive( exec, value, object.map, 0 );
+					KeepAllocations( exec, used, object.map );
+					result = value;
+				}
+				else
+				{
+					const u32 entry = MapFind( object.map, key );
+					if ( entry != U32_MAX )
+					{
+						result = object.map->entries[entry].value;
+					}
+				}
+			}
+			else if ( object.type != VALUE_TYPE_ARRAY )
+			{
+				RUNTIME_ERROR(exec, "%d: Only arrays and maps can be indexed.\n", token.line);
+			}
+			else if ( index.type != VALUE_TYPE_FLOAT || !(index.f >= 0.0f && index.f < (f32)U32_MAX) || index.f != (f32)(u32)index.f )
+			{
+				RUNTIME_ERROR(exec, "%d: Array indices must be non-negative integers.\n", token.line);
+			}
+			else if ( (u32)index.f >= object.array->count )
+			{
+				RUNTIME_ERROR(exec, "%d: Array index %u out of bounds.\n", token.line, (u32)index.f);
+			}
+			else if ( expr.type == EXPR_INDEX_SET )
+			{
+				const u32 used = arena.used;
+				SetElement( arena, object.array, (u32)index.f, value );
+				KeepAlive( exec, value, object.array, 0 );
+				KeepAllocations( exec, used, object.array );
+				result = value;
+			}
+			else
+			{
+				result = GetElement( object.array, (u32)index.f );
+			}
+
+			PopFrame(exec);
+			PushValue(exec, result);
+			break;
+		}
+		default:
+			INVALID_CODE_PATH();
 	}
-
-	return false;
 }
 
-Value Evaluate(Arena &arena, Expr *expr, Environment &env)
+void StepStmt(Execution &exec)
 {
-	Value value = {};
+	Program &program = *exec.program;
+	ExecFrame &frame = TopFrame(exec);
+	const StmtId stmtId = frame.node;
+	const Stmt &stmt = program.stmts[ stmtId ];
 
-	switch (expr->type)
+	if ( frame.stage == 0 )
 	{
-		case EXPR_IDENTIFIER:
+		ProfilerLine( stmt.line );
+	}
+
+	switch ( stmt.type )
+	{
+		case STMT_EXPR:
+		case STMT_PRINT:
 		{
-			if ( !Get(env, expr->identifier.identifierToken->lexeme, value) )
+			if ( frame.stage++ == 0 )
+			{
+				PushFrame(exec, FRAME_EXPR, stmt.expr);
+				break;
+			}
+
+			const Value val = PopValue(exec);
+			if ( stmt.type == STMT_PRINT )
 			{
-				printf("Could not find identifier %.*s\n", expr->identifier.identifierToken->lexeme.size, expr->identifier.identifierToken->lexeme.str);
+				// TODO: In case there was an evaluation erro,
+				// this should not print anything
+				printf("Evaluated value: ");
+				PrintValue(program, val);
+				printf("\n");
 			}
+			PopFrame(exec);
 			break;
 		}
-		case EXPR_LITERAL:
+		case STMT_VAR_DECL:
 		{
-			value = expr->literal.literalToken->literal;
+			if ( frame.stage++ == 0 )
+			{
+				if ( stmt.expr )
+				{
+					PushFrame(exec, FRAME_EXPR, stmt.expr);
+				}
+				else
+				{
+					PushValue(exec, NilValue());
+				}
+				break;
+			}
+
+			const Value val = PopValue(exec);
+			PopFrame(exec);
+			Declare(exec, GetToken(program, stmt.identifier).lexeme, val, stmt.local);
 			break;
 		}
-		case EXPR_UNARY:
+		case STMT_CLASS_DECL:
 		{
-			value = Evaluate( arena, expr->unary.expr, env );
-			switch ( expr->unary.operatorToken->type )
+			if ( stmt.expr && frame.stage++ == 0 )
 			{
-				case TOKEN_MINUS:
-					ASSERT( value.type == VALUE_TYPE_FLOAT );
-					value.f = -value.f;
-					break;
-				case TOKEN_NOT:
-					ASSERT( value.type == VALUE_TYPE_BOOL );
-					value.b = !value.b;
-					break;
-				default:
-					INVALID_CODE_PATH();
+				PushFrame(exec, FRAME_EXPR, stmt.expr);
+				break;
+			}
+
+			const Value superclass = stmt.expr ? PopValue(exec) : NilValue();
+			if ( stmt.expr && superclass.type != VALUE_TYPE_CLASS )
+			{
+				RUNTIME_ERROR(exec, "%d: Superclass must be a class.\n", stmt.line);
 			}
+
+			const String name = GetToken(program, stmt.identifier).lexeme;
+			Value val;
+			val.type = VALUE_TYPE_CLASS;
+			val.klass = CreateClass( *exec.arena, *program.arena, name, stmtId,
+					superclass.type == VALUE_TYPE_CLASS ? superclass.klass : 0 );
+			KeepAlive( exec, superclass, val.klass, 0 );
+			PopFrame(exec);
+			Declare(exec, name, val, stmt.local);
 			break;
 		}
-		case EXPR_BINARY:
+		case STMT_FUN_DECL:
+		{
+			Value val;
+			val.type = VALUE_TYPE_FUNCTION;
+			val.function = stmtId;
+			PopFrame(exec);
+			Declare(exec, GetToken(program, stmt.identifier).lexeme, val, stmt.local);
+			break;
+		}
+		case STMT_RETURN:
 		{
-			Value left = Evaluate( arena, expr->binary.left, env );
-			Value right = Evaluate( arena, expr->binary.right, env );
-			switch ( expr->binary.operatorToken->type )
+			if ( frame.stage++ == 0 )
 			{
-				case TOKEN_MINUS:
-					ASSERT( left.type == VALUE_TYPE_FLOAT && right.type == VALUE_TYPE_FLOAT );
-					value.type = VALUE_TYPE_FLOAT;
-					value.f = left.f - right.f;
-					break;
-				case TOKEN_PLUS:
-					ASSERT( left.type == VALUE_TYPE_FLOAT && right.type == VALUE_TYPE_FLOAT );
-					value.type = VALUE_TYPE_FLOAT;
-					value.f = left.f + right.f;
-					break;
-				case TOKEN_STAR:
-					ASSERT( left.type == VALUE_TYPE_FLOAT && right.type == VALUE_TYPE_FLOAT );
-					value.type = VALUE_TYPE_FLOAT;
-					value.f = left.f * right.f;
-					break;
-				case TOKEN_SLASH:
-					ASSERT( left.type == VALUE_TYPE_FLOAT && right.type == VALUE_TYPE_FLOAT );
-					value.type = VALUE_TYPE_FLOAT;
-					value.f = left.f / right.f;
-					break;
-				case TOKEN_LESS:
-					ASSERT( left.type == VALUE_TYPE_FLOAT && right.type == VALUE_TYPE_FLOAT );
-					value.type = VALUE_TYPE_BOOL;
-					value.b = left.f < right.f;
-					break;
-				case TOKEN_LESS_EQUAL:
-					ASSERT( left.type == VALUE_TYPE_FLOAT && right.type == VALUE_TYPE_FLOAT );
-					value.type = VALUE_TYPE_BOOL;
-					value.b = left.f <= right.f;
-					break;
-				case TOKEN_GREATER:
-					ASSERT( left.type == VALUE_TYPE_FLOAT && right.type == VALUE_TYPE_FLOAT );
-					value.type = VALUE_TYPE_BOOL;
-					value.b = left.f > right.f;
-					break;
-				case TOKEN_GREATER_EQUAL:
-					ASSERT( left.type == VALUE_TYPE_FLOAT && right.type == VALUE_TYPE_FLOAT );
-					value.type = VALUE_TYPE_BOOL;
-					value.b = left.f >= right.f;
-					break;
-				case TOKEN_NOT_EQUAL:
-					value.type = VALUE_TYPE_BOOL;
-					value.b = false;
-					if ( left.type == VALUE_TYPE_BOOL && right.type == VALUE_TYPE_BOOL ) {
-						value.b = left.b != right.b;
-					} else if ( left.type == VALUE_TYPE_FLOAT && right.type == VALUE_TYPE_FLOAT ) {
-						value.b = left.f != right.f;
-					}
+				if ( stmt.expr )
+				{
+					PushFrame(exec, FRAME_EXPR, stmt.expr);
+				}
+				else
+				{
+					PushValue(exec, NilValue());
+				}
+				break;
+			}
+
+			ReturnFromFunction(exec, PopValue(exec));
+			break;
+		}
+		case STMT_BLOCK:
+		{
+			const u32 mark = exec.stack->localsCount;
+			PopFrame(exec);
+			PushFrame(exec, FRAME_LIST, stmt.body);
+			TopFrame(exec).mark = mark;
+			OpenRegions(exec, TopFrame(exec), REGION_BLOCK | REGION_STEP);
+			break;
+		}
+		case STMT_IF:
+		{
+			if ( frame.stage++ == 0 )
+			{
+				PushFrame(exec, FRAME_EXPR, stmt.expr);
+				break;
+			}
+
+			const StmtId branch = IsTruthy( PopValue(exec) ) ? stmt.body : stmt.elseBranch;
+			PopFrame(exec);
+			if ( branch )
+			{
+				PushFrame(exec, FRAME_STMT, branch);
+			}
+			break;
+		}
+		case STMT_WHILE:
+		{
+			if ( frame.stage == 0 )
+			{
+				// Each iteration is a step, starting with the condition
+				if ( frame.regions )
+				{
+					EndStep(exec, frame);
+				}
+				else
+				{
+					OpenRegions(exec, frame, REGION_STEP);
+				}
+
+				frame.stage = 1;
+				PushFrame(exec, FRAME_EXPR, stmt.expr);
+				break;
+			}
+
+			if ( IsTruthy( PopValue(exec) ) )
+			{
+				frame.stage = 0;
+				PushFrame(exec, FRAME_STMT, stmt.body);
+			}
+			else
+			{
+				CloseRegions(exec, frame);
+				PopFrame(exec);
+			}
+			break;
+		}
+		default:
+			INVALID_CODE_PATH();
+	}
+}
+
+void StepList(Execution &exec)
+{
+	ExecFrame &frame = TopFrame(exec);
+
+	// The previous statement finished
+	EndStep(exec, frame);
+
+	if ( frame.node )
+	{
+		const StmtId stmt = frame.node;
+		frame.node = exec.program->stmts[stmt].next;
+		PushFrame(exec, FRAME_STMT, stmt);
+	}
+	else
+	{
+		// Leaving the block discards its local variables
+		exec.stack->localsCount = frame.mark;
+		CloseRegions(exec, frame);
+		PopFrame(exec);
+	}
+}
+
+// Globals and anything created while running go to the given (runtime) arena
+void BeginExecution(Arena &arena, Execution &exec, Program &program, Environment &env)
+{
+	ZeroStruct(&exec);
+	exec.program = &program;
+	exec.env = &env;
+	exec.arena = &arena;
+	exec.profilerFramesCount = ProfilerFramesCount();
+
+	ExecStack &stack = exec.mainStack;
+	stack.frames = PushArray(arena, ExecFrame, EXECUTION_MAX_FRAMES);
+	stack.framesCapacity = EXECUTION_MAX_FRAMES;
+	stack.values = PushArray(arena, Value, EXECUTION_MAX_VALUES);
+	stack.valuesCapacity = EXECUTION_MAX_VALUES;
+	stack.locals = PushArray(arena, Var, EXECUTION_MAX_LOCALS);
+	stack.localsCapacity = EXECUTION_MAX_LOCALS;
+	exec.stack = &stack;
+
+	PushFrame(exec, FRAME_LIST, program.firstStmt);
+	OpenRegions(exec, TopFrame(exec), REGION_BLOCK | REGION_STEP);
+}
+
+void EndExecution(Execution &exec)
+{
+	ProfilerUnwind(exec.profilerFramesCount);
+
+	if ( exec.stackPool.base )
+	{
+		FreeGrowableArena(exec.stackPool);
+		exec.freeStacks = 0;
+	}
+}
+
+bool IsFinished(const Execution &exec)
+{
+	return exec.mainStack.framesCount == 0 || exec.hasErrors;
+}
+
+// Runs the program until it finishes or the budget is exhausted. Returns whether it finished,
+// otherwise calling it again continues where it stopped.
+bool ExecuteSlice(Execution &exec, const ExecutionBudget &budget)
+{
+	const Clock start = GetClock();
+	const f32 maxSeconds = budget.maxMicroseconds * 0.000001f;
+
+	u64 steps = 0;
+	while ( !IsFinished(exec) )
+	{
+		if ( budget.maxSteps && steps == budget.maxSteps )
+		{
+			break;
+		}
+
+		if ( budget.maxMicroseconds && steps % EXECUTION_CLOCK_STEPS == EXECUTION_CLOCK_STEPS - 1 &&
+			 GetSecondsElapsed(start, GetClock()) >= maxSeconds )
+		{
+			break;
+		}
+
+		switch ( TopFrame(exec).type )
+		{
+			case FRAME_EXPR: StepExpr(exec); break;
+			case FRAME_STMT: StepStmt(exec); break;
+			case FRAME_LIST: StepList(exec); break;
+			case FRAME_CALL: ReturnFromFunction(exec, NilValue()); break; // body ended without return
+			default: INVALID_CODE_PATH();
+		}
+
+		steps++;
+	}
+
+	exec.steps += steps;
+	return IsFinished(exec);
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Images
+
+// An image stores the global environment left by a script (typically a prelude) along with
+// its program, so that other processes can start from it without running the script again.
+// Functions and classes in the globals are StmtIds into that program, and scripts run on top
+// of it (see AppendTokens). References inside the image are offsets relative to its base or
+// indices into its arrays, so it can be mapped at any address and its strings, expressions
+// and statements are used in place, without copies. Only tokens and property sites, which
+// hold pointers, are rebuilt when loading.
+//
+// Objects (instances, arrays, maps, coroutines and bound methods) are not stored, as their
+// whole graph would need to be relocated, so preludes must not leave them in their globals.
+
+#define IMAGE_MAGIC 0x494C534A // "JSLI"
+#define IMAGE_VERSION 2
+
+struct ImageString
+{
+	u32 offset;
+	u32 size;
+};
+
+struct ImageArray
+{
+	u32 offset;
+	u32 count;
+};
+
+struct ImageVar
+{
+	ImageString name;
+	u32 type;
+	union
+	{
+		u32 b;
+		f32 f;
+		ImageString s;
+		StmtId function;
+		u32 klass; // index into the classes of the image
+	};
+};
+
+// Classes come after their superclass
+struct ImageClass
+{
+	StmtId decl;
+	u32 superclass; // index into the classes of the image, U32_MAX for none
+};
+
+struct ImageToken
+{
+	u32 type; // TokenId
+	i32 line;
+	ImageString lexeme;
+	u32 literalType; // ValueType
+	union
+	{
+		u32 b;
+		f32 f;
+		ImageString s;
+	};
+};
+
+// Arrays follow the header in this order, each one right after the previous one, then strings
+struct ImageHeader
+{
+	u32 magic;
+	u32 version;
+	ImageArray vars;      // ImageVar
+	ImageArray classes;   // ImageClass
+	ImageArray tokens;    // ImageToken
+	ImageArray exprs;     // Expr
+	ImageArray arguments; // ExprId
+	ImageArray sites;     // ImageString with the property name
+	ImageArray stmts;     // Stmt
+	ImageString strings;
+};
+
+ImageArray NextImageArray(u64 &offset, u32 count, u64 elementSize)
+{
+	ImageArray array = { (u32)offset, count };
+	offset += count * elementSize;
+	return array;
+}
+
+ImageString PushImageString(Arena &arena, u32 stringsOffset, String string)
+{
+	ImageString imageString = { stringsOffset + (u32)arena.used, string.size };
+	char *chars = PushArray(arena, char, string.size);
+	MemCopy(chars, string.str, string.size);
+	return imageString;
+}
+
+String GetImageString(const DataChunk &image, ImageString imageString)
+{
+	String string = { image.chars + imageString.offset, imageString.size };
+	return string;
+}
+
+// Index of the class in the image, which is added after its superclasses if missing
+u32 PushImageClass(Class **classes, u32 &classesCount, Class *klass)
+{
+	for (u32 i = 0; i < classesCount; ++i)
+	{
+		if ( classes[i] == klass ) return i;
+	}
+
+	if ( klass->superclass )
+	{
+		PushImageClass(classes, classesCount, klass->superclass);
+	}
+	classes[classesCount] = klass;
+	return classesCount++;
+}
+
+// The image is pushed into arena, SaveImage writes it to a file
+bool PushImage(Arena &arena, Environment &env, DataChunk &image)
+{
+	const Program *program = env.program;
+	if ( !program )
+	{
+		LOG(Error, "There is no program to store in the image.\n");
+		return false;
+	}
+	const TokenList &tokenList = *program->tokenList;
+
+	u32 varsCount = 0;
+	u32 classesCapacity = 0;
+	u64 stringsSize = 0;
+	for (VarList *list = env.variables; list; list = list->next)
+	{
+		for (u32 i = 0; i < list->varsCount; ++i)
+		{
+			const Var &var = list->vars[i];
+			varsCount++;
+			stringsSize += var.name.size;
+			switch ( var.value.type )
+			{
+				case VALUE_TYPE_STRING: stringsSize += var.value.s.size; break;
+				case VALUE_TYPE_CLASS:
+					for (const Class *klass = var.value.klass; klass; klass = klass->superclass) classesCapacity++;
 					break;
-				case TOKEN_EQUAL_EQUAL:
-					value.type = VALUE_TYPE_BOOL;
-					value.b = false;
-					if ( left.type == VALUE_TYPE_BOOL && right.type == VALUE_TYPE_BOOL ) {
-						value.b = left.b == right.b;
-					} else if ( left.type == VALUE_TYPE_FLOAT && right.type == VALUE_TYPE_FLOAT ) {
-						value.b = left.f == right.f;
-					}
+				case VALUE_TYPE_BOOL:
+				case VALUE_TYPE_FLOAT:
+				case VALUE_TYPE_NIL:
+				case VALUE_TYPE_FUNCTION:
 					break;
 				default:
-					INVALID_CODE_PATH();
+					LOG(Error, "Variable '%.*s' holds an object, which images cannot store.\n", var.name.size, var.name.str);
+					return false;
 			}
-			break;
 		}
-		case EXPR_ASSIGNMENT:
+	}
+
+	for (i32 i = 0; i < tokenList.count; ++i)
+	{
+		const Token &token = tokenList.tokens[i];
+		stringsSize += token.lexeme.size;
+		stringsSize += token.literal.type == VALUE_TYPE_STRING ? token.literal.s.size : 0;
+	}
+	for (u32 i = 0; i < program->sitesCount; ++i)
+	{
+		stringsSize += StrLen(program->sites[i].name);
+	}
+
+	Class **classes = PushArray(arena, Class*, classesCapacity);
+	u32 classesCount = 0;
+	for (VarList *list = env.variables; list; list = list->next)
+	{
+		for (u32 i = 0; i < list->varsCount; ++i)
 		{
-			Token *name = expr->assignment.nameToken;
-			Expr *right = expr->assignment.right;
+			if ( list->vars[i].value.type == VALUE_TYPE_CLASS )
+			{
+				PushImageClass(classes, classesCount, list->vars[i].value.klass);
+			}
+		}
+	}
+
+	ImageHeader header = {};
+	header.magic = IMAGE_MAGIC;
+	header.version = IMAGE_VERSION;
+	u64 offset = sizeof(ImageHeader);
+	header.vars = NextImageArray(offset, varsCount, sizeof(ImageVar));
+	header.classes = NextImageArray(offset, classesCount, sizeof(ImageClass));
+	header.tokens = NextImageArray(offset, tokenList.count, sizeof(ImageToken));
+	header.exprs = NextImageArray(offset, program->exprsCount, sizeof(Expr));
+	header.arguments = NextImageArray(offset, program->argumentsCount, sizeof(ExprId));
+	header.sites = NextImageArray(offset, program->sitesCount, sizeof(ImageString));
+	header.stmts = NextImageArray(offset, program->stmtsCount, sizeof(Stmt));
+	header.strings.offset = (u32)offset;
+	header.strings.size = (u32)stringsSize;
+
+	const u64 imageSize = offset + stringsSize;
+	if ( imageSize > U32_MAX )
+	{
+		LOG(Error, "The image does not fit in 32-bit offsets.\n");
+		return false;
+	}
+
+	image.bytes = PushZeroSize(arena, imageSize);
+	image.size = imageSize;
+	*(ImageHeader*)image.bytes = header;
 
-			Value value = Evaluate( arena, right, env );
-			if ( !Set( env, name->lexeme, value ) )
+	Arena stringsArena = MakeArena(image.bytes + header.strings.offset, stringsSize + 1);
+	const u32 stringsOffset = header.strings.offset;
+
+	ImageVar *imageVars = (ImageVar*)(image.bytes + header.vars.offset);
+	u32 varIndex = 0;
+	for (VarList *list = env.variables; list; list = list->next)
+	{
+		for (u32 i = 0; i < list->varsCount; ++i)
+		{
+			const Var &var = list->vars[i];
+			ImageVar &imageVar = imageVars[varIndex++];
+			imageVar.name = PushImageString(stringsArena, stringsOffset, var.name);
+			imageVar.type = var.value.type;
+			switch ( var.value.type )
 			{
-				printf("Could not find identifier %.*s\n", name->lexeme.size, name->lexeme.str);
+				case VALUE_TYPE_BOOL: imageVar.b = var.value.b; break;
+				case VALUE_TYPE_FLOAT: imageVar.f = var.value.f; break;
+				case VALUE_TYPE_STRING: imageVar.s = PushImageString(stringsArena, stringsOffset, var.value.s); break;
+				case VALUE_TYPE_NIL: break;
+				case VALUE_TYPE_FUNCTION: imageVar.function = var.value.function; break;
+				case VALUE_TYPE_CLASS: imageVar.klass = PushImageClass(classes, classesCount, var.value.klass); break;
+				default: INVALID_CODE_PATH();
 			}
-			break;
 		}
-		default:
-			INVALID_CODE_PATH();
 	}
 
-	return value;
+	ImageClass *imageClasses = (ImageClass*)(image.bytes + header.classes.offset);
+	for (u32 i = 0; i < classesCount; ++i)
+	{
+		imageClasses[i].decl = classes[i]->decl;
+		imageClasses[i].superclass = classes[i]->superclass ? PushImageClass(classes, classesCount, classes[i]->superclass) : U32_MAX;
+	}
+
+	ImageToken *imageTokens = (ImageToken*)(image.bytes + header.tokens.offset);
+	for (i32 i = 0; i < tokenList.count; ++i)
+	{
+		const Token &token = tokenList.tokens[i];
+		ImageToken &imageToken = imageTokens[i];
+		imageToken.type = token.type;
+		imageToken.line = token.line;
+		imageToken.lexeme = PushImageString(stringsArena, stringsOffset, token.lexeme);
+		imageToken.literalType = token.literal.type;
+		switch ( token.literal.type )
+		{
+			case VALUE_TYPE_BOOL: imageToken.b = token.literal.b; break;
+			case VALUE_TYPE_FLOAT: imageToken.f = token.literal.f; break;
+			case VALUE_TYPE_STRING: imageToken.s = PushImageString(stringsArena, stringsOffset, token.literal.s); break;
+			default: break;
+		}
+	}
+
+	ImageString *imageSites = (ImageString*)(image.bytes + header.sites.offset);
+	for (u32 i = 0; i < program->sitesCount; ++i)
+	{
+		imageSites[i] = PushImageString(stringsArena, stringsOffset, MakeString(program->sites[i].name));
+	}
+
+	MemCopy(image.bytes + header.exprs.offset, program->exprs, program->exprsCount * sizeof(Expr));
+	MemCopy(image.bytes + header.arguments.offset, program->arguments, program->argumentsCount * sizeof(ExprId));
+	MemCopy(image.bytes + header.stmts.offset, program->stmts, program->stmtsCount * sizeof(Stmt));
+
+	return true;
 }
 
-void Execute( Arena &arena, Stmt &stmt, Environment &env)
+bool SaveImage(Arena &arena, Environment &env, const char *filename)
 {
-	switch ( stmt.type )
+	TempArena temp = BeginTempArena(arena);
+	DataChunk image;
+	const bool ok = PushImage(arena, env, image) && WriteEntireFile(filename, image.bytes, image.size);
+	EndTempArena(temp);
+	return ok;
+}
+
+// Ranges are checked in 64 bits, so crafted offsets and sizes can't wrap around
+bool ValidImageLayout(const ImageHeader &header, u64 imageSize)
+{
+	const ImageArray arrays[] = { header.vars, header.classes, header.tokens, header.exprs, header.arguments, header.sites, header.stmts };
+	const u64 elementSizes[] = { sizeof(ImageVar), sizeof(ImageClass), sizeof(ImageToken), sizeof(Expr), sizeof(ExprId), sizeof(ImageString), sizeof(Stmt) };
+
+	u64 end = sizeof(ImageHeader);
+	for (u32 i = 0; i < ARRAY_COUNT(arrays); ++i)
 	{
-		case STMT_EXPR:
-			{
-				// Assignment statements are here by now
-				Evaluate( arena, stmt.expr, env );
-				break;
-			}
-		case STMT_PRINT:
-			{
-				Value val = Evaluate( arena, stmt.expr, env );
-				// TODO: In case there was an evaluation erro,
-				// this should not print anything
+		if ( arrays[i].offset != end ) return false;
+		end += arrays[i].count * elementSizes[i];
+	}
 
-				printf("Evaluated value: ");
-				switch ( val.type )
-				{
-					case VALUE_TYPE_FLOAT:
-						printf("%f", val.f);
-						break;
-					case VALUE_TYPE_BOOL:
-						printf("%s", val.b ? "true" : "false" );
-						break;
-					case VALUE_TYPE_STRING:
-						char cstring[512];
-						StrCopy(cstring, val.s);
-						printf("%s", cstring);
-						break;
-					case VALUE_TYPE_NIL:
-						printf("nil");
-						break;
-					default:
-						INVALID_CODE_PATH();
-				}
-				printf("\n");
-			}
-			break;
-		case STMT_VAR_DECL:
-			{
-				Value val;
-				val.type = VALUE_TYPE_NIL;
+	// Indices 0 of expressions and statements are reserved, and tokens end with EOF
+	return header.strings.offset == end && end + header.strings.size == imageSize &&
+		header.tokens.count > 0 && header.exprs.count > 0 && header.stmts.count > 0;
+}
 
-				if ( stmt.expr )
-				{
-					val = Evaluate( arena, stmt.expr, env );
-				}
+bool ValidImageString(const ImageHeader &header, ImageString imageString)
+{
+	return imageString.offset >= header.strings.offset &&
+		(u64)imageString.offset + imageString.size <= (u64)header.strings.offset + header.strings.size;
+}
 
-				if ( !Add( arena, env, stmt.identifier->lexeme, val ) )
-				{
-					printf("Error\n");
-				}
-				break;
-			}
+bool ValidImageToken(const ImageHeader &header, const ImageToken &token)
+{
+	if ( token.type > TOKEN_EOF || !ValidImageString(header, token.lexeme) ) return false;
+	switch ( token.literalType )
+	{
+		case VALUE_TYPE_BOOL:
+		case VALUE_TYPE_FLOAT:
+		case VALUE_TYPE_NIL:
+			return true;
+		case VALUE_TYPE_STRING:
+			return ValidImageString(header, token.s);
 		default:
-			INVALID_CODE_PATH();
+			return false;
+	}
+}
+
+// Indices must stay inside the arrays of the image, so that running its program can't read out
+// of bounds. Index 0 (none) is always valid.
+bool ValidImageExpr(const ImageHeader &header, const Expr &expr)
+{
+	const u32 exprsCount = header.exprs.count;
+	if ( expr.token >= header.tokens.count ) return false;
+	switch ( expr.type )
+	{
+		case EXPR_IDENTIFIER:
+		case EXPR_LITERAL:
+			return true;
+		case EXPR_UNARY:
+			return expr.unary.expr < exprsCount;
+		case EXPR_BINARY:
+		case EXPR_LOGICAL:
+			return expr.binary.left < exprsCount && expr.binary.right < exprsCount;
+		case EXPR_ASSIGNMENT:
+			return expr.assignment.right < exprsCount;
+		case EXPR_CALL:
+			return expr.call.callee < exprsCount && (u64)expr.call.firstArgument + expr.argumentsCount <= header.arguments.count;
+		case EXPR_GET:
+			return expr.get.object < exprsCount && expr.get.site < header.sites.count;
+		case EXPR_SET:
+			return expr.set.object < exprsCount && expr.set.site < header.sites.count && expr.set.value < exprsCount;
+		case EXPR_ARRAY:
+			return (u64)expr.array.firstElement + expr.argumentsCount <= header.arguments.count;
+		case EXPR_INDEX:
+		case EXPR_INDEX_SET:
+			return expr.index.object < exprsCount && expr.index.index < exprsCount && expr.index.value < exprsCount;
+		case EXPR_SUPER:
+			return expr.super.klass < header.stmts.count;
+		default:
+			return false;
+	}
+}
+
+bool ValidImageStmt(const ImageHeader &header, const Stmt &stmt)
+{
+	const u32 stmtsCount = header.stmts.count;
+	return (u32)stmt.type <= STMT_WHILE &&
+		stmt.expr < header.exprs.count &&
+		stmt.identifier < header.tokens.count &&
+		stmt.next < stmtsCount && stmt.body < stmtsCount && stmt.elseBranch < stmtsCount &&
+		(u64)stmt.firstParam + 2ull * stmt.paramsCount <= (u64)header.tokens.count + 1;
+}
+
+bool ValidImageProgram(const DataChunk &image, const ImageHeader &header)
+{
+	const ImageToken *tokens = (const ImageToken*)(image.bytes + header.tokens.offset);
+	for (u32 i = 0; i < header.tokens.count; ++i)
+	{
+		if ( !ValidImageToken(header, tokens[i]) ) return false;
+	}
+
+	const Expr *exprs = (const Expr*)(image.bytes + header.exprs.offset);
+	for (u32 i = 0; i < header.exprs.count; ++i)
+	{
+		if ( !ValidImageExpr(header, exprs[i]) ) return false;
+	}
+
+	const ExprId *arguments = (const ExprId*)(image.bytes + header.arguments.offset);
+	for (u32 i = 0; i < header.arguments.count; ++i)
+	{
+		if ( arguments[i] >= header.exprs.count ) return false;
+	}
+
+	const ImageString *sites = (const ImageString*)(image.bytes + header.sites.offset);
+	for (u32 i = 0; i < header.sites.count; ++i)
+	{
+		if ( !ValidImageString(header, sites[i]) ) return false;
+	}
+
+	const Stmt *stmts = (const Stmt*)(image.bytes + header.stmts.offset);
+	for (u32 i = 0; i < header.stmts.count; ++i)
+	{
+		if ( !ValidImageStmt(header, stmts[i]) ) return false;
+	}
+
+	// Superclasses come first, so their chains can't loop
+	const ImageClass *classes = (const ImageClass*)(image.bytes + header.classes.offset);
+	for (u32 i = 0; i < header.classes.count; ++i)
+	{
+		const ImageClass &klass = classes[i];
+		if ( klass.decl >= header.stmts.count || stmts[klass.decl].type != STMT_CLASS_DECL ||
+			( klass.superclass != U32_MAX && klass.superclass >= i ) )
+		{
+			return false;
+		}
 	}
+
+	return true;
 }
 
-void Execute(Arena &arena, Program &program, Environment &env)
+// The image must stay mapped while the environment is in use, as strings, expressions and
+// statements point into it. The program goes to arena and the variables to runtimeArena.
+bool LoadImage(Arena &arena, Arena &runtimeArena, const DataChunk &image, Environment &env)
 {
-	for (StmtList *list = program.statements; list; list = list->next)
+	const ImageHeader &header = *(const ImageHeader*)image.bytes;
+	if ( image.size < sizeof(ImageHeader) ||
+		header.magic != IMAGE_MAGIC ||
+		header.version != IMAGE_VERSION ||
+		!ValidImageLayout(header, image.size) )
+	{
+		LOG(Error, "Invalid or incompatible image.\n");
+		return false;
+	}
+
+	if ( !ValidImageProgram(image, header) )
+	{
+		LOG(Error, "Corrupted image program.\n");
+		return false;
+	}
+
+	Program *program = PushZeroStruct(arena, Program);
+	program->arena = &arena;
+	program->interning = StringInterningCreate(&arena);
+
+	TokenList *tokenList = PushZeroStruct(arena, TokenList);
+	tokenList->tokens = PushZeroArray(arena, Token, header.tokens.count);
+	tokenList->count = header.tokens.count;
+	tokenList->capacity = header.tokens.count;
+	program->tokenList = tokenList;
+
+	const ImageToken *imageTokens = (const ImageToken*)(image.bytes + header.tokens.offset);
+	for (u32 i = 0; i < header.tokens.count; ++i)
+	{
+		const ImageToken &imageToken = imageTokens[i];
+		Token &token = tokenList->tokens[i];
+		token.type = (TokenId)imageToken.type;
+		token.line = imageToken.line;
+		token.lexeme = GetImageString(image, imageToken.lexeme);
+		token.literal.type = (ValueType)imageToken.literalType;
+		switch ( imageToken.literalType )
+		{
+			case VALUE_TYPE_BOOL: token.literal.b = imageToken.b; break;
+			case VALUE_TYPE_FLOAT: token.literal.f = imageToken.f; break;
+			case VALUE_TYPE_STRING: token.literal.s = GetImageString(image, imageToken.s); break;
+		}
+	}
+
+	program->exprs = (Expr*)(image.bytes + header.exprs.offset);
+	program->exprsCount = program->exprsCapacity = header.exprs.count;
+	program->arguments = (ExprId*)(image.bytes + header.arguments.offset);
+	program->argumentsCount = program->argumentsCapacity = header.arguments.count;
+	program->stmts = (Stmt*)(image.bytes + header.stmts.offset);
+	program->stmtsCount = program->stmtsCapacity = header.stmts.count;
+
+	const ImageString *imageSites = (const ImageString*)(image.bytes + header.sites.offset);
+	program->sites = PushZeroArray(arena, PropertySite, header.sites.count);
+	program->sitesCount = program->sitesCapacity = header.sites.count;
+	for (u32 i = 0; i < header.sites.count; ++i)
 	{
-		for (u32 i = 0; i < list->stmtsCount; ++i)
+		program->sites[i].name = InternString(*program, GetImageString(image, imageSites[i]));
+	}
+
+	env.program = program;
+
+	const ImageClass *imageClasses = (const ImageClass*)(image.bytes + header.classes.offset);
+	Class **classes = PushArray(arena, Class*, header.classes.count);
+	for (u32 i = 0; i < header.classes.count; ++i)
+	{
+		const ImageClass &imageClass = imageClasses[i];
+		const String name = GetToken(*program, program->stmts[imageClass.decl].identifier).lexeme;
+		Class *superclass = imageClass.superclass != U32_MAX ? classes[imageClass.superclass] : 0;
+		classes[i] = CreateClass(runtimeArena, arena, name, imageClass.decl, superclass);
+	}
+
+	const ImageVar *imageVars = (const ImageVar*)(image.bytes + header.vars.offset);
+	for (u32 i = 0; i < header.vars.count; ++i)
+	{
+		const ImageVar &imageVar = imageVars[i];
+		if ( !ValidImageString(header, imageVar.name) ||
+			( imageVar.type == VALUE_TYPE_STRING && !ValidImageString(header, imageVar.s) ) )
+		{
+			LOG(Error, "Corrupted image string.\n");
+			return false;
+		}
+
+		Value value = {};
+		value.type = (ValueType)imageVar.type;
+		switch ( imageVar.type )
 		{
-			Execute( arena, list->stmts[i], env );
+			case VALUE_TYPE_BOOL: value.b = imageVar.b; break;
+			case VALUE_TYPE_FLOAT: value.f = imageVar.f; break;
+			case VALUE_TYPE_STRING: value.s = GetImageString(image, imageVar.s); break;
+			case VALUE_TYPE_NIL: break;
+			case VALUE_TYPE_FUNCTION:
+				if ( imageVar.function >= header.stmts.count || program->stmts[imageVar.function].type != STMT_FUN_DECL )
+				{
+					LOG(Error, "Corrupted image function.\n");
+					return false;
+				}
+				value.function = imageVar.function;
+				break;
+			case VALUE_TYPE_CLASS:
+				if ( imageVar.klass >= header.classes.count )
+				{
+					LOG(Error, "Corrupted image class.\n");
+					return false;
+				}
+				value.klass = classes[imageVar.klass];
+				break;
+			default:
+				LOG(Error, "Unknown value type in image.\n");
+				return false;
 		}
+
+		Add(runtimeArena, env, GetImageString(image, imageVar.name), value);
 	}
+
+	return true;
 }
 
 
@@ -1171,44 +4954,87 @@ void PrintTokenList(const TokenList &tokenList)
 }
 #endif
 
-void Run(Arena &arena, const char *script, u32 scriptSize)
+// Scripts are executed in slices limited by sliceBudget, as a host would do once per frame.
+// The script, its tokens and its AST go to arena, globals and runtime objects to runtimeArena.
+bool Run(Arena &arena, Arena &runtimeArena, const char *script, u32 scriptSize, Environment &env, const ExecutionBudget &sliceBudget)
 {
+	// The environment keeps the program for the functions and classes in its variables
+	TokenList *tokenList = PushStruct(arena, TokenList);
+	Program *program = PushStruct(arena, Program);
+
 	ScanState scanState = {};
-	TokenList tokenList = Scan(arena, scanState, script, scriptSize);
+	*tokenList = Scan(arena, scanState, script, scriptSize);
+
+	if ( scanState.hasErrors )
+	{
+		return false;
+	}
 
-	if ( !scanState.hasErrors )
+	if ( env.program )
 	{
+		*tokenList = AppendTokens(arena, *env.program->tokenList, *tokenList);
+	}
+
 #if 0
-		PrintTokenList(tokenList);
+	PrintTokenList(*tokenList);
 #endif
 
-		ParseState parseState = {};
-		Program program = Parse(arena, parseState, tokenList);
+	ParseState parseState = {};
+	*program = Parse(arena, parseState, *tokenList, env.program);
 
-		if ( !parseState.hasErrors )
-		{
-			Environment env = {};
+	if ( parseState.hasErrors )
+	{
+		return false;
+	}
 
-			Execute(arena, program, env);
-		}
+	env.program = program;
+
+	Execution exec;
+	BeginExecution(runtimeArena, exec, *program, env);
+
+	u32 slicesCount = 1;
+	while ( !ExecuteSlice(exec, sliceBudget) )
+	{
+		slicesCount++;
+	}
+
+	if ( slicesCount > 1 )
+	{
+		LOG(Info, "Executed %llu steps in %u slices\n", exec.steps, slicesCount);
 	}
+
+	EndExecution(exec);
+
+	return !exec.hasErrors;
+}
+
+bool Run(Arena &arena, Arena &runtimeArena, const char *script, u32 scriptSize)
+{
+	Environment env = {};
+	const ExecutionBudget unlimited = {};
+	const bool ok = Run(arena, runtimeArena, script, scriptSize, env, unlimited);
+	return ok;
 }
 
-void RunFile(Arena &arena, const char* filename)
+bool RunFile(Arena &arena, Arena &runtimeArena, const char* filename, Environment &env, const ExecutionBudget &sliceBudget)
 {
+	bool ok = false;
+
+	ProfilerEnter(filename);
+
 	u64 fileSize;
 	if ( GetFileSize(filename, fileSize) && fileSize > 0 )
 	{
-		Arena backupArena = arena;
+		TempArena temp = BeginTempArena(arena);
 		char* bytes = PushArray(arena, char, fileSize + 1);
 		if ( ReadEntireFile(filename, bytes, fileSize) )
 		{
 			bytes[fileSize] = 0;
-			Run(arena, bytes, fileSize);
+			ok = Run(arena, runtimeArena, bytes, fileSize, env, sliceBudget);
 		}
 		else
 		{
-			arena = backupArena;
+			EndTempArena(temp);
 			LOG(Error, "ReadEntireFile() failed reading %s\n", filename);
 		}
 	}
@@ -1216,9 +5042,21 @@ void RunFile(Arena &arena, const char* filename)
 	{
 		LOG(Error, "GetFileSize() failed reading %s\n", filename);
 	}
+
+	ProfilerLeave();
+
+	return ok;
+}
+
+bool RunFile(Arena &arena, Arena &runtimeArena, const char* filename)
+{
+	Environment env = {};
+	const ExecutionBudget unlimited = {};
+	const bool ok = RunFile(arena, runtimeArena, filename, env, unlimited);
+	return ok;
 }
 
-void RunPrompt(Arena &arena)
+void RunPrompt(Arena &arena, Arena &runtimeArena)
 {
 	char line[1024];
 
@@ -1243,34 +5081,277 @@ void RunPrompt(Arena &arena)
 		else
 		{
 			ResetArena(arena);
-			Run(arena, line, lineLen);
+			ResetArena(runtimeArena);
+			Run(arena, runtimeArena, line, lineLen);
 		}
 	}
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Batch runner
+
+#define SCRIPT_EXTENSION ".jsl"
+#define BATCH_ARENA_SIZE GB(1)
+#define BATCH_RUNTIME_ARENA_SIZE GB(1)
+#define MAX_BATCH_WORKERS MAX_JOB_WORKERS
+
+struct BatchScript
+{
+	const char *path;
+	f32 seconds;
+	u32 arenaUsed;
+	u32 runtimeArenaPeak;
+	bool ok;
+};
+
+// Arenas of each job worker
+struct BatchWorker
+{
+	Arena arena;
+	Arena runtimeArena;
+};
+
+struct Batch
+{
+	BatchScript *scripts;
+	u32 scriptsCount;
+
+	BatchWorker workers[MAX_BATCH_WORKERS];
+	u32 workersCount;
+};
+
+struct BatchScriptNode
+{
+	BatchScript script;
+	BatchScriptNode *next;
+};
+
+struct BatchDirectory
+{
+	Arena *arena;
+	const char *dirname;
+	BatchScriptNode *scripts;
+	u32 scriptsCount;
+};
+
+PARALLEL_FOR_FUNCTION(RunBatchScripts)
+{
+	Batch &batch = *(Batch*)arguments;
+	BatchWorker &worker = batch.workers[GetJobWorkerIndex()];
+
+	for (u32 scriptIndex = begin; scriptIndex < end; ++scriptIndex)
+	{
+		BatchScript &script = batch.scripts[scriptIndex];
+
+		// Each script runs on a freshly reset arena, isolated from any other script
+		ResetArena(worker.arena);
+		ResetArena(worker.runtimeArena);
+		worker.runtimeArena.peak = 0;
+
+		const Clock start = GetClock();
+		script.ok = RunFile(worker.arena, worker.runtimeArena, script.path);
+		const Clock end = GetClock();
+
+		script.seconds = GetSecondsElapsed(start, end);
+		script.arenaUsed = worker.arena.used;
+		script.runtimeArenaPeak = worker.runtimeArena.peak;
+	}
+}
+
+void AddBatchScript(const char *filename, void *userData)
+{
+	BatchDirectory &directory = *(BatchDirectory*)userData;
+
+	const u32 len = StrLen(filename);
+	const u32 extLen = StrLen(SCRIPT_EXTENSION);
+	if ( len > extLen && StrEq(filename + len - extLen, SCRIPT_EXTENSION) )
+	{
+		char *path = PushArray(*directory.arena, char, StrLen(directory.dirname) + len + 2);
+		StrCopy(path, directory.dirname);
+		StrCat(path, "/");
+		StrCat(path, filename);
+
+		BatchScriptNode *node = PushZeroStruct(*directory.arena, BatchScriptNode);
+		node->script.path = path;
+		node->next = directory.scripts;
+		directory.scripts = node;
+		directory.scriptsCount++;
+	}
+}
+
+bool RunBatch(Arena &arena, const char *dirname, u32 workersCount)
+{
+	BatchDirectory directory = {};
+	directory.dirname = dirname;
+	directory.arena = &arena;
+
+	if ( !ListDirectory(dirname, AddBatchScript, &directory) )
+	{
+		return false;
+	}
+
+	const u32 scriptsCount = directory.scriptsCount;
+	if ( scriptsCount == 0 )
+	{
+		LOG(Error, "No %s scripts found in %s\n", SCRIPT_EXTENSION, dirname);
+		return false;
+	}
+
+	// Flatten the list so workers can address scripts by index
+	BatchScript *scripts = PushArray(arena, BatchScript, scriptsCount);
+	u32 scriptIndex = scriptsCount;
+	for (BatchScriptNode *node = directory.scripts; node; node = node->next)
+	{
+		scripts[--scriptIndex] = node->script;
+	}
+
+	Batch *batch = PushZeroStruct(arena, Batch);
+	batch->scripts = scripts;
+	batch->scriptsCount = scriptsCount;
+	batch->workersCount = Clamp(workersCount, 1u, Min(scriptsCount, (u32)MAX_BATCH_WORKERS));
+
+	for (u32 i = 0; i < batch->workersCount; ++i)
+	{
+		BatchWorker &worker = batch->workers[i];
+		// Growable like the arenas of single scripts, so big scripts fit and small ones stay cheap
+		worker.arena = MakeGrowableArena(BATCH_ARENA_SIZE);
+		worker.runtimeArena = MakeGrowableArena(BATCH_RUNTIME_ARENA_SIZE);
+	}
+
+	const Clock start = GetClock();
+
+	// One script per batch, workers pick the next one as soon as they finish theirs
+	JobSystem *jobs = StartJobSystem(arena, batch->workersCount);
+	RunParallelFor(*jobs, scriptsCount, 1, RunBatchScripts, batch);
+	StopJobSystem(*jobs);
+
+	const Clock end = GetClock();
+
+	for (u32 i = 0; i < batch->workersCount; ++i)
+	{
+		FreeGrowableArena(batch->workers[i].arena);
+		FreeGrowableArena(batch->workers[i].runtimeArena);
+	}
+
+	// Summary
+	u32 failedCount = 0;
+	f32 scriptSeconds = 0.0f;
+	LOG(Info, "\n%-48s %6s %12s %12s %12s\n", "Script", "Status", "Time (ms)", "Arena (kB)", "Runtime (kB)");
+	for (u32 i = 0; i < scriptsCount; ++i)
+	{
+		const BatchScript &script = scripts[i];
+		LOG(Info, "%-48s %6s %12.3f %12u %12u\n", script.path, script.ok ? "ok" : "FAILED", script.seconds * 1000.0f, script.arenaUsed / 1024, script.runtimeArenaPeak / 1024);
+		failedCount += script.ok ? 0 : 1;
+		scriptSeconds += script.seconds;
+	}
+
+	const f32 wallSeconds = GetSecondsElapsed(start, end);
+	LOG(Info, "\n%u scripts, %u failed, %u workers\n", scriptsCount, failedCount, batch->workersCount);
+	LOG(Info, "- wall time: %.3f ms\n", wallSeconds * 1000.0f);
+	LOG(Info, "- script time: %.3f ms\n", scriptSeconds * 1000.0f);
+
+	return failedCount == 0;
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Main
+
+void PrintUsage()
+{
+	printf("Usage: %s [script]\n", COMMAND_NAME);
+	printf("       %s --batch <dir> [-j <workers>]\n", COMMAND_NAME);
+	printf("       %s --save-image <prelude> <image>\n", COMMAND_NAME);
+	printf("       %s --image <image> <script>\n", COMMAND_NAME);
+	printf("       %s --profile <output> <script>\n", COMMAND_NAME);
+	printf("       %s --slice <microseconds> <script>\n", COMMAND_NAME);
+}
+
+// Programs embedding the interpreter (e.g. main_fuzz.cpp) define JSL_NO_MAIN to provide their own
+#ifndef JSL_NO_MAIN
 int main(int argc, char **argv)
 {
-	u32 globalArenaSize = MB(2);
-	byte *globalArenaBase = (byte*)AllocateVirtualMemory(globalArenaSize);
+	// Only the pages used get committed. Region marks are 32-bit, so stay below 4GB.
+	Arena globalArena = MakeGrowableArena(GB(1));
+	Arena runtimeArena = MakeGrowableArena(GB(1));
+
+	if ( argc >= 2 && StrEq(argv[1], "--batch") )
+	{
+		if ( argc != 3 && !( argc == 5 && StrEq(argv[3], "-j") ) )
+		{
+			PrintUsage();
+			return -1;
+		}
+
+		const u32 workersCount = argc == 5 ? StrToUnsignedInt(argv[4]) : GetProcessorCount();
+		const bool ok = RunBatch(globalArena, argv[2], workersCount);
+		return ok ? 0 : -1;
+	}
+	else if ( argc == 4 && StrEq(argv[1], "--save-image") )
+	{
+		Environment env = {};
+		const ExecutionBudget unlimited = {};
+		const bool ok = RunFile(globalArena, runtimeArena, argv[2], env, unlimited) && SaveImage(globalArena, env, argv[3]);
+		return ok ? 0 : -1;
+	}
+	else if ( argc == 4 && StrEq(argv[1], "--image") )
+	{
+		DataChunk image;
+		if ( !MapFile(argv[2], image) )
+		{
+			return -1;
+		}
+
+		Environment env = {};
+		const ExecutionBudget unlimited = {};
+		const bool ok = LoadImage(globalArena, runtimeArena, image, env) && RunFile(globalArena, runtimeArena, argv[3], env, unlimited);
+		UnmapFile(image);
+		return ok ? 0 : -1;
+	}
+	else if ( argc == 4 && StrEq(argv[1], "--profile") )
+	{
+		if ( !ProfilerStart() )
+		{
+			FreeProfiler();
+			return -1;
+		}
 
-	Arena globalArena = MakeArena(globalArenaBase, globalArenaSize);
+		const bool ok = RunFile(globalArena, runtimeArena, argv[3]);
+		ProfilerStop();
+		const bool written = ok && WriteProfile(argv[2]);
+		FreeProfiler();
+		return written ? 0 : -1;
+	}
+	else if ( argc == 4 && StrEq(argv[1], "--slice") )
+	{
+		ExecutionBudget sliceBudget = {};
+		sliceBudget.maxMicroseconds = StrToUnsignedInt(argv[2]);
 
-	if ( argc > 2 )
+		Environment env = {};
+		const bool ok = RunFile(globalArena, runtimeArena, argv[3], env, sliceBudget);
+		return ok ? 0 : -1;
+	}
+	else if ( argc > 2 )
 	{
-		printf("Usage: %s [script]\n", COMMAND_NAME);
+		PrintUsage();
 		return -1;
 	}
-	else if ( argc == 2 )
+
+	bool ok = true;
+	if ( argc == 2 )
 	{
-		RunFile(globalArena, argv[1]);
+		ok = RunFile(globalArena, runtimeArena, argv[1]);
 	}
 	else
 	{
-		RunPrompt(globalArena);
+		RunPrompt(globalArena, runtimeArena);
 	}
 
-	PrintArenaUsage(globalArena);
+	PrintArenaUsage(globalArena, "Compile");
+	PrintArenaUsage(runtimeArena, "Runtime");
 
-	return 0;
+	return ok ? 0 : -1;
 }
+#endif // JSL_NO_MAIN
 
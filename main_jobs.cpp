@@ -0,0 +1,337 @@
+#include "tools.h"
+
+#define TEST_FUNCTIONALITY 1
+#define TEST_PERFORMANCE 1
+
+#define FLAT_JOBS_COUNT (2 * JOB_QUEUE_SIZE + 100) // fills the queue, so pushes also run jobs inline
+#define JOB_TREE_DEPTH 12
+#define PARALLEL_FOR_COUNT 100000
+#define BENCH_JOBS_COUNT 200000
+#define INTERNING_THREADS_COUNT 8
+#define INTERNING_STRINGS_COUNT 20000
+
+////////////////////////////////////////////////////////////////////////
+// Functional test
+
+// Every job has to run exactly once, whichever worker takes it
+
+JOB_FUNCTION(CountRunJob)
+{
+	AtomicIncrement((volatile u32*)arguments);
+}
+
+u32 TestFlatJobs(JobSystem &jobs)
+{
+	static volatile u32 runs[FLAT_JOBS_COUNT];
+	MemSet((void*)runs, sizeof(runs), 0);
+
+	JobCounter counter = {};
+	for (u32 i = 0; i < FLAT_JOBS_COUNT; ++i)
+	{
+		PushJob(jobs, CountRunJob, (void*)&runs[i], &counter);
+	}
+	WaitJobCounter(jobs, counter);
+
+	u32 failures = 0;
+	for (u32 i = 0; i < FLAT_JOBS_COUNT; ++i)
+	{
+		if ( runs[i] != 1 )
+		{
+			if ( failures++ == 0 ) LOG(Error, "  - Job %u ran %u times\n", i, runs[i]);
+		}
+	}
+	return failures;
+}
+
+// Jobs pushing jobs and waiting for them, from any worker
+
+struct JobTreeNode
+{
+	u32 depth;
+	volatile u32 *leaves;
+};
+
+JOB_FUNCTION(JobTreeJob)
+{
+	const JobTreeNode &node = *(JobTreeNode*)arguments;
+	if ( node.depth == 0 )
+	{
+		AtomicIncrement(node.leaves);
+		return;
+	}
+
+	JobSystem &jobs = *GetJobSystem();
+	JobTreeNode children[2] = { { node.depth - 1, node.leaves }, { node.depth - 1, node.leaves } };
+	JobCounter counter = {};
+	PushJob(jobs, JobTreeJob, &children[0], &counter);
+	PushJob(jobs, JobTreeJob, &children[1], &counter);
+	WaitJobCounter(jobs, counter);
+}
+
+u32 TestJobTree(JobSystem &jobs)
+{
+	volatile u32 leaves = 0;
+	JobTreeNode root = { JOB_TREE_DEPTH, &leaves };
+	JobTreeJob(&root);
+
+	if ( leaves != 1u << JOB_TREE_DEPTH )
+	{
+		LOG(Error, "  - Job tree ran %u leaves instead of %u\n", leaves, 1u << JOB_TREE_DEPTH);
+		return 1;
+	}
+	return 0;
+}
+
+// Parallel fors cover the range once, also with a last partial batch and inside jobs
+
+PARALLEL_FOR_FUNCTION(MarkRangeJob)
+{
+	volatile u32 *marks = (volatile u32*)arguments;
+	for (u32 i = begin; i < end; ++i)
+	{
+		AtomicIncrement(&marks[i]);
+	}
+}
+
+u32 CheckMarks(const volatile u32 *marks, u32 count, u32 batchSize)
+{
+	for (u32 i = 0; i < count; ++i)
+	{
+		if ( marks[i] != 1 )
+		{
+			LOG(Error, "  - Parallel for (batch size %u) visited %u %u times\n", batchSize, i, marks[i]);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+u32 TestParallelFor(JobSystem &jobs, Arena arena)
+{
+	u32 failures = 0;
+	volatile u32 *marks = PushZeroArray(arena, u32, PARALLEL_FOR_COUNT);
+
+	const u32 batchSizes[] = { 1, 7, 64, 1000, PARALLEL_FOR_COUNT, 2 * PARALLEL_FOR_COUNT };
+	for (u32 i = 0; i < ARRAY_COUNT(batchSizes); ++i)
+	{
+		MemSet((void*)marks, PARALLEL_FOR_COUNT * sizeof(u32), 0);
+		RunParallelFor(jobs, PARALLEL_FOR_COUNT, batchSizes[i], MarkRangeJob, (void*)marks);
+		failures += CheckMarks(marks, PARALLEL_FOR_COUNT, batchSizes[i]);
+	}
+
+	// An empty range must not call the function
+	RunParallelFor(jobs, 0, 16, MarkRangeJob, NULL);
+	return failures;
+}
+
+struct NestedParallelFor
+{
+	volatile u32 *marks;
+	u32 count;
+};
+
+JOB_FUNCTION(NestedParallelForJob)
+{
+	NestedParallelFor &nested = *(NestedParallelFor*)arguments;
+	RunParallelFor(*GetJobSystem(), nested.count, 16, MarkRangeJob, (void*)nested.marks);
+}
+
+u32 TestNestedParallelFor(JobSystem &jobs, Arena arena)
+{
+	const u32 jobsCount = 8;
+	const u32 count = 1000;
+	NestedParallelFor nested[jobsCount];
+
+	JobCounter counter = {};
+	for (u32 i = 0; i < jobsCount; ++i)
+	{
+		nested[i].marks = PushZeroArray(arena, u32, count);
+		nested[i].count = count;
+		PushJob(jobs, NestedParallelForJob, &nested[i], &counter);
+	}
+	WaitJobCounter(jobs, counter);
+
+	u32 failures = 0;
+	for (u32 i = 0; i < jobsCount; ++i)
+	{
+		failures += CheckMarks(nested[i].marks, count, 16);
+	}
+	return failures;
+}
+
+// Threads interning the same strings have to get the same pointers. Interning a string again
+// must not allocate, also when its shard is about to grow.
+
+struct InterningThread
+{
+	StringInterning *interning;
+	u32 first; // each thread goes through the strings starting somewhere else
+	const char **interned;
+};
+
+void PrintInterningString(char *buffer, u32 size, u32 index)
+{
+	snprintf(buffer, size, "name_%u", index);
+}
+
+THREAD_FUNCTION(InterningThreadMain)
+{
+	InterningThread &thread = *(InterningThread*)arguments;
+	for (u32 i = 0; i < INTERNING_STRINGS_COUNT; ++i)
+	{
+		const u32 index = (thread.first + i) % INTERNING_STRINGS_COUNT;
+		char string[32];
+		PrintInterningString(string, sizeof(string), index);
+		thread.interned[index] = MakeStringIntern(thread.interning, string);
+	}
+	THREAD_FUNCTION_RETURN();
+}
+
+u32 TestStringInterning(Arena arena)
+{
+	u32 failures = 0;
+
+	StringInterning interning = StringInterningCreate(&arena);
+	for (u32 i = 0; i < INTERNING_STRINGS_COUNT && failures == 0; ++i)
+	{
+		char string[32];
+		PrintInterningString(string, sizeof(string), i);
+		const char *interned = MakeStringIntern(&interning, string);
+		const u64 used = arena.used;
+		if ( MakeStringIntern(&interning, string) != interned || arena.used != used )
+		{
+			LOG(Error, "  - Interning '%s' again allocated or gave another pointer\n", string);
+			failures++;
+		}
+	}
+
+	StringInterning shared = StringInterningCreate(&arena);
+	InterningThread threads[INTERNING_THREADS_COUNT];
+	Thread handles[INTERNING_THREADS_COUNT];
+	for (u32 i = 0; i < INTERNING_THREADS_COUNT; ++i)
+	{
+		threads[i].interning = &shared;
+		threads[i].first = i * INTERNING_STRINGS_COUNT / INTERNING_THREADS_COUNT;
+		threads[i].interned = PushArray(arena, const char*, INTERNING_STRINGS_COUNT);
+	}
+	// Only interning uses the arena from now on
+	for (u32 i = 0; i < INTERNING_THREADS_COUNT; ++i)
+	{
+		handles[i] = CreateThread(InterningThreadMain, &threads[i]);
+	}
+	for (u32 i = 0; i < INTERNING_THREADS_COUNT; ++i)
+	{
+		JoinThread(handles[i]);
+	}
+
+	for (u32 i = 0; i < INTERNING_STRINGS_COUNT && failures == 0; ++i)
+	{
+		char string[32];
+		PrintInterningString(string, sizeof(string), i);
+		const char *interned = threads[0].interned[i];
+		for (u32 j = 0; j < INTERNING_THREADS_COUNT; ++j)
+		{
+			if ( threads[j].interned[i] != interned || !StrEq(interned, string) )
+			{
+				LOG(Error, "  - Thread %u interned '%s' at another pointer\n", j, string);
+				failures++;
+				break;
+			}
+		}
+	}
+
+	LOG(Info, "- string interning (%u threads): %s\n", INTERNING_THREADS_COUNT, failures == 0 ? "OK" : "FAILED");
+	return failures;
+}
+
+bool TestFunctionality(Arena &arena)
+{
+	u32 failures = 0;
+
+	const u32 workersCounts[] = { 1, 4, 16 };
+	for (u32 i = 0; i < ARRAY_COUNT(workersCounts); ++i)
+	{
+		TempArena temp = BeginTempArena(arena);
+		JobSystem *jobs = StartJobSystem(arena, workersCounts[i]);
+
+		const u32 workerFailures =
+			TestFlatJobs(*jobs) +
+			TestJobTree(*jobs) +
+			TestParallelFor(*jobs, arena) +
+			TestNestedParallelFor(*jobs, arena);
+
+		StopJobSystem(*jobs);
+		EndTempArena(temp);
+
+		LOG(Info, "- %2u workers: %s\n", workersCounts[i], workerFailures == 0 ? "OK" : "FAILED");
+		failures += workerFailures;
+	}
+
+	failures += TestStringInterning(arena);
+	return failures == 0;
+}
+
+////////////////////////////////////////////////////////////////////////
+// Performance test
+
+JOB_FUNCTION(EmptyJob)
+{
+}
+
+PARALLEL_FOR_FUNCTION(EmptyRangeJob)
+{
+}
+
+void TestPerformance(Arena &arena)
+{
+	LOG(Info, "%10s %14s %14s\n", "workers", "job ns", "for item ns");
+
+	const u32 workersCounts[] = { 1, 2, 4, 8, 16 };
+	for (u32 i = 0; i < ARRAY_COUNT(workersCounts); ++i)
+	{
+		TempArena temp = BeginTempArena(arena);
+		JobSystem *jobs = StartJobSystem(arena, workersCounts[i]);
+
+		// Pushed in queue-sized rounds, so that no job runs inline
+		const Clock c0 = GetClock();
+		for (u32 pushed = 0; pushed < BENCH_JOBS_COUNT; pushed += JOB_QUEUE_SIZE / 2)
+		{
+			JobCounter counter = {};
+			for (u32 j = 0; j < JOB_QUEUE_SIZE / 2; ++j)
+			{
+				PushJob(*jobs, EmptyJob, NULL, &counter);
+			}
+			WaitJobCounter(*jobs, counter);
+		}
+		const Clock c1 = GetClock();
+		RunParallelFor(*jobs, BENCH_JOBS_COUNT, 1, EmptyRangeJob, NULL);
+		const Clock c2 = GetClock();
+
+		StopJobSystem(*jobs);
+		EndTempArena(temp);
+
+		LOG(Info, "%10u %14.1f %14.1f\n", workersCounts[i],
+				1e9f * GetSecondsElapsed(c0, c1) / BENCH_JOBS_COUNT,
+				1e9f * GetSecondsElapsed(c1, c2) / BENCH_JOBS_COUNT);
+	}
+}
+
+int main()
+{
+	Arena arena = MakeGrowableArena(GB(1));
+
+	bool ok = true;
+
+#if TEST_FUNCTIONALITY
+	LOG(Info, "Functional test:\n");
+	ok = TestFunctionality(arena);
+#endif
+
+#if TEST_PERFORMANCE
+	LOG(Info, "Performance test:\n");
+	TestPerformance(arena);
+#endif
+
+	FreeGrowableArena(arena);
+	return ok ? 0 : -1;
+}
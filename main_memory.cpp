@@ -0,0 +1,274 @@
+#include "tools.h"
+#include <string.h> // memset, memcpy, memcmp
+
+#define TEST_FUNCTIONALITY 1
+#define TEST_PERFORMANCE 1
+
+#define MAX_BENCH_SIZE MB(64)
+#define BENCH_BYTES_PER_SIZE MB(512)
+#define BENCH_SLACK 64
+
+static u64 gRandomState = 0x9e3779b97f4a7c15ull;
+
+u32 Random()
+{
+	gRandomState ^= gRandomState << 13;
+	gRandomState ^= gRandomState >> 7;
+	gRandomState ^= gRandomState << 17;
+	return (u32)gRandomState;
+}
+
+i32 Sign(i32 value)
+{
+	return value < 0 ? -1 : value > 0 ? 1 : 0;
+}
+
+// Checks every operation against libc over random sizes, offsets and mismatch positions
+bool TestFunctionality(byte *bufferA, byte *bufferB, byte *bufferC)
+{
+	u32 failures = 0;
+
+	for (u32 i = 0; i < 200000; ++i)
+	{
+		const u32 maxSize = i % 4 == 0 ? KB(4) : 300;
+		const u32 size = Random() % maxSize;
+		const u32 offsetA = Random() % BENCH_SLACK;
+		const u32 offsetB = Random() % BENCH_SLACK;
+		byte *a = bufferA + offsetA;
+		byte *b = bufferB + offsetB;
+		byte *c = bufferC + offsetB;
+
+		// Fill with guards around to catch writes out of bounds
+		for (u32 j = 0; j < size + 2 * BENCH_SLACK; ++j) bufferA[j] = (byte)Random();
+		memcpy(bufferC, bufferA, size + 2 * BENCH_SLACK);
+		memcpy(bufferB, bufferA, size + 2 * BENCH_SLACK);
+
+		const byte value = (byte)Random();
+		MemSet(a, size, value);
+		memset(bufferC + offsetA, value, size);
+		if (memcmp(bufferA, bufferC, size + 2 * BENCH_SLACK) != 0) {
+			LOG(Error, "MemSet failed (size:%u offset:%u)\n", size, offsetA);
+			failures++;
+		}
+
+		memcpy(bufferC, bufferB, size + 2 * BENCH_SLACK);
+		MemCopy(b, a, size);
+		memcpy(c, a, size);
+		if (memcmp(bufferB, bufferC, size + 2 * BENCH_SLACK) != 0) {
+			LOG(Error, "MemCopy failed (size:%u offsets:%u,%u)\n", size, offsetA, offsetB);
+			failures++;
+		}
+
+		// Differ in one byte sometimes, in the tail or anywhere
+		memcpy(b, a, size);
+		if (size > 0 && i % 3 != 0) {
+			const u32 position = i % 3 == 1 ? size - 1 - Random() % Min(size, 40u) : Random() % size;
+			b[position] = (byte)Random();
+		}
+		const i32 expected = Sign(memcmp(a, b, size));
+		const i32 result = MemCompare(a, b, size);
+		if (Sign(result) != expected) {
+			LOG(Error, "MemCompare failed (size:%u offsets:%u,%u result:%d expected:%d)\n", size, offsetA, offsetB, result, expected);
+			failures++;
+		}
+
+		if (failures > 10) break;
+	}
+
+	LOG(Info, "- %s\n", failures == 0 ? "OK" : "FAILED");
+	return failures == 0;
+}
+
+// Subarenas of growable arenas start anywhere in the parent and commit through it. Pools
+// recycle slots through their free list and detect stale handles. Temp and scratch arenas
+// roll back in order.
+bool TestArenas()
+{
+	u32 failures = 0;
+
+	Arena parent = MakeGrowableArena(MB(64));
+	PushSize(parent, 100);
+
+	Arena subarena = MakeSubArena(parent);
+	Arena nested = MakeSubArena(subarena, MB(1));
+	for (u32 i = 0; i < 4; ++i)
+	{
+		MemSet(PushSize(subarena, KB(40)), KB(40), (byte)i);
+		MemSet(PushSize(nested, KB(100)), KB(100), (byte)i);
+	}
+
+	const u64 subarenaEnd = (u64)(subarena.base - parent.base) + subarena.committed;
+	if (parent.committed < subarenaEnd) {
+		LOG(Error, "Subarena commits not seen by the parent (%llu < %llu)\n", parent.committed, subarenaEnd);
+		failures++;
+	}
+
+	// The parent gives back what its subarenas committed
+	ResetArena(parent);
+	if (parent.committed > ARENA_COMMIT_SIZE) {
+		LOG(Error, "Parent did not decommit subarena memory (%llu committed)\n", parent.committed);
+		failures++;
+	}
+	FreeGrowableArena(parent);
+
+	// Pools hand out unused slots in order, then reuse the last freed one first
+	Arena arena = MakeGrowableArena(MB(1));
+	Pool pool = PushPool(arena, sizeof(u64), 4, true);
+	u64 *a = PoolAllocStruct(pool, u64);
+	u64 *b = PoolAllocStruct(pool, u64);
+	u64 *c = PoolAllocStruct(pool, u64);
+	if (PoolIndex(pool, a) != 0 || PoolIndex(pool, b) != 1 || PoolIndex(pool, c) != 2 || pool.count != 3) {
+		LOG(Error, "Pool did not hand out slots in order\n");
+		failures++;
+	}
+
+	const PoolHandle handleA = PoolGetHandle(pool, a);
+	const PoolHandle handleB = PoolGetHandle(pool, b);
+	PoolFree(pool, b);
+	if (PoolGet(pool, handleB) != NULL || PoolGet(pool, handleA) != a) {
+		LOG(Error, "Pool handle not invalidated by PoolFree\n");
+		failures++;
+	}
+	if (PoolAllocStruct(pool, u64) != b || PoolGet(pool, handleB) != NULL) {
+		LOG(Error, "Pool did not reuse the freed slot, or a stale handle saw it\n");
+		failures++;
+	}
+
+	PoolFree(pool, handleA);
+	PoolFree(pool, c);
+	u64 *first = PoolAllocStruct(pool, u64);
+	u64 *second = PoolAllocStruct(pool, u64);
+	u64 *unused = PoolAllocStruct(pool, u64);
+	if (first != c || second != a || PoolIndex(pool, unused) != 3 || PoolAlloc(pool) != NULL || pool.count != 4) {
+		LOG(Error, "Pool free list order or full pool wrong\n");
+		failures++;
+	}
+
+	const PoolHandle handleUnused = PoolGetHandle(pool, unused);
+	ResetPool(pool);
+	if (pool.count != 0 || PoolGet(pool, handleUnused) != NULL || PoolAllocStruct(pool, u64) != a) {
+		LOG(Error, "ResetPool did not start over or kept old handles valid\n");
+		failures++;
+	}
+
+	// Temp arenas nest and only roll back used, committed pages stay for the next pushes
+	ResetArena(arena);
+	PushSize(arena, 100);
+	TempArena outer = BeginTempArena(arena);
+	PushSize(arena, KB(200));
+	TempArena inner = BeginTempArena(arena);
+	PushSize(arena, 50);
+	EndTempArena(inner);
+	const u64 usedAfterInner = arena.used;
+	const u64 committed = arena.committed;
+	EndTempArena(outer);
+	if (usedAfterInner != 100 + KB(200) || arena.used != 100 || arena.committed != committed || arena.peak < 150 + KB(200)) {
+		LOG(Error, "Temp arenas did not restore used only (used %llu, committed %llu of %llu)\n", arena.used, arena.committed, committed);
+		failures++;
+	}
+	FreeGrowableArena(arena);
+
+	// Scratch arenas avoid the one given as conflict
+	TempArena scratch = BeginScratch();
+	TempArena other = BeginScratch(scratch.arena);
+	TempArena third = BeginScratch(other.arena);
+	if (scratch.arena == NULL || other.arena == scratch.arena || third.arena != scratch.arena) {
+		LOG(Error, "BeginScratch did not avoid the conflicting arena\n");
+		failures++;
+	}
+	EndTempArena(third);
+	EndTempArena(other);
+	EndTempArena(scratch);
+	FreeScratchArenas();
+
+	LOG(Info, "- %s\n", failures == 0 ? "OK (arenas)" : "FAILED (arenas)");
+	return failures == 0;
+}
+
+void PrintThroughput(u32 size, u32 repetitions, Clock c0, Clock c1)
+{
+	const f32 seconds = GetSecondsElapsed(c0, c1);
+	const f32 gigabytes = (f32)size * repetitions / (1024.0f * 1024.0f * 1024.0f);
+	LOG(Info, " %10.2f", seconds > 0.0f ? gigabytes / seconds : 0.0f);
+}
+
+void TestPerformance(byte *bufferA, byte *bufferB)
+{
+	volatile i32 sink = 0;
+
+	LOG(Info, "%10s %10s %10s %10s %10s %10s %10s  (GB/s)\n", "size", "memset", "MemSet", "memcpy", "MemCopy", "memcmp", "MemCompare");
+
+	for (u32 size = 8; size <= MAX_BENCH_SIZE; size *= 2)
+	{
+		const u32 repetitions = BENCH_BYTES_PER_SIZE / size;
+		byte *a = bufferA + 1; // Unaligned source
+		byte *b = bufferB;
+
+		if (size < KB(1)) LOG(Info, "%9uB", size);
+		else if (size < MB(1)) LOG(Info, "%8ukB", (u32)(size / KB(1)));
+		else LOG(Info, "%8uMB", (u32)(size / MB(1)));
+
+		// Touch pages before timing
+		memset(a, 0, size);
+		memset(b, 0, size);
+
+		Clock c0 = GetClock();
+		for (u32 i = 0; i < repetitions; ++i) { memset(b, (byte)i, size); sink = sink + b[i % size]; }
+		Clock c1 = GetClock();
+		for (u32 i = 0; i < repetitions; ++i) { MemSet(b, size, (byte)i); sink = sink + b[i % size]; }
+		Clock c2 = GetClock();
+		PrintThroughput(size, repetitions, c0, c1);
+		PrintThroughput(size, repetitions, c1, c2);
+
+		c0 = GetClock();
+		for (u32 i = 0; i < repetitions; ++i) { memcpy(b, a, size); sink = sink + b[i % size]; }
+		c1 = GetClock();
+		for (u32 i = 0; i < repetitions; ++i) { MemCopy(b, a, size); sink = sink + b[i % size]; }
+		c2 = GetClock();
+		PrintThroughput(size, repetitions, c0, c1);
+		PrintThroughput(size, repetitions, c1, c2);
+
+		// Equal buffers, so the whole range is compared
+		c0 = GetClock();
+		for (u32 i = 0; i < repetitions; ++i) { sink = sink + memcmp(b, a, size); }
+		c1 = GetClock();
+		for (u32 i = 0; i < repetitions; ++i) { sink = sink + MemCompare(b, a, size); }
+		c2 = GetClock();
+		PrintThroughput(size, repetitions, c0, c1);
+		PrintThroughput(size, repetitions, c1, c2);
+
+		LOG(Info, "\n");
+	}
+}
+
+int main()
+{
+	const u32 bufferSize = MAX_BENCH_SIZE + 3 * BENCH_SLACK;
+	byte *bufferA = (byte*)AllocateVirtualMemory(bufferSize);
+	byte *bufferB = (byte*)AllocateVirtualMemory(bufferSize);
+	byte *bufferC = (byte*)AllocateVirtualMemory(bufferSize);
+	if ( !bufferA || !bufferB || !bufferC )
+	{
+		LOG(Error, "Could not allocate memory\n");
+		return -1;
+	}
+
+	bool ok = true;
+
+#if TEST_FUNCTIONALITY
+	LOG(Info, "Functional test:\n");
+	ok = TestFunctionality(bufferA, bufferB, bufferC);
+	ok = TestArenas() && ok;
+#endif
+
+#if TEST_PERFORMANCE
+	LOG(Info, "Performance test:\n");
+	TestPerformance(bufferA, bufferB);
+#endif
+
+	FreeVirtualMemory(bufferA, bufferSize);
+	FreeVirtualMemory(bufferB, bufferSize);
+	FreeVirtualMemory(bufferC, bufferSize);
+
+	return ok ? 0 : -1;
+}
@@ -131,9 +131,13 @@ struct Graphics
 
 	Texture textures[MAX_TEXTURES];
 	u32 textureCount;
+	HashMapEntry textureMapEntries[2 * MAX_TEXTURES];
+	HashMap textureMap; // From name to texture index
 
 	Material materials[MAX_MATERIALS];
 	u32 materialCount;
+	HashMapEntry materialMapEntries[2 * MAX_MATERIALS];
+	HashMap materialMap; // From name to material index
 
 	BindGroupAllocator globalBindGroupAllocator;
 	BindGroupAllocator materialBindGroupAllocator;
@@ -435,10 +439,9 @@ BufferChunk PushData(Graphics &gfx, const CommandList &commandList, BufferArena
 
 RenderPassH RenderPassHandle(const Graphics &gfx, const char *name)
 {
-	for (u32 i = 0; i < gfx.device.renderPassCount; ++i) {
-		if ( StrEq(gfx.device.renderPasses[i].name, name) ) {
-			return { .index = i };
-		}
+	const u64 *index = HashMapFind(gfx.device.renderPassMap, MakeString(name));
+	if ( index ) {
+		return { .index = (u32)*index };
 	}
 	LOG(Warning, "Could not find render <%s> handle.\n", name);
 	INVALID_CODE_PATH();
@@ -447,10 +450,9 @@ RenderPassH RenderPassHandle(const Graphics &gfx, const char *name)
 
 PipelineH PipelineHandle(const Graphics &gfx, const char *name)
 {
-	for (u32 i = 0; i < gfx.device.pipelineCount; ++i) {
-		if ( StrEq(gfx.device.pipelines[i].name, name) ) {
-			return PipelineH{ .index = i };
-		}
+	const u64 *index = HashMapFind(gfx.device.pipelineMap, MakeString(name));
+	if ( index ) {
+		return PipelineH{ .index = (u32)*index };
 	}
 	LOG(Warning, "Could not find pipeline <%s> handle.\n", name);
 	INVALID_CODE_PATH();
@@ -544,8 +546,9 @@ TextureH CreateTexture(Graphics &gfx, const TextureDesc &desc)
 
 	ASSERT( gfx.textureCount < ARRAY_COUNT(gfx.textures) );
 	TextureH textureHandle = gfx.textureCount++;
-	gfx.textures[textureHandle].name = desc.name;
+	gfx.textures[textureHandle].name = InternString(desc.name);
 	gfx.textures[textureHandle].image = image;
+	HashMapInsert(gfx.textureMap, MakeString(gfx.textures[textureHandle].name), textureHandle);
 
 	return textureHandle;
 }
@@ -558,10 +561,9 @@ const Texture &GetTexture(const Graphics &gfx, TextureH handle)
 
 TextureH TextureHandle(const Graphics &gfx, const char *name)
 {
-	for (u32 i = 0; i < gfx.textureCount; ++i) {
-		if ( StrEq(gfx.textures[i].name, name) ) {
-			return i;
-		}
+	const u64 *index = HashMapFind(gfx.textureMap, MakeString(name));
+	if ( index ) {
+		return (TextureH)*index;
 	}
 	LOG(Warning, "Could not find texture <%s> handle.\n", name);
 	INVALID_CODE_PATH();
@@ -575,11 +577,12 @@ MaterialH CreateMaterial( Graphics &gfx, const MaterialDesc &desc)
 
 	ASSERT(gfx.materialCount < MAX_MATERIALS);
 	MaterialH materialHandle = gfx.materialCount++;
-	gfx.materials[materialHandle].name = desc.name;
+	gfx.materials[materialHandle].name = InternString(desc.name);
 	gfx.materials[materialHandle].pipelineH = pipelineHandle;
 	gfx.materials[materialHandle].albedoTexture = textureHandle;
 	gfx.materials[materialHandle].uvScale = desc.uvScale;
 	gfx.materials[materialHandle].bufferOffset = materialHandle * AlignUp(sizeof(SMaterial), gfx.device.alignment.uniformBufferOffset);
+	HashMapInsert(gfx.materialMap, MakeString(gfx.materials[materialHandle].name), materialHandle);
 
 	return materialHandle;
 }
@@ -592,10 +595,9 @@ Material &GetMaterial( Graphics &gfx, MaterialH materialHandle )
 
 MaterialH MaterialHandle(const Graphics &gfx, const char *name)
 {
-	for (u32 i = 0; i < gfx.materialCount; ++i) {
-		if ( StrEq(gfx.materials[i].name, name) ) {
-			return i;
-		}
+	const u64 *index = HashMapFind(gfx.materialMap, MakeString(name));
+	if ( index ) {
+		return (MaterialH)*index;
 	}
 	LOG(Warning, "Could not find material <%s> handle.\n", name);
 	INVALID_CODE_PATH();
@@ -729,6 +731,9 @@ bool InitializeGraphics(Graphics &gfx, Arena &arena, Window &window)
 		return false;
 	}
 
+	gfx.textureMap = MakeHashMap(gfx.textureMapEntries, ARRAY_COUNT(gfx.textureMapEntries));
+	gfx.materialMap = MakeHashMap(gfx.materialMapEntries, ARRAY_COUNT(gfx.materialMapEntries));
+
 	// Global render pass
 	{
 		const RenderpassDesc renderpassDesc = {
@@ -1925,8 +1930,8 @@ void EngineMain( void *userData )
 
 	// Memory
 	platform.stringMemorySize = KB(16);
-	platform.globalMemorySize = MB(64);
-	platform.frameMemorySize = MB(16);
+	platform.globalMemorySize = GB(64);
+	platform.frameMemorySize = GB(4);
 
 	// Callbacks
 	platform.InitCallback = EngineInit;
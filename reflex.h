@@ -84,6 +84,9 @@ struct ReflexStruct
 static const ReflexStruct *gReflexStructs[REFLEX_MAX_STRUCTS] = {};
 static const ReflexEnum *gReflexEnums[REFLEX_MAX_ENUMS] = {};
 
+static HashMapEntry gReflexStructsMapEntries[2 * REFLEX_MAX_STRUCTS];
+static HashMap gReflexStructsMap; // From struct name to ReflexStruct pointer
+
 
 static bool ReflexIsTrivial(ReflexID id)
 {
@@ -113,15 +116,8 @@ static const ReflexStruct* ReflexGetStruct(ReflexID id)
 
 static const ReflexStruct* ReflexGetStructFromName(const char *name)
 {
-	const ReflexStruct **rstruct = gReflexStructs;
-	const ReflexStruct **end = gReflexStructs + ReflexID_StructCount;
-	while (*rstruct && rstruct != end && (*rstruct)->name) {
-		if (StrEq((*rstruct)->name, name) ) {
-			return *rstruct;
-		}
-		++rstruct;
-	}
-	return 0;
+	const u64 *rstruct = HashMapFind(gReflexStructsMap, MakeString(name));
+	return rstruct ? (const ReflexStruct *)*rstruct : 0;
 }
 
 static const ReflexEnum* ReflexGetEnum(ReflexID id)
@@ -138,6 +134,12 @@ static ReflexID ReflexRegisterStruct(const ReflexStruct *reflexStruct)
 	ASSERT(sReflexIdCounter < ReflexID_StructCount);
 	gReflexStructs[sReflexIdCounter] = reflexStruct;
 	ReflexID reflexId = ReflexID_StructBegin + sReflexIdCounter++;
+
+	// Registered from static initializers, so the map is made by the first one
+	if (!gReflexStructsMap.entries) {
+		gReflexStructsMap = MakeHashMap(gReflexStructsMapEntries, ARRAY_COUNT(gReflexStructsMapEntries));
+	}
+	HashMapInsert(gReflexStructsMap, MakeString(reflexStruct->name), (u64)reflexStruct);
 	return reflexId;
 }
 
@@ -3,6 +3,8 @@ ENUM_ENTRY(TOKEN_LEFT_PAREN)
 ENUM_ENTRY(TOKEN_RIGHT_PAREN)
 ENUM_ENTRY(TOKEN_LEFT_BRACE)
 ENUM_ENTRY(TOKEN_RIGHT_BRACE)
+ENUM_ENTRY(TOKEN_LEFT_BRACKET)
+ENUM_ENTRY(TOKEN_RIGHT_BRACKET)
 ENUM_ENTRY(TOKEN_COMMA)
 ENUM_ENTRY(TOKEN_DOT)
 ENUM_ENTRY(TOKEN_MINUS)
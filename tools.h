@@ -10,9 +10,13 @@
  * - Strings
  * - Hashing
  * - Memory allocators
+ * - Hash maps
  * - File reading
  * - Mathematics
  * - Clock / timing
+ * - Threads and atomics
+ * - Jobs
+ * - String interning
  * - Window creation
  * - Input handling (mouse and keyboard)
  */
@@ -54,6 +58,9 @@
 #include <string.h>   // strerror_r
 #include <errno.h>    // errno
 #include <sys/mman.h> // mmap
+#include <dirent.h>   // opendir, readdir
+#include <pthread.h>  // pthread_create, pthread_join, pthread_mutex_t, pthread_cond_t
+#include <sched.h>    // sched_yield
 #endif
 
 #if PLATFORM_ANDROID
@@ -64,6 +71,8 @@
 
 
 #include <stdio.h>  // printf
+#include <stdlib.h> // strtof
+#include <string.h> // memcpy
 #include <math.h>
 // TODO: Remove C runtime library includes. But first...
 // TODO: Remove calls to printf.
@@ -75,10 +84,10 @@
 
 #define internal static
 
-#define KB(x) (1024ul * x)
-#define MB(x) (1024ul * KB(x))
-#define GB(x) (1024ul * MB(x))
-#define TB(x) (1024ul * GB(x))
+#define KB(x) (1024ull * x)
+#define MB(x) (1024ull * KB(x))
+#define GB(x) (1024ull * MB(x))
+#define TB(x) (1024ull * GB(x))
 
 #if PLATFORM_ANDROID
 #define Debug ANDROID_LOG_DEBUG
@@ -140,6 +149,7 @@ CT_ASSERT(sizeof(byte) == 1);
 #define U8_MAX 255
 #define U16_MAX 65535
 #define U32_MAX 4294967295
+#define U64_MAX 18446744073709551615ull
 
 
 
@@ -206,6 +216,13 @@ u32 CLZ(u32 bitMask)
 	_BitScanReverse(&lastBitSetIndex, bitMask);
 	return 31 - lastBitSetIndex;
 }
+
+// Count bits set
+u32 PopCount(u32 bitMask)
+{
+	u32 count = __popcnt(bitMask);
+	return count;
+}
 #else // #if PLATFORM_WINDOWS
 // Count trailing zeros
 u32 CTZ(u32 bitMask)
@@ -222,6 +239,13 @@ u32 CLZ(u32 bitMask)
 	u32 count = __builtin_clz(bitMask);
 	return count;
 }
+
+// Count bits set
+u32 PopCount(u32 bitMask)
+{
+	u32 count = __builtin_popcount(bitMask);
+	return count;
+}
 #endif // #else // #if PLATFORM_WINDOWS
 #else // #if TOOLS_USE_INTRINSICS
 // Count trailing zeros
@@ -248,8 +272,41 @@ u32 CLZ(u32 bitMask)
 	}
 	return count;
 }
+
+// Count bits set
+u32 PopCount(u32 bitMask)
+{
+	u32 count = 0;
+	while (bitMask) {
+		bitMask &= bitMask - 1;
+		++count;
+	}
+	return count;
+}
 #endif // #else // #if TOOLS_USE_INTRINSICS
 
+// Count leading zeros
+u32 CLZ64(u64 bitMask)
+{
+	const u32 high = (u32)(bitMask >> 32);
+	const u32 count = high ? CLZ(high) : 32 + CLZ((u32)bitMask);
+	return count;
+}
+
+// Full 128-bit product, returns the high half
+u64 MultiplyHigh(u64 a, u64 b, u64 &low)
+{
+#if PLATFORM_WINDOWS
+	u64 high;
+	low = _umul128(a, b, &high);
+	return high;
+#else
+	const unsigned __int128 product = (unsigned __int128)a * b;
+	low = (u64)product;
+	return (u64)(product >> 64);
+#endif
+}
+
 
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -398,24 +455,77 @@ bool StrToChar(const String &s)
 	return value;
 }
 
+// Numbers are parsed eight digits at a time where possible, all in a u64 (SWAR). Strings
+// without a length are null-terminated, and then the eight chars are checked one by one before
+// loading them, so nothing past the terminator is read.
+// https://lemire.me/blog/2022/01/21/swar-explained-parsing-eight-digits/
+
+// Whether there are chars left, end being NULL for null-terminated strings
+bool StrNotEnd(const char *str, const char *end)
+{
+	return end == NULL || str < end;
+}
+
+bool StrIsDigit(const char *str, const char *end)
+{
+	return StrNotEnd(str, end) && (u32)(*str - '0') < 10;
+}
+
+bool LoadEightDigits(const char *str, const char *end, u64 &chunk)
+{
+	if ( end == NULL ) {
+		for ( u32 i = 0; i < 8; ++i ) {
+			if ( (u32)(str[i] - '0') >= 10 ) return false;
+		}
+	} else if ( end - str < 8 ) {
+		return false;
+	}
+	memcpy(&chunk, str, 8);
+	// Every byte in '0'..'9' has 3 in the high nibble, and adding 6 doesn't carry into it
+	const bool digits = ((chunk & 0xF0F0F0F0F0F0F0F0ull) |
+		(((chunk + 0x0606060606060606ull) & 0xF0F0F0F0F0F0F0F0ull) >> 4)) == 0x3333333333333333ull;
+	return digits;
+}
+
+// The first char is in the lowest byte, so it gets the highest power of ten
+u32 ParseEightDigits(u64 chunk)
+{
+	chunk -= 0x3030303030303030ull;
+	chunk = chunk * 10 + (chunk >> 8); // pairs of digits
+	chunk = ((chunk & 0x000000FF000000FFull) * (100 + (1000000ull << 32)) +
+		((chunk >> 16) & 0x000000FF000000FFull) * (1 + (10000ull << 32))) >> 32;
+	return (u32)chunk;
+}
+
+// Overflows wrap around
+u32 ScanDigits(const char *&str, const char *end)
+{
+	u32 integer = 0;
+	u64 chunk;
+	if ( LoadEightDigits(str, end, chunk) ) {
+		integer = ParseEightDigits(chunk);
+		str += 8;
+	}
+	while ( StrIsDigit(str, end) ) {
+		integer = (integer << 3) + (integer << 1); // x10
+		integer += *str++ - '0';
+	}
+	return integer;
+}
+
 i32 StrToInt(const char *str, u32 len = U32_MAX)
 {
-	i32 integer = 0;
+	const char *end = len == U32_MAX ? NULL : str + len;
 
 	// scan sign
 	bool negative = false;
-	if (*str == '-') {
+	if ( StrNotEnd(str, end) && *str == '-' ) {
 		negative = true;
 		str++;
-		len--;
 	}
 
 	// scan integer part
-	while (*str >= '0' && *str <= '9' && len > 0) {
-		integer = (integer << 3) + (integer << 1); // x10
-		integer += *str++ - '0';
-		len--;
-	}
+	const i32 integer = (i32)ScanDigits(str, end);
 
 	const i32 result = negative ? -integer : integer;
 	return result;
@@ -429,15 +539,10 @@ i32 StrToInt(const String &s)
 
 u32 StrToUnsignedInt(const char *str, u32 len = U32_MAX)
 {
-	u32 integer = 0;
+	const char *end = len == U32_MAX ? NULL : str + len;
 
 	// scan integer part
-	while (*str >= '0' && *str <= '9' && len > 0) {
-		integer = (integer << 3) + (integer << 1); // x10
-		integer += *str++ - '0';
-		len--;
-	}
-
+	const u32 integer = ScanDigits(str, end);
 	return integer;
 }
 
@@ -447,42 +552,292 @@ u32 StrToUnsignedInt(const String &s)
 	return number;
 }
 
+// StrToFloat reads up to 19 significant digits in a u64 w and the decimal exponent q, so the
+// number is w * 10^q. Small enough w and q are exact floats, and then a single float product
+// or division is correctly rounded (Clinger's fast path). Otherwise, the Eisel-Lemire algorithm
+// multiplies w by a 128-bit approximation of 5^q, and the leading bits give the mantissa. With
+// more than 19 digits, it checks that w and w+1 round to the same float, and if not (or if the
+// number is very long) strtof is the fallback.
+// https://arxiv.org/abs/2101.11408
+
+#define FLOAT_POW5_MIN_EXPONENT -64 // below, everything rounds to zero
+#define FLOAT_POW5_MAX_EXPONENT 38 // above, everything rounds to infinity
+
+static const u64 gFloatPowersOfFive[] = {
+	0xa87fea27a539e9a5ull, 0x3f2398d747b36224ull, // 5^-64
+	0xd29fe4b18e88640eull, 0x8eec7f0d19a03aadull, // 5^-63
+	0x83a3eeeef9153e89ull, 0x1953cf68300424acull, // 5^-62
+	0xa48ceaaab75a8e2bull, 0x5fa8c3423c052dd7ull, // 5^-61
+	0xcdb02555653131b6ull, 0x3792f412cb06794dull, // 5^-60
+	0x808e17555f3ebf11ull, 0xe2bbd88bbee40bd0ull, // 5^-59
+	0xa0b19d2ab70e6ed6ull, 0x5b6aceaeae9d0ec4ull, // 5^-58
+	0xc8de047564d20a8bull, 0xf245825a5a445275ull, // 5^-57
+	0xfb158592be068d2eull, 0xeed6e2f0f0d56712ull, // 5^-56
+	0x9ced737bb6c4183dull, 0x55464dd69685606bull, // 5^-55
+	0xc428d05aa4751e4cull, 0xaa97e14c3c26b886ull, // 5^-54
+	0xf53304714d9265dfull, 0xd53dd99f4b3066a8ull, // 5^-53
+	0x993fe2c6d07b7fabull, 0xe546a8038efe4029ull, // 5^-52
+	0xbf8fdb78849a5f96ull, 0xde98520472bdd033ull, // 5^-51
+	0xef73d256a5c0f77cull, 0x963e66858f6d4440ull, // 5^-50
+	0x95a8637627989aadull, 0xdde7001379a44aa8ull, // 5^-49
+	0xbb127c53b17ec159ull, 0x5560c018580d5d52ull, // 5^-48
+	0xe9d71b689dde71afull, 0xaab8f01e6e10b4a6ull, // 5^-47
+	0x9226712162ab070dull, 0xcab3961304ca70e8ull, // 5^-46
+	0xb6b00d69bb55c8d1ull, 0x3d607b97c5fd0d22ull, // 5^-45
+	0xe45c10c42a2b3b05ull, 0x8cb89a7db77c506aull, // 5^-44
+	0x8eb98a7a9a5b04e3ull, 0x77f3608e92adb242ull, // 5^-43
+	0xb267ed1940f1c61cull, 0x55f038b237591ed3ull, // 5^-42
+	0xdf01e85f912e37a3ull, 0x6b6c46dec52f6688ull, // 5^-41
+	0x8b61313bbabce2c6ull, 0x2323ac4b3b3da015ull, // 5^-40
+	0xae397d8aa96c1b77ull, 0xabec975e0a0d081aull, // 5^-39
+	0xd9c7dced53c72255ull, 0x96e7bd358c904a21ull, // 5^-38
+	0x881cea14545c7575ull, 0x7e50d64177da2e54ull, // 5^-37
+	0xaa242499697392d2ull, 0xdde50bd1d5d0b9e9ull, // 5^-36
+	0xd4ad2dbfc3d07787ull, 0x955e4ec64b44e864ull, // 5^-35
+	0x84ec3c97da624ab4ull, 0xbd5af13bef0b113eull, // 5^-34
+	0xa6274bbdd0fadd61ull, 0xecb1ad8aeacdd58eull, // 5^-33
+	0xcfb11ead453994baull, 0x67de18eda5814af2ull, // 5^-32
+	0x81ceb32c4b43fcf4ull, 0x80eacf948770ced7ull, // 5^-31
+	0xa2425ff75e14fc31ull, 0xa1258379a94d028dull, // 5^-30
+	0xcad2f7f5359a3b3eull, 0x096ee45813a04330ull, // 5^-29
+	0xfd87b5f28300ca0dull, 0x8bca9d6e188853fcull, // 5^-28
+	0x9e74d1b791e07e48ull, 0x775ea264cf55347eull, // 5^-27
+	0xc612062576589ddaull, 0x95364afe032a819eull, // 5^-26
+	0xf79687aed3eec551ull, 0x3a83ddbd83f52205ull, // 5^-25
+	0x9abe14cd44753b52ull, 0xc4926a9672793543ull, // 5^-24
+	0xc16d9a0095928a27ull, 0x75b7053c0f178294ull, // 5^-23
+	0xf1c90080baf72cb1ull, 0x5324c68b12dd6339ull, // 5^-22
+	0x971da05074da7beeull, 0xd3f6fc16ebca5e04ull, // 5^-21
+	0xbce5086492111aeaull, 0x88f4bb1ca6bcf585ull, // 5^-20
+	0xec1e4a7db69561a5ull, 0x2b31e9e3d06c32e6ull, // 5^-19
+	0x9392ee8e921d5d07ull, 0x3aff322e62439fd0ull, // 5^-18
+	0xb877aa3236a4b449ull, 0x09befeb9fad487c3ull, // 5^-17
+	0xe69594bec44de15bull, 0x4c2ebe687989a9b4ull, // 5^-16
+	0x901d7cf73ab0acd9ull, 0x0f9d37014bf60a11ull, // 5^-15
+	0xb424dc35095cd80full, 0x538484c19ef38c95ull, // 5^-14
+	0xe12e13424bb40e13ull, 0x2865a5f206b06fbaull, // 5^-13
+	0x8cbccc096f5088cbull, 0xf93f87b7442e45d4ull, // 5^-12
+	0xafebff0bcb24aafeull, 0xf78f69a51539d749ull, // 5^-11
+	0xdbe6fecebdedd5beull, 0xb573440e5a884d1cull, // 5^-10
+	0x89705f4136b4a597ull, 0x31680a88f8953031ull, // 5^-9
+	0xabcc77118461cefcull, 0xfdc20d2b36ba7c3eull, // 5^-8
+	0xd6bf94d5e57a42bcull, 0x3d32907604691b4dull, // 5^-7
+	0x8637bd05af6c69b5ull, 0xa63f9a49c2c1b110ull, // 5^-6
+	0xa7c5ac471b478423ull, 0x0fcf80dc33721d54ull, // 5^-5
+	0xd1b71758e219652bull, 0xd3c36113404ea4a9ull, // 5^-4
+	0x83126e978d4fdf3bull, 0x645a1cac083126eaull, // 5^-3
+	0xa3d70a3d70a3d70aull, 0x3d70a3d70a3d70a4ull, // 5^-2
+	0xccccccccccccccccull, 0xcccccccccccccccdull, // 5^-1
+	0x8000000000000000ull, 0x0000000000000000ull, // 5^0
+	0xa000000000000000ull, 0x0000000000000000ull, // 5^1
+	0xc800000000000000ull, 0x0000000000000000ull, // 5^2
+	0xfa00000000000000ull, 0x0000000000000000ull, // 5^3
+	0x9c40000000000000ull, 0x0000000000000000ull, // 5^4
+	0xc350000000000000ull, 0x0000000000000000ull, // 5^5
+	0xf424000000000000ull, 0x0000000000000000ull, // 5^6
+	0x9896800000000000ull, 0x0000000000000000ull, // 5^7
+	0xbebc200000000000ull, 0x0000000000000000ull, // 5^8
+	0xee6b280000000000ull, 0x0000000000000000ull, // 5^9
+	0x9502f90000000000ull, 0x0000000000000000ull, // 5^10
+	0xba43b74000000000ull, 0x0000000000000000ull, // 5^11
+	0xe8d4a51000000000ull, 0x0000000000000000ull, // 5^12
+	0x9184e72a00000000ull, 0x0000000000000000ull, // 5^13
+	0xb5e620f480000000ull, 0x0000000000000000ull, // 5^14
+	0xe35fa931a0000000ull, 0x0000000000000000ull, // 5^15
+	0x8e1bc9bf04000000ull, 0x0000000000000000ull, // 5^16
+	0xb1a2bc2ec5000000ull, 0x0000000000000000ull, // 5^17
+	0xde0b6b3a76400000ull, 0x0000000000000000ull, // 5^18
+	0x8ac7230489e80000ull, 0x0000000000000000ull, // 5^19
+	0xad78ebc5ac620000ull, 0x0000000000000000ull, // 5^20
+	0xd8d726b7177a8000ull, 0x0000000000000000ull, // 5^21
+	0x878678326eac9000ull, 0x0000000000000000ull, // 5^22
+	0xa968163f0a57b400ull, 0x0000000000000000ull, // 5^23
+	0xd3c21bcecceda100ull, 0x0000000000000000ull, // 5^24
+	0x84595161401484a0ull, 0x0000000000000000ull, // 5^25
+	0xa56fa5b99019a5c8ull, 0x0000000000000000ull, // 5^26
+	0xcecb8f27f4200f3aull, 0x0000000000000000ull, // 5^27
+	0x813f3978f8940984ull, 0x4000000000000000ull, // 5^28
+	0xa18f07d736b90be5ull, 0x5000000000000000ull, // 5^29
+	0xc9f2c9cd04674edeull, 0xa400000000000000ull, // 5^30
+	0xfc6f7c4045812296ull, 0x4d00000000000000ull, // 5^31
+	0x9dc5ada82b70b59dull, 0xf020000000000000ull, // 5^32
+	0xc5371912364ce305ull, 0x6c28000000000000ull, // 5^33
+	0xf684df56c3e01bc6ull, 0xc732000000000000ull, // 5^34
+	0x9a130b963a6c115cull, 0x3c7f400000000000ull, // 5^35
+	0xc097ce7bc90715b3ull, 0x4b9f100000000000ull, // 5^36
+	0xf0bdc21abb48db20ull, 0x1e86d40000000000ull, // 5^37
+	0x96769950b50d88f4ull, 0x1314448000000000ull, // 5^38
+};
+
+static const f32 gFloatPowersOfTen[] = { 1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f };
+
+// Returns the float bits for w * 10^q without sign, or U32_MAX if the result is not certain
+u32 EiselLemireFloat(u64 w, i32 q)
+{
+	const u32 mantissaBits = 23;
+	const i32 minExponent = -127;
+	const u32 infiniteExponent = 0xff;
+
+	if ( w == 0 || q < FLOAT_POW5_MIN_EXPONENT ) return 0;
+	if ( q > FLOAT_POW5_MAX_EXPONENT ) return infiniteExponent << mantissaBits;
+
+	const u32 leadingZeros = CLZ64(w);
+	w <<= leadingZeros;
+
+	// Product with 5^q, only precise enough for the top mantissaBits + 3 bits
+	const u32 index = 2 * (q - FLOAT_POW5_MIN_EXPONENT);
+	u64 low;
+	u64 high = MultiplyHigh(w, gFloatPowersOfFive[index], low);
+	const u64 precisionMask = U64_MAX >> (mantissaBits + 3);
+	if ( (high & precisionMask) == precisionMask )
+	{
+		u64 secondLow;
+		const u64 secondHigh = MultiplyHigh(w, gFloatPowersOfFive[index + 1], secondLow);
+		low += secondHigh;
+		if ( secondHigh > low ) high++;
+	}
+
+	const u32 upperBit = (u32)(high >> 63);
+	const u32 shift = upperBit + 64 - mantissaBits - 3;
+	u64 mantissa = high >> shift;
+	// floor(log2(10^q)) = floor(q * log2(10)) for |q| small, plus 63 for the w normalization
+	i32 power2 = (((152170 + 65536) * q) >> 16) + 63 + upperBit - leadingZeros - minExponent;
+
+	if ( power2 <= 0 ) // subnormal
+	{
+		if ( -power2 + 1 >= 64 ) return 0;
+		mantissa >>= -power2 + 1;
+		mantissa += mantissa & 1;
+		mantissa >>= 1;
+		power2 = mantissa < (1ull << mantissaBits) ? 0 : 1;
+		return (u32)(power2 << mantissaBits) | (u32)(mantissa & ((1ull << mantissaBits) - 1));
+	}
+
+	// Exactly halfway between two floats, which only happens for small q, rounds to even
+	if ( low <= 1 && q >= -17 && q <= 10 && (mantissa & 3) == 1 && (mantissa << shift) == high )
+	{
+		mantissa &= ~1ull;
+	}
+
+	mantissa += mantissa & 1;
+	mantissa >>= 1;
+	if ( mantissa >= (2ull << mantissaBits) )
+	{
+		mantissa = 1ull << mantissaBits;
+		power2++;
+	}
+	mantissa &= ~(1ull << mantissaBits);
+
+	if ( power2 >= (i32)infiniteExponent ) return infiniteExponent << mantissaBits;
+	return ((u32)power2 << mantissaBits) | (u32)mantissa;
+}
+
+// Accepts [+-]digits[.digits][(e|E)[+-]digits], where any suffix (like 'f') is ignored
 f32 StrToFloat(const char *str, u32 len = U32_MAX)
 {
-	i32 integer = 0;
+	const char *start = str;
+	const char *end = len == U32_MAX ? NULL : str + len;
 
 	// scan sign
-	i32 sign = 1.0f;
-	if (*str == '-') {
-		sign = -1.0f;
+	bool negative = false;
+	if ( StrNotEnd(str, end) && (*str == '-' || *str == '+') ) {
+		negative = *str == '-';
 		str++;
-		len--;
 	}
 
-	// scan integer part
-	while (*str >= '0' && *str <= '9' && len > 0) {
-		integer = (integer << 3) + (integer << 1); // x10
-		integer += *str++ - '0';
-		len--;
+	// scan integer and decimal parts, up to 19 significant digits
+	u64 w = 0;
+	i32 q = 0;
+	u32 digitsCount = 0;
+	bool truncated = false;
+	while ( StrNotEnd(str, end) && *str == '0' ) str++;
+	u64 chunk;
+	while ( digitsCount <= 11 && LoadEightDigits(str, end, chunk) ) {
+		w = w * 100000000 + ParseEightDigits(chunk);
+		digitsCount += 8;
+		str += 8;
+	}
+	while ( StrIsDigit(str, end) ) {
+		if ( digitsCount < 19 ) {
+			w = w * 10 + (*str - '0');
+			digitsCount++;
+		} else {
+			truncated |= *str != '0';
+			q++;
+		}
+		str++;
+	}
+	if ( StrNotEnd(str, end) && *str == '.' ) {
+		str++;
+		if ( digitsCount == 0 ) {
+			while ( StrNotEnd(str, end) && *str == '0' ) { str++; q--; }
+		}
+		while ( digitsCount <= 11 && LoadEightDigits(str, end, chunk) ) {
+			w = w * 100000000 + ParseEightDigits(chunk);
+			digitsCount += 8;
+			q -= 8;
+			str += 8;
+		}
+		while ( StrIsDigit(str, end) ) {
+			if ( digitsCount < 19 ) {
+				w = w * 10 + (*str - '0');
+				digitsCount++;
+				q--;
+			} else {
+				truncated |= *str != '0';
+			}
+			str++;
+		}
 	}
 
-	switch (*str++) {
-		case '.': break;
-		default: return integer;
+	// scan exponent
+	if ( StrNotEnd(str, end) && (*str == 'e' || *str == 'E') ) {
+		const char *exponentStr = str + 1;
+		bool negativeExponent = false;
+		if ( StrNotEnd(exponentStr, end) && (*exponentStr == '-' || *exponentStr == '+') ) {
+			negativeExponent = *exponentStr == '-';
+			exponentStr++;
+		}
+		if ( StrIsDigit(exponentStr, end) ) {
+			i32 exponent = 0;
+			while ( StrIsDigit(exponentStr, end) ) {
+				if ( exponent < 100000 ) exponent = exponent * 10 + (*exponentStr - '0');
+				exponentStr++;
+			}
+			q += negativeExponent ? -exponent : exponent;
+			str = exponentStr;
+		}
 	}
-	len--;
 
-	// scan decimal part
-	u32 tenPower = 1;
-	while (*str >= '0' && *str <= '9' && len > 0) {
-		tenPower = (tenPower << 3) + (tenPower << 1);
-		integer = (integer << 3) + (integer << 1); // x10
-		integer += *str++ - '0';
-		len--;
+	union { f32 value; u32 bits; } result;
+	if ( !truncated && w <= (1u << 24) && q >= -10 && q <= 10 )
+	{
+		result.value = (f32)w;
+		result.value = q < 0 ? result.value / gFloatPowersOfTen[-q] : result.value * gFloatPowersOfTen[q];
+	}
+	else
+	{
+		result.bits = EiselLemireFloat(w, q);
+		if ( truncated && result.bits != EiselLemireFloat(w + 1, q) )
+		{
+			// Too close to call with 19 digits, and numbers that long are rare
+			const u32 size = (u32)(str - start);
+			char buffer[256];
+			if ( len == U32_MAX )
+			{
+				return strtof(start, NULL);
+			}
+			else if ( size < sizeof(buffer) )
+			{
+				for (u32 i = 0; i < size; ++i) buffer[i] = start[i];
+				buffer[size] = 0;
+				return strtof(buffer, NULL);
+			}
+		}
 	}
 
-	const float value = sign * integer / (f32)tenPower;
-	return value;
+	const f32 value = result.value;
+	return negative ? -value : value;
 }
 
 f32 StrToFloat(const String &s)
@@ -518,982 +873,2845 @@ u32 HashStringFNV(const char *data, u32 prime = TOOLS_HASH_FNV_SEED)
 	return hash;
 }
 
+// Hash64 follows wyhash (final version 4), which reads 16 bytes per step, or 48 bytes per step
+// in three independent lanes for longer inputs, and mixes them with 64x64->128 multiplications.
+// FNV stays for CRCs whose values are already known elsewhere.
+// https://github.com/wangyi-fudan/wyhash
 
+#define HASH_SECRET0 0x2d358dccaa6c78a5ull
+#define HASH_SECRET1 0x8bb84b93962eacc9ull
+#define HASH_SECRET2 0x4b33a62ed433d4a3ull
+#define HASH_SECRET3 0x4d5a2da51de1aa47ull
+#define HASH_STRIPE_SIZE 48
 
-////////////////////////////////////////////////////////////////////////////////////////////////////
-// Memory
-
-#if PLATFORM_LINUX || PLATFORM_ANDROID || PLATFORM_APPLE
-
-void* AllocateVirtualMemory(u32 size)
+u64 HashMix(u64 a, u64 b)
 {
-	void* baseAddress = 0;
-	i32 prot = PROT_READ | PROT_WRITE;
-	i32 flags = MAP_PRIVATE | MAP_ANONYMOUS;
-	i32 fd = -1;
-	off_t offset = 0;
-	void *allocatedMemory = mmap(baseAddress, size, prot, flags, fd, offset);
-	ASSERT( allocatedMemory != MAP_FAILED && "Failed to allocate memory." );
-	return allocatedMemory;
+	u64 low;
+	const u64 high = MultiplyHigh(a, b, low);
+	return low ^ high;
 }
 
-#elif PLATFORM_WINDOWS
+u64 HashRead8(const byte *p)
+{
+	u64 value;
+	memcpy(&value, p, sizeof(value));
+	return value;
+}
 
-void* AllocateVirtualMemory(u32 size)
+u64 HashRead4(const byte *p)
 {
-	void *data = VirtualAlloc(0, size, MEM_RESERVE|MEM_COMMIT, PAGE_READWRITE);
-	return data;
+	u32 value;
+	memcpy(&value, p, sizeof(value));
+	return value;
 }
 
-#endif
+u64 HashSeed(u64 seed)
+{
+	return seed ^ HashMix(seed ^ HASH_SECRET0, HASH_SECRET1);
+}
 
-void MemSet(void *ptr, u32 size, byte value)
+void HashStripe(u64 lanes[3], const byte *p)
 {
-	byte *bytePtr = (byte*)ptr;
-	while (size-- > 0) *bytePtr++ = value;
+	lanes[0] = HashMix(HashRead8(p) ^ HASH_SECRET1, HashRead8(p + 8) ^ lanes[0]);
+	lanes[1] = HashMix(HashRead8(p + 16) ^ HASH_SECRET2, HashRead8(p + 24) ^ lanes[1]);
+	lanes[2] = HashMix(HashRead8(p + 32) ^ HASH_SECRET3, HashRead8(p + 40) ^ lanes[2]);
 }
 
-void MemCopy(void *dst, const void *src, u32 size)
+u64 HashFinal(u64 a, u64 b, u64 seed, u64 size)
 {
-	const byte *pSrc = (byte*) src;
-	const byte *pEnd = pSrc + size;
-	byte *pDst = (byte*) dst;
-	while (pSrc != pEnd) *pDst++ = *pSrc++;
+	u64 low;
+	const u64 high = MultiplyHigh(a ^ HASH_SECRET1, b ^ seed, low);
+	return HashMix(low ^ HASH_SECRET0 ^ size, high ^ HASH_SECRET1);
 }
 
-i32 MemCompare(const void *a, const void *b, u32 size)
+// Up to 16 bytes, read as overlapping 4-byte words
+u64 HashShort(u64 seed, const byte *p, u64 size)
+{
+	u64 a = 0;
+	u64 b = 0;
+	if ( size >= 4 ) {
+		const u64 offset = (size >> 3) << 2;
+		a = (HashRead4(p) << 32) | HashRead4(p + offset);
+		b = (HashRead4(p + size - 4) << 32) | HashRead4(p + size - 4 - offset);
+	} else if ( size > 0 ) {
+		a = ((u64)p[0] << 16) | ((u64)p[size >> 1] << 8) | p[size - 1];
+	}
+	return HashFinal(a, b, seed, size);
+}
+
+// Last 1 to 48 bytes of an input longer than 16 bytes. The last 16 bytes are read ending at
+// the end, so up to 15 bytes before p may be read again.
+u64 HashLong(u64 seed, const byte *p, u64 remaining, u64 size)
 {
-	const byte *pA = (const byte*) a;
-	const byte *pB = (const byte*) b;
-	const byte *pEnd = pA + size;
-	while (pA != pEnd) {
-		const byte valueA = *pA++;
-		const byte valueB = *pB++;
-		if (valueA != valueB) {
-			return valueA - valueB;
-		}
+	while ( remaining > 16 ) {
+		seed = HashMix(HashRead8(p) ^ HASH_SECRET1, HashRead8(p + 8) ^ seed);
+		p += 16;
+		remaining -= 16;
 	}
-	return 0;
+	return HashFinal(HashRead8(p + remaining - 16), HashRead8(p + remaining - 8), seed, size);
 }
 
+u64 Hash64(const void *data, u64 size, u64 seed = 0)
+{
+	const byte *p = (const byte*)data;
+	seed = HashSeed(seed);
+	if ( size <= 16 ) {
+		return HashShort(seed, p, size);
+	}
+
+	u64 remaining = size;
+	if ( remaining > HASH_STRIPE_SIZE ) {
+		u64 lanes[3] = { seed, seed, seed };
+		do {
+			HashStripe(lanes, p);
+			p += HASH_STRIPE_SIZE;
+			remaining -= HASH_STRIPE_SIZE;
+		} while ( remaining > HASH_STRIPE_SIZE );
+		seed = lanes[0] ^ lanes[1] ^ lanes[2];
+	}
+	return HashLong(seed, p, remaining, size);
+}
 
+u64 HashString64(const char *str, u64 seed = 0)
+{
+	return Hash64(str, StrLen(str), seed);
+}
 
-////////////////////////////////////////////////////////////////////////////////////////////////////
-// Arena
+// Streaming version of Hash64, giving the same hash for the same bytes however they are split.
+// Stripes are only mixed once more bytes come after them, as the last ones are mixed apart.
 
-struct Arena
+struct HashState
 {
-	byte* base;
-	u32 used;
-	u32 size;
+	u64 lanes[3];
+	u64 size;
+	byte buffer[16 + HASH_STRIPE_SIZE]; // 16 bytes before the pending ones, then the pending ones
+	u32 pendingSize;
 };
 
-Arena MakeArena(byte* base, u32 size)
+HashState HashBegin(u64 seed = 0)
 {
-	ASSERT(base != NULL && "MakeArena needs a non-null base pointer.");
-	ASSERT(size > 0 && "MakeArena needs a greater-than-zero size.");
-	Arena arena = {};
-	arena.base = base;
-	arena.size = size;
-	arena.used = 0;
-	return arena;
+	HashState state = {};
+	seed = HashSeed(seed);
+	state.lanes[0] = state.lanes[1] = state.lanes[2] = seed;
+	return state;
 }
 
-Arena MakeSubArena(Arena &arena, u32 size)
+void HashUpdate(HashState &state, const void *data, u64 size)
 {
-	ASSERT(arena.used + size <= arena.size && "MakeSubArena of bounds of the memory arena.");
-	Arena subarena = {};
-	subarena.base = arena.base + arena.used;
-	subarena.size = size;
-	subarena.used = 0;
-	return subarena;
+	const byte *p = (const byte*)data;
+	byte *pending = state.buffer + 16;
+	state.size += size;
+
+	while ( size > 0 )
+	{
+		if ( state.pendingSize == HASH_STRIPE_SIZE )
+		{
+			HashStripe(state.lanes, pending);
+			memcpy(state.buffer, pending + HASH_STRIPE_SIZE - 16, 16);
+			state.pendingSize = 0;
+		}
+
+		if ( state.pendingSize == 0 && size > HASH_STRIPE_SIZE )
+		{
+			do {
+				HashStripe(state.lanes, p);
+				p += HASH_STRIPE_SIZE;
+				size -= HASH_STRIPE_SIZE;
+			} while ( size > HASH_STRIPE_SIZE );
+			memcpy(state.buffer, p - 16, 16);
+		}
+
+		const u64 free = HASH_STRIPE_SIZE - state.pendingSize;
+		const u32 count = (u32)(size < free ? size : free);
+		memcpy(pending + state.pendingSize, p, count);
+		state.pendingSize += count;
+		p += count;
+		size -= count;
+	}
 }
 
-Arena MakeSubArena(Arena &arena)
+u64 HashEnd(const HashState &state)
 {
-	u32 remainingSize = arena.size - arena.used;
-	Arena subarena = MakeSubArena(arena, remainingSize);
-	return subarena;
+	const byte *pending = state.buffer + 16;
+	if ( state.size <= 16 ) {
+		return HashShort(state.lanes[0], pending, state.size);
+	}
+
+	const u64 seed = state.lanes[0] ^ state.lanes[1] ^ state.lanes[2];
+	return HashLong(seed, pending, state.pendingSize, state.size);
 }
 
-byte* PushSize(Arena &arena, u32 size)
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Memory
+
+// Reserved memory only takes address space, and its pages must be committed before use.
+// Decommitted pages give their physical memory back to the OS but stay reserved.
+
+#if PLATFORM_LINUX || PLATFORM_ANDROID || PLATFORM_APPLE
+
+void* AllocateVirtualMemory(u64 size)
 {
-	ASSERT(arena.used + size <= arena.size && "PushSize of bounds of the memory arena.");
-	byte* head = arena.base + arena.used;
-	arena.used += size;
-	return head;
+	void* baseAddress = 0;
+	i32 prot = PROT_READ | PROT_WRITE;
+	i32 flags = MAP_PRIVATE | MAP_ANONYMOUS;
+	i32 fd = -1;
+	off_t offset = 0;
+	void *allocatedMemory = mmap(baseAddress, size, prot, flags, fd, offset);
+	ASSERT( allocatedMemory != MAP_FAILED && "Failed to allocate memory." );
+	return allocatedMemory;
 }
 
-byte* PushZeroSize(Arena &arena, u32 size)
+void FreeVirtualMemory(void *address, u64 size)
 {
-	byte *bytes = PushSize(arena, size);
-	MemSet(bytes, size, 0);
-	return bytes;
+	munmap(address, size);
 }
 
-char *PushStringN(Arena &arena, const char *str, u32 len)
+void* ReserveVirtualMemory(u64 size)
 {
-	char *bytes = (char*)PushSize(arena, len+1);
-	MemCopy(bytes, str, len);
-	bytes[len] = 0;
-	return bytes;
+	void *reservedMemory = mmap(0, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	ASSERT( reservedMemory != MAP_FAILED && "Failed to reserve memory." );
+	return reservedMemory;
 }
 
-void ResetArena(Arena &arena)
+bool CommitVirtualMemory(void *address, u64 size)
 {
-	// This tells the OS we don't need these pages
-	//madvise(arena.base, arena.size, MADV_DONTNEED);
-	arena.used = 0;
+	const bool committed = mprotect(address, size, PROT_READ | PROT_WRITE) == 0;
+	return committed;
 }
 
-void PrintArenaUsage(Arena &arena)
+void DecommitVirtualMemory(void *address, u64 size)
 {
-	LOG(Info, "Memory Arena Usage:\n");
-	LOG(Info, "- size: %u B / %u kB\n", arena.size, arena.size/1024);
-	LOG(Info, "- used: %u B / %u kB\n", arena.used, arena.used/1024);
+	madvise(address, size, MADV_DONTNEED);
+	mprotect(address, size, PROT_NONE);
 }
 
-#define ZeroStruct( pointer ) MemSet(pointer, sizeof(*pointer), 0)
-#define PushStruct( arena, struct_type ) (struct_type*)PushSize(arena, sizeof(struct_type))
-#define PushArray( arena, type, count ) (type*)PushSize(arena, sizeof(type) * count)
-#define PushZeroStruct( arena, struct_type ) (struct_type*)PushZeroSize(arena, sizeof(struct_type))
-#define PushZeroArray( arena, type, count ) (type*)PushZeroSize(arena, sizeof(type) * count)
-
-
-
-////////////////////////////////////////////////////////////////////////////////////////////////////
-// String interning
+#elif PLATFORM_WINDOWS
 
-struct StringIntern
+void* AllocateVirtualMemory(u64 size)
 {
-	char *str;
-	u32 hash;
-};
+	void *data = VirtualAlloc(0, size, MEM_RESERVE|MEM_COMMIT, PAGE_READWRITE);
+	return data;
+}
 
-struct StringInterningNode
+void FreeVirtualMemory(void *address, u64 size)
 {
-	StringIntern stringIntern;
-	StringInterningNode *next;
-};
+	VirtualFree(address, 0, MEM_RELEASE);
+}
 
-struct StringInterningTable
+void* ReserveVirtualMemory(u64 size)
 {
-	StringInterningNode* bins[1024];
-};
+	void *data = VirtualAlloc(0, size, MEM_RESERVE, PAGE_NOACCESS);
+	ASSERT( data != NULL && "Failed to reserve memory." );
+	return data;
+}
 
-struct StringInterning
+bool CommitVirtualMemory(void *address, u64 size)
 {
-	Arena *arena;
-	StringInterningTable *table;
-};
+	const bool committed = VirtualAlloc(address, size, MEM_COMMIT, PAGE_READWRITE) != NULL;
+	return committed;
+}
 
-StringInterning StringInterningCreate(Arena *arena)
+void DecommitVirtualMemory(void *address, u64 size)
 {
-	StringInterning interning = {
-		.arena = arena,
-		.table = PushZeroStruct(*arena, StringInterningTable),
-	};
-	return interning;
+	VirtualFree(address, size, MEM_DECOMMIT);
 }
 
-const char *MakeStringIntern(StringInterning *context, const char *str, u32 len)
-{
-	ASSERT(context && context->table);
-	const u32 hash = HashFNV(str, len);
-	const u32 index = hash % ARRAY_COUNT(context->table->bins);
+#endif
 
-	StringInterningNode *next = NULL;
+// MemSet, MemCopy and MemCompare go through memory in blocks as wide as the SIMD registers
+// (TOOLS_USE_SIMD), or 64-bit words otherwise. The first and last blocks are unaligned and
+// overlap the aligned ones in between, so there are no byte loops but for sizes below a
+// word. Sets and copies beyond TOOLS_MEMORY_STREAM_SIZE bypass the caches, they would only
+// evict everything else. Copied ranges must not overlap.
 
-	if (context->table->bins[index])
-	{
-		StringInterningNode *node = context->table->bins[index];
-		while (node)
-		{
-			if (node->stringIntern.hash == hash) // same hash?
-			{
-				if (StrEq(node->stringIntern.str, str)) // same string?
-				{
-					return node->stringIntern.str; // found!
-				}
-			}
-			node = node->next; // collision! keep searching...
-		}
-		next = context->table->bins[index];
-	}
+#ifndef TOOLS_USE_SIMD
+#define TOOLS_USE_SIMD 1
+#endif
 
-	// No coincidence found, insert a new node
-	StringInterningNode *node = PushZeroStruct(*(context->arena), StringInterningNode);
-	node->stringIntern.str = PushStringN(*(context->arena), str, len);
-	node->stringIntern.hash = hash;
-	node->next = next;
-	context->table->bins[index] = node;
-	return node->stringIntern.str;
-}
+#define TOOLS_MEMORY_STREAM_SIZE MB(4)
 
-const char *MakeStringIntern(StringInterning *context, const char *str)
-{
-	const u32 len = StrLen(str);
-	const char *internStr = MakeStringIntern(context, str, len);
-	return internStr;
-}
+#if !TOOLS_USE_SIMD
+#elif defined(__AVX2__)
+#	define TOOLS_SIMD_AVX2 1
+#	include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#	define TOOLS_SIMD_SSE2 1
+#	include <emmintrin.h>
+#endif
 
+// Unaligned words that may alias anything
+#if PLATFORM_WINDOWS
+typedef u64 MemoryWord;
+#else
+typedef u64 __attribute__((may_alias, aligned(1))) MemoryWord;
+#endif
 
+#if TOOLS_SIMD_AVX2
 
-////////////////////////////////////////////////////////////////////////////////////////////////////
-// Files
+#define MEMORY_BLOCK_SIZE 32
+#define MEMORY_BLOCK_MASK 0xffffffff
 
-struct DataChunk
+typedef __m256i MemoryBlock;
+
+MemoryBlock LoadMemoryBlock(const void *ptr) { return _mm256_loadu_si256((const __m256i*)ptr); }
+void StoreMemoryBlock(void *ptr, MemoryBlock block) { _mm256_storeu_si256((__m256i*)ptr, block); }
+void StoreAlignedMemoryBlock(void *ptr, MemoryBlock block) { _mm256_store_si256((__m256i*)ptr, block); }
+void StreamMemoryBlock(void *ptr, MemoryBlock block) { _mm256_stream_si256((__m256i*)ptr, block); }
+void EndMemoryStream() { _mm_sfence(); }
+MemoryBlock SplatMemoryBlock(byte value) { return _mm256_set1_epi8((char)value); }
+u32 EqualMemoryBlocks(MemoryBlock a, MemoryBlock b) { return (u32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b)); }
+
+#elif TOOLS_SIMD_SSE2
+
+#define MEMORY_BLOCK_SIZE 16
+#define MEMORY_BLOCK_MASK 0xffff
+
+typedef __m128i MemoryBlock;
+
+MemoryBlock LoadMemoryBlock(const void *ptr) { return _mm_loadu_si128((const __m128i*)ptr); }
+void StoreMemoryBlock(void *ptr, MemoryBlock block) { _mm_storeu_si128((__m128i*)ptr, block); }
+void StoreAlignedMemoryBlock(void *ptr, MemoryBlock block) { _mm_store_si128((__m128i*)ptr, block); }
+void StreamMemoryBlock(void *ptr, MemoryBlock block) { _mm_stream_si128((__m128i*)ptr, block); }
+void EndMemoryStream() { _mm_sfence(); }
+MemoryBlock SplatMemoryBlock(byte value) { return _mm_set1_epi8((char)value); }
+u32 EqualMemoryBlocks(MemoryBlock a, MemoryBlock b) { return (u32)_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)); }
+
+#else
+
+#define MEMORY_BLOCK_SIZE 8
+#define MEMORY_BLOCK_MASK 0xff
+
+typedef u64 MemoryBlock;
+
+MemoryBlock LoadMemoryBlock(const void *ptr) { return *(const MemoryWord*)ptr; }
+void StoreMemoryBlock(void *ptr, MemoryBlock block) { *(MemoryWord*)ptr = block; }
+void StoreAlignedMemoryBlock(void *ptr, MemoryBlock block) { *(MemoryWord*)ptr = block; }
+void StreamMemoryBlock(void *ptr, MemoryBlock block) { *(MemoryWord*)ptr = block; }
+void EndMemoryStream() {}
+MemoryBlock SplatMemoryBlock(byte value) { return 0x0101010101010101ull * value; }
+u32 EqualMemoryBlocks(MemoryBlock a, MemoryBlock b)
 {
-	union {
-		byte *bytes;
-		const char *chars;
-	};
-	u64 size;
-};
+	u32 mask = 0;
+	for (u32 i = 0; i < 8; ++i) mask |= ((a >> (8 * i)) & 0xff) == ((b >> (8 * i)) & 0xff) ? 1u << i : 0;
+	return mask;
+}
 
-bool GetFileSize(const char *filename, u64 &size)
+#endif
+
+// First byte address past ptr aligned to a block
+byte *NextAlignedMemoryBlock(const void *ptr)
 {
-	bool ok = true;
-#if PLATFORM_WINDOWS
-	WIN32_FILE_ATTRIBUTE_DATA Data;
-	if( GetFileAttributesExA(filename, GetFileExInfoStandard, &Data) )
-	{
-		size = (u64)Data.nFileSizeLow;
-		size |= (u64)Data.nFileSizeHigh << 32;
-	}
-	else
+	const u64 address = (u64)ptr;
+	return (byte*)((address + MEMORY_BLOCK_SIZE) & ~(u64)(MEMORY_BLOCK_SIZE - 1));
+}
+
+void MemSet(void *ptr, u32 size, byte value)
+{
+	byte *bytes = (byte*)ptr;
+	byte *end = bytes + size;
+
+	if ( size >= MEMORY_BLOCK_SIZE )
 	{
-		Win32ReportError();
-		ok = false;
+		const MemoryBlock block = SplatMemoryBlock(value);
+		StoreMemoryBlock(bytes, block);
+
+		byte *aligned = NextAlignedMemoryBlock(bytes);
+		if ( size >= TOOLS_MEMORY_STREAM_SIZE )
+		{
+			for (; aligned + MEMORY_BLOCK_SIZE <= end; aligned += MEMORY_BLOCK_SIZE)
+			{
+				StreamMemoryBlock(aligned, block);
+			}
+			EndMemoryStream();
+		}
+		else
+		{
+			for (; aligned + 4 * MEMORY_BLOCK_SIZE <= end; aligned += 4 * MEMORY_BLOCK_SIZE)
+			{
+				StoreAlignedMemoryBlock(aligned, block);
+				StoreAlignedMemoryBlock(aligned + MEMORY_BLOCK_SIZE, block);
+				StoreAlignedMemoryBlock(aligned + 2 * MEMORY_BLOCK_SIZE, block);
+				StoreAlignedMemoryBlock(aligned + 3 * MEMORY_BLOCK_SIZE, block);
+			}
+			for (; aligned + MEMORY_BLOCK_SIZE <= end; aligned += MEMORY_BLOCK_SIZE)
+			{
+				StoreAlignedMemoryBlock(aligned, block);
+			}
+		}
+
+		StoreMemoryBlock(end - MEMORY_BLOCK_SIZE, block);
 	}
-#elif PLATFORM_LINUX || PLATFORM_ANDROID
-	struct stat attrib;
-	if ( stat(filename, &attrib) == 0 )
+	else if ( size >= sizeof(MemoryWord) )
 	{
-		size = attrib.st_size;
+		const u64 word = 0x0101010101010101ull * value;
+		for (; bytes + sizeof(MemoryWord) < end; bytes += sizeof(MemoryWord))
+		{
+			*(MemoryWord*)bytes = word;
+		}
+		*(MemoryWord*)(end - sizeof(MemoryWord)) = word;
 	}
 	else
 	{
-		LinuxReportError("stat");
-		ok = false;
+		while (bytes != end) *bytes++ = value;
 	}
-#endif
-	return ok;
 }
 
-bool ReadEntireFile(const char *filename, void *buffer, u64 bytesToRead)
+void MemCopy(void *dst, const void *src, u32 size)
 {
-	bool ok = false;
-#if PLATFORM_WINDOWS
-	HANDLE file = CreateFileA( filename, GENERIC_READ, 0, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_READONLY, NULL );
-	if ( file == INVALID_HANDLE_VALUE  )
-	{
-		Win32ReportError();
-	}
-	else
+	const byte *pSrc = (const byte*) src;
+	byte *pDst = (byte*) dst;
+	byte *pEnd = pDst + size;
+
+	if ( size >= MEMORY_BLOCK_SIZE )
 	{
-		DWORD bytesRead = 0;
-		ok = ReadFile( file, buffer, bytesToRead, &bytesRead, NULL );
-		if ( !ok && bytesToRead == bytesRead )
+		// Loaded upfront, as the aligned blocks may overwrite it
+		const MemoryBlock last = LoadMemoryBlock(pSrc + size - MEMORY_BLOCK_SIZE);
+		StoreMemoryBlock(pDst, LoadMemoryBlock(pSrc));
+
+		byte *aligned = NextAlignedMemoryBlock(pDst);
+		pSrc += aligned - pDst;
+		if ( size >= TOOLS_MEMORY_STREAM_SIZE )
 		{
-			Win32ReportError();
+			for (; aligned + MEMORY_BLOCK_SIZE <= pEnd; aligned += MEMORY_BLOCK_SIZE, pSrc += MEMORY_BLOCK_SIZE)
+			{
+				StreamMemoryBlock(aligned, LoadMemoryBlock(pSrc));
+			}
+			EndMemoryStream();
 		}
-		CloseHandle( file );
-	}
-#elif PLATFORM_LINUX || PLATFORM_ANDROID
-	int fd = open(filename, O_RDONLY);
-	if ( fd == -1 )
-	{
-		LinuxReportError("open");
-	}
-	else
-	{
-		while ( bytesToRead > 0 )
+		else
 		{
-			u32 bytesRead = read(fd, buffer, bytesToRead);
-			if ( bytesRead > 0 )
+			for (; aligned + 4 * MEMORY_BLOCK_SIZE <= pEnd; aligned += 4 * MEMORY_BLOCK_SIZE, pSrc += 4 * MEMORY_BLOCK_SIZE)
 			{
-				bytesToRead -= bytesRead;
-				buffer = (byte*)buffer + bytesRead;
+				const MemoryBlock block0 = LoadMemoryBlock(pSrc);
+				const MemoryBlock block1 = LoadMemoryBlock(pSrc + MEMORY_BLOCK_SIZE);
+				const MemoryBlock block2 = LoadMemoryBlock(pSrc + 2 * MEMORY_BLOCK_SIZE);
+				const MemoryBlock block3 = LoadMemoryBlock(pSrc + 3 * MEMORY_BLOCK_SIZE);
+				StoreAlignedMemoryBlock(aligned, block0);
+				StoreAlignedMemoryBlock(aligned + MEMORY_BLOCK_SIZE, block1);
+				StoreAlignedMemoryBlock(aligned + 2 * MEMORY_BLOCK_SIZE, block2);
+				StoreAlignedMemoryBlock(aligned + 3 * MEMORY_BLOCK_SIZE, block3);
 			}
-			else
+			for (; aligned + MEMORY_BLOCK_SIZE <= pEnd; aligned += MEMORY_BLOCK_SIZE, pSrc += MEMORY_BLOCK_SIZE)
 			{
-				LinuxReportError("read");
-				break;
+				StoreAlignedMemoryBlock(aligned, LoadMemoryBlock(pSrc));
 			}
 		}
-		ok = (bytesToRead == 0);
-		close(fd);
+
+		StoreMemoryBlock(pEnd - MEMORY_BLOCK_SIZE, last);
+	}
+	else if ( size >= sizeof(MemoryWord) )
+	{
+		const u64 last = *(const MemoryWord*)(pSrc + size - sizeof(MemoryWord));
+		for (; pDst + sizeof(MemoryWord) < pEnd; pDst += sizeof(MemoryWord), pSrc += sizeof(MemoryWord))
+		{
+			*(MemoryWord*)pDst = *(const MemoryWord*)pSrc;
+		}
+		*(MemoryWord*)(pEnd - sizeof(MemoryWord)) = last;
+	}
+	else
+	{
+		while (pDst != pEnd) *pDst++ = *pSrc++;
 	}
-#endif
-	return ok;
 }
 
-DataChunk *PushFile( Arena& arena, const char *filename )
+i32 MemCompare(const void *a, const void *b, u32 size)
 {
-	DataChunk *file = 0;
+	const byte *pA = (const byte*) a;
+	const byte *pB = (const byte*) b;
+	const byte *pEnd = pA + size;
 
-	u64 fileSize;
-	if ( GetFileSize( filename, fileSize ) && fileSize > 0 )
+	if ( size >= MEMORY_BLOCK_SIZE )
 	{
-		Arena backupArena = arena;
-		byte *fileData = PushArray( arena, byte, fileSize + 1 );
-		if ( ReadEntireFile( filename, fileData, fileSize ) )
+		// Skips groups of equal blocks first, then finds the different block, if any. The
+		// last block overlaps the previous ones instead of going byte by byte.
+		for (; pA + 4 * MEMORY_BLOCK_SIZE <= pEnd; pA += 4 * MEMORY_BLOCK_SIZE, pB += 4 * MEMORY_BLOCK_SIZE)
 		{
-			fileData[fileSize] = 0; // final zero
-			file = PushStruct( arena, DataChunk );
-			file->bytes = fileData;
-			file->size = fileSize;
-		}
-		else
-		{
-			// TODO: Log error here?
-			arena = backupArena;
+			const u32 equalMask =
+				EqualMemoryBlocks(LoadMemoryBlock(pA), LoadMemoryBlock(pB)) &
+				EqualMemoryBlocks(LoadMemoryBlock(pA + MEMORY_BLOCK_SIZE), LoadMemoryBlock(pB + MEMORY_BLOCK_SIZE)) &
+				EqualMemoryBlocks(LoadMemoryBlock(pA + 2 * MEMORY_BLOCK_SIZE), LoadMemoryBlock(pB + 2 * MEMORY_BLOCK_SIZE)) &
+				EqualMemoryBlocks(LoadMemoryBlock(pA + 3 * MEMORY_BLOCK_SIZE), LoadMemoryBlock(pB + 3 * MEMORY_BLOCK_SIZE));
+			if ( equalMask != MEMORY_BLOCK_MASK ) break;
 		}
-	}
-
-	return file;
-}
 
-bool GetFileLastWriteTimestamp(const char* filename, u64 &ts)
-{
-	bool ok = true;
+		const byte *pLast = pEnd - MEMORY_BLOCK_SIZE;
+		for (;;)
+		{
+			if ( pA > pLast )
+			{
+				pB -= pA - pLast;
+				pA = pLast;
+			}
 
-#if PLATFORM_WINDOWS
-	union Filetime2u64 {
-		FILETIME filetime;
-		u64      u64time;
-	} conversor;
+			const u32 equalMask = EqualMemoryBlocks(LoadMemoryBlock(pA), LoadMemoryBlock(pB));
+			if ( equalMask != MEMORY_BLOCK_MASK )
+			{
+				const u32 index = CTZ(~equalMask);
+				return pA[index] - pB[index];
+			}
+			if ( pA == pLast )
+			{
+				return 0;
+			}
 
-	WIN32_FILE_ATTRIBUTE_DATA Data;
-	if( GetFileAttributesExA(filename, GetFileExInfoStandard, &Data) )
-	{
-		conversor.filetime = Data.ftLastWriteTime;
-		ts = conversor.u64time;
-	}
-	else
-	{
-		Win32ReportError();
-		ok = false;
+			pA += MEMORY_BLOCK_SIZE;
+			pB += MEMORY_BLOCK_SIZE;
+		}
 	}
-#elif PLATFORM_LINUX || PLATFORM_ANDROID
-	struct stat attrib;
-	if ( stat(filename, &attrib) == 0 )
+
+	while (pA + sizeof(MemoryWord) <= pEnd && *(const MemoryWord*)pA == *(const MemoryWord*)pB)
 	{
-		ts = attrib.st_mtime;
+		pA += sizeof(MemoryWord);
+		pB += sizeof(MemoryWord);
 	}
-	else
-	{
-		LinuxReportError("stat");
-		ok = false;
+	while (pA != pEnd) {
+		const byte valueA = *pA++;
+		const byte valueB = *pB++;
+		if (valueA != valueB) {
+			return valueA - valueB;
+		}
 	}
-#endif
-
-	return ok;
+	return 0;
 }
 
 
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
-// File paths
+// Arena
 
-#define MAX_PATH_LENGTH 512
+// Arenas made with MakeGrowableArena reserve a big address range and commit it by chunks of
+// ARENA_COMMIT_SIZE as PushSize goes beyond the committed memory. ResetArena decommits what
+// was not used since the previous reset, so a single peak doesn't stay resident forever.
 
-struct FilePath
+#define ARENA_COMMIT_SIZE KB(64)
+
+struct Arena
 {
-	char str[MAX_PATH_LENGTH];
+	byte* base;
+	u64 used;
+	u64 size;
+	u64 peak; // highest used, also across resets
+	u64 committed; // growable arenas only
+	u64 lastUsed; // growable arenas only, used before the last reset
+	Arena *parent; // growable subarenas only, commits go through it
+	bool growable;
 };
 
-FilePath MakePath(const char *relativePath)
+Arena MakeArena(byte* base, u64 size)
 {
-	FilePath path = {};
-#if PLATFORM_ANDROID
-	// TODO: Don't hardcode this path here and get it from Android API.
-	StrCat(path.str, "/sdcard/Android/data/com.tools.game/files/");
-#endif
-	StrCat(path.str, relativePath);
-	return path;
+	ASSERT(base != NULL && "MakeArena needs a non-null base pointer.");
+	ASSERT(size > 0 && "MakeArena needs a greater-than-zero size.");
+	Arena arena = {};
+	arena.base = base;
+	arena.size = size;
+	arena.used = 0;
+	arena.committed = size;
+	return arena;
 }
 
-
-
-////////////////////////////////////////////////////////////////////////////////////////////////////
-// Math
-
-struct uint2
+Arena MakeGrowableArena(u64 reserveSize)
 {
-	union { u32 x, r; };
-	union { u32 y, g; };
-};
+	ASSERT(reserveSize > 0 && "MakeGrowableArena needs a greater-than-zero size.");
+	Arena arena = {};
+	arena.base = (byte*)ReserveVirtualMemory(reserveSize);
+	arena.size = reserveSize;
+	arena.used = 0;
+	arena.committed = 0;
+	arena.growable = true;
+	return arena;
+}
 
-struct float2
+// Not for subarenas, they don't own the reservation
+void FreeGrowableArena(Arena &arena)
 {
-	union { float x, r; };
-	union { float y, g; };
-};
+	ASSERT(arena.growable);
+	FreeVirtualMemory(arena.base, arena.size);
+	arena = {};
+}
 
-struct float3
+void CommitArena(Arena &arena, u64 end)
 {
-	union { float x, r; };
-	union { float y, g; };
-	union { float z, b; };
-};
+	ASSERT(arena.growable && "Arena out of memory.");
+	u64 committed = (end + ARENA_COMMIT_SIZE - 1) & ~(u64)(ARENA_COMMIT_SIZE - 1);
+	if ( committed > arena.size ) committed = arena.size;
+	if ( arena.parent )
+	{
+		// Subarenas don't start at a page boundary, only the reservation does
+		const u64 offset = arena.base - arena.parent->base;
+		if ( offset + committed > arena.parent->committed ) CommitArena(*arena.parent, offset + committed);
+	}
+	else
+	{
+		const bool ok = CommitVirtualMemory(arena.base + arena.committed, committed - arena.committed);
+		ASSERT(ok && "Failed to commit arena memory.");
+	}
+	arena.committed = committed;
+}
 
-struct float4
+// Subarenas of growable arenas keep a pointer to their parent, which must outlive them
+Arena MakeSubArena(Arena &arena, u64 size)
 {
-	union
+	ASSERT(arena.used + size <= arena.size && "MakeSubArena of bounds of the memory arena.");
+	Arena subarena = {};
+	subarena.base = arena.base + arena.used;
+	subarena.size = size;
+	subarena.used = 0;
+	subarena.committed = size;
+	if ( arena.growable )
 	{
-		f32 vec[4];
-		struct
+		// Commits more of the parent reservation on demand
+		const u64 committed = arena.committed - arena.used;
+		subarena.committed = committed < size ? committed : size;
+		subarena.parent = &arena;
+		subarena.growable = true;
+	}
+	return subarena;
+}
+
+Arena MakeSubArena(Arena &arena)
+{
+	u64 remainingSize = arena.size - arena.used;
+	Arena subarena = MakeSubArena(arena, remainingSize);
+	return subarena;
+}
+
+byte* PushSize(Arena &arena, u64 size)
+{
+	ASSERT(arena.used + size <= arena.size && "PushSize of bounds of the memory arena.");
+	byte* head = arena.base + arena.used;
+	arena.used += size;
+	if ( arena.used > arena.committed ) CommitArena(arena, arena.used);
+	if ( arena.used > arena.peak ) arena.peak = arena.used;
+	return head;
+}
+
+byte* PushZeroSize(Arena &arena, u32 size)
+{
+	byte *bytes = PushSize(arena, size);
+	MemSet(bytes, size, 0);
+	return bytes;
+}
+
+// Pushes are not aligned, so data used by atomics, futexes or SIMD loads must use this
+byte* PushAlignedZeroSize(Arena &arena, u32 size, u32 alignment)
+{
+	const u64 misalignment = (u64)(arena.base + arena.used) & (alignment - 1);
+	if ( misalignment ) PushSize(arena, alignment - misalignment);
+	return PushZeroSize(arena, size);
+}
+
+char *PushStringN(Arena &arena, const char *str, u32 len)
+{
+	char *bytes = (char*)PushSize(arena, len+1);
+	MemCopy(bytes, str, len);
+	bytes[len] = 0;
+	return bytes;
+}
+
+void ResetArena(Arena &arena)
+{
+	// Subarenas leave decommitting to their parent
+	if ( arena.growable && !arena.parent )
+	{
+		// This tells the OS we don't need the pages used by neither of the last two cycles
+		const u64 used = arena.used > arena.lastUsed ? arena.used : arena.lastUsed;
+		const u64 keep = (used + ARENA_COMMIT_SIZE - 1) & ~(u64)(ARENA_COMMIT_SIZE - 1);
+		if ( arena.committed > keep )
 		{
-			union { float x, r; };
-			union { float y, g; };
-			union { float z, b; };
-			union { float w, a; };
-		};
-		float3 xyz;
-	};
+			DecommitVirtualMemory(arena.base + keep, arena.committed - keep);
+			arena.committed = keep;
+		}
+		arena.lastUsed = arena.used;
+	}
+	arena.used = 0;
+}
+
+void PrintArenaUsage(Arena &arena, const char *name = "Memory")
+{
+	LOG(Info, "%s Arena Usage:\n", name);
+	LOG(Info, "- size: %llu B / %llu kB\n", arena.size, arena.size/1024);
+	LOG(Info, "- used: %llu B / %llu kB\n", arena.used, arena.used/1024);
+	LOG(Info, "- peak: %llu B / %llu kB\n", arena.peak, arena.peak/1024);
+	if ( arena.growable ) {
+		LOG(Info, "- committed: %llu B / %llu kB\n", arena.committed, arena.committed/1024);
+	}
+}
+
+// Temporary arenas roll an arena back to where it was at BeginTempArena. They can nest, but
+// must end in reverse order. A temp arena that never ends just keeps its allocations, as when
+// a backtracking parser succeeds.
+
+struct TempArena
+{
+	Arena *arena;
+	u64 used;
 };
 
-struct float3x3
+TempArena BeginTempArena(Arena &arena)
 {
-	union
+	TempArena temp = { &arena, arena.used };
+	return temp;
+}
+
+void EndTempArena(TempArena &temp)
+{
+	ASSERT(temp.arena != NULL && "EndTempArena called twice.");
+	ASSERT(temp.arena->used >= temp.used && "EndTempArena out of order, an outer one already ended.");
+	temp.arena->used = temp.used;
+	temp.arena = NULL;
+}
+
+// Every thread has two scratch arenas, so functions taking an arena for their results can still
+// get scratch memory from the other one. The arena already in use, if any, goes as conflict.
+
+#define SCRATCH_ARENA_SIZE GB(1)
+
+static thread_local Arena tScratchArenas[2];
+
+TempArena BeginScratch(const Arena *conflict = NULL)
+{
+	Arena *scratch = &tScratchArenas[0];
+	if ( scratch == conflict ) scratch = &tScratchArenas[1];
+	if ( !scratch->base ) *scratch = MakeGrowableArena(SCRATCH_ARENA_SIZE);
+	return BeginTempArena(*scratch);
+}
+
+// For threads that end, the scratch reservations would stay behind otherwise
+void FreeScratchArenas()
+{
+	for (u32 i = 0; i < ARRAY_COUNT(tScratchArenas); ++i)
 	{
-		f32 mat[3][3];
-		struct
-		{
-			f32 m00, m01, m02,
-				m10, m11, m12,
-				m20, m21, m22;
-		};
-	};
+		if ( tScratchArenas[i].base ) FreeGrowableArena(tScratchArenas[i]);
+	}
+}
+
+#define ZeroStruct( pointer ) MemSet(pointer, sizeof(*pointer), 0)
+#define PushStruct( arena, struct_type ) (struct_type*)PushSize(arena, sizeof(struct_type))
+#define PushArray( arena, type, count ) (type*)PushSize(arena, sizeof(type) * count)
+#define PushZeroStruct( arena, struct_type ) (struct_type*)PushZeroSize(arena, sizeof(struct_type))
+#define PushZeroArray( arena, type, count ) (type*)PushZeroSize(arena, sizeof(type) * count)
+#define PushAlignedZeroStruct( arena, struct_type, alignment ) (struct_type*)PushAlignedZeroSize(arena, sizeof(struct_type), alignment)
+#define PushAlignedZeroArray( arena, type, count, alignment ) (type*)PushAlignedZeroSize(arena, sizeof(type) * count, alignment)
+
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Pool
+
+// Fixed-size slots recycled through an intrusive free list: free slots store the index of the
+// next free one in their first bytes. Slots that were never used come after the last used one,
+// so making a pool doesn't touch its memory. Pools made with generations also count the frees
+// of every slot, which lets PoolHandles detect they refer to a freed slot.
+
+#define POOL_NO_SLOT U32_MAX
+
+struct Pool
+{
+	byte *base;
+	u32 elementSize;
+	u32 capacity;
+	u32 used; // slots handed out at least once
+	u32 count; // slots alive
+	u32 firstFree;
+	u32 *generations; // optional
 };
 
-struct float4x4
+struct PoolHandle
 {
-	union
+	u32 index;
+	u32 generation;
+};
+
+Pool MakePool(byte *base, u32 elementSize, u32 capacity, u32 *generations = NULL)
+{
+	ASSERT(base != NULL && "MakePool needs a non-null base pointer.");
+	ASSERT(elementSize >= sizeof(u32) && "MakePool elements must fit the free list index.");
+	Pool pool = {};
+	pool.base = base;
+	pool.elementSize = elementSize;
+	pool.capacity = capacity;
+	pool.firstFree = POOL_NO_SLOT;
+	pool.generations = generations;
+	return pool;
+}
+
+Pool PushPool(Arena &arena, u32 elementSize, u32 capacity, bool withGenerations = false)
+{
+	byte *base = PushSize(arena, (u64)elementSize * capacity);
+	u32 *generations = withGenerations ? PushZeroArray(arena, u32, capacity) : NULL;
+	Pool pool = MakePool(base, elementSize, capacity, generations);
+	return pool;
+}
+
+void *PoolSlot(const Pool &pool, u32 index)
+{
+	return pool.base + (u64)index * pool.elementSize;
+}
+
+u32 PoolIndex(const Pool &pool, const void *element)
+{
+	const u64 offset = (const byte*)element - pool.base;
+	ASSERT(offset < (u64)pool.capacity * pool.elementSize && offset % pool.elementSize == 0);
+	return (u32)(offset / pool.elementSize);
+}
+
+// Returns NULL when the pool is full
+void *PoolAlloc(Pool &pool)
+{
+	u32 index = pool.firstFree;
+	if ( index != POOL_NO_SLOT )
 	{
-		f32 mat[4][4];
-		struct
-		{
-			f32 m00, m01, m02, m03,
-				m10, m11, m12, m13,
-				m20, m21, m22, m23,
-				m30, m31, m32, m33;
-		};
-	};
+		MemCopy(&pool.firstFree, PoolSlot(pool, index), sizeof(u32));
+	}
+	else if ( pool.used < pool.capacity )
+	{
+		index = pool.used++;
+	}
+	else
+	{
+		return NULL;
+	}
+	pool.count++;
+	return PoolSlot(pool, index);
+}
+
+void *PoolZeroAlloc(Pool &pool)
+{
+	void *element = PoolAlloc(pool);
+	if ( element ) MemSet(element, pool.elementSize, 0);
+	return element;
+}
+
+void PoolFree(Pool &pool, void *element)
+{
+	ASSERT(pool.count > 0);
+	const u32 index = PoolIndex(pool, element);
+	if ( pool.generations ) pool.generations[index]++;
+	MemCopy(element, &pool.firstFree, sizeof(u32));
+	pool.firstFree = index;
+	pool.count--;
+}
+
+void ResetPool(Pool &pool)
+{
+	// Generations stay, so that old handles are still detected
+	if ( pool.generations )
+	{
+		for (u32 i = 0; i < pool.used; ++i) pool.generations[i]++;
+	}
+	pool.used = 0;
+	pool.count = 0;
+	pool.firstFree = POOL_NO_SLOT;
+}
+
+PoolHandle PoolGetHandle(const Pool &pool, const void *element)
+{
+	ASSERT(pool.generations && "PoolHandles need a pool with generations.");
+	const u32 index = PoolIndex(pool, element);
+	const PoolHandle handle = { index, pool.generations[index] };
+	return handle;
+}
+
+// Returns NULL if the slot was freed after the handle was taken
+void *PoolGet(const Pool &pool, PoolHandle handle)
+{
+	ASSERT(pool.generations && "PoolHandles need a pool with generations.");
+	ASSERT(handle.index < pool.capacity);
+	void *element = pool.generations[handle.index] == handle.generation ? PoolSlot(pool, handle.index) : NULL;
+	return element;
+}
+
+void PoolFree(Pool &pool, PoolHandle handle)
+{
+	void *element = PoolGet(pool, handle);
+	ASSERT(element != NULL && "PoolFree of a stale handle.");
+	PoolFree(pool, element);
+}
+
+#define PushStructPool( arena, struct_type, capacity ) PushPool(arena, sizeof(struct_type), capacity)
+#define PoolAllocStruct( pool, struct_type ) (struct_type*)PoolAlloc(pool)
+#define PoolZeroAllocStruct( pool, struct_type ) (struct_type*)PoolZeroAlloc(pool)
+
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Hash maps
+//
+// Open addressing with Robin Hood probing: entries displaced further from their home slot take
+// the place of closer ones, so lookups stop as soon as they pass the distance the key would have.
+// Removal shifts the following entries back instead of leaving tombstones.
+//
+// Keys are numbers (integers, handles or pointers like interned strings) or Strings, whose
+// characters are not copied and have to outlive the map. Both kinds can't be mixed in a map.
+// Values are u64, usually an index or a pointer.
+//
+// Maps made from an arena grow into it, old entries are left there. Maps made over an array
+// have a fixed capacity.
+
+#define HASH_MAP_MIN_CAPACITY 8
+
+struct HashMapEntry
+{
+	u64 key;     // The number, or a pointer to the characters of String keys
+	u64 value;
+	u32 hash;    // 0 for empty entries
+	u32 keySize; // 0 for number keys
 };
 
-static constexpr f32 Pi = 3.14159265358979323846f;
-static constexpr f32 ToRadians = Pi / 180.0f;
-static constexpr f32 ToDegrees = 180.0f / Pi;
+struct HashMap
+{
+	HashMapEntry *entries;
+	u32 count;
+	u32 capacity; // power of two
+	Arena *arena; // NULL for fixed capacity
+};
 
-float3 Float3(float value)
+u32 HashNumber(u64 bits)
 {
-	const float3 res = {value, value, value};
-	return res;
+	// Finalizer of MurmurHash3, enough to spread pointers and sequential indices
+	bits ^= bits >> 33;
+	bits *= 0xff51afd7ed558ccdull;
+	bits ^= bits >> 33;
+	bits *= 0xc4ceb9fe1a85ec53ull;
+	bits ^= bits >> 33;
+	const u32 hash = (u32)bits;
+	return hash ? hash : 1;
 }
 
-float3 Float3(float x, float y, float z)
+u32 HashMapStringHash(String key)
 {
-	const float3 res = {x, y, z};
-	return res;
+	const u32 hash = (u32)Hash64(key.str, key.size);
+	return hash ? hash : 1;
 }
 
-float4 Float4(float3 xyz, f32 w)
+HashMap MakeHashMap(Arena &arena, u32 expectedCount = 0)
 {
-	const float4 res = { xyz.x, xyz.y, xyz.z, w };
-	return res;
+	u32 capacity = HASH_MAP_MIN_CAPACITY;
+	while ( 4 * expectedCount > 3 * capacity ) capacity *= 2;
+
+	HashMap map = {};
+	map.entries = PushZeroArray(arena, HashMapEntry, capacity);
+	map.capacity = capacity;
+	map.arena = &arena;
+	return map;
 }
 
-float3x3 Float3x3(const float4x4 &m)
+HashMap MakeHashMap(HashMapEntry *entries, u32 capacity)
 {
-	const float3x3 res = {
-		m.m00, m.m01, m.m02,
-		m.m10, m.m11, m.m12,
-		m.m20, m.m21, m.m22,
-	};
-	return res;
+	ASSERT( capacity > 0 && (capacity & (capacity - 1)) == 0 && "HashMap capacity must be a power of two." );
+	MemSet(entries, capacity * sizeof(HashMapEntry), 0);
+
+	HashMap map = {};
+	map.entries = entries;
+	map.capacity = capacity;
+	return map;
 }
 
-float4x4 Float4x4(const float3x3 &m)
+void ResetHashMap(HashMap &map)
 {
-	const float4x4 res = {
-		m.m00, m.m01, m.m02, 0.0f,
-		m.m10, m.m11, m.m12, 0.0f,
-		m.m20, m.m21, m.m22, 0.0f,
-		0.0f, 0.0f, 0.0f, 1.0f,
-	};
-	return res;
+	MemSet(map.entries, map.capacity * sizeof(HashMapEntry), 0);
+	map.count = 0;
 }
 
-f32 Sin(f32 value)
+u32 HashMapProbeDistance(const HashMap &map, u32 index, u32 hash)
 {
-	const f32 res = ::sinf(value);
-	return res;
+	return (index - hash) & (map.capacity - 1);
 }
 
-f32 Cos(f32 value)
+bool HashMapKeysEqual(const HashMapEntry &entry, u64 key, u32 keySize, bool stringKey)
 {
-	const f32 res = ::cosf(value);
-	return res;
+	if ( entry.keySize != keySize ) return false;
+	return stringKey ? MemCompare((const void*)entry.key, (const void*)key, keySize) == 0 : entry.key == key;
 }
 
-f32 Tan(f32 value)
+// Returns the index of the entry, or U32_MAX if missing
+u32 HashMapFindIndex(const HashMap &map, u64 key, u32 keySize, bool stringKey, u32 hash)
 {
-	const f32 res = ::tanf(value);
-	return res;
+	if ( map.count == 0 )
+	{
+		return U32_MAX;
+	}
+
+	const u32 mask = map.capacity - 1;
+	for (u32 index = hash & mask, distance = 0; ; index = (index + 1) & mask, ++distance)
+	{
+		const HashMapEntry &entry = map.entries[index];
+		if ( entry.hash == 0 || HashMapProbeDistance(map, index, entry.hash) < distance )
+		{
+			return U32_MAX;
+		}
+		if ( entry.hash == hash && HashMapKeysEqual(entry, key, keySize, stringKey) )
+		{
+			return index;
+		}
+	}
+}
+
+void HashMapInsertEntry(HashMap &map, HashMapEntry entry, bool stringKey);
+
+void GrowHashMap(HashMap &map)
+{
+	ASSERT( map.arena != NULL && "HashMap of fixed capacity is full." );
+
+	HashMapEntry *entries = map.entries;
+	const u32 capacity = map.capacity;
+
+	map.capacity = capacity ? capacity * 2 : HASH_MAP_MIN_CAPACITY;
+	map.entries = PushZeroArray(*map.arena, HashMapEntry, map.capacity);
+	map.count = 0;
+
+	for (u32 i = 0; i < capacity; ++i)
+	{
+		if ( entries[i].hash )
+		{
+			// Keys are already unique, so they never need to be compared here
+			HashMapInsertEntry(map, entries[i], false);
+		}
+	}
+}
+
+void HashMapInsertEntry(HashMap &map, HashMapEntry entry, bool stringKey)
+{
+	// Keep the load factor under 3/4. Updates add no entry, so a full map can still take them.
+	if ( (map.count + 1) * 4 > map.capacity * 3 )
+	{
+		const u32 index = HashMapFindIndex(map, entry.key, entry.keySize, stringKey, entry.hash);
+		if ( index != U32_MAX )
+		{
+			map.entries[index].value = entry.value;
+			return;
+		}
+		GrowHashMap(map);
+	}
+
+	const u32 mask = map.capacity - 1;
+	for (u32 index = entry.hash & mask, distance = 0; ; index = (index + 1) & mask, ++distance)
+	{
+		HashMapEntry &slot = map.entries[index];
+		if ( slot.hash == 0 )
+		{
+			slot = entry;
+			map.count++;
+			return;
+		}
+		if ( slot.hash == entry.hash && HashMapKeysEqual(slot, entry.key, entry.keySize, stringKey) )
+		{
+			slot.value = entry.value;
+			return;
+		}
+
+		const u32 slotDistance = HashMapProbeDistance(map, index, slot.hash);
+		if ( slotDistance < distance )
+		{
+			// Take the place of the richer entry and keep looking for a slot for it
+			const HashMapEntry displaced = slot;
+			slot = entry;
+			entry = displaced;
+			distance = slotDistance;
+		}
+	}
+}
+
+bool HashMapRemoveIndex(HashMap &map, u32 index)
+{
+	if ( index == U32_MAX )
+	{
+		return false;
+	}
+
+	const u32 mask = map.capacity - 1;
+	for (u32 next = (index + 1) & mask; ; index = next, next = (next + 1) & mask)
+	{
+		const HashMapEntry &entry = map.entries[next];
+		if ( entry.hash == 0 || HashMapProbeDistance(map, next, entry.hash) == 0 )
+		{
+			break;
+		}
+		map.entries[index] = entry;
+	}
+
+	map.entries[index].hash = 0;
+	map.count--;
+	return true;
+}
+
+// Return a pointer to the value, or NULL if the key is missing
+u64 *HashMapFind(const HashMap &map, u64 key)
+{
+	const u32 index = HashMapFindIndex(map, key, 0, false, HashNumber(key));
+	return index != U32_MAX ? &map.entries[index].value : NULL;
+}
+
+u64 *HashMapFind(const HashMap &map, String key)
+{
+	const u32 index = HashMapFindIndex(map, (u64)key.str, key.size, true, HashMapStringHash(key));
+	return index != U32_MAX ? &map.entries[index].value : NULL;
+}
+
+// Replace the value if the key is already there
+void HashMapInsert(HashMap &map, u64 key, u64 value)
+{
+	const HashMapEntry entry = { key, value, HashNumber(key), 0 };
+	HashMapInsertEntry(map, entry, false);
+}
+
+void HashMapInsert(HashMap &map, String key, u64 value)
+{
+	const HashMapEntry entry = { (u64)key.str, value, HashMapStringHash(key), key.size };
+	HashMapInsertEntry(map, entry, true);
+}
+
+bool HashMapRemove(HashMap &map, u64 key)
+{
+	const u32 index = HashMapFindIndex(map, key, 0, false, HashNumber(key));
+	return HashMapRemoveIndex(map, index);
+}
+
+bool HashMapRemove(HashMap &map, String key)
+{
+	const u32 index = HashMapFindIndex(map, (u64)key.str, key.size, true, HashMapStringHash(key));
+	return HashMapRemoveIndex(map, index);
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Files
+
+struct DataChunk
+{
+	union {
+		byte *bytes;
+		const char *chars;
+	};
+	u64 size;
+};
+
+bool GetFileSize(const char *filename, u64 &size)
+{
+	bool ok = true;
+#if PLATFORM_WINDOWS
+	WIN32_FILE_ATTRIBUTE_DATA Data;
+	if( GetFileAttributesExA(filename, GetFileExInfoStandard, &Data) )
+	{
+		size = (u64)Data.nFileSizeLow;
+		size |= (u64)Data.nFileSizeHigh << 32;
+	}
+	else
+	{
+		Win32ReportError();
+		ok = false;
+	}
+#elif PLATFORM_LINUX || PLATFORM_ANDROID
+	struct stat attrib;
+	if ( stat(filename, &attrib) == 0 )
+	{
+		size = attrib.st_size;
+	}
+	else
+	{
+		LinuxReportError("stat");
+		ok = false;
+	}
+#endif
+	return ok;
+}
+
+bool ReadEntireFile(const char *filename, void *buffer, u64 bytesToRead)
+{
+	bool ok = false;
+#if PLATFORM_WINDOWS
+	HANDLE file = CreateFileA( filename, GENERIC_READ, 0, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_READONLY, NULL );
+	if ( file == INVALID_HANDLE_VALUE  )
+	{
+		Win32ReportError();
+	}
+	else
+	{
+		DWORD bytesRead = 0;
+		ok = ReadFile( file, buffer, bytesToRead, &bytesRead, NULL );
+		if ( !ok && bytesToRead == bytesRead )
+		{
+			Win32ReportError();
+		}
+		CloseHandle( file );
+	}
+#elif PLATFORM_LINUX || PLATFORM_ANDROID
+	int fd = open(filename, O_RDONLY);
+	if ( fd == -1 )
+	{
+		LinuxReportError("open");
+	}
+	else
+	{
+		while ( bytesToRead > 0 )
+		{
+			u32 bytesRead = read(fd, buffer, bytesToRead);
+			if ( bytesRead > 0 )
+			{
+				bytesToRead -= bytesRead;
+				buffer = (byte*)buffer + bytesRead;
+			}
+			else
+			{
+				LinuxReportError("read");
+				break;
+			}
+		}
+		ok = (bytesToRead == 0);
+		close(fd);
+	}
+#endif
+	return ok;
+}
+
+bool WriteEntireFile(const char *filename, const void *buffer, u64 bytesToWrite)
+{
+	bool ok = false;
+#if PLATFORM_WINDOWS
+	HANDLE file = CreateFileA( filename, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL );
+	if ( file == INVALID_HANDLE_VALUE  )
+	{
+		Win32ReportError();
+	}
+	else
+	{
+		DWORD bytesWritten = 0;
+		ok = WriteFile( file, buffer, bytesToWrite, &bytesWritten, NULL ) && bytesWritten == bytesToWrite;
+		if ( !ok )
+		{
+			Win32ReportError();
+		}
+		CloseHandle( file );
+	}
+#elif PLATFORM_LINUX || PLATFORM_ANDROID
+	int fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if ( fd == -1 )
+	{
+		LinuxReportError("open");
+	}
+	else
+	{
+		while ( bytesToWrite > 0 )
+		{
+			ssize_t bytesWritten = write(fd, buffer, bytesToWrite);
+			if ( bytesWritten > 0 )
+			{
+				bytesToWrite -= bytesWritten;
+				buffer = (const byte*)buffer + bytesWritten;
+			}
+			else
+			{
+				LinuxReportError("write");
+				break;
+			}
+		}
+		ok = (bytesToWrite == 0);
+		close(fd);
+	}
+#endif
+	return ok;
+}
+
+// Maps the whole file read-only into the address space of the process.
+bool MapFile(const char *filename, DataChunk &chunk)
+{
+	bool ok = false;
+	chunk.bytes = NULL;
+	chunk.size = 0;
+
+	u64 fileSize;
+	if ( !GetFileSize(filename, fileSize) || fileSize == 0 )
+	{
+		return false;
+	}
+
+#if PLATFORM_WINDOWS
+	HANDLE file = CreateFileA( filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_READONLY, NULL );
+	if ( file == INVALID_HANDLE_VALUE )
+	{
+		Win32ReportError();
+	}
+	else
+	{
+		HANDLE mapping = CreateFileMappingA( file, NULL, PAGE_READONLY, 0, 0, NULL );
+		if ( mapping )
+		{
+			// The view keeps a reference to the mapping, so handles can be closed right away
+			chunk.bytes = (byte*)MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 );
+			ok = chunk.bytes != NULL;
+			CloseHandle( mapping );
+		}
+		if ( !ok )
+		{
+			Win32ReportError();
+		}
+		CloseHandle( file );
+	}
+#elif PLATFORM_LINUX || PLATFORM_ANDROID
+	int fd = open(filename, O_RDONLY);
+	if ( fd == -1 )
+	{
+		LinuxReportError("open");
+	}
+	else
+	{
+		void *data = mmap(NULL, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+		if ( data != MAP_FAILED )
+		{
+			chunk.bytes = (byte*)data;
+			ok = true;
+		}
+		else
+		{
+			LinuxReportError("mmap");
+		}
+		close(fd);
+	}
+#endif
+
+	if ( ok )
+	{
+		chunk.size = fileSize;
+	}
+	return ok;
+}
+
+void UnmapFile(DataChunk &chunk)
+{
+	if ( chunk.bytes )
+	{
+#if PLATFORM_WINDOWS
+		UnmapViewOfFile( chunk.bytes );
+#elif PLATFORM_LINUX || PLATFORM_ANDROID
+		munmap( chunk.bytes, chunk.size );
+#endif
+		chunk.bytes = NULL;
+		chunk.size = 0;
+	}
+}
+
+DataChunk *PushFile( Arena& arena, const char *filename )
+{
+	DataChunk *file = 0;
+
+	u64 fileSize;
+	if ( GetFileSize( filename, fileSize ) && fileSize > 0 )
+	{
+		TempArena temp = BeginTempArena( arena );
+		byte *fileData = PushArray( arena, byte, fileSize + 1 );
+		if ( ReadEntireFile( filename, fileData, fileSize ) )
+		{
+			fileData[fileSize] = 0; // final zero
+			file = PushStruct( arena, DataChunk );
+			file->bytes = fileData;
+			file->size = fileSize;
+		}
+		else
+		{
+			// TODO: Log error here?
+			EndTempArena( temp );
+		}
+	}
+
+	return file;
+}
+
+// Calls the given callback for each regular file found in the given directory (non-recursive).
+// The filename passed to the callback is the entry name, not prefixed with the directory path.
+typedef void (*DirectoryEntryCallback)(const char *filename, void *userData);
+
+bool ListDirectory(const char *dirname, DirectoryEntryCallback callback, void *userData)
+{
+	bool ok = true;
+#if PLATFORM_WINDOWS
+	char pattern[MAX_PATH];
+	snprintf(pattern, ARRAY_COUNT(pattern), "%s\\*", dirname);
+
+	WIN32_FIND_DATAA findData;
+	HANDLE find = FindFirstFileA(pattern, &findData);
+	if ( find != INVALID_HANDLE_VALUE )
+	{
+		do
+		{
+			if ( !(findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) )
+			{
+				callback(findData.cFileName, userData);
+			}
+		}
+		while ( FindNextFileA(find, &findData) );
+		FindClose(find);
+	}
+	else
+	{
+		Win32ReportError();
+		ok = false;
+	}
+#elif PLATFORM_LINUX || PLATFORM_ANDROID
+	DIR *dir = opendir(dirname);
+	if ( dir )
+	{
+		struct dirent *entry;
+		while ( (entry = readdir(dir)) != NULL )
+		{
+			// Some filesystems don't fill d_type, then stat tells
+			struct stat fileStat;
+			const bool regular = entry->d_type == DT_REG ||
+				( entry->d_type == DT_UNKNOWN && fstatat(dirfd(dir), entry->d_name, &fileStat, 0) == 0 && S_ISREG(fileStat.st_mode) );
+			if ( regular )
+			{
+				callback(entry->d_name, userData);
+			}
+		}
+		closedir(dir);
+	}
+	else
+	{
+		LinuxReportError("opendir");
+		ok = false;
+	}
+#endif
+	return ok;
+}
+
+bool GetFileLastWriteTimestamp(const char* filename, u64 &ts)
+{
+	bool ok = true;
+
+#if PLATFORM_WINDOWS
+	union Filetime2u64 {
+		FILETIME filetime;
+		u64      u64time;
+	} conversor;
+
+	WIN32_FILE_ATTRIBUTE_DATA Data;
+	if( GetFileAttributesExA(filename, GetFileExInfoStandard, &Data) )
+	{
+		conversor.filetime = Data.ftLastWriteTime;
+		ts = conversor.u64time;
+	}
+	else
+	{
+		Win32ReportError();
+		ok = false;
+	}
+#elif PLATFORM_LINUX || PLATFORM_ANDROID
+	struct stat attrib;
+	if ( stat(filename, &attrib) == 0 )
+	{
+		ts = attrib.st_mtime;
+	}
+	else
+	{
+		LinuxReportError("stat");
+		ok = false;
+	}
+#endif
+
+	return ok;
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// File paths
+
+#define MAX_PATH_LENGTH 512
+
+struct FilePath
+{
+	char str[MAX_PATH_LENGTH];
+};
+
+FilePath MakePath(const char *relativePath)
+{
+	FilePath path = {};
+#if PLATFORM_ANDROID
+	// TODO: Don't hardcode this path here and get it from Android API.
+	StrCat(path.str, "/sdcard/Android/data/com.tools.game/files/");
+#endif
+	StrCat(path.str, relativePath);
+	return path;
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Math
+
+struct uint2
+{
+	union { u32 x, r; };
+	union { u32 y, g; };
+};
+
+struct float2
+{
+	union { float x, r; };
+	union { float y, g; };
+};
+
+struct float3
+{
+	union { float x, r; };
+	union { float y, g; };
+	union { float z, b; };
+};
+
+struct float4
+{
+	union
+	{
+		f32 vec[4];
+		struct
+		{
+			union { float x, r; };
+			union { float y, g; };
+			union { float z, b; };
+			union { float w, a; };
+		};
+		float3 xyz;
+	};
+};
+
+struct float3x3
+{
+	union
+	{
+		f32 mat[3][3];
+		struct
+		{
+			f32 m00, m01, m02,
+				m10, m11, m12,
+				m20, m21, m22;
+		};
+	};
+};
+
+struct float4x4
+{
+	union
+	{
+		f32 mat[4][4];
+		struct
+		{
+			f32 m00, m01, m02, m03,
+				m10, m11, m12, m13,
+				m20, m21, m22, m23,
+				m30, m31, m32, m33;
+		};
+	};
+};
+
+static constexpr f32 Pi = 3.14159265358979323846f;
+static constexpr f32 ToRadians = Pi / 180.0f;
+static constexpr f32 ToDegrees = 180.0f / Pi;
+
+float3 Float3(float value)
+{
+	const float3 res = {value, value, value};
+	return res;
+}
+
+float3 Float3(float x, float y, float z)
+{
+	const float3 res = {x, y, z};
+	return res;
+}
+
+float4 Float4(float3 xyz, f32 w)
+{
+	const float4 res = { xyz.x, xyz.y, xyz.z, w };
+	return res;
+}
+
+float3x3 Float3x3(const float4x4 &m)
+{
+	const float3x3 res = {
+		m.m00, m.m01, m.m02,
+		m.m10, m.m11, m.m12,
+		m.m20, m.m21, m.m22,
+	};
+	return res;
+}
+
+float4x4 Float4x4(const float3x3 &m)
+{
+	const float4x4 res = {
+		m.m00, m.m01, m.m02, 0.0f,
+		m.m10, m.m11, m.m12, 0.0f,
+		m.m20, m.m21, m.m22, 0.0f,
+		0.0f, 0.0f, 0.0f, 1.0f,
+	};
+	return res;
+}
+
+f32 Sin(f32 value)
+{
+	const f32 res = ::sinf(value);
+	return res;
+}
+
+f32 Cos(f32 value)
+{
+	const f32 res = ::cosf(value);
+	return res;
+}
+
+f32 Tan(f32 value)
+{
+	const f32 res = ::tanf(value);
+	return res;
+}
+
+f32 Sqrt(f32 value)
+{
+	const f32 res = ::sqrtf(value);
+	return res;
+}
+
+float3 FromTo(const float3 &a, const float3 &b)
+{
+	const float3 res = { b.x - a.x, b.y - a.y, b.z - a.z };
+	return res;
+}
+
+float3 Add(const float3 &a, const float3 &b)
+{
+	const float3 res = { b.x + a.x, b.y + a.y, b.z + a.z };
+	return res;
+}
+
+float3 Sub(const float3 &a, const float3 &b)
+{
+	const float3 res = { a.x - b.x, a.y - b.y, a.z - b.z };
+	return res;
+}
+
+float3 Mul(const float3 &a, f32 b)
+{
+	const float3 res = { a.x * b, a.y * b, a.z * b };
+	return res;
+}
+
+float4 Mul(const float4x4 &a, const float4 &b)
+{
+#define USE_ROWS_TIMES_COLUMNS_MATRIX_MULTIPLICATION 1
+#if USE_ROWS_TIMES_COLUMNS_MATRIX_MULTIPLICATION
+	const float4 res = {
+		a.m00*b.x + a.m10*b.y + a.m20*b.z + a.m30*b.w,
+		a.m01*b.x + a.m11*b.y + a.m21*b.z + a.m31*b.w,
+		a.m02*b.x + a.m12*b.y + a.m22*b.z + a.m32*b.w,
+		a.m03*b.x + a.m13*b.y + a.m23*b.z + a.m33*b.w,
+	};
+	return res;
+#else
+#	error "Missing implementation"
+#endif
+}
+
+float3 MulVector(const float4x4 &a, const float3 &b)
+{
+	const float3 res = Mul(a, Float4(b, 0.0)).xyz;
+	return res;
+}
+
+float3 MulPoint(const float4x4 &a, const float3 &b)
+{
+	const float3 res = Mul(a, Float4(b, 1.0)).xyz;
+	return res;
+}
+
+float4x4 Mul(const float4x4 &a, const float4x4 &b)
+{
+#define USE_ROWS_TIMES_COLUMNS_MATRIX_MULTIPLICATION 1
+#if USE_ROWS_TIMES_COLUMNS_MATRIX_MULTIPLICATION
+	const float4x4 res = {
+		a.m00*b.m00 + a.m10*b.m01 + a.m20*b.m02 + a.m30*b.m03,
+		a.m01*b.m00 + a.m11*b.m01 + a.m21*b.m02 + a.m31*b.m03,
+		a.m02*b.m00 + a.m12*b.m01 + a.m22*b.m02 + a.m32*b.m03,
+		a.m03*b.m00 + a.m13*b.m01 + a.m23*b.m02 + a.m33*b.m03,
+
+		a.m00*b.m10 + a.m10*b.m11 + a.m20*b.m12 + a.m30*b.m13,
+		a.m01*b.m10 + a.m11*b.m11 + a.m21*b.m12 + a.m31*b.m13,
+		a.m02*b.m10 + a.m12*b.m11 + a.m22*b.m12 + a.m32*b.m13,
+		a.m03*b.m10 + a.m13*b.m11 + a.m23*b.m12 + a.m33*b.m13,
+
+		a.m00*b.m20 + a.m10*b.m21 + a.m20*b.m22 + a.m30*b.m23,
+		a.m01*b.m20 + a.m11*b.m21 + a.m21*b.m22 + a.m31*b.m23,
+		a.m02*b.m20 + a.m12*b.m21 + a.m22*b.m22 + a.m32*b.m23,
+		a.m03*b.m20 + a.m13*b.m21 + a.m23*b.m22 + a.m33*b.m23,
+
+		a.m00*b.m30 + a.m10*b.m31 + a.m20*b.m32 + a.m30*b.m33,
+		a.m01*b.m30 + a.m11*b.m31 + a.m21*b.m32 + a.m31*b.m33,
+		a.m02*b.m30 + a.m12*b.m31 + a.m22*b.m32 + a.m32*b.m33,
+		a.m03*b.m30 + a.m13*b.m31 + a.m23*b.m32 + a.m33*b.m33,
+	};
+#else // columns times rows
+	const float4x4 res = {
+		a.m00*b.m00 + a.m01*b.m10 + a.m02*b.m20 + a.m03*b.m30,
+		a.m00*b.m01 + a.m01*b.m11 + a.m02*b.m21 + a.m03*b.m31,
+		a.m00*b.m02 + a.m01*b.m12 + a.m02*b.m22 + a.m03*b.m32,
+		a.m00*b.m03 + a.m01*b.m13 + a.m02*b.m23 + a.m03*b.m33,
+
+		a.m10*b.m00 + a.m11*b.m10 + a.m12*b.m20 + a.m13*b.m30,
+		a.m10*b.m01 + a.m11*b.m11 + a.m12*b.m21 + a.m13*b.m31,
+		a.m10*b.m02 + a.m11*b.m12 + a.m12*b.m22 + a.m13*b.m32,
+		a.m10*b.m03 + a.m11*b.m13 + a.m12*b.m23 + a.m13*b.m33,
+
+		a.m20*b.m00 + a.m21*b.m10 + a.m22*b.m20 + a.m23*b.m30,
+		a.m20*b.m01 + a.m21*b.m11 + a.m22*b.m21 + a.m23*b.m31,
+		a.m20*b.m02 + a.m21*b.m12 + a.m22*b.m22 + a.m23*b.m32,
+		a.m20*b.m03 + a.m21*b.m13 + a.m22*b.m23 + a.m23*b.m33,
+
+		a.m30*b.m00 + a.m31*b.m10 + a.m32*b.m20 + a.m33*b.m30,
+		a.m30*b.m01 + a.m31*b.m11 + a.m32*b.m21 + a.m33*b.m31,
+		a.m30*b.m02 + a.m31*b.m12 + a.m32*b.m22 + a.m33*b.m32,
+		a.m30*b.m03 + a.m31*b.m13 + a.m32*b.m23 + a.m33*b.m33,
+	};
+#endif
+	return res;
+}
+
+float3 Negate(const float3 &v)
+{
+	const float3 res = { -v.x, -v.y, -v.z };
+	return res;
+}
+
+f32 Dot(const float3 &a, const float3 &b)
+{
+	const f32 res = a.x * b.x + a.y * b.y + a.z * b.z;
+	return res;
+}
+
+f32 Dot(const float4 &a, const float4 &b)
+{
+	const f32 res = a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
+	return res;
+}
+
+f32 Length2(const float3 &v)
+{
+	const f32 res = Dot(v, v);
+	return res;
+}
+
+f32 Length(const float3 &v)
+{
+	const f32 res = Sqrt(Length2(v));
+	return res;
+}
+
+bool IsZero(const float3 &v)
+{
+	return Length2(v) == 0.0f;
+}
+
+float3 Normalize(const float3 &v)
+{
+	const f32 invLen = 1.0f / Length(v);
+	const float3 res = {v.x * invLen, v.y * invLen, v.z * invLen};
+	return res;
+}
+
+float3 NormalizeIfNotZero(const float3 &v)
+{
+	const float3 res = Length2(v) > 0.0f ? Normalize(v) : v;
+	return res;
+}
+
+float3 Cross(const float3 &u, const float3 &v)
+{
+	const float3 res = {
+		u.y * v.z - u.z * v.y, // x
+		u.z * v.x - u.x * v.z, // y
+		u.x * v.y - u.y * v.x  // z
+	};
+	return res;
+}
+
+float4x4 Eye()
+{
+	float4x4 mat = {};
+	mat.m00 = mat.m11 = mat.m22 = mat.m33 = 1.0f;
+	return mat;
+}
+
+float4x4 Translate(const float3 &t)
+{
+	const float4x4 mat = {
+		1, 0, 0, 0,
+		0, 1, 0, 0,
+		0, 0, 1, 0,
+		t.x, t.y, t.z, 1,
+	};
+	return mat;
+}
+
+float4x4 Rotate(const float3 &axis, f32 degrees)
+{
+	// ASSERT( IsNormalized(axis) );
+
+	const f32 radians = degrees * ToRadians;
+	const f32 c = Cos(radians);
+	const f32 s = Sin(radians);
+	const f32 t = 1.0f - c;
+
+	const f32 m00 = c + axis.x*axis.x*t;
+	const f32 m11 = c + axis.y*axis.y*t;
+	const f32 m22 = c + axis.z*axis.z*t;
+
+	const f32 tmp1 = axis.x*axis.y*t;
+	const f32 tmp2 = axis.z*s;
+	const f32 m10 = tmp1 + tmp2;
+	const f32 m01 = tmp1 - tmp2;
+
+	const f32 tmp3 = axis.x*axis.z*t;
+	const f32 tmp4 = axis.y*s;
+	const f32 m20 = tmp3 - tmp4;
+	const f32 m02 = tmp3 + tmp4;
+
+	const f32 tmp5 = axis.y*axis.z*t;
+	const f32 tmp6 = axis.x*s;
+	const f32 m21 = tmp5 + tmp6;
+	const f32 m12 = tmp5 - tmp6;
+
+	const float4x4 mat = {
+		m00, m01, m02, 0,
+		m10, m11, m12, 0,
+		m20, m21, m22, 0,
+		0,     0,   0, 1,
+	};
+	return mat;
+}
+
+float4x4 Scale(const float3 &s)
+{
+	const float4x4 mat = {
+		s.x, 0, 0, 0,
+		0, s.y, 0, 0,
+		0, 0, s.y, 0,
+		0, 0, 0, 1,
+	};
+	return mat;
+}
+
+float4x4 LookAt(const float3 &vrp, const float3 &obs, const float3 &up)
+{
+	const float3 forward = Normalize(FromTo(vrp, obs));
+	const float3 right = Normalize(Cross(up, forward));
+	const float3 newUp = Cross(forward, right);
+	const f32 tx = Dot(Negate(right) ,obs);
+	const f32 ty = Dot(Negate(newUp) ,obs);
+	const f32 tz = Dot(Negate(forward) ,obs);
+	const float4x4 mat = {
+		right.x, newUp.x, forward.x, 0,
+		right.y, newUp.y, forward.y, 0,
+		right.z, newUp.z, forward.z, 0,
+		tx, ty, tz, 1,
+	};
+	return mat;
+}
+
+//#define USE_DEPTH_ZERO_TO_ONE 0 // For OpenGL
+#define USE_DEPTH_ZERO_TO_ONE 1 // For DX12, Vulkan
+
+//#define USE_REVERSE_Z 0
+#define USE_REVERSE_Z 1
+
+float4x4 Perspective(float fov, float aspect, float Near, float Far)
+{
+#if USE_REVERSE_Z
+#if USE_DEPTH_ZERO_TO_ONE
+	float tmp = Near;
+	Near = Far;
+	Far = tmp;
+#else
+#error "Check reverse-z for OpenGL implementations"
+#endif
+#endif
+
+	const f32 yScale = 1.0f / Tan(fov * ToRadians / 2.0f);
+	const f32 xScale = yScale / aspect;
+	const f32 NearMinusFar = Near - Far;
+
+	float4x4 mat = {};
+	mat.m00 = xScale;
+	mat.m11 = yScale;
+#if USE_DEPTH_ZERO_TO_ONE
+	mat.m22 = Far / NearMinusFar;
+	mat.m32 = Far * Near / NearMinusFar;
+#else
+	mat.m22 = (Far + Near) / NearMinusFar;
+	mat.m32 = 2.0f * Far * Near / NearMinusFar;
+#endif
+	mat.m23 = -1;
+
+	return mat;
+}
+
+float4x4 Orthogonal(f32 l, f32 r, f32 b, f32 t, f32 n, f32 f)
+{
+#if USE_REVERSE_Z
+#if USE_DEPTH_ZERO_TO_ONE
+	float tmp = n;
+	n = f;
+	f = tmp;
+#else
+#error "Check reverse-z for OpenGL implementations"
+#endif
+#endif
+
+	float4x4 mat = {};
+	const f32 RminusL = r - l;
+	const f32 TminusB = t - b;
+	const f32 FminusN = f - n;
+
+	mat.m00 = 2.0f / RminusL;
+	mat.m30 = -(r + l)/RminusL;
+	mat.m11 = 2.0f / TminusB;
+	mat.m31 = -(t + b)/TminusB;
+#if USE_DEPTH_ZERO_TO_ONE
+	mat.m22 = -1.0f / FminusN;
+	mat.m32 = - n /FminusN;
+#else
+	mat.m22 = -2.0f / FminusN;
+	mat.m32 = -(f + n)/FminusN;
+#endif
+	mat.m33 = 1.0f;
+
+	return mat;
+}
+
+float3x3 Transpose(const float3x3 &m)
+{
+	const float3x3 res = {
+		m.m00, m.m10, m.m20,
+		m.m01, m.m11, m.m21,
+		m.m02, m.m12, m.m22,
+	};
+	return res;
+}
+
+float4x4 Transpose(const float4x4 &m)
+{
+	const float4x4 res = {
+		m.m00, m.m10, m.m20, m.m30,
+		m.m01, m.m11, m.m21, m.m31,
+		m.m02, m.m12, m.m22, m.m32,
+		m.m03, m.m13, m.m23, m.m33,
+	};
+	return res;
+}
+
+i32 Floor(f32 value)
+{
+	const f32 res = ::floorf(value);
+	return static_cast<i32>(res);
+}
+
+f32 Log2(f32 value)
+{
+	const f32 res = ::log2f(value);
+	return res;
+}
+
+
+
+#define INSTANTIATE_MATH_OPS_FOR_TYPE( Type ) \
+Type Min( Type a, Type b ) { return a < b ? a : b; } \
+Type Max( Type a, Type b ) { return a > b ? a : b; } \
+Type Clamp( Type v, Type min, Type max ) { return Min( Max( v, min ), max ); }
+
+INSTANTIATE_MATH_OPS_FOR_TYPE( float )
+INSTANTIATE_MATH_OPS_FOR_TYPE( i32 )
+INSTANTIATE_MATH_OPS_FOR_TYPE( u32 )
+
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Alignment functions
+
+bool IsPowerOfTwo(u32 value)
+{
+	// First value in the below expression is for the case when value is 0
+	return value && (!(value & (value - 1)));
+}
+
+u32 AlignUp(u32 value, u32 alignment)
+{
+	ASSERT( IsPowerOfTwo(alignment) );
+	const u32 alignedValue =  ((value - 1) & ~(alignment - 1)) + alignment;
+	return alignedValue;
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Time
+
+struct Clock
+{
+#if PLATFORM_WINDOWS
+	LARGE_INTEGER counter;
+#elif PLATFORM_LINUX || PLATFORM_ANDROID
+	timespec timeSpec;
+#else
+#	error "Missing implementation"
+#endif
+};
+
+#define SECONDS_FROM_NANOSECONDS( ns ) ((float)(ns) / 1000000000.0f)
+
+#if PLATFORM_WINDOWS
+internal LONGLONG Win32GetPerformanceCounterFrequency()
+{
+	LARGE_INTEGER PerfCountFrequencyResult;
+	BOOL res = QueryPerformanceFrequency(&PerfCountFrequencyResult);
+	ASSERT(res && "QueryPerformanceFrequency() failed!");
+	return PerfCountFrequencyResult.QuadPart;
+}
+
+// TODO: Investigate... is there any problem in computing this at static init time?
+internal LONGLONG gPerformanceCounterFrequency = Win32GetPerformanceCounterFrequency();
+#endif
+
+Clock GetClock()
+{
+	Clock clock;
+#if PLATFORM_WINDOWS
+	QueryPerformanceCounter(&clock.counter);
+#elif PLATFORM_LINUX || PLATFORM_ANDROID
+	clock_gettime(CLOCK_MONOTONIC, &clock.timeSpec);
+#endif
+	return clock;
+}
+
+float GetSecondsElapsed(Clock start, Clock end)
+{
+	f32 elapsedSeconds;
+#if PLATFORM_WINDOWS
+	ASSERT( start.counter.QuadPart <= end.counter.QuadPart );
+	elapsedSeconds = (
+			(float)(end.counter.QuadPart - start.counter.QuadPart) /
+			(float)gPerformanceCounterFrequency );
+	return elapsedSeconds;
+#elif PLATFORM_LINUX || PLATFORM_ANDROID
+	ASSERT( start.timeSpec.tv_sec < end.timeSpec.tv_sec || (
+				start.timeSpec.tv_sec == end.timeSpec.tv_sec &&
+				start.timeSpec.tv_nsec <= end.timeSpec.tv_nsec ) );
+	if ( start.timeSpec.tv_sec == end.timeSpec.tv_sec )
+	{
+		elapsedSeconds = SECONDS_FROM_NANOSECONDS( end.timeSpec.tv_nsec - start.timeSpec.tv_nsec );
+	}
+	else
+	{
+		elapsedSeconds = end.timeSpec.tv_sec - start.timeSpec.tv_sec - 1;
+		elapsedSeconds += 1.0f - SECONDS_FROM_NANOSECONDS( start.timeSpec.tv_nsec );
+		elapsedSeconds += SECONDS_FROM_NANOSECONDS( end.timeSpec.tv_nsec );
+	}
+#endif
+	return elapsedSeconds;
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Threads and atomics
+
+#if PLATFORM_WINDOWS
+#define THREAD_FUNCTION(name) DWORD WINAPI name(void *arguments)
+#define THREAD_FUNCTION_RETURN() return 0
+typedef LPTHREAD_START_ROUTINE ThreadFunction;
+#elif PLATFORM_LINUX || PLATFORM_ANDROID
+#define THREAD_FUNCTION(name) void *name(void *arguments)
+#define THREAD_FUNCTION_RETURN() return NULL
+typedef void *(*ThreadFunction)(void *);
+#endif
+
+struct Thread
+{
+#if PLATFORM_WINDOWS
+	HANDLE handle;
+#elif PLATFORM_LINUX || PLATFORM_ANDROID
+	pthread_t handle;
+#endif
+};
+
+Thread CreateThread(ThreadFunction function, void *arguments)
+{
+	Thread thread = {};
+#if PLATFORM_WINDOWS
+	thread.handle = ::CreateThread(NULL, 0, function, arguments, 0, NULL);
+	ASSERT( thread.handle != NULL && "Failed to create thread." );
+#elif PLATFORM_LINUX || PLATFORM_ANDROID
+	const int res = pthread_create(&thread.handle, NULL, function, arguments);
+	ASSERT( res == 0 && "Failed to create thread." );
+#endif
+	return thread;
+}
+
+void JoinThread(Thread thread)
+{
+#if PLATFORM_WINDOWS
+	WaitForSingleObject(thread.handle, INFINITE);
+	CloseHandle(thread.handle);
+#elif PLATFORM_LINUX || PLATFORM_ANDROID
+	pthread_join(thread.handle, NULL);
+#endif
+}
+
+u32 GetProcessorCount()
+{
+#if PLATFORM_WINDOWS
+	SYSTEM_INFO systemInfo;
+	GetSystemInfo(&systemInfo);
+	const u32 count = systemInfo.dwNumberOfProcessors;
+#elif PLATFORM_LINUX || PLATFORM_ANDROID
+	const long res = sysconf(_SC_NPROCESSORS_ONLN);
+	const u32 count = res > 0 ? (u32)res : 1;
+#endif
+	return count;
+}
+
+// All atomic operations below are sequentially consistent.
+
+u32 AtomicIncrement(volatile u32 *value)
+{
+#if PLATFORM_WINDOWS
+	const u32 res = InterlockedIncrement((volatile LONG*)value);
+#else
+	const u32 res = __atomic_add_fetch(value, 1, __ATOMIC_SEQ_CST);
+#endif
+	return res;
+}
+
+u64 AtomicLoad(volatile u64 *value)
+{
+#if PLATFORM_WINDOWS
+	const u64 res = InterlockedCompareExchange64((volatile LONG64*)value, 0, 0);
+#else
+	const u64 res = __atomic_load_n(value, __ATOMIC_SEQ_CST);
+#endif
+	return res;
+}
+
+void AtomicStore(volatile u64 *value, u64 newValue)
+{
+#if PLATFORM_WINDOWS
+	InterlockedExchange64((volatile LONG64*)value, newValue);
+#else
+	__atomic_store_n(value, newValue, __ATOMIC_SEQ_CST);
+#endif
 }
 
-f32 Sqrt(f32 value)
+// Relaxed: atomic, but no ordering with other memory. For data that other threads may read
+// while it's being written, when they can tell from elsewhere whether what they read is valid.
+u64 AtomicLoadRelaxed(volatile u64 *value)
 {
-	const f32 res = ::sqrtf(value);
+#if PLATFORM_WINDOWS
+	const u64 res = *value; // aligned 64-bit accesses are atomic on x64 and arm64
+#else
+	const u64 res = __atomic_load_n(value, __ATOMIC_RELAXED);
+#endif
 	return res;
 }
 
-float3 FromTo(const float3 &a, const float3 &b)
+void AtomicStoreRelaxed(volatile u64 *value, u64 newValue)
 {
-	const float3 res = { b.x - a.x, b.y - a.y, b.z - a.z };
-	return res;
+#if PLATFORM_WINDOWS
+	*value = newValue;
+#else
+	__atomic_store_n(value, newValue, __ATOMIC_RELAXED);
+#endif
 }
 
-float3 Add(const float3 &a, const float3 &b)
+// Returns true if *value was equal to expected and got replaced by desired
+bool AtomicCompareExchange(volatile u64 *value, u64 expected, u64 desired)
 {
-	const float3 res = { b.x + a.x, b.y + a.y, b.z + a.z };
+#if PLATFORM_WINDOWS
+	const bool res = InterlockedCompareExchange64((volatile LONG64*)value, desired, expected) == (LONG64)expected;
+#else
+	const bool res = __atomic_compare_exchange_n(value, &expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+#endif
 	return res;
 }
 
-float3 Sub(const float3 &a, const float3 &b)
+u32 AtomicLoad(volatile u32 *value)
 {
-	const float3 res = { a.x - b.x, a.y - b.y, a.z - b.z };
+#if PLATFORM_WINDOWS
+	const u32 res = InterlockedCompareExchange((volatile LONG*)value, 0, 0);
+#else
+	const u32 res = __atomic_load_n(value, __ATOMIC_SEQ_CST);
+#endif
 	return res;
 }
 
-float3 Mul(const float3 &a, f32 b)
+// Returns the new value
+u32 AtomicAdd(volatile u32 *value, u32 addend)
 {
-	const float3 res = { a.x * b, a.y * b, a.z * b };
+#if PLATFORM_WINDOWS
+	const u32 res = InterlockedExchangeAdd((volatile LONG*)value, addend) + addend;
+#else
+	const u32 res = __atomic_add_fetch(value, addend, __ATOMIC_SEQ_CST);
+#endif
 	return res;
 }
 
-float4 Mul(const float4x4 &a, const float4 &b)
+u32 AtomicDecrement(volatile u32 *value)
 {
-#define USE_ROWS_TIMES_COLUMNS_MATRIX_MULTIPLICATION 1
-#if USE_ROWS_TIMES_COLUMNS_MATRIX_MULTIPLICATION
-	const float4 res = {
-		a.m00*b.x + a.m10*b.y + a.m20*b.z + a.m30*b.w,
-		a.m01*b.x + a.m11*b.y + a.m21*b.z + a.m31*b.w,
-		a.m02*b.x + a.m12*b.y + a.m22*b.z + a.m32*b.w,
-		a.m03*b.x + a.m13*b.y + a.m23*b.z + a.m33*b.w,
-	};
-	return res;
+#if PLATFORM_WINDOWS
+	const u32 res = InterlockedDecrement((volatile LONG*)value);
 #else
-#	error "Missing implementation"
+	const u32 res = __atomic_sub_fetch(value, 1, __ATOMIC_SEQ_CST);
 #endif
+	return res;
 }
 
-float3 MulVector(const float4x4 &a, const float3 &b)
+// Returns the previous value
+u32 AtomicExchange(volatile u32 *value, u32 newValue)
 {
-	const float3 res = Mul(a, Float4(b, 0.0)).xyz;
+#if PLATFORM_WINDOWS
+	const u32 res = InterlockedExchange((volatile LONG*)value, newValue);
+#else
+	const u32 res = __atomic_exchange_n(value, newValue, __ATOMIC_SEQ_CST);
+#endif
 	return res;
 }
 
-float3 MulPoint(const float4x4 &a, const float3 &b)
+// Hint for the core while busy waiting
+void CpuPause()
 {
-	const float3 res = Mul(a, Float4(b, 1.0)).xyz;
-	return res;
+#if PLATFORM_WINDOWS
+	YieldProcessor();
+#elif defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+	__asm__ __volatile__("yield");
+#endif
 }
 
-float4x4 Mul(const float4x4 &a, const float4x4 &b)
+// Gives the rest of the time slice to other threads, if any are ready
+void YieldThread()
 {
-#define USE_ROWS_TIMES_COLUMNS_MATRIX_MULTIPLICATION 1
-#if USE_ROWS_TIMES_COLUMNS_MATRIX_MULTIPLICATION
-	const float4x4 res = {
-		a.m00*b.m00 + a.m10*b.m01 + a.m20*b.m02 + a.m30*b.m03,
-		a.m01*b.m00 + a.m11*b.m01 + a.m21*b.m02 + a.m31*b.m03,
-		a.m02*b.m00 + a.m12*b.m01 + a.m22*b.m02 + a.m32*b.m03,
-		a.m03*b.m00 + a.m13*b.m01 + a.m23*b.m02 + a.m33*b.m03,
-
-		a.m00*b.m10 + a.m10*b.m11 + a.m20*b.m12 + a.m30*b.m13,
-		a.m01*b.m10 + a.m11*b.m11 + a.m21*b.m12 + a.m31*b.m13,
-		a.m02*b.m10 + a.m12*b.m11 + a.m22*b.m12 + a.m32*b.m13,
-		a.m03*b.m10 + a.m13*b.m11 + a.m23*b.m12 + a.m33*b.m13,
+#if PLATFORM_WINDOWS
+	SwitchToThread();
+#elif PLATFORM_LINUX || PLATFORM_ANDROID
+	sched_yield();
+#endif
+}
 
-		a.m00*b.m20 + a.m10*b.m21 + a.m20*b.m22 + a.m30*b.m23,
-		a.m01*b.m20 + a.m11*b.m21 + a.m21*b.m22 + a.m31*b.m23,
-		a.m02*b.m20 + a.m12*b.m21 + a.m22*b.m22 + a.m32*b.m23,
-		a.m03*b.m20 + a.m13*b.m21 + a.m23*b.m22 + a.m33*b.m23,
+// For short critical sections only, waiting threads keep spinning
+struct SpinLock
+{
+	volatile u32 locked;
+};
 
-		a.m00*b.m30 + a.m10*b.m31 + a.m20*b.m32 + a.m30*b.m33,
-		a.m01*b.m30 + a.m11*b.m31 + a.m21*b.m32 + a.m31*b.m33,
-		a.m02*b.m30 + a.m12*b.m31 + a.m22*b.m32 + a.m32*b.m33,
-		a.m03*b.m30 + a.m13*b.m31 + a.m23*b.m32 + a.m33*b.m33,
-	};
-#else // columns times rows
-	const float4x4 res = {
-		a.m00*b.m00 + a.m01*b.m10 + a.m02*b.m20 + a.m03*b.m30,
-		a.m00*b.m01 + a.m01*b.m11 + a.m02*b.m21 + a.m03*b.m31,
-		a.m00*b.m02 + a.m01*b.m12 + a.m02*b.m22 + a.m03*b.m32,
-		a.m00*b.m03 + a.m01*b.m13 + a.m02*b.m23 + a.m03*b.m33,
+void AcquireSpinLock(SpinLock &lock)
+{
+	while ( AtomicExchange(&lock.locked, 1) )
+	{
+		// Wait reading only so the cache line is not bounced between cores
+		while ( AtomicLoad(&lock.locked) )
+		{
+			CpuPause();
+		}
+	}
+}
 
-		a.m10*b.m00 + a.m11*b.m10 + a.m12*b.m20 + a.m13*b.m30,
-		a.m10*b.m01 + a.m11*b.m11 + a.m12*b.m21 + a.m13*b.m31,
-		a.m10*b.m02 + a.m11*b.m12 + a.m12*b.m22 + a.m13*b.m32,
-		a.m10*b.m03 + a.m11*b.m13 + a.m12*b.m23 + a.m13*b.m33,
+void ReleaseSpinLock(SpinLock &lock)
+{
+	AtomicExchange(&lock.locked, 0);
+}
 
-		a.m20*b.m00 + a.m21*b.m10 + a.m22*b.m20 + a.m23*b.m30,
-		a.m20*b.m01 + a.m21*b.m11 + a.m22*b.m21 + a.m23*b.m31,
-		a.m20*b.m02 + a.m21*b.m12 + a.m22*b.m22 + a.m23*b.m32,
-		a.m20*b.m03 + a.m21*b.m13 + a.m22*b.m23 + a.m23*b.m33,
+// Mutexes and conditions are initialized in place, they can't be copied afterwards
 
-		a.m30*b.m00 + a.m31*b.m10 + a.m32*b.m20 + a.m33*b.m30,
-		a.m30*b.m01 + a.m31*b.m11 + a.m32*b.m21 + a.m33*b.m31,
-		a.m30*b.m02 + a.m31*b.m12 + a.m32*b.m22 + a.m33*b.m32,
-		a.m30*b.m03 + a.m31*b.m13 + a.m32*b.m23 + a.m33*b.m33,
-	};
+struct Mutex
+{
+#if PLATFORM_WINDOWS
+	SRWLOCK handle;
+#elif PLATFORM_LINUX || PLATFORM_ANDROID
+	pthread_mutex_t handle;
 #endif
-	return res;
-}
+};
 
-float3 Negate(const float3 &v)
+struct Condition
 {
-	const float3 res = { -v.x, -v.y, -v.z };
-	return res;
-}
+#if PLATFORM_WINDOWS
+	CONDITION_VARIABLE handle;
+#elif PLATFORM_LINUX || PLATFORM_ANDROID
+	pthread_cond_t handle;
+#endif
+};
 
-f32 Dot(const float3 &a, const float3 &b)
+void InitializeMutex(Mutex &mutex)
 {
-	const f32 res = a.x * b.x + a.y * b.y + a.z * b.z;
-	return res;
+#if PLATFORM_WINDOWS
+	InitializeSRWLock(&mutex.handle);
+#elif PLATFORM_LINUX || PLATFORM_ANDROID
+	pthread_mutex_init(&mutex.handle, NULL);
+#endif
 }
 
-f32 Dot(const float4 &a, const float4 &b)
+void DestroyMutex(Mutex &mutex)
 {
-	const f32 res = a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
-	return res;
+#if PLATFORM_LINUX || PLATFORM_ANDROID
+	pthread_mutex_destroy(&mutex.handle);
+#endif
 }
 
-f32 Length2(const float3 &v)
+void LockMutex(Mutex &mutex)
 {
-	const f32 res = Dot(v, v);
-	return res;
+#if PLATFORM_WINDOWS
+	AcquireSRWLockExclusive(&mutex.handle);
+#elif PLATFORM_LINUX || PLATFORM_ANDROID
+	pthread_mutex_lock(&mutex.handle);
+#endif
 }
 
-f32 Length(const float3 &v)
+void UnlockMutex(Mutex &mutex)
 {
-	const f32 res = Sqrt(Length2(v));
-	return res;
+#if PLATFORM_WINDOWS
+	ReleaseSRWLockExclusive(&mutex.handle);
+#elif PLATFORM_LINUX || PLATFORM_ANDROID
+	pthread_mutex_unlock(&mutex.handle);
+#endif
 }
 
-bool IsZero(const float3 &v)
+void InitializeCondition(Condition &condition)
 {
-	return Length2(v) == 0.0f;
+#if PLATFORM_WINDOWS
+	InitializeConditionVariable(&condition.handle);
+#elif PLATFORM_LINUX || PLATFORM_ANDROID
+	pthread_cond_init(&condition.handle, NULL);
+#endif
 }
 
-float3 Normalize(const float3 &v)
+void DestroyCondition(Condition &condition)
 {
-	const f32 invLen = 1.0f / Length(v);
-	const float3 res = {v.x * invLen, v.y * invLen, v.z * invLen};
-	return res;
+#if PLATFORM_LINUX || PLATFORM_ANDROID
+	pthread_cond_destroy(&condition.handle);
+#endif
 }
 
-float3 NormalizeIfNotZero(const float3 &v)
+// Unlocks the mutex while waiting, it is locked again on return. Wakeups may be spurious.
+void WaitCondition(Condition &condition, Mutex &mutex)
 {
-	const float3 res = Length2(v) > 0.0f ? Normalize(v) : v;
-	return res;
+#if PLATFORM_WINDOWS
+	SleepConditionVariableSRW(&condition.handle, &mutex.handle, INFINITE, 0);
+#elif PLATFORM_LINUX || PLATFORM_ANDROID
+	pthread_cond_wait(&condition.handle, &mutex.handle);
+#endif
 }
 
-float3 Cross(const float3 &u, const float3 &v)
+void SignalCondition(Condition &condition)
 {
-	const float3 res = {
-		u.y * v.z - u.z * v.y, // x
-		u.z * v.x - u.x * v.z, // y
-		u.x * v.y - u.y * v.x  // z
-	};
-	return res;
+#if PLATFORM_WINDOWS
+	WakeConditionVariable(&condition.handle);
+#elif PLATFORM_LINUX || PLATFORM_ANDROID
+	pthread_cond_signal(&condition.handle);
+#endif
 }
 
-float4x4 Eye()
+void BroadcastCondition(Condition &condition)
 {
-	float4x4 mat = {};
-	mat.m00 = mat.m11 = mat.m22 = mat.m33 = 1.0f;
-	return mat;
+#if PLATFORM_WINDOWS
+	WakeAllConditionVariable(&condition.handle);
+#elif PLATFORM_LINUX || PLATFORM_ANDROID
+	pthread_cond_broadcast(&condition.handle);
+#endif
 }
 
-float4x4 Translate(const float3 &t)
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Jobs
+//
+// A fixed pool of worker threads, each one owning a Chase-Lev deque of jobs. Owners push and pop
+// jobs at the bottom of their deque, the most recent ones, still warm in cache. Idle workers steal
+// from the top of the others, the oldest ones. Workers with nothing to do sleep on a condition.
+//
+// The thread starting the job system is worker 0 and is the only one besides the workers that can
+// push jobs. It runs jobs too while waiting for counters, as do workers waiting inside jobs, so
+// jobs can wait for jobs they push. Jobs can use BeginScratch, scratch arenas are per thread.
+
+#define MAX_JOB_WORKERS 64
+#define JOB_QUEUE_SIZE 4096 // power of two
+#define JOB_SPIN_COUNT 64
+
+#define JOB_FUNCTION(name) void name(void *arguments)
+typedef void (*JobFunction)(void *arguments);
+
+#define PARALLEL_FOR_FUNCTION(name) void name(void *arguments, u32 begin, u32 end)
+typedef void (*ParallelForFunction)(void *arguments, u32 begin, u32 end);
+
+// Counts pending jobs, zero once all of them are done
+struct JobCounter
+{
+	volatile u32 pending;
+};
+
+struct Job
 {
-	const float4x4 mat = {
-		1, 0, 0, 0,
-		0, 1, 0, 0,
-		0, 0, 1, 0,
-		t.x, t.y, t.z, 1,
-	};
-	return mat;
-}
+	JobFunction function;
+	void *arguments;
+	JobCounter *counter;
+};
 
-float4x4 Rotate(const float3 &axis, f32 degrees)
+struct JobSystem;
+
+struct JobWorker
 {
-	// ASSERT( IsNormalized(axis) );
+	volatile u64 top; // Thieves take jobs from here
+	byte padding0[56];
+	volatile u64 bottom; // The owner pushes and pops jobs here
+	byte padding1[56];
+	Job jobs[JOB_QUEUE_SIZE];
 
-	const f32 radians = degrees * ToRadians;
-	const f32 c = Cos(radians);
-	const f32 s = Sin(radians);
-	const f32 t = 1.0f - c;
+	JobSystem *system;
+	u32 index;
+};
 
-	const f32 m00 = c + axis.x*axis.x*t;
-	const f32 m11 = c + axis.y*axis.y*t;
-	const f32 m22 = c + axis.z*axis.z*t;
+struct JobSystem
+{
+	JobWorker *workers;
+	u32 workersCount;
+	Thread threads[MAX_JOB_WORKERS];
 
-	const f32 tmp1 = axis.x*axis.y*t;
-	const f32 tmp2 = axis.z*s;
-	const f32 m10 = tmp1 + tmp2;
-	const f32 m01 = tmp1 - tmp2;
+	u32 spinCount; // Attempts to take jobs before sleeping or yielding
 
-	const f32 tmp3 = axis.x*axis.z*t;
-	const f32 tmp4 = axis.y*s;
-	const f32 m20 = tmp3 - tmp4;
-	const f32 m02 = tmp3 + tmp4;
+	volatile u32 queuedCount; // Jobs pushed but not taken yet, for sleeping workers
+	volatile u32 sleepingCount;
+	volatile u32 stop;
+	Mutex mutex;
+	Condition condition;
+};
 
-	const f32 tmp5 = axis.y*axis.z*t;
-	const f32 tmp6 = axis.x*s;
-	const f32 m21 = tmp5 + tmp6;
-	const f32 m12 = tmp5 - tmp6;
+static thread_local u32 tJobWorkerIndex = 0;
+static thread_local JobSystem *tJobSystem = NULL;
 
-	const float4x4 mat = {
-		m00, m01, m02, 0,
-		m10, m11, m12, 0,
-		m20, m21, m22, 0,
-		0,     0,   0, 1,
-	};
-	return mat;
+u32 GetJobWorkerIndex()
+{
+	return tJobWorkerIndex;
 }
 
-float4x4 Scale(const float3 &s)
+// The job system the calling thread is a worker of, if any, so code running in jobs can push jobs
+JobSystem *GetJobSystem()
 {
-	const float4x4 mat = {
-		s.x, 0, 0, 0,
-		0, s.y, 0, 0,
-		0, 0, s.y, 0,
-		0, 0, 0, 1,
-	};
-	return mat;
+	return tJobSystem;
 }
 
-float4x4 LookAt(const float3 &vrp, const float3 &obs, const float3 &up)
+// Thieves may read a slot while its owner reuses it, so slots are accessed field by field with
+// atomics. Torn jobs read that way are dropped, as taking them fails.
+CT_ASSERT(sizeof(void*) == sizeof(u64));
+
+void StoreJob(Job &slot, const Job &job)
 {
-	const float3 forward = Normalize(FromTo(vrp, obs));
-	const float3 right = Normalize(Cross(up, forward));
-	const float3 newUp = Cross(forward, right);
-	const f32 tx = Dot(Negate(right) ,obs);
-	const f32 ty = Dot(Negate(newUp) ,obs);
-	const f32 tz = Dot(Negate(forward) ,obs);
-	const float4x4 mat = {
-		right.x, newUp.x, forward.x, 0,
-		right.y, newUp.y, forward.y, 0,
-		right.z, newUp.z, forward.z, 0,
-		tx, ty, tz, 1,
-	};
-	return mat;
+	AtomicStoreRelaxed((volatile u64*)&slot.function, (u64)job.function);
+	AtomicStoreRelaxed((volatile u64*)&slot.arguments, (u64)job.arguments);
+	AtomicStoreRelaxed((volatile u64*)&slot.counter, (u64)job.counter);
 }
 
-//#define USE_DEPTH_ZERO_TO_ONE 0 // For OpenGL
-#define USE_DEPTH_ZERO_TO_ONE 1 // For DX12, Vulkan
+Job LoadJob(Job &slot)
+{
+	Job job;
+	job.function = (JobFunction)AtomicLoadRelaxed((volatile u64*)&slot.function);
+	job.arguments = (void*)AtomicLoadRelaxed((volatile u64*)&slot.arguments);
+	job.counter = (JobCounter*)AtomicLoadRelaxed((volatile u64*)&slot.counter);
+	return job;
+}
 
-//#define USE_REVERSE_Z 0
-#define USE_REVERSE_Z 1
+// Only the owner of the deque
+bool PushJobToWorker(JobWorker &worker, const Job &job)
+{
+	const u64 bottom = worker.bottom;
+	const u64 top = AtomicLoad(&worker.top);
+	if ( bottom - top >= JOB_QUEUE_SIZE )
+	{
+		return false;
+	}
+
+	StoreJob(worker.jobs[bottom & (JOB_QUEUE_SIZE - 1)], job);
+	AtomicStore(&worker.bottom, bottom + 1);
+	return true;
+}
 
-float4x4 Perspective(float fov, float aspect, float Near, float Far)
+// Only the owner of the deque
+bool PopJobFromWorker(JobWorker &worker, Job &job)
 {
-#if USE_REVERSE_Z
-#if USE_DEPTH_ZERO_TO_ONE
-	float tmp = Near;
-	Near = Far;
-	Far = tmp;
-#else
-#error "Check reverse-z for OpenGL implementations"
-#endif
-#endif
+	const u64 bottom = worker.bottom - 1;
+	AtomicStore(&worker.bottom, bottom);
+	const u64 top = AtomicLoad(&worker.top);
 
-	const f32 yScale = 1.0f / Tan(fov * ToRadians / 2.0f);
-	const f32 xScale = yScale / aspect;
-	const f32 NearMinusFar = Near - Far;
+	if ( (i64)(bottom - top) < 0 )
+	{
+		// Empty
+		AtomicStore(&worker.bottom, top);
+		return false;
+	}
 
-	float4x4 mat = {};
-	mat.m00 = xScale;
-	mat.m11 = yScale;
-#if USE_DEPTH_ZERO_TO_ONE
-	mat.m22 = Far / NearMinusFar;
-	mat.m32 = Far * Near / NearMinusFar;
-#else
-	mat.m22 = (Far + Near) / NearMinusFar;
-	mat.m32 = 2.0f * Far * Near / NearMinusFar;
-#endif
-	mat.m23 = -1;
+	job = worker.jobs[bottom & (JOB_QUEUE_SIZE - 1)];
+	if ( bottom != top )
+	{
+		return true;
+	}
 
-	return mat;
+	// Last job, thieves may be trying to take it as well
+	const bool taken = AtomicCompareExchange(&worker.top, top, top + 1);
+	AtomicStore(&worker.bottom, top + 1);
+	return taken;
 }
 
-float4x4 Orthogonal(f32 l, f32 r, f32 b, f32 t, f32 n, f32 f)
+// Any thread
+bool StealJobFromWorker(JobWorker &worker, Job &job)
 {
-#if USE_REVERSE_Z
-#if USE_DEPTH_ZERO_TO_ONE
-	float tmp = n;
-	n = f;
-	f = tmp;
-#else
-#error "Check reverse-z for OpenGL implementations"
-#endif
-#endif
+	const u64 top = AtomicLoad(&worker.top);
+	const u64 bottom = AtomicLoad(&worker.bottom);
+	if ( (i64)(bottom - top) <= 0 )
+	{
+		return false;
+	}
 
-	float4x4 mat = {};
-	const f32 RminusL = r - l;
-	const f32 TminusB = t - b;
-	const f32 FminusN = f - n;
+	// The copy may be torn if the slot got reused meanwhile, but then the exchange fails
+	job = LoadJob(worker.jobs[top & (JOB_QUEUE_SIZE - 1)]);
+	return AtomicCompareExchange(&worker.top, top, top + 1);
+}
 
-	mat.m00 = 2.0f / RminusL;
-	mat.m30 = -(r + l)/RminusL;
-	mat.m11 = 2.0f / TminusB;
-	mat.m31 = -(t + b)/TminusB;
-#if USE_DEPTH_ZERO_TO_ONE
-	mat.m22 = -1.0f / FminusN;
-	mat.m32 = - n /FminusN;
-#else
-	mat.m22 = -2.0f / FminusN;
-	mat.m32 = -(f + n)/FminusN;
-#endif
-	mat.m33 = 1.0f;
+bool TakeJob(JobSystem &system, u32 workerIndex, Job &job)
+{
+	bool taken = PopJobFromWorker(system.workers[workerIndex], job);
 
-	return mat;
+	for (u32 i = 1; i < system.workersCount && !taken; ++i)
+	{
+		JobWorker &victim = system.workers[(workerIndex + i) % system.workersCount];
+		taken = StealJobFromWorker(victim, job);
+	}
+
+	if ( taken )
+	{
+		AtomicDecrement(&system.queuedCount);
+	}
+	return taken;
 }
 
-float3x3 Transpose(const float3x3 &m)
+void RunJob(const Job &job)
 {
-	const float3x3 res = {
-		m.m00, m.m10, m.m20,
-		m.m01, m.m11, m.m21,
-		m.m02, m.m12, m.m22,
-	};
-	return res;
+	job.function(job.arguments);
+	if ( job.counter )
+	{
+		AtomicDecrement(&job.counter->pending);
+	}
 }
 
-float4x4 Transpose(const float4x4 &m)
+// Runs the job right away if the queue of the worker is full
+void PushJob(JobSystem &system, JobFunction function, void *arguments, JobCounter *counter = NULL)
 {
-	const float4x4 res = {
-		m.m00, m.m10, m.m20, m.m30,
-		m.m01, m.m11, m.m21, m.m31,
-		m.m02, m.m12, m.m22, m.m32,
-		m.m03, m.m13, m.m23, m.m33,
-	};
-	return res;
+	const Job job = { function, arguments, counter };
+	if ( counter )
+	{
+		AtomicAdd(&counter->pending, 1);
+	}
+
+	AtomicAdd(&system.queuedCount, 1);
+	if ( !PushJobToWorker(system.workers[tJobWorkerIndex], job) )
+	{
+		AtomicDecrement(&system.queuedCount);
+		RunJob(job);
+		return;
+	}
+
+	if ( AtomicLoad(&system.sleepingCount) > 0 )
+	{
+		LockMutex(system.mutex);
+		SignalCondition(system.condition);
+		UnlockMutex(system.mutex);
+	}
 }
 
-i32 Floor(f32 value)
+// Runs other jobs until the counter gets to zero
+void WaitJobCounter(JobSystem &system, JobCounter &counter)
 {
-	const f32 res = ::floorf(value);
-	return static_cast<i32>(res);
+	u32 spinCount = 0;
+	while ( AtomicLoad(&counter.pending) > 0 )
+	{
+		Job job;
+		if ( TakeJob(system, tJobWorkerIndex, job) )
+		{
+			RunJob(job);
+			spinCount = 0;
+		}
+		else if ( ++spinCount < system.spinCount )
+		{
+			CpuPause();
+		}
+		else
+		{
+			// The remaining jobs are running, let their threads have the core if there are more threads than cores
+			YieldThread();
+		}
+	}
 }
 
-f32 Log2(f32 value)
+THREAD_FUNCTION(JobWorkerMain)
 {
-	const f32 res = ::log2f(value);
-	return res;
+	JobWorker &worker = *(JobWorker*)arguments;
+	JobSystem &system = *worker.system;
+	tJobWorkerIndex = worker.index;
+	tJobSystem = &system;
+
+	while ( !AtomicLoad(&system.stop) )
+	{
+		Job job;
+		bool taken = TakeJob(system, worker.index, job);
+		for (u32 i = 0; i < system.spinCount && !taken; ++i)
+		{
+			CpuPause();
+			taken = TakeJob(system, worker.index, job);
+		}
+
+		if ( taken )
+		{
+			RunJob(job);
+			continue;
+		}
+
+		// Pushers check for sleeping workers after queueing, so either they see this
+		// worker sleeping and wake it up, or this worker sees their job queued.
+		LockMutex(system.mutex);
+		AtomicAdd(&system.sleepingCount, 1);
+		while ( AtomicLoad(&system.queuedCount) == 0 && !AtomicLoad(&system.stop) )
+		{
+			WaitCondition(system.condition, system.mutex);
+		}
+		AtomicDecrement(&system.sleepingCount);
+		UnlockMutex(system.mutex);
+	}
+
+	FreeScratchArenas();
+	THREAD_FUNCTION_RETURN();
 }
 
+// Starts workersCount - 1 threads, the calling thread being the first worker
+JobSystem *StartJobSystem(Arena &arena, u32 workersCount)
+{
+	workersCount = workersCount < 1 ? 1 : workersCount > MAX_JOB_WORKERS ? MAX_JOB_WORKERS : workersCount;
 
+	// The mutex and condition need aligned futex words, and deque ends are padded to cache lines
+	JobSystem *system = PushAlignedZeroStruct(arena, JobSystem, 64);
+	system->workers = PushAlignedZeroArray(arena, JobWorker, workersCount, 64);
+	system->workersCount = workersCount;
+	// Spinning only helps if every worker has a core, otherwise it takes time from the ones working
+	system->spinCount = workersCount <= GetProcessorCount() ? JOB_SPIN_COUNT : 0;
+	InitializeMutex(system->mutex);
+	InitializeCondition(system->condition);
 
-#define INSTANTIATE_MATH_OPS_FOR_TYPE( Type ) \
-Type Min( Type a, Type b ) { return a < b ? a : b; } \
-Type Max( Type a, Type b ) { return a > b ? a : b; } \
-Type Clamp( Type v, Type min, Type max ) { return Min( Max( v, min ), max ); }
+	tJobWorkerIndex = 0;
+	tJobSystem = system;
+	for (u32 i = 0; i < workersCount; ++i)
+	{
+		system->workers[i].system = system;
+		system->workers[i].index = i;
+	}
+	for (u32 i = 1; i < workersCount; ++i)
+	{
+		system->threads[i] = CreateThread(JobWorkerMain, &system->workers[i]);
+	}
+	return system;
+}
 
-INSTANTIATE_MATH_OPS_FOR_TYPE( float )
-INSTANTIATE_MATH_OPS_FOR_TYPE( i32 )
-INSTANTIATE_MATH_OPS_FOR_TYPE( u32 )
+// Pushed jobs should be waited for before stopping
+void StopJobSystem(JobSystem &system)
+{
+	LockMutex(system.mutex);
+	AtomicExchange(&system.stop, 1);
+	BroadcastCondition(system.condition);
+	UnlockMutex(system.mutex);
 
+	for (u32 i = 1; i < system.workersCount; ++i)
+	{
+		JoinThread(system.threads[i]);
+	}
 
+	DestroyCondition(system.condition);
+	DestroyMutex(system.mutex);
+	tJobSystem = NULL;
+}
 
-////////////////////////////////////////////////////////////////////////////////////////////////////
-// Alignment functions
+// Parallel for jobs take batches of the range until there are none left
 
-bool IsPowerOfTwo(u32 value)
+struct ParallelFor
 {
-	// First value in the below expression is for the case when value is 0
-	return value && (!(value & (value - 1)));
+	ParallelForFunction function;
+	void *arguments;
+	u32 count;
+	u32 batchSize;
+	volatile u32 next;
+};
+
+JOB_FUNCTION(ParallelForJob)
+{
+	ParallelFor &parallelFor = *(ParallelFor*)arguments;
+	for (;;)
+	{
+		const u32 end = AtomicAdd(&parallelFor.next, parallelFor.batchSize);
+		const u32 begin = end - parallelFor.batchSize;
+		if ( begin >= parallelFor.count ) break;
+		parallelFor.function(parallelFor.arguments, begin, end < parallelFor.count ? end : parallelFor.count);
+	}
 }
 
-u32 AlignUp(u32 value, u32 alignment)
+// Calls function over [0, count) in batches of batchSize elements and waits for all of them
+void RunParallelFor(JobSystem &system, u32 count, u32 batchSize, ParallelForFunction function, void *arguments)
 {
-	ASSERT( IsPowerOfTwo(alignment) );
-	const u32 alignedValue =  ((value - 1) & ~(alignment - 1)) + alignment;
-	return alignedValue;
+	ASSERT( batchSize > 0 );
+	ParallelFor parallelFor = { function, arguments, count, batchSize, 0 };
+
+	const u32 batchesCount = count / batchSize + (count % batchSize ? 1 : 0);
+	const u32 jobsCount = batchesCount < system.workersCount ? batchesCount : system.workersCount;
+
+	JobCounter counter = {};
+	for (u32 i = 1; i < jobsCount; ++i)
+	{
+		PushJob(system, ParallelForJob, &parallelFor, &counter);
+	}
+	ParallelForJob(&parallelFor);
+	WaitJobCounter(system, counter);
 }
 
 
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
-// Time
+// String interning
 
-struct Clock
+// Strings are spread by hash over shards, each one an open addressing table with linear probing
+// and its own lock, so threads interning at the same time rarely wait for each other. Shards
+// grow independently by rehashing into a table twice as big, old tables are left in the arena.
+// The arena is only used under its own lock, so it must not be used by anything else while
+// other threads are interning.
+
+#define STRING_INTERNING_SHARD_BITS 4
+#define STRING_INTERNING_SHARD_COUNT (1 << STRING_INTERNING_SHARD_BITS)
+#define STRING_INTERNING_MIN_CAPACITY 64
+
+struct StringIntern
 {
-#if PLATFORM_WINDOWS
-	LARGE_INTEGER counter;
-#elif PLATFORM_LINUX || PLATFORM_ANDROID
-	timespec timeSpec;
-#else
-#	error "Missing implementation"
-#endif
+	const char *str; // NULL for empty slots
+	u32 len;
+	u32 hash;
 };
 
-#define SECONDS_FROM_NANOSECONDS( ns ) ((float)(ns) / 1000000000.0f)
+struct StringInterningShard
+{
+	StringIntern *slots;
+	u32 capacity; // power of two
+	u32 count;
+	SpinLock lock;
+};
 
-#if PLATFORM_WINDOWS
-internal LONGLONG Win32GetPerformanceCounterFrequency()
+struct StringInterningTable
 {
-	LARGE_INTEGER PerfCountFrequencyResult;
-	BOOL res = QueryPerformanceFrequency(&PerfCountFrequencyResult);
-	ASSERT(res && "QueryPerformanceFrequency() failed!");
-	return PerfCountFrequencyResult.QuadPart;
-}
+	StringInterningShard shards[STRING_INTERNING_SHARD_COUNT];
+	SpinLock arenaLock;
+};
 
-// TODO: Investigate... is there any problem in computing this at static init time?
-internal LONGLONG gPerformanceCounterFrequency = Win32GetPerformanceCounterFrequency();
-#endif
+struct StringInterning
+{
+	Arena *arena;
+	StringInterningTable *table;
+};
 
-Clock GetClock()
+StringInterning StringInterningCreate(Arena *arena)
 {
-	Clock clock;
-#if PLATFORM_WINDOWS
-	QueryPerformanceCounter(&clock.counter);
-#elif PLATFORM_LINUX || PLATFORM_ANDROID
-	clock_gettime(CLOCK_MONOTONIC, &clock.timeSpec);
-#endif
-	return clock;
+	StringInterning interning = {
+		.arena = arena,
+		// Spin locks must not straddle cache lines, which would make them split locks
+		.table = PushAlignedZeroStruct(*arena, StringInterningTable, 64),
+	};
+	return interning;
 }
 
-float GetSecondsElapsed(Clock start, Clock end)
+static void GrowStringInterningShard(StringInterning *context, StringInterningShard &shard)
 {
-	f32 elapsedSeconds;
-#if PLATFORM_WINDOWS
-	ASSERT( start.counter.QuadPart <= end.counter.QuadPart );
-	elapsedSeconds = (
-			(float)(end.counter.QuadPart - start.counter.QuadPart) /
-			(float)gPerformanceCounterFrequency );
-	return elapsedSeconds;
-#elif PLATFORM_LINUX || PLATFORM_ANDROID
-	ASSERT( start.timeSpec.tv_sec < end.timeSpec.tv_sec || (
-				start.timeSpec.tv_sec == end.timeSpec.tv_sec &&
-				start.timeSpec.tv_nsec <= end.timeSpec.tv_nsec ) );
-	if ( start.timeSpec.tv_sec == end.timeSpec.tv_sec )
+	const u32 capacity = shard.capacity ? 2 * shard.capacity : STRING_INTERNING_MIN_CAPACITY;
+
+	AcquireSpinLock(context->table->arenaLock);
+	StringIntern *slots = PushZeroArray(*context->arena, StringIntern, capacity);
+	ReleaseSpinLock(context->table->arenaLock);
+
+	const u32 mask = capacity - 1;
+	for (u32 i = 0; i < shard.capacity; ++i)
 	{
-		elapsedSeconds = SECONDS_FROM_NANOSECONDS( end.timeSpec.tv_nsec - start.timeSpec.tv_nsec );
+		const StringIntern &intern = shard.slots[i];
+		if ( intern.str )
+		{
+			u32 index = intern.hash & mask;
+			while ( slots[index].str ) index = (index + 1) & mask;
+			slots[index] = intern;
+		}
 	}
-	else
+
+	shard.slots = slots;
+	shard.capacity = capacity;
+}
+
+const char *MakeStringIntern(StringInterning *context, const char *str, u32 len)
+{
+	ASSERT(context && context->table);
+	const u64 hash64 = Hash64(str, len);
+	const u32 hash = (u32)hash64;
+	StringInterningShard &shard = context->table->shards[hash64 >> (64 - STRING_INTERNING_SHARD_BITS)];
+
+	AcquireSpinLock(shard.lock);
+
+	u32 index = 0;
+	if ( shard.capacity )
 	{
-		elapsedSeconds = end.timeSpec.tv_sec - start.timeSpec.tv_sec - 1;
-		elapsedSeconds += 1.0f - SECONDS_FROM_NANOSECONDS( start.timeSpec.tv_nsec );
-		elapsedSeconds += SECONDS_FROM_NANOSECONDS( end.timeSpec.tv_nsec );
+		const u32 mask = shard.capacity - 1;
+		index = hash & mask;
+		while ( shard.slots[index].str )
+		{
+			const StringIntern &intern = shard.slots[index];
+			if ( intern.hash == hash && intern.len == len && MemCompare(intern.str, str, len) == 0 )
+			{
+				ReleaseSpinLock(shard.lock);
+				return intern.str; // found!
+			}
+			index = (index + 1) & mask;
+		}
 	}
-#endif
-	return elapsedSeconds;
+
+	// Not found. Keep the load factor under 3/4, growing moves the empty slot for it.
+	if ( 4 * (shard.count + 1) > 3 * shard.capacity )
+	{
+		GrowStringInterningShard(context, shard);
+		const u32 mask = shard.capacity - 1;
+		index = hash & mask;
+		while ( shard.slots[index].str ) index = (index + 1) & mask;
+	}
+
+	// Insert it in the first empty slot
+	AcquireSpinLock(context->table->arenaLock);
+	const char *internStr = PushStringN(*context->arena, str, len);
+	ReleaseSpinLock(context->table->arenaLock);
+
+	StringIntern &intern = shard.slots[index];
+	intern.str = internStr;
+	intern.len = len;
+	intern.hash = hash;
+	shard.count++;
+
+	ReleaseSpinLock(shard.lock);
+	return internStr;
+}
+
+const char *MakeStringIntern(StringInterning *context, const char *str)
+{
+	const u32 len = StrLen(str);
+	const char *internStr = MakeStringIntern(context, str, len);
+	return internStr;
 }
 
 
@@ -1711,9 +3929,10 @@ struct Platform
 {
 	// To be configured by the client app
 
-	u32 globalMemorySize = MB(64);
-	u32 frameMemorySize = MB(16);
-	u32 stringMemorySize = KB(16);
+	// Global and frame arenas are growable, these only reserve address space
+	u64 globalMemorySize = GB(64);
+	u64 frameMemorySize = GB(4);
+	u64 stringMemorySize = KB(16);
 
 	bool (*InitCallback)(Platform &);
 	void (*UpdateCallback)(Platform &);
@@ -2496,11 +4715,8 @@ bool PlatformRun(Platform &platform)
 		return false;
 	}
 
-	byte *baseMemory = (byte*)AllocateVirtualMemory(platform.globalMemorySize);
-	platform.globalArena = MakeArena(baseMemory, platform.globalMemorySize);
-
-	byte *frameMemory = (byte*)AllocateVirtualMemory(platform.frameMemorySize);
-	platform.frameArena = MakeArena(frameMemory, platform.frameMemorySize);
+	platform.globalArena = MakeGrowableArena(platform.globalMemorySize);
+	platform.frameArena = MakeGrowableArena(platform.frameMemorySize);
 
 	byte *stringMemory = (byte*)AllocateVirtualMemory(platform.stringMemorySize);
 	platform.stringArena = MakeArena(stringMemory, platform.stringMemorySize);
@@ -625,17 +625,20 @@ struct GraphicsDevice
 	u32 bufferViewCount;
 
 	Image images[MAX_IMAGES + MAX_SWAPCHAIN_IMAGE_COUNT];
-	u32 imageCount;
-	u32 freeImages[MAX_IMAGES];
+	Pool imagePool; // Over the first MAX_IMAGES images, swapchain ones come after
 
 	Sampler samplers[MAX_SAMPLERS];
 	u32 samplerCount;
 
 	Pipeline pipelines[MAX_PIPELINES];
 	u32 pipelineCount;
+	HashMapEntry pipelineMapEntries[2 * MAX_PIPELINES];
+	HashMap pipelineMap; // From name to pipeline index
 
 	RenderPass renderPasses[MAX_RENDERPASSES];
 	u32 renderPassCount;
+	HashMapEntry renderPassMapEntries[2 * MAX_RENDERPASSES];
+	HashMap renderPassMap; // From name to render pass index
 };
 
 
@@ -1224,13 +1227,12 @@ struct ShaderBindings
 
 static ShaderBindings ReflectShaderBindings( Arena scratch, byte* microcodeData[], const u64 microcodeSize[], u32 microcodeCount )
 {
-	void *tempMem = scratch.base + scratch.used;
-	const u32 tempMemSize = scratch.size - scratch.used;
-
 	SpvDescriptorSetList spvDescriptorList = {};
 	for (u32 i = 0; i < microcodeCount; ++i)
 	{
 		SpvParser parser = SpvParserInit( microcodeData[i], microcodeSize[i] );
+		const u32 tempMemSize = sizeof(SpvId) * (parser.header->bound + 1);
+		void *tempMem = PushSize(scratch, tempMemSize);
 		SpvParseDescriptors( &parser, &spvDescriptorList, tempMem, tempMemSize );
 	}
 
@@ -2088,10 +2090,12 @@ bool InitializeGraphicsDevice(GraphicsDevice &device, Arena scratch, Window &win
 	VK_CALL( vkCreateCommandPool(device.handle, &transientCommandPoolCreateInfo, VULKAN_ALLOCATORS, &device.transientCommandPool) );
 
 
-	// Initialize image list
-	for ( u32 i = 0; i < MAX_IMAGES; ++i ) {
-		device.freeImages[i] = i;
-	}
+	// Initialize image pool
+	device.imagePool = MakePool((byte*)device.images, sizeof(Image), MAX_IMAGES);
+
+	// Initialize name lookups
+	device.pipelineMap = MakeHashMap(device.pipelineMapEntries, ARRAY_COUNT(device.pipelineMapEntries));
+	device.renderPassMap = MakeHashMap(device.renderPassMapEntries, ARRAY_COUNT(device.renderPassMapEntries));
 
 	// Create swapchain
 	device.swapchain = CreateSwapchain( device, window, device.swapchainInfo );
@@ -2199,7 +2203,7 @@ void ResetBindGroupAllocator(const GraphicsDevice &device, BindGroupAllocator &b
 BindGroupLayout CreateBindGroupLayout(GraphicsDevice &device, const ShaderBinding bindings[], u8 bindingCount)
 {
 	// Try finding if an equal layout was already created
-	const u32 crc = HashFNV(bindings, bindingCount);
+	const u32 crc = (u32)Hash64(bindings, bindingCount * sizeof(ShaderBinding));
 
 	for (u32 i = 0; i < device.bindGroupLayoutCount; ++i)
 	{
@@ -2504,9 +2508,10 @@ Image CreateImageInternal(GraphicsDevice &device, u32 width, u32 height, u32 mip
 
 ImageH CreateImage(GraphicsDevice &device, u32 width, u32 height, u32 mipLevels, Format format, ImageUsageFlags usage, HeapType heapType)
 {
-	ASSERT( device.imageCount < MAX_IMAGES );
-	ImageH imageH = { .index = device.freeImages[device.imageCount++] };
-	device.images[imageH.index] = CreateImageInternal(device, width, height, mipLevels, format, usage, heapType);
+	Image *image = PoolAllocStruct(device.imagePool, Image);
+	ASSERT( image != NULL && "Too many images" );
+	*image = CreateImageInternal(device, width, height, mipLevels, format, usage, heapType);
+	const ImageH imageH = { .index = PoolIndex(device.imagePool, image) };
 	return imageH;
 }
 
@@ -2526,7 +2531,7 @@ const Image &GetImage(const GraphicsDevice &device, ImageH imageH)
 
 bool IsSwapchainImage(ImageH image)
 {
-	const bool isSwapchainImage = image.index < MAX_IMAGES;
+	const bool isSwapchainImage = image.index >= FIRST_SWAPCHAIN_IMAGE_INDEX;
 	return isSwapchainImage;
 }
 
@@ -2547,8 +2552,7 @@ void DestroyImage(GraphicsDevice &device, ImageH imageH)
 
 	if ( !IsSwapchainImage(imageH) )
 	{
-		ASSERT(device.imageCount > 0);
-		device.freeImages[--device.imageCount] = imageH.index;
+		PoolFree(device.imagePool, &image);
 	}
 }
 
@@ -2905,6 +2909,7 @@ PipelineH CreateGraphicsPipeline(GraphicsDevice &device, Arena &arena, const Pip
 	const PipelineH pipelineHandle = { .index = device.pipelineCount++ };
 	Pipeline &pipeline = device.pipelines[pipelineHandle.index];
 	pipeline = CreateGraphicsPipelineInternal(device, arena, desc, renderPass, globalBindGroupLayout);
+	HashMapInsert(device.pipelineMap, MakeString(pipeline.name), pipelineHandle.index);
 	return pipelineHandle;
 }
 
@@ -2914,6 +2919,7 @@ PipelineH CreateComputePipeline(GraphicsDevice &device, Arena &arena, const Comp
 	const PipelineH pipelineHandle = { .index = device.pipelineCount++ };
 	Pipeline &pipeline = device.pipelines[pipelineHandle.index];
 	pipeline = CreateComputePipelineInternal(device, arena, desc);
+	HashMapInsert(device.pipelineMap, MakeString(pipeline.name), pipelineHandle.index);
 	return pipelineHandle;
 }
 
@@ -3025,6 +3031,7 @@ RenderPassH CreateRenderPass( GraphicsDevice &device, const RenderpassDesc &desc
 	ASSERT( device.renderPassCount < ARRAY_COUNT( device.renderPasses ) );
 	const RenderPassH renderPassH = { .index = device.renderPassCount++ };
 	device.renderPasses[renderPassH.index] = CreateRenderPassInternal(device, desc);
+	HashMapInsert(device.renderPassMap, MakeString(device.renderPasses[renderPassH.index].name), renderPassH.index);
 	return renderPassH;
 }
 